@@ -1,9 +1,13 @@
 #pragma once
 
+#include "AppPaths.hpp"
 #include "ConfigManager.hpp"
+#include "ControlServer.hpp"
 #include "TorrentManager.hpp"
 #include "SearchEngine.hpp"
+#include "StartupProfiler.hpp"
 #include "SystemUtils.hpp"
+#include <future>
 
 class App
 {
@@ -12,8 +16,12 @@ public:
 	~App();
 
 	void initialize();
+	// Bounded by SHUTDOWN_FLUSH_BUDGET plus the final file writes. Resume-data
+	// collection progress is logged as replies arrive.
 	void shutdown();
 
+	static constexpr std::chrono::milliseconds SHUTDOWN_FLUSH_BUDGET{5000};
+
 	ConfigManager &torrentsConfigManager() { return torrentsConfigManager_; }
 	ConfigManager &settingsConfigManager() { return settingsConfigManager_; }
 	TorrentManager &torrentManager() { return torrentManager_; }
@@ -21,10 +29,14 @@ public:
 	Utils::SystemUtils::SystemOpener &systemOpener() { return systemOpener_; }
 
 private:
+	// Constructed first so it also times the members below.
+	Utils::StartupProfiler startupProfiler_;
 	ConfigManager torrentsConfigManager_;
 	ConfigManager settingsConfigManager_;
-	TorrentManager torrentManager_;
+	TorrentManager torrentManager_{Utils::AppPaths::sessionStatePath()};
 	SearchEngine searchEngine_;
+	ControlServer controlServer_{torrentManager_, searchEngine_};
 	Utils::SystemUtils::SystemOpener systemOpener_;
+	std::future<void> favoritesPreload_;
 	bool initialized_ = false;
 };
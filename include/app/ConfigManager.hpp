@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -7,9 +8,13 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <deque>
 #include <atomic>
 #include <future>
+#include <memory>
+#include <optional>
+#include <utility>
+#include "TorrentJournal.hpp"
 #include "TorrentManager.hpp"
 #include "Result.hpp"
 
@@ -37,11 +42,18 @@ struct PreferencesSettings
 	bool enableNatPmp = true;
 	bool torznabEnabled = false;
 	std::string torznabUrl;
+	// Query every search provider at once instead of only the active one.
+	bool searchFanOut = false;
 	bool proxyEnabled = false;
 	std::string proxyType = "socks5";
 	std::string proxyHost;
 	int proxyPort = 1080;
 	std::string proxyUsername;
+	// Auto-managed queue limits; 0 leaves the category unlimited.
+	int activeDownloads = 3;
+	int activeSeeds = 5;
+	int activeLimit = 500;
+	bool controlSocketEnabled = false;
 	struct UiLayout
 	{
 		int sidebarWidth = 240;
@@ -49,11 +61,23 @@ struct PreferencesSettings
 		bool sidebarCollapsed = false;
 		int selectedMainTab = 0;
 		int selectedDetailsTab = 0;
+
+		bool operator==(const UiLayout &) const = default;
 	} ui;
+
+	bool operator==(const PreferencesSettings &) const = default;
 };
 
 using SaveHandle = std::shared_future<Result>;
 
+// Indented output for files people edit; compact output for machine-owned
+// files such as torrents.json.
+enum class JsonFormat
+{
+	Pretty,
+	Compact
+};
+
 class ConfigManager
 {
 public:
@@ -68,12 +92,15 @@ public:
 	Result commitPreferences(const PreferencesSettings &settings);
 	PreferencesSettings getPreferencesSettings() const;
 
-	void saveTorrents(const std::vector<ManagedTorrent> &torrents);
+	// Records are built and diffed on the save worker, not the caller.
+	void saveTorrents(std::vector<ManagedTorrent> torrents);
 	Result loadTorrents(const std::string &path, std::vector<TorrentConfigData> &outTorrents);
 
-	// Favorites and search history
-	void saveFavoritesAndHistory(const std::vector<TorrentSearchResult> &favorites, const std::vector<std::string> &searchHistory);
-	void loadFavoritesAndHistory(std::vector<TorrentSearchResult> &favorites, std::vector<std::string> &searchHistory);
+	// Favorites and search history live in their own document, stored as
+	// compact rows encoded on the save worker. Entries left in the settings
+	// document by older versions are moved there when no such file exists.
+	void saveFavoritesAndHistory(const std::string &path, std::vector<TorrentSearchResult> favorites, std::vector<std::string> searchHistory);
+	Result loadFavoritesAndHistory(const std::string &path, std::vector<TorrentSearchResult> &favorites, std::vector<std::string> &searchHistory);
 
 	// Speed limit configuration
 	void setDownloadSpeedLimit(int bytesPerSecond);
@@ -104,6 +131,8 @@ public:
 	int getProxyPort() const;
 	void setProxyUsername(const std::string &username);
 	std::string getProxyUsername() const;
+	void setControlSocketEnabled(bool enable);
+	bool getControlSocketEnabled() const;
 
 	// Schema management
 	int getConfigVersion() const;
@@ -121,22 +150,64 @@ public:
 private:
 	mutable std::mutex configMutex;
 	json config;
+	// Typed view of config for the getters, replaced whole when a write
+	// changes a value. Getters never take configMutex. With
+	// std::atomic<std::shared_ptr> a replaced snapshot is freed once its last
+	// reader drops it, at the cost of the library's internal lock bit and a
+	// shared reference count on each load. Without it, readers load a plain
+	// atomic pointer and replaced snapshots are kept until destruction.
+#if defined(__cpp_lib_atomic_shared_ptr)
+	using PreferencesSnapshot = std::shared_ptr<const PreferencesSettings>;
+#else
+	using PreferencesSnapshot = const PreferencesSettings *;
+	// Every published snapshot. Requires configMutex.
+	std::vector<std::unique_ptr<const PreferencesSettings>> publishedPreferences;
+#endif
+	std::atomic<PreferencesSnapshot> preferences{};
+	PreferencesSnapshot currentPreferences() const;
+	// Requires configMutex.
+	void publishPreferencesUnlocked();
 	// Async save worker
 	struct SaveRequest {
 		std::string path;
 		json data;
 		std::shared_ptr<std::promise<Result>> completion;
+		JsonFormat format = JsonFormat::Pretty;
+		// Torrent set to journal in place of a document.
+		std::optional<std::vector<ManagedTorrent>> torrents;
+		// Favorites and history to encode in place of a document.
+		std::optional<std::pair<std::vector<TorrentSearchResult>, std::vector<std::string>>> favorites;
+		// Preferences candidates must reach disk themselves before they are
+		// committed, so later saves may not absorb them.
+		bool supersedable = true;
+	};
+
+	// Last document the worker wrote per path; only the worker touches it.
+	struct PersistedDocument {
+		std::size_t contentHash = 0;
+		std::uintmax_t serializedSize = 0;
+		std::filesystem::file_time_type writeTime;
+		std::uintmax_t size = 0;
 	};
 
 	std::thread saveThread;
-	std::queue<SaveRequest> saveQueue;
+	std::deque<SaveRequest> saveQueue;
+	std::unordered_map<std::string, PersistedDocument> persistedDocuments;
 	std::mutex queueMutex;
 	std::condition_variable queueCv;
 	std::atomic<bool> stopWorker{false};
 	std::atomic<int> activeJobs{0};
 
 	void workerLoop();
+	SaveRequest takeNextSaveRequest(std::vector<std::shared_ptr<std::promise<Result>>> &superseded);
+	bool isPersisted(const std::string &path, std::size_t contentHash, std::uintmax_t serializedSize) const;
+	Result writeTorrentSet(const std::string &path, const std::vector<ManagedTorrent> &torrents);
 	SaveHandle enqueueSave(const std::string& path, json data);
+	SaveHandle enqueueSave(SaveRequest request);
+
+	// Persisted torrent set; guarded by configMutex.
+	TorrentJournal torrentJournal;
+	std::string torrentsPath;
 
 	json createDefaultConfig() const;
 	void ensureSettingsStructure();
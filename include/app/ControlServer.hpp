@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Result.hpp"
+#include "TorrentManager.hpp"
+#include "presentation/TorrentListPresenter.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class SearchEngine;
+
+struct ControlServerOptions
+{
+	// Used for torrent.add items that do not carry their own savePath.
+	std::function<std::string()> defaultSavePath;
+	std::size_t maxClients = 16;
+	std::size_t maxMessageBytes = 1024 * 1024;
+	std::size_t maxBatchItems = 10000;
+	// Notifications are withheld above the watermark; a client whose pending
+	// responses exceed the hard limit is disconnected.
+	std::size_t notificationWatermarkBytes = 256 * 1024;
+	std::size_t maxOutgoingBytes = 8 * 1024 * 1024;
+	std::chrono::milliseconds statusInterval{500};
+};
+
+// Newline-delimited outgoing buffer for one control connection. Responses are
+// always accepted until the hard limit so a request is never silently lost;
+// notifications are refused above the watermark so callers can coalesce them.
+class ControlOutbox
+{
+public:
+	ControlOutbox(std::size_t watermarkBytes, std::size_t limitBytes);
+
+	bool pushResponse(std::string_view message);
+	bool pushNotification(std::string_view message);
+	bool acceptsNotifications() const { return size() < watermarkBytes_; }
+	std::string_view pending() const;
+	void consume(std::size_t bytes);
+	std::size_t size() const { return buffer_.size() - offset_; }
+	bool empty() const { return size() == 0; }
+
+private:
+	std::string buffer_;
+	std::size_t offset_ = 0;
+	std::size_t watermarkBytes_;
+	std::size_t limitBytes_;
+
+	void append(std::string_view message);
+};
+
+/**
+ * Local JSON-RPC 2.0 control endpoint for scripting a running instance.
+ *
+ * Requests and notifications are newline-delimited JSON over a Unix domain
+ * socket. Batches, bulk torrent operations, projected listings, and status or
+ * event subscriptions are served from one I/O thread; search requests run on a
+ * separate worker so a slow provider never stalls status delivery.
+ */
+class ControlServer
+{
+public:
+	ControlServer(TorrentManager &torrentManager, SearchEngine &searchEngine);
+	~ControlServer();
+	ControlServer(const ControlServer &) = delete;
+	ControlServer &operator=(const ControlServer &) = delete;
+
+	Result start(const std::filesystem::path &socketPath, ControlServerOptions options = {});
+	void stop();
+	bool isRunning() const { return running_.load(); }
+	std::filesystem::path socketPath() const;
+	static std::filesystem::path defaultSocketPath();
+
+private:
+	struct Client;
+	using Method = Result (ControlServer::*)(Client &, const nlohmann::json &, nlohmann::json &);
+
+	TorrentManager &torrentManager_;
+	SearchEngine &searchEngine_;
+	ControlServerOptions options_;
+	std::filesystem::path socketPath_;
+	std::intptr_t listenSocket_ = -1;
+	std::atomic<bool> running_{false};
+	std::atomic<bool> stopRequested_{false};
+	std::thread ioThread_;
+
+	mutable std::mutex clientsMutex_;
+	std::unordered_map<std::uint64_t, std::shared_ptr<Client>> clients_;
+	std::uint64_t nextClientId_ = 1;
+
+	// The presenter caches an id registry and is shared by the I/O thread and
+	// the search worker when a batch mixes search with torrent methods.
+	std::mutex presenterMutex_;
+	Presentation::TorrentListPresenter presenter_;
+	std::chrono::steady_clock::time_point lastStatusPublish_;
+
+	struct SlowRequest
+	{
+		std::uint64_t clientId = 0;
+		nlohmann::json message;
+	};
+	std::mutex slowMutex_;
+	std::condition_variable slowCv_;
+	std::deque<SlowRequest> slowRequests_;
+	std::thread slowWorker_;
+	std::atomic<bool> slowBusy_{false};
+
+	std::mutex eventMutex_;
+	std::vector<TorrentEvent> pendingEvents_;
+	std::uint64_t droppedEvents_ = 0;
+	std::uint64_t eventListenerId_ = 0;
+
+	void ioLoop();
+	void slowWorkerLoop();
+	void acceptClients();
+	bool readClient(const std::shared_ptr<Client> &client);
+	bool writeClient(const std::shared_ptr<Client> &client);
+	void closeClient(const std::shared_ptr<Client> &client);
+	void handleLine(const std::shared_ptr<Client> &client, std::string_view line);
+	void deliver(Client &client, const std::optional<nlohmann::json> &response);
+	void publishEvents();
+	void publishStatus();
+
+	std::optional<nlohmann::json> dispatchMessage(Client &client, const nlohmann::json &message);
+	std::optional<nlohmann::json> dispatchCall(Client &client, const nlohmann::json &call);
+	static bool requiresSlowLane(const nlohmann::json &message);
+	static const std::unordered_map<std::string, Method> &methods();
+
+	Result serverInfo(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result addTorrents(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result commandTorrents(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result removeTorrents(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result moveTorrents(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result queueTorrents(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result listTorrents(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result search(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result subscribe(Client &client, const nlohmann::json &params, nlohmann::json &result);
+	Result unsubscribe(Client &client, const nlohmann::json &params, nlohmann::json &result);
+};
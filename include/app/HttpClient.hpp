@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Result.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct HttpRequest
+{
+	std::string url;
+	// Bounds each attempt, and separately how long an attempt may wait for
+	// its host to admit it.
+	int timeoutSeconds = 30;
+	// Total tries, including the first; transient failures are retried once
+	// the host's backoff has passed.
+	int maxAttempts = 1;
+	std::size_t maxResponseBytes = 10 * 1024 * 1024;
+	bool useProxy = false;
+	std::string proxyType = "socks5";
+	std::string proxyHost;
+	int proxyPort = 0;
+	std::string proxyUsername;
+	std::string proxyPassword;
+	// When set, a 200 response body is handed over as it arrives instead of
+	// being buffered, on the I/O thread. Returning false rejects the body and
+	// fails the transfer with Parse; it is not retried.
+	std::function<bool(std::string_view chunk)> onBody;
+	// Runs before a retry re-sends the request, so a streaming consumer can
+	// drop what the failed attempt delivered.
+	std::function<void()> onRestart;
+};
+
+// How requests to one host are paced. Hosts are keyed by name and explicit
+// port, e.g. "torrents-csv.com" or "127.0.0.1:9117".
+struct HostPolicy
+{
+	// Sustained rate and burst of the host's token bucket; a rate of 0
+	// leaves the host unthrottled.
+	double requestsPerSecond = 1.0;
+	int burst = 10;
+	// Consecutive transient failures wait backoffBase doubled per failure
+	// (or the server's Retry-After). After failureThreshold of them the
+	// circuit opens: requests to the host fail at once for cooldown, doubled
+	// per reopening up to eight times, and then a single probe goes out.
+	std::chrono::milliseconds backoffBase{500};
+	int failureThreshold = 5;
+	std::chrono::milliseconds cooldown{30000};
+};
+
+/**
+ * Runs HTTP transfers on one long-lived I/O thread driving curl_multi.
+ *
+ * Any number of transfers share the thread, its connection cache, and a
+ * CURLSH holding DNS entries and TLS sessions. Submissions, cancellations,
+ * and shutdown wake the loop through curl_multi_wakeup. Each host has a
+ * token bucket, a backoff, and a circuit breaker that outlive individual
+ * requests: a transfer waits on the loop's timer until its host admits it,
+ * and fails at once when the host's circuit is open or the wait would take
+ * longer than its timeout. The
+ * thread starts with the first transfer.
+ */
+class HttpClient
+{
+public:
+	using Completion = std::function<void(Result result, std::string body)>;
+
+	// Host key of a URL as used for policies; empty if it does not parse.
+	static std::string hostKey(const std::string &url);
+	// Applies to transfers submitted afterwards.
+	void setHostPolicy(const std::string &host, HostPolicy policy);
+	void setDefaultHostPolicy(HostPolicy policy);
+
+	HttpClient();
+	~HttpClient();
+	HttpClient(const HttpClient &) = delete;
+	HttpClient &operator=(const HttpClient &) = delete;
+
+	// Queues a transfer. The completion runs exactly once on the I/O thread,
+	// with Cancelled after cancel() or shutdown(), so it must not block.
+	uint64_t submit(HttpRequest request, Completion completion);
+	void cancel(uint64_t id);
+
+	// Runs a transfer and blocks the caller until it completes. cancelled is
+	// re-checked whenever wakeWaiters() is called, and at least every
+	// 250 ms for conditions that change with time such as deadlines.
+	Result perform(HttpRequest request, std::string &body, const std::function<bool()> &cancelled = {});
+	// Makes blocked perform() calls re-check their cancellation condition.
+	void wakeWaiters();
+
+	// Cancels every transfer and joins the I/O thread. Later submissions
+	// complete immediately with Unavailable.
+	void shutdown();
+
+private:
+	struct Transfer;
+	struct Loop;
+
+	void ensureStarted();
+	void wake();
+
+	std::mutex mutex_;
+	std::unique_ptr<Loop> loop_;
+	std::thread thread_;
+	bool stopping_ = false;
+	std::atomic<uint64_t> nextId_{1};
+	std::vector<std::unique_ptr<Transfer>> submitted_;
+	std::vector<uint64_t> cancelled_;
+	std::unordered_map<std::string, HostPolicy> hostPolicies_;
+	HostPolicy defaultPolicy_;
+
+	std::mutex waitMutex_;
+	std::condition_variable waitChanged_;
+	uint64_t wakeGeneration_ = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Result.hpp"
+#include "SearchEngine.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Offline index over favorites and recently seen search results.
+ *
+ * Names and categories are split into lowercase words and indexed by the
+ * trigrams of each word, so lookups match partial words and tolerate small
+ * typos without touching the network. Matches are ranked by the share of
+ * query trigrams they contain, then favorites, then seeders. Results not seen
+ * for maxAge are dropped unless they are favorites.
+ */
+class LocalSearchIndex
+{
+public:
+	using Clock = std::chrono::system_clock;
+
+	static constexpr std::size_t MAX_DOCUMENTS = 50000;
+
+	LocalSearchIndex();
+	explicit LocalSearchIndex(Clock::duration maxAge);
+
+	// Adds results a provider returned, or refreshes their counters.
+	void record(const std::vector<TorrentSearchResult> &results, Clock::time_point now = Clock::now());
+	void setFavorite(const TorrentSearchResult &result, bool favorite, Clock::time_point now = Clock::now());
+	// Marks exactly these results as favorites.
+	void syncFavorites(const std::vector<TorrentSearchResult> &favorites, Clock::time_point now = Clock::now());
+
+	// Best matches first; empty when the query has no letter or digit.
+	std::vector<TorrentSearchResult> search(std::string_view query, std::size_t limit = 50) const;
+	std::size_t size() const;
+	bool dirty() const;
+
+	// Entries already in the index are kept over those in the file.
+	Result load(const std::filesystem::path &path, Clock::time_point now = Clock::now());
+	Result save(const std::filesystem::path &path, Clock::time_point now = Clock::now());
+
+private:
+	struct Document
+	{
+		TorrentSearchResult result;
+		int64_t lastSeen = 0;
+		bool favorite = false;
+		bool live = true;
+		std::string text;
+	};
+
+	static std::string documentKey(const TorrentSearchResult &result);
+	static std::vector<uint32_t> trigrams(std::string_view text);
+	// keepFavorite leaves the flag of an existing entry alone.
+	void upsertUnlocked(const TorrentSearchResult &result, int64_t seen, bool favorite, bool keepFavorite);
+	void addUnlocked(Document document, const std::string &key);
+	void dropUnlocked(uint32_t id);
+	void pruneUnlocked(int64_t now);
+	void rebuildUnlocked();
+
+	Clock::duration maxAge_;
+	mutable std::mutex mutex_;
+	std::vector<Document> documents_;
+	std::unordered_map<std::string, uint32_t> idByKey_;
+	// Trigram -> ids of the documents containing it, in ascending order.
+	std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;
+	std::size_t liveCount_ = 0;
+	bool dirty_ = false;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Result.hpp"
+#include "SearchEngine.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * Least-recently-used cache of search pages, bounded by an estimate of the
+ * bytes its responses occupy.
+ *
+ * Pages are keyed by a stable 64-bit hash of provider, query, page size and
+ * page token. A page is fresh for a while after it was stored, then stale
+ * until it expires: stale pages are still served, and the first lookup that
+ * sees one is asked to refresh it. The most recently used pages can be saved
+ * to a file and read back on the next start, where they come back stale.
+ */
+class SearchCache
+{
+public:
+	using Clock = std::chrono::system_clock;
+
+	struct Limits
+	{
+		std::size_t maxBytes = 16 * 1024 * 1024;
+		// Budget for the pages written by save().
+		std::size_t diskBytes = 2 * 1024 * 1024;
+		Clock::duration freshFor = std::chrono::minutes(5);
+		Clock::duration staleFor = std::chrono::hours(24);
+	};
+
+	enum class Hit
+	{
+		Miss,
+		Fresh,
+		Stale
+	};
+
+	SearchCache();
+	explicit SearchCache(Limits limits);
+
+	static uint64_t makeKey(std::string_view provider, std::string_view query, int maxResults, std::string_view pageToken);
+	// Estimated heap footprint of a response, as charged against maxBytes.
+	static std::size_t estimateBytes(const SearchResponse &response);
+
+	// Copies a cached page into response. On a Stale hit refresh is set for
+	// exactly one caller until the page is stored again or releaseRefresh().
+	Hit lookup(uint64_t key, SearchResponse &response, bool &refresh, Clock::time_point now = Clock::now());
+	// Pages larger than the whole budget are not kept.
+	void store(uint64_t key, SearchResponse response, Clock::time_point now = Clock::now());
+	void releaseRefresh(uint64_t key);
+	bool isFresh(uint64_t key, Clock::time_point now = Clock::now()) const;
+	void clear();
+
+	std::size_t size() const;
+	std::size_t bytes() const;
+
+	// scope identifies the configuration the pages were fetched with, e.g.
+	// the endpoints; a file written under another scope is ignored.
+	Result load(const std::filesystem::path &path, std::string_view scope, Clock::time_point now = Clock::now());
+	Result save(const std::filesystem::path &path, std::string_view scope) const;
+
+private:
+	struct Entry
+	{
+		uint64_t key = 0;
+		SearchResponse response;
+		std::size_t bytes = 0;
+		Clock::time_point storedAt;
+		bool refreshing = false;
+	};
+
+	void insertUnlocked(uint64_t key, SearchResponse &&response, Clock::time_point storedAt, bool mostRecent);
+	void eraseUnlocked(std::list<Entry>::iterator entry);
+
+	Limits limits_;
+	mutable std::mutex mutex_;
+	// Most recently used first.
+	std::list<Entry> entries_;
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+	std::size_t bytes_ = 0;
+};
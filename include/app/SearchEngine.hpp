@@ -1,12 +1,15 @@
 #pragma once
 
 #include "Result.hpp"
+#include "utils/BoundedQueue.hpp"
 #include <string>
 #include <vector>
 #include <memory>
 #include <functional>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <atomic>
 #include <unordered_map>
 #include <unordered_set>
@@ -14,6 +17,8 @@
 #include <cstdint>
 #include <chrono>
 
+struct HttpRequest;
+
 struct TorrentSearchResult
 {
 	std::string name;
@@ -58,6 +63,13 @@ struct SearchResponse
 	bool hasMore = false;
 };
 
+// Results a provider of an async search has parsed so far.
+struct SearchBatch
+{
+	uint64_t requestId = 0;
+	std::vector<TorrentSearchResult> torrents;
+};
+
 struct CompletedSearch
 {
 	uint64_t requestId = 0;
@@ -70,22 +82,68 @@ class SearchEngine
 public:
 	friend class SearchEngineTest;
 	using SearchProvider = std::function<Result(const SearchQuery &, SearchResponse &, const std::function<bool()> &)>;
+	// Streaming providers hand results to the sink as they parse them, and
+	// still return every result in the response. The sink may be empty.
+	using SearchResultSink = std::function<void(std::vector<TorrentSearchResult> &&)>;
+	using StreamingSearchProvider = std::function<Result(const SearchQuery &, SearchResponse &, const std::function<bool()> &,
+		const SearchResultSink &)>;
 	SearchEngine();
 	~SearchEngine();
 
 	// Core search functionality
 	Result searchTorrents(const SearchQuery &query, std::vector<TorrentSearchResult> &results);
 	Result searchTorrents(const SearchQuery &query, SearchResponse &response);
+	// A plain provider streams its whole response once it returns.
 	Result registerSearchProvider(const std::string &id, SearchProvider provider);
+	Result registerStreamingSearchProvider(const std::string &id, StreamingSearchProvider provider);
 	Result setActiveSearchProvider(const std::string &id);
 	std::string getActiveSearchProvider() const;
 	std::vector<std::string> getSearchProviders() const;
 	Result configureTorznabProvider(const std::string &url, const std::string &apiKey = "");
 	static Result validateTorznabConfig(const std::string &url);
 	void clearSearchCache();
+	// Pages in the cache file are read on the first search and served stale
+	// while they are refreshed. saveSearchCache() writes the most recently
+	// used pages back.
+	void attachSearchCacheFile(std::string path);
+	void saveSearchCache();
+
+	// Offline lookup over favorites and every result seen in the last 30
+	// days; answers from memory, without any provider. The index file is
+	// read on first use.
+	std::vector<TorrentSearchResult> searchLocal(const std::string &query, std::size_t limit = 50);
+	void attachLocalIndexFile(std::string path);
+	void preloadLocalIndex() { ensureLocalIndexLoaded(); }
+	void saveLocalIndex();
+
+	// Fan-out mode queries torrents-csv and every registered provider in
+	// parallel and merges their results by info hash. Each provider runs
+	// until its own timeout, which defaults to the HTTP timeout; once one
+	// provider has answered, the rest get the grace period before they are
+	// cancelled. Providers must poll their cancellation callback.
+	void setFanOutEnabled(bool enabled);
+	bool getFanOutEnabled() const;
+	void setProviderTimeout(const std::string &id, std::chrono::milliseconds timeout);
+	void setFanOutGrace(std::chrono::milliseconds grace);
+
+	// Once a page with more results arrives, the next page is fetched in the
+	// background into the search cache, so loading more is usually answered
+	// from memory. Each provider may prefetch pagesPerMinute pages (default
+	// 6); 0 disables prefetching for it. A new query cancels the prefetch.
+	void setPrefetchBudget(const std::string &id, int pagesPerMinute);
+
+	// Paces requests to the host a provider currently uses; hosts are shared
+	// by every search, so this also bounds fan-out and prefetching. Only
+	// "torrents-csv" and "torznab" go through the engine's HTTP client.
+	// 0 requests per minute leaves the host unthrottled.
+	Result setProviderRateLimit(const std::string &id, int requestsPerMinute, int burst);
 
 	// Async searches publish owned completions for the UI thread to consume.
+	// Before that, results are queued in batches as providers parse them; a
+	// batch is dropped when the queue is full, and the completion still
+	// carries every result.
 	Result startSearch(const SearchQuery &query, uint64_t &requestId);
+	std::optional<SearchBatch> takeSearchBatch();
 	std::optional<CompletedSearch> takeCompletedSearch();
 	void shutdown();
 
@@ -97,12 +155,16 @@ public:
 	void addToFavorites(const TorrentSearchResult &result);
 	void removeFromFavorites(const std::string &infoHash);
 	std::vector<TorrentSearchResult> getFavorites() const;
-	uint64_t getFavoritesRevision() const { return favoritesRevision; }
+	uint64_t getFavoritesRevision() const;
 	bool isFavorite(const std::string &infoHash) const;
 
-	// Persistence
-	void saveFavoritesAndHistory(class ConfigManager &configManager);
-	void loadFavoritesAndHistory(class ConfigManager &configManager);
+	// Persistence. The store is read on first access to favorites or history,
+	// and saves are skipped until either changes.
+	void attachFavoritesStore(class ConfigManager &configManager, std::string path);
+	// Reads the attached store now, e.g. from a startup worker. Readers that
+	// arrive while it runs wait for it.
+	void preloadFavorites() const { ensureFavoritesLoaded(); }
+	void saveFavoritesAndHistory();
 
 	// Configuration
 	void setApiUrl(const std::string &url);
@@ -133,38 +195,99 @@ private:
 	std::atomic<uint64_t> nextRequestId{1};
 
 	std::mutex searchMutex;
-	std::mutex threadMutex;
-	std::thread searchThread;
+	// Long-lived workers run async searches and fan-out members, so the
+	// search path does not create threads once they exist. The pool grows
+	// only when every worker is busy, e.g. while a search waits on members.
+	std::mutex workerMutex;
+	std::condition_variable workAvailable;
+	std::deque<std::function<void()>> workQueue;
+	std::vector<std::thread> workers;
+	std::size_t idleWorkers = 0;
+	bool workersStopping = false;
 	std::mutex completionMutex;
 	std::optional<CompletedSearch> completedSearch;
+	// Filled by workers and drained by the UI thread without locking.
+	Utils::BoundedQueue<SearchBatch> searchBatches{256};
 
-	std::vector<std::string> searchHistory;
-	std::vector<TorrentSearchResult> favorites;
-	std::atomic<uint64_t> favoritesRevision{0};
+	// Filled from the attached store on first use.
+	mutable std::vector<std::string> searchHistory;
+	mutable std::vector<TorrentSearchResult> favorites;
+	mutable std::atomic<uint64_t> favoritesRevision{0};
+	std::atomic<uint64_t> historyRevision{0};
 	mutable std::mutex historyMutex;
-	std::unordered_set<std::string> favoriteHashes;
+	mutable std::unordered_set<std::string> favoriteHashes;
 	mutable std::mutex favoritesMutex;
+	class ConfigManager *favoritesStore = nullptr;
+	std::string favoritesPath;
+	mutable bool favoritesLoaded = false;
+	mutable uint64_t savedFavoritesRevision = 0;
+	mutable uint64_t savedHistoryRevision = 0;
+	// Guards the store fields above; taken before favoritesMutex and historyMutex.
+	mutable std::mutex favoritesStoreMutex;
+	void ensureFavoritesLoaded() const;
 	mutable std::mutex settingsMutex;
 	mutable std::mutex providersMutex;
-	std::unordered_map<std::string, SearchProvider> providers;
+	std::unordered_map<std::string, StreamingSearchProvider> providers;
 	std::string activeProvider = "torrents-csv";
-	struct CachedSearch
-	{
-		SearchResponse response;
-		std::chrono::steady_clock::time_point expiresAt;
-	};
-	mutable std::mutex cacheMutex;
-	std::unordered_map<std::string, CachedSearch> searchCache;
+	bool fanOutEnabled = false;
+	std::unordered_map<std::string, std::chrono::milliseconds> providerTimeouts;
+	std::chrono::milliseconds fanOutGrace{2000};
+	std::string torznabEndpoint;
+	// Fresh pages are served for five minutes, then served stale while a
+	// worker refreshes them.
+	std::unique_ptr<class SearchCache> searchCache;
+	std::mutex searchCacheFileMutex;
+	std::string searchCachePath;
+	bool searchCacheLoaded = false;
+	std::string searchCacheScope() const;
+	void ensureSearchCacheLoaded();
+	// Fed from every successful fetch, prefetches and refreshes included.
+	std::unique_ptr<class LocalSearchIndex> localIndex;
+	std::mutex localIndexFileMutex;
+	std::string localIndexPath;
+	bool localIndexLoaded = false;
+	void ensureLocalIndexLoaded();
+	// At most one prefetch runs; a search for the page it is fetching waits
+	// for it instead of sending the same request.
+	std::mutex prefetchMutex;
+	std::condition_variable prefetchChanged;
+	std::unordered_map<std::string, int> prefetchBudgets;
+	std::unordered_map<std::string, std::deque<std::chrono::steady_clock::time_point>> prefetchHistory;
+	std::optional<uint64_t> prefetchingKey;
+	std::atomic<uint64_t> prefetchGeneration{0};
+	void schedulePrefetch(const SearchQuery &query, const SearchResponse &response, const std::string &providerId,
+		bool fanOut, const StreamingSearchProvider &provider);
+	bool waitForPrefetch(uint64_t cacheKey);
+	void cancelPrefetch();
+	// Every request runs on the client's curl_multi thread, so repeated
+	// searches and page loads reuse warm connections.
+	std::unique_ptr<class HttpClient> httpClient;
 
 	// HTTP client methods
-	Result makeHttpRequest(const std::string &url, std::string &response);
+	// cancelled, when set, aborts the request in addition to cancelCurrentSearch().
+	Result makeHttpRequest(const std::string &url, std::string &response, const std::function<bool()> &cancelled = {});
+	HttpRequest buildHttpRequest(const std::string &url) const;
+	Result performHttpRequest(HttpRequest request, std::string &response, const std::function<bool()> &cancelled);
 	std::string buildSearchUrl(const SearchQuery &query) const;
 	Result parseSearchResponse(const std::string &response, std::vector<TorrentSearchResult> &results);
 	Result parseSearchResponse(const std::string &response, SearchResponse &searchResponse);
 	Result parseTorznabResponse(const std::string &response, SearchResponse &searchResponse);
-	Result performSearch(const SearchQuery &query, SearchResponse &response);
+	// sink, when set, receives results as they are parsed; pages served from
+	// the cache arrive only in the response.
+	Result performSearch(const SearchQuery &query, SearchResponse &response, const SearchResultSink &sink = {});
+	// Runs the search without the cache; fanOut and provider are resolved by
+	// performSearch. cancelled, when set, aborts in addition to cancelCurrentSearch().
+	Result fetchSearch(const SearchQuery &query, SearchResponse &response, bool fanOut, const StreamingSearchProvider &provider,
+		const std::function<bool()> &cancelled = {}, const SearchResultSink &sink = {});
+	Result performFanOutSearch(const SearchQuery &query, SearchResponse &response, const std::function<bool()> &cancelled = {},
+		const SearchResultSink &sink = {});
+	Result searchTorrentsCsv(const SearchQuery &query, SearchResponse &response, const std::function<bool()> &cancelled,
+		const SearchResultSink &sink = {});
 	bool tryStartSearch();
 	void finishSearch();
+	// Queues a job for the worker pool; fails once shutdown() has begun.
+	Result post(std::function<void()> job);
+	void runWorker();
 
 	// Utility methods
 };
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Result.hpp"
+#include "SearchEngine.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Lowercases a 40 or 64 character hex info hash; false if it is neither.
+bool normalizeInfoHash(std::string &hash);
+
+/**
+ * Incremental parser for torrents-csv JSON responses.
+ *
+ * The body can be fed in any chunking, e.g. straight from the transfer, and
+ * each torrent is appended to the response as soon as its object closes, so
+ * no document tree is built and only the string being read is buffered.
+ * Accepts a bare array of torrents or an object with a "torrents" (preferred)
+ * or "data" array and an optional "next" page token.
+ */
+class TorrentsCsvParser
+{
+public:
+	// Appended results skip hashes already present when deduplicate is set.
+	TorrentsCsvParser(SearchResponse &response, bool deduplicate);
+
+	// Returns false once the body is known to be malformed.
+	bool feed(std::string_view chunk);
+	// Ends the body; fails if it was malformed, incomplete, or held no list.
+	Result finish();
+	// Drops everything parsed so far, e.g. before a retried transfer.
+	void reset();
+
+	std::size_t parsedCount() const { return parsed_; }
+
+private:
+	enum class Expect : uint8_t { Value, FirstValueOrEnd, FirstKeyOrEnd, Key, Colon, CommaOrEnd, Done };
+	enum class Token : uint8_t { None, String, Number, Literal };
+	enum class Kind : uint8_t { String, Number, Boolean, Null, Container };
+	enum class List : uint8_t { None, Torrents, Data };
+	enum class Field : uint8_t { Other, Name, InfoHash, SizeBytes, Seeders, Leechers, CreatedUnix, ScrapedDate, Completed, Torrents, Data, Next };
+
+	bool fail(std::string message);
+	bool step(char character);
+	bool consumeString(std::string_view chunk, std::size_t &index);
+	bool endNumber();
+	bool endLiteral();
+	bool endValue();
+	bool openContainer(char type);
+	bool closeContainer(char type);
+	void onKey();
+	void onScalar(Kind kind);
+	void applyField(Kind kind);
+	void beginItem();
+	void endItem();
+	void emit(TorrentSearchResult &&result);
+
+	SearchResponse &response_;
+	bool deduplicate_;
+	std::size_t initialSize_;
+	std::string initialNextToken_;
+	bool initialHasMore_;
+
+	// Tokenizer state; survives chunk boundaries.
+	Expect expect_ = Expect::Value;
+	Token token_ = Token::None;
+	std::vector<char> stack_;
+	std::string text_;
+	bool stringIsKey_ = false;
+	bool escape_ = false;
+	int unicodeDigits_ = -1;
+	uint32_t unicodeValue_ = 0;
+	uint32_t highSurrogate_ = 0;
+	std::size_t consumed_ = 0;
+	std::size_t position_ = 0;
+	std::size_t bomBytes_ = 0;
+	std::string error_;
+
+	// Document state.
+	Field rootKey_ = Field::Other;
+	List list_ = List::None;
+	std::size_t listDepth_ = 0;
+	bool sawList_ = false;
+	bool sawTorrents_ = false;
+	std::vector<TorrentSearchResult> dataItems_;
+	std::unordered_set<std::string> seenHashes_;
+	std::size_t parsed_ = 0;
+
+	// Torrent being read.
+	bool inItem_ = false;
+	Field field_ = Field::Other;
+	TorrentSearchResult item_;
+	bool nameValid_ = false;
+	bool hashValid_ = false;
+	bool hasCreated_ = false;
+};
+
+/**
+ * Incremental parser for Torznab (RSS) search responses.
+ *
+ * Tokenizes the XML subset Torznab feeds use (elements, attributes, the
+ * predefined and numeric entities, CDATA, comments) in one pass over bytes
+ * fed in any chunking. Only the text of elements that map to a result field
+ * is kept, and each item is converted when it closes. At most MAX_RESULTS
+ * items are read; the newznab:response offset and total drive pagination.
+ */
+class TorznabParser
+{
+public:
+	static constexpr std::size_t MAX_RESULTS = 500;
+
+	// Clears the response; results replace whatever it held.
+	explicit TorznabParser(SearchResponse &response);
+
+	// Returns false once the feed turned out to be a provider error.
+	bool feed(std::string_view chunk);
+	Result finish();
+	void reset();
+
+private:
+	enum class State : uint8_t { Text, Markup, Declaration, Comment, CData, Instruction, Skip, TagName, EndTagName, Attributes, IgnoredAttributes, AttributeName, BeforeValue, AttributeValue, SelfClose };
+	enum class Field : uint8_t { Title, Guid, Link, Size, Category, PubDate, InfoHash, MagnetUri, Seeders, Peers, Count, None = Count };
+
+	void consume(char character);
+	void appendDecoded(std::string &output, char character);
+	void flushEntity(std::string &output);
+	void abandonEntity(std::string &output);
+	std::string_view attribute(std::string_view name) const;
+	void startElement(bool selfClosing);
+	void endElement();
+	void endItem();
+
+	SearchResponse &response_;
+
+	State state_ = State::Text;
+	std::string name_;
+	std::string markup_;
+	std::string entity_;
+	bool inEntity_ = false;
+	char quote_ = '"';
+	int pendingBrackets_ = 0;
+	int pendingDashes_ = 0;
+	char previous_ = 0;
+	// Attributes of the current tag; entries past attributeCount_ are
+	// kept only for their capacity.
+	std::vector<std::pair<std::string, std::string>> attributes_;
+	std::size_t attributeCount_ = 0;
+	std::size_t consumed_ = 0;
+
+	std::size_t depth_ = 0;
+	bool errorSeen_ = false;
+	std::string errorDescription_;
+	bool pageSeen_ = false;
+	long long offset_ = 0;
+	long long total_ = 0;
+
+	bool inItem_ = false;
+	std::size_t itemDepth_ = 0;
+	Field capture_ = Field::None;
+	std::size_t captureDepth_ = 0;
+	std::string fields_[static_cast<std::size_t>(Field::Count)];
+	bool fieldSeen_[static_cast<std::size_t>(Field::Count)] = {};
+	std::unordered_set<std::string> seenHashes_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Result.hpp"
+
+// Append-only change log for the persisted torrent set. torrents.json holds a
+// compacted snapshot tagged with a generation; the journal next to it holds
+// put and remove records for that generation. Each record line starts with a
+// CRC-32 of its payload so replay stops at a torn or corrupt tail.
+//
+// The in-memory state is not synchronized; ConfigManager guards it with its
+// configuration mutex and performs the file I/O on its save worker.
+class TorrentJournal
+{
+public:
+	// Compaction runs once the journal outgrows the snapshot it amends, but
+	// never for journals below this size.
+	static constexpr std::uintmax_t MIN_COMPACTION_BYTES = 1024 * 1024;
+
+	struct Entry
+	{
+		std::string key;
+		nlohmann::json value;
+	};
+
+	// Pending file work. A compaction replaces the snapshot and starts a new
+	// journal generation; otherwise records are appended to the current one.
+	struct Write
+	{
+		bool compact = false;
+		std::uint64_t generation = 0;
+		nlohmann::json snapshot;
+		std::string records;
+	};
+
+	static std::filesystem::path journalPathFor(const std::filesystem::path &snapshotPath);
+
+	// Resets the state to a loaded snapshot, replays the matching journal on
+	// top of it, and returns the merged entries in restore order.
+	std::vector<Entry> restore(const nlohmann::json &snapshot, const std::filesystem::path &journalPath);
+	// Same, for a snapshot already split into its generation and entries, as
+	// produced by a streaming reader. Entries without a key are keyed as
+	// legacy entries; non-object values are skipped.
+	std::vector<Entry> restore(std::uint64_t generation, std::vector<Entry> snapshot, const std::filesystem::path &journalPath);
+
+	// Diffs the current torrent set against the persisted state. Returns
+	// nothing when the set is unchanged.
+	std::optional<Write> stage(std::vector<Entry> entries);
+
+	// Forces the next stage() to compact, e.g. after a failed write left the
+	// files behind the in-memory state.
+	void invalidate();
+
+	const nlohmann::json *find(const std::string &key) const;
+
+	// Worker-side file operations.
+	static Result begin(const std::filesystem::path &journalPath, std::uint64_t generation);
+	static Result append(const std::filesystem::path &journalPath, const std::string &records);
+
+private:
+	struct Stored
+	{
+		nlohmann::json value;
+		std::size_t bytes = 0;
+	};
+
+	void store(const std::string &key, nlohmann::json value, std::size_t bytes);
+	bool replay(const std::filesystem::path &journalPath);
+
+	std::uint64_t generation_ = 0;
+	std::vector<std::string> order_;
+	std::unordered_map<std::string, Stored> entries_;
+	std::uintmax_t snapshotBytes_ = 0;
+	std::uintmax_t journalBytes_ = 0;
+	bool needsCompaction_ = true;
+};
@@ -2,10 +2,12 @@
 
 #include "Result.hpp"
 #include <libtorrent/session.hpp>
+#include <libtorrent/session_params.hpp>
 #include <libtorrent/torrent_info.hpp>
 #include <libtorrent/add_torrent_params.hpp>
 #include <libtorrent/magnet_uri.hpp>
 #include <libtorrent/info_hash.hpp>
+#include <filesystem>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -20,6 +22,8 @@
 #include <thread>
 #include <deque>
 #include <array>
+#include <functional>
+#include <span>
 
 #include "Logger.hpp"
 #include <future>
@@ -43,6 +47,8 @@ struct TorrentEvent
 	std::optional<lt::info_hash_t> hash;
 };
 
+using TorrentEventListener = std::function<void(const TorrentEvent &)>;
+
 // A value snapshot used by the UI and persistence layers. The map containing
 // these entries never escapes TorrentManager, so callers cannot race a map
 // mutation while rendering or saving the application state.
@@ -53,8 +59,22 @@ struct ManagedTorrent
 	std::string torrentFilePath;
 	std::vector<char> resumeData;
 	std::string displayName;
+	// Persistence snapshots fill these from cached state so the records can
+	// be built without blocking calls into the session.
+	std::string savePath;
+	std::string magnetUri;
+};
+
+struct PersistenceProgress
+{
+	std::size_t completed = 0;
+	std::size_t total = 0;
 };
 
+using PersistenceProgressCallback = std::function<void(const PersistenceProgress &)>;
+// Reports how long each persisted torrent took to restore.
+using TorrentRestoreTimingCallback = std::function<void(std::chrono::nanoseconds)>;
+
 struct PersistenceSnapshotResult
 {
 	bool success = false;
@@ -78,11 +98,41 @@ enum class TorrentCommand
 	ForceRecheck,
 	MoveQueueUp,
 	MoveQueueDown,
+	MoveQueueTop,
+	MoveQueueBottom,
 	ForceReannounce,
 	EnableSequential,
 	DisableSequential
 };
 
+enum class StorageMovePolicy
+{
+	FailIfExists,
+	ReplaceExisting,
+	KeepExisting
+};
+
+// Aggregate progress of the storage moves queued since the last idle point.
+// libtorrent reports moves per torrent, so throughput advances in whole
+// torrents rather than per file.
+struct StorageMoveProgress
+{
+	std::size_t total = 0;
+	std::size_t queued = 0;
+	std::size_t active = 0;
+	std::size_t completed = 0;
+	std::size_t failed = 0;
+	std::uint64_t bytesMoved = 0;
+	std::uint64_t bytesTotal = 0;
+	std::uint64_t bytesPerSecond = 0;
+};
+
+enum class QueueMove
+{
+	Top,
+	Bottom
+};
+
 enum class TorrentDetailSection
 {
 	Files = 0,
@@ -139,18 +189,36 @@ struct TorrentDetailsSnapshot
 class TorrentManager
 {
 public:
-	TorrentManager();
+	// A non-empty sessionStatePath restores DHT nodes and session settings saved
+	// by a previous run so discovery does not bootstrap from scratch.
+	explicit TorrentManager(std::filesystem::path sessionStatePath = {});
 	~TorrentManager();
 	TorrentManager(const TorrentManager &) = delete;
 	TorrentManager &operator=(const TorrentManager &) = delete;
 	Result addTorrent(const std::string &torrentPath, const std::string &savePath = "./downloads");
 	Result addMagnetTorrent(const std::string &magnetUri, const std::string &savePath = "./downloads");
-	void addTorrentsFromConfig(const std::vector<TorrentConfigData> &torrents);
+	void addTorrentsFromConfig(const std::vector<TorrentConfigData> &torrents, const TorrentRestoreTimingCallback &timing = {});
+	// Restores on a worker thread so the window can open first. Entries not
+	// restored yet are merged unchanged into persistence snapshots, so
+	// checkpoints and the shutdown save stay complete at any point. Shutdown
+	// stops the restore between torrents. The completion callback runs on the
+	// worker.
+	void restoreTorrentsInBackground(std::vector<TorrentConfigData> torrents, TorrentRestoreTimingCallback timing = {}, std::function<void()> completed = {});
+	bool isRestoringTorrents() const { return restoringTorrents_.load(); }
 	Result removeTorrent(const lt::info_hash_t &hash, TorrentRemovalMode removeMode);
 	Result executeCommand(const lt::info_hash_t &hash, TorrentCommand command);
 	std::vector<ManagedTorrent> getTorrentSnapshot() const;
 	std::uint64_t getTorrentCollectionRevision() const { return torrentCollectionRevision.load(); }
 	Result getPersistenceSnapshot(std::vector<ManagedTorrent> &snapshot, std::chrono::milliseconds timeout = std::chrono::seconds(5));
+	// Final collection at exit: stops a background restore, stops
+	// checkpoints, pauses the session, and requests resume data only for
+	// torrents changed since their last save.
+	// Torrents that miss the budget keep their previously captured data, and
+	// torrents the restore never reached keep their persisted entries.
+	Result flushForShutdown(std::vector<ManagedTorrent> &snapshot, std::chrono::milliseconds budget, const PersistenceProgressCallback &progress = {});
+	// Writes the DHT state and session settings atomically. Unchanged state is
+	// not rewritten, so the call is cheap enough for periodic checkpoints.
+	Result saveSessionState();
 
 	// Speed limit methods
 	void setDownloadSpeedLimit(int bytesPerSecond); // 0 means unlimited
@@ -158,6 +226,13 @@ public:
 	int getDownloadSpeedLimit() const;
 	int getUploadSpeedLimit() const;
 	void configureDiscovery(bool enableDht, bool enableUpnp, bool enableNatPmp);
+	// Auto-managed queue limits; 0 leaves the category unlimited.
+	void setQueueLimits(int activeDownloads, int activeSeeds, int activeLimit);
+
+	// Queue ordering. Bulk moves keep the relative order of hashes and issue
+	// one asynchronous session call per torrent.
+	Result setQueuePosition(const lt::info_hash_t &hash, int position);
+	Result moveQueue(std::span<const lt::info_hash_t> hashes, QueueMove move);
 
 	// Status cache methods
 	std::optional<lt::torrent_status> getCachedStatus(const lt::info_hash_t &hash) const;
@@ -173,6 +248,11 @@ public:
 	std::shared_ptr<const TorrentDetailsSnapshot> getDetailsSnapshot(const lt::info_hash_t &hash, TorrentDetailSection section) const;
 	Result setFilePriority(const lt::info_hash_t &hash, int fileIndex, int priority);
 
+	// Queues storage moves for many torrents. Moves that touch the same volume
+	// run one at a time; moves between unrelated volumes proceed in parallel.
+	Result moveStorage(std::span<const lt::info_hash_t> hashes, const std::string &destination, StorageMovePolicy policy = StorageMovePolicy::FailIfExists);
+	StorageMoveProgress getStorageMoveProgress() const;
+
 	// Sequential download (streaming) methods
 	void setSequentialDownload(const lt::info_hash_t &hash, bool sequential);
 	bool isSequentialDownload(const lt::info_hash_t &hash) const;
@@ -187,14 +267,24 @@ public:
 
 	// Event draining methods (replaces raw pollAlerts)
 	std::vector<TorrentEvent> drainEvents();
+	// Listeners observe every event on the alert thread in addition to the
+	// drained queue. They must not block or call back into TorrentManager.
+	std::uint64_t addEventListener(TorrentEventListener listener);
+	void removeEventListener(std::uint64_t id);
 
 private:
 	lt::session session;
+	std::filesystem::path sessionStatePath_;
+	std::mutex sessionStateMutex_;
+	std::vector<char> lastSessionState_;
 	mutable std::mutex operationMutex;
 	mutable std::mutex stateMutex;
 	std::unordered_map<lt::info_hash_t, lt::torrent_handle> torrents;
 	std::unordered_map<lt::info_hash_t, std::string> torrentFilePaths;
 	std::unordered_map<lt::info_hash_t, std::string> torrentDisplayNames;
+	std::unordered_map<lt::info_hash_t, std::string> torrentMagnetUris;
+	// Trackers of torrents without a magnet URI, for the one persistence builds.
+	std::unordered_map<lt::info_hash_t, std::vector<std::string>> torrentTrackers;
 	std::atomic<std::uint64_t> torrentCollectionRevision{0};
 
 	// Alert pump & persistence synchronization
@@ -202,16 +292,56 @@ private:
 	std::condition_variable alertCv_;
 	std::atomic<bool> stopAlertWorker_{false};
 	std::vector<TorrentEvent> eventsQueue_;
+	// Latest resume data per torrent and the time each outstanding request was
+	// issued; overlapping collections share requests instead of reissuing them.
 	std::unordered_map<lt::info_hash_t, std::vector<char>> resumeDataStore_;
-	std::unordered_set<lt::info_hash_t> pendingResumeHashes_;
+	std::unordered_map<lt::info_hash_t, std::chrono::steady_clock::time_point> pendingResumeHashes_;
+	// Save paths the session reported in resume data or after a storage move.
+	// They win over the status cache, which only refreshes while the UI polls.
+	std::unordered_map<lt::info_hash_t, std::string> reportedSavePaths_;
 	std::thread alertWorker_;
 	void alertWorkerLoop();
+	Result collectResumeData(std::vector<ManagedTorrent> &snapshot, std::chrono::steady_clock::time_point deadline, bool interruptible, const PersistenceProgressCallback &progress);
+	void restoreTorrentFromConfig(const TorrentConfigData &data);
+	std::vector<ManagedTorrent> unrestoredTorrents() const;
+	std::mutex listenerMutex_;
+	std::vector<std::pair<std::uint64_t, TorrentEventListener>> eventListeners_;
+	std::uint64_t nextEventListenerId_{1};
+	std::atomic<bool> hasEventListeners_{false};
 
 	// Async persistence task
 	mutable std::mutex asyncPersistenceMutex_;
 	std::future<PersistenceSnapshotResult> asyncPersistenceFuture_;
 	bool asyncPersistencePending_{false};
 	std::atomic<bool> shuttingDown_{false};
+	std::thread restoreWorker_;
+	std::atomic<bool> restoringTorrents_{false};
+	// Checked by the restore loop between torrents.
+	std::atomic<bool> stopRestore_{false};
+	// Entries handed to the background restore; those from restoreCursor_ on
+	// are not in the session yet. The worker only reads the entries, so
+	// snapshots copy them under restoreMutex_ while it runs.
+	mutable std::mutex restoreMutex_;
+	std::vector<TorrentConfigData> pendingRestore_;
+	std::size_t restoreCursor_ = 0;
+
+	struct StorageMove
+	{
+		lt::info_hash_t hash;
+		lt::torrent_handle handle;
+		std::string destination;
+		lt::move_flags_t flags = lt::move_flags_t::fail_if_exist;
+		std::vector<std::string> volumes;
+		std::uint64_t bytes = 0;
+	};
+	mutable std::mutex moveMutex_;
+	std::deque<StorageMove> queuedMoves_;
+	std::unordered_map<lt::info_hash_t, StorageMove> activeMoves_;
+	std::unordered_set<std::string> busyVolumes_;
+	StorageMoveProgress moveProgress_;
+	std::chrono::steady_clock::time_point moveBatchStarted_;
+	void startQueuedMoves();
+	bool finishStorageMove(const lt::info_hash_t &hash, bool success);
 
 	// Status cache
 	mutable std::mutex cacheMutex;
@@ -6,6 +6,8 @@
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace Presentation
@@ -53,6 +55,13 @@ public:
 private:
 	SearchEngine &searchEngine;
 	std::vector<TorrentSearchResult> results_;
+	// Position in results_ by resultKey().
+	std::unordered_map<std::string, std::size_t> resultIndex_;
+	// Keys of entries in results_ that came from the local index.
+	std::unordered_set<std::string> localResults_;
+	// Keys of entries streamed for the active request that its completion
+	// has not confirmed yet.
+	std::unordered_set<std::string> streamedResults_;
 	std::vector<TorrentSearchResult> favorites_;
 	std::optional<TorrentSearchResult> selectedResult_;
 	std::string currentQuery_;
@@ -65,7 +74,14 @@ private:
 	bool loadingMore_ = false;
 	SearchState state_ = SearchState::Idle;
 
+	// Info hash, or the magnet URI when there is none.
+	static const std::string &resultKey(const TorrentSearchResult &result);
+	void resetResults(std::vector<TorrentSearchResult> results);
+	// Local and streamed entries are replaced in place by a later copy;
+	// entries a completion confirmed are kept.
+	void mergeResult(TorrentSearchResult &&result, bool streamed);
 	void mergeUnique(std::vector<TorrentSearchResult> incoming);
+	void dropUnconfirmed();
 	static SearchResultDto toDto(const TorrentSearchResult &result, bool favorite);
 };
 } // namespace Presentation
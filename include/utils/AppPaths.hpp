@@ -23,6 +23,11 @@ public:
 	static std::filesystem::path torrentsConfigPath();
 	static std::filesystem::path settingsConfigPath();
 	static std::filesystem::path logFilePath();
+	static std::filesystem::path sessionStatePath();
+	static std::filesystem::path favoritesPath();
+	static std::filesystem::path startupReportPath();
+	static std::filesystem::path searchCachePath();
+	static std::filesystem::path localSearchIndexPath();
 	static void ensureDirectories();
 };
 } // namespace Utils
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace Utils
+{
+/**
+ * Fixed-capacity lock-free queue for any number of producers and consumers.
+ *
+ * Each cell carries a sequence number telling whether it is ready to be
+ * written or read in the current lap, so a push or pop is one compare-and-swap
+ * on the shared position plus a move; nothing blocks and nothing allocates
+ * after construction. tryPush fails instead of waiting when the queue is full.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+	// The capacity is rounded up to a power of two.
+	explicit BoundedQueue(std::size_t capacity)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		mask_ = size - 1;
+		cells_ = std::make_unique<Cell[]>(size);
+		for (std::size_t index = 0; index < size; ++index)
+			cells_[index].sequence.store(index, std::memory_order_relaxed);
+	}
+
+	BoundedQueue(const BoundedQueue &) = delete;
+	BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+	bool tryPush(T &&value)
+	{
+		std::size_t position = enqueue_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell &cell = cells_[position & mask_];
+			const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+			if (lag == 0)
+			{
+				if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.value = std::move(value);
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lag < 0)
+				return false;
+			else
+				position = enqueue_.load(std::memory_order_relaxed);
+		}
+	}
+
+	bool tryPop(T &value)
+	{
+		std::size_t position = dequeue_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell &cell = cells_[position & mask_];
+			const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const auto lag = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+			if (lag == 0)
+			{
+				if (dequeue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					value = std::move(cell.value);
+					// Leaves no moved-from payload holding memory in the cell.
+					cell.value = T();
+					cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lag < 0)
+				return false;
+			else
+				position = dequeue_.load(std::memory_order_relaxed);
+		}
+	}
+
+	std::size_t capacity() const { return mask_ + 1; }
+
+private:
+	struct Cell
+	{
+		std::atomic<std::size_t> sequence{0};
+		T value{};
+	};
+
+	std::unique_ptr<Cell[]> cells_;
+	std::size_t mask_ = 0;
+	// Kept on separate cache lines so producers and consumers do not contend.
+	alignas(64) std::atomic<std::size_t> enqueue_{0};
+	alignas(64) std::atomic<std::size_t> dequeue_{0};
+};
+} // namespace Utils
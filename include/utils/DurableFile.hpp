@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Result.hpp"
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string_view>
+
+namespace Utils
+{
+// Appends data to the file and flushes it to disk before returning, so an
+// acknowledged write survives power loss. truncate starts the file over and
+// also syncs its directory, making a newly created file durable.
+Result appendDurably(const std::filesystem::path &path, std::string_view data, bool truncate = false);
+
+// Replaces path with what write puts into the stream. The data goes to
+// path + ".tmp", is flushed to disk and is then renamed over path, so readers
+// see either the old file or the new one. keepBackup first copies the current
+// file to path + ".bak". An exception thrown by write abandons the new file.
+Result writeFileAtomically(const std::filesystem::path &path, const std::function<void(std::ostream &)> &write, bool keepBackup = false);
+
+// Makes entries created or renamed in directory durable. Best effort: some
+// filesystems refuse to fsync directories, and Windows journals renames.
+void syncDirectory(const std::filesystem::path &directory);
+} // namespace Utils
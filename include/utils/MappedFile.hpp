@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Result.hpp"
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace Utils
+{
+/**
+ * Read-only memory mapping of a whole file. The view stays valid until the
+ * mapping is closed or destroyed; an empty file maps to an empty view.
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Fails with NotFound when the file does not exist or cannot be opened.
+	Result open(const std::filesystem::path &path);
+	void close();
+
+	bool isOpen() const { return open_; }
+	std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+	const char *data_ = nullptr;
+	std::size_t size_ = 0;
+	bool open_ = false;
+#if defined(_WIN32)
+	void *mapping_ = nullptr;
+#endif
+};
+} // namespace Utils
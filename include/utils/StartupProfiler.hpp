@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Result.hpp"
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Utils
+{
+/**
+ * Records wall and CPU time for named startup phases, plus sample series such
+ * as per-torrent restore times, and renders them as a JSON report and a
+ * one-line summary.
+ *
+ * Phases with the same name accumulate. Recording is thread-safe so phases
+ * may run on worker threads. Phases overlap across threads, so a phase is
+ * charged the CPU time of the thread it runs on; process CPU time is only
+ * reported for the total and for recordSinceStart. A phase that ends on a
+ * different thread than it began on reports wall time only.
+ */
+class StartupProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	class Phase
+	{
+	public:
+		Phase(StartupProfiler &profiler, std::string name);
+		~Phase();
+		Phase(const Phase &) = delete;
+		Phase &operator=(const Phase &) = delete;
+
+	private:
+		StartupProfiler &profiler_;
+		std::string name_;
+		Clock::time_point wallStart_;
+		std::thread::id thread_;
+		std::chrono::nanoseconds cpuStart_;
+	};
+
+	StartupProfiler();
+
+	Phase phase(std::string name) { return Phase(*this, std::move(name)); }
+	// Records the time since the profiler was constructed as a phase, for
+	// work that happens before a scope can be opened, such as member
+	// construction.
+	void recordSinceStart(const std::string &name);
+	void addSample(const std::string &series, std::chrono::nanoseconds elapsed);
+
+	std::string toJson() const;
+	std::string summary() const;
+	Result writeReport(const std::filesystem::path &path) const;
+
+	static std::chrono::nanoseconds processCpuTime();
+	static std::chrono::nanoseconds threadCpuTime();
+
+private:
+	struct PhaseTotals
+	{
+		std::chrono::nanoseconds wall{0};
+		std::chrono::nanoseconds cpu{0};
+		std::size_t count = 0;
+		bool cpuMeasured = false;
+	};
+
+	void record(const std::string &name, std::chrono::nanoseconds wall, std::optional<std::chrono::nanoseconds> cpu);
+
+	const std::chrono::system_clock::time_point startedAt_;
+	const Clock::time_point wallStart_;
+	const std::chrono::nanoseconds cpuStart_;
+	mutable std::mutex mutex_;
+	// Phases in first-recorded order.
+	std::vector<std::string> order_;
+	std::map<std::string, PhaseTotals> phases_;
+	std::map<std::string, std::vector<std::chrono::nanoseconds>> samples_;
+};
+} // namespace Utils
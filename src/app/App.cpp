@@ -2,6 +2,8 @@
 #include "AppPaths.hpp"
 #include "CredentialStore.hpp"
 #include "Logger.hpp"
+#include "StartupProfiler.hpp"
+#include <future>
 #include <iostream>
 #include <cstdlib>
 
@@ -12,71 +14,151 @@ void App::initialize()
 	if (initialized_)
 		return;
 
-	Utils::AppPaths::ensureDirectories();
-	Utils::Logger::initialize(Utils::AppPaths::logFilePath());
+	// Member construction created the session and restored session.dat.
+	startupProfiler_.recordSinceStart("session_create");
+	{
+		auto phase = startupProfiler_.phase("paths_and_logging");
+		Utils::AppPaths::ensureDirectories();
+		Utils::Logger::initialize(Utils::AppPaths::logFilePath());
+	}
 	Utils::Logger::info("app", "Starting Hypertube");
 	initialized_ = true;
 
-	// Load settings before restoring torrents so session behavior is effective
-	// from the first network operation.
+	// Startup graph: torrents.json is parsed while settings load, and the
+	// credential lookups run while the session is configured. Settings must
+	// precede the session configuration, and the proxy must be applied before
+	// the first torrent is added.
 	const auto torrentsConfigPath = Utils::AppPaths::torrentsConfigPath();
 	const auto settingsConfigPath = Utils::AppPaths::settingsConfigPath();
-	Result settingsLoadResult = settingsConfigManager_.load(settingsConfigPath.string());
-	if (!settingsLoadResult)
-		std::cerr << "Warning: " << settingsLoadResult.message << std::endl;
-	torrentManager_.setDownloadSpeedLimit(settingsConfigManager_.getDownloadSpeedLimit());
-	torrentManager_.setUploadSpeedLimit(settingsConfigManager_.getUploadSpeedLimit());
-	torrentManager_.configureDiscovery(
-		settingsConfigManager_.getEnableDHT(),
-		settingsConfigManager_.getEnableUPnP(),
-		settingsConfigManager_.getEnableNATPMP());
-	const std::optional<std::string> storedProxyPassword = Utils::CredentialStore::load("proxy_password");
-	const bool proxyEnabled = settingsConfigManager_.getProxyEnabled();
-	const std::string proxyType = settingsConfigManager_.getProxyType();
-	const std::string proxyHost = settingsConfigManager_.getProxyHost();
-	const int proxyPort = settingsConfigManager_.getProxyPort();
-	const std::string proxyUsername = settingsConfigManager_.getProxyUsername();
-	const std::string proxyPassword = storedProxyPassword.value_or("");
-	torrentManager_.setProxyConfig(proxyHost, proxyPort, proxyUsername, proxyPassword,
-		proxyEnabled ? (proxyType == "http" ? 2 : 1) : 0);
-	Result searchProxyResult = searchEngine_.setProxyConfig(
-		proxyEnabled, proxyType, proxyHost, proxyPort, proxyUsername, proxyPassword);
-	if (!searchProxyResult)
-		Utils::Logger::warning("search", "Proxy configuration was ignored: " + searchProxyResult.message);
-	if (settingsConfigManager_.getTorznabEnabled())
+	struct LoadedTorrents
+	{
+		Result result = Result::Success();
+		std::vector<TorrentConfigData> torrents;
+	};
+	std::future<LoadedTorrents> torrentsLoad = std::async(std::launch::async, [this, torrentsConfigPath]()
+	{
+		auto phase = startupProfiler_.phase("torrents_load");
+		LoadedTorrents loaded;
+		// Streams the snapshot; a DOM load of the same file would double the parse.
+		loaded.result = torrentsConfigManager_.loadTorrents(torrentsConfigPath.string(), loaded.torrents);
+		return loaded;
+	});
+
+	{
+		auto phase = startupProfiler_.phase("settings_load");
+		Result settingsLoadResult = settingsConfigManager_.load(settingsConfigPath.string());
+		if (!settingsLoadResult)
+			std::cerr << "Warning: " << settingsLoadResult.message << std::endl;
+	}
+	const PreferencesSettings preferences = settingsConfigManager_.getPreferencesSettings();
+
+	// Linux lookups may each spawn the Secret Service helper.
+	auto lookupCredential = [this](const char *account)
+	{
+		return std::async(std::launch::async, [this, account]()
+		{
+			auto phase = startupProfiler_.phase("credential_store");
+			return Utils::CredentialStore::load(account);
+		});
+	};
+	std::future<std::optional<std::string>> proxyPasswordLookup = lookupCredential("proxy_password");
+	std::future<std::optional<std::string>> apiKeyLookup;
+	if (preferences.torznabEnabled)
+		apiKeyLookup = lookupCredential("torznab_api_key");
+
+	// Favorites, search history and the local index are read on a worker
+	// rather than when the search views first need them.
+	searchEngine_.attachFavoritesStore(settingsConfigManager_, Utils::AppPaths::favoritesPath().string());
+	searchEngine_.attachSearchCacheFile(Utils::AppPaths::searchCachePath().string());
+	searchEngine_.attachLocalIndexFile(Utils::AppPaths::localSearchIndexPath().string());
+	favoritesPreload_ = std::async(std::launch::async, [this]()
+	{
+		auto phase = startupProfiler_.phase("favorites_load");
+		searchEngine_.preloadFavorites();
+		searchEngine_.preloadLocalIndex();
+	});
+
+	{
+		auto phase = startupProfiler_.phase("session_configure");
+		torrentManager_.setDownloadSpeedLimit(preferences.downloadSpeedLimit);
+		torrentManager_.setUploadSpeedLimit(preferences.uploadSpeedLimit);
+		torrentManager_.configureDiscovery(preferences.enableDht, preferences.enableUpnp, preferences.enableNatPmp);
+		torrentManager_.setQueueLimits(preferences.activeDownloads, preferences.activeSeeds, preferences.activeLimit);
+	}
+	const std::string proxyPassword = proxyPasswordLookup.get().value_or("");
 	{
-		std::optional<std::string> storedApiKey = Utils::CredentialStore::load("torznab_api_key");
+		auto phase = startupProfiler_.phase("proxy_configure");
+		torrentManager_.setProxyConfig(preferences.proxyHost, preferences.proxyPort, preferences.proxyUsername,
+			proxyPassword, preferences.proxyEnabled ? (preferences.proxyType == "http" ? 2 : 1) : 0);
+		Result searchProxyResult = searchEngine_.setProxyConfig(preferences.proxyEnabled, preferences.proxyType,
+			preferences.proxyHost, preferences.proxyPort, preferences.proxyUsername, proxyPassword);
+		if (!searchProxyResult)
+			Utils::Logger::warning("search", "Proxy configuration was ignored: " + searchProxyResult.message);
+	}
+	if (preferences.torznabEnabled)
+	{
+		const std::optional<std::string> storedApiKey = apiKeyLookup.get();
 		const char *environmentApiKey = std::getenv("HYPERTUBE_TORZNAB_API_KEY");
 		const std::string apiKey = storedApiKey.value_or(environmentApiKey ? environmentApiKey : "");
-		Result providerResult = searchEngine_.configureTorznabProvider(
-			settingsConfigManager_.getTorznabUrl(), apiKey);
+		Result providerResult = searchEngine_.configureTorznabProvider(preferences.torznabUrl, apiKey);
 		if (providerResult)
 			searchEngine_.setActiveSearchProvider("torznab");
 		else
 			Utils::Logger::warning("search", "Torznab configuration was ignored: " + providerResult.message);
 	}
+	searchEngine_.setFanOutEnabled(preferences.searchFanOut);
 
-	// Load torrents configuration
-	Result configLoadResult = torrentsConfigManager_.load(torrentsConfigPath.string(), false);
-	if (!configLoadResult)
+	// Torrents are restored in the background so the window can open. The
+	// report is written once both the restore and initialize() are done.
+	LoadedTorrents loaded = torrentsLoad.get();
+	if (!loaded.result)
+		std::cerr << "Warning: " << loaded.result.message << std::endl;
+	const bool restoring = loaded.result && !loaded.torrents.empty();
+	auto pendingReport = std::make_shared<std::atomic<int>>(restoring ? 2 : 1);
+	auto finishStartupReport = [this, pendingReport]()
 	{
-		std::cerr << "Warning: " << configLoadResult.message << std::endl;
-	}
-
-	// Load torrents from config
-	std::vector<TorrentConfigData> torrents;
-	Result torrentsLoadResult = torrentsConfigManager_.loadTorrents(torrentsConfigPath.string(), torrents);
-	if (torrentsLoadResult)
+		if (--*pendingReport != 0)
+			return;
+		Utils::Logger::info("app", startupProfiler_.summary());
+		Result reportResult = startupProfiler_.writeReport(Utils::AppPaths::startupReportPath());
+		if (!reportResult)
+			Utils::Logger::warning("app", reportResult.message);
+	};
+	if (restoring)
 	{
-		torrentManager_.addTorrentsFromConfig(torrents);
+		// Opened here and closed on the restore worker, so it reports wall time
+		// only; the per-torrent samples cover the worker's cost.
+		auto restorePhase = std::make_shared<std::optional<Utils::StartupProfiler::Phase>>();
+		restorePhase->emplace(startupProfiler_, "torrents_restore");
+		torrentManager_.restoreTorrentsInBackground(std::move(loaded.torrents),
+			[this](std::chrono::nanoseconds elapsed)
+			{ startupProfiler_.addSample("torrent_restore", elapsed); },
+			[restorePhase, finishStartupReport]()
+			{
+				restorePhase->reset();
+				finishStartupReport();
+			});
 	}
-	else
+
+	// The control socket is opt-in; the environment variable enables it for a
+	// single run and overrides the socket path.
+	const char *controlSocketPath = std::getenv("HYPERTUBE_CONTROL_SOCKET");
+	if (preferences.controlSocketEnabled || controlSocketPath)
 	{
-		std::cerr << "Warning: " << torrentsLoadResult.message << std::endl;
+		auto phase = startupProfiler_.phase("control_socket");
+		ControlServerOptions controlOptions;
+		controlOptions.defaultSavePath = [this]()
+		{ return settingsConfigManager_.getDownloadPath(); };
+		const std::filesystem::path socketPath = controlSocketPath && *controlSocketPath
+			? std::filesystem::path(controlSocketPath)
+			: ControlServer::defaultSocketPath();
+		Result controlResult = controlServer_.start(socketPath, std::move(controlOptions));
+		if (!controlResult)
+			Utils::Logger::warning("control", "Control socket was not started: " + controlResult.message);
 	}
 
-	// Load favorites and search history
-	searchEngine_.loadFavoritesAndHistory(settingsConfigManager_);
+	startupProfiler_.recordSinceStart("ready");
+	finishStartupReport();
 }
 
 App::~App()
@@ -90,16 +172,46 @@ void App::shutdown()
 		return;
 	initialized_ = false;
 
+	// Stop external clients before tearing down the services they drive.
+	controlServer_.stop();
 	// Ensure no search worker can outlive the UI objects it was initiated from.
 	searchEngine_.shutdown();
+	if (favoritesPreload_.valid())
+		favoritesPreload_.wait();
+	// Queue the favorites, history, search cache and local index writes first
+	// so they overlap the resume-data flush.
+	searchEngine_.saveFavoritesAndHistory();
+	searchEngine_.saveSearchCache();
+	searchEngine_.saveLocalIndex();
+
+	// This is the only shutdown collection; the UI controller no longer saves
+	// torrents on stop.
+	const auto flushStarted = std::chrono::steady_clock::now();
+	// Replies can arrive thousands at a time, so progress is logged at most
+	// every half second plus once at the end.
+	auto lastProgressLog = flushStarted;
+	auto progress = [&lastProgressLog](const PersistenceProgress &report)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (report.completed != report.total && now - lastProgressLog < std::chrono::milliseconds(500))
+			return;
+		lastProgressLog = now;
+		Utils::Logger::info("torrent", "Collected fast-resume data for " + std::to_string(report.completed) +
+			" of " + std::to_string(report.total) + " torrent(s)");
+	};
 	std::vector<ManagedTorrent> persistenceSnapshot;
-	Result resumeResult = torrentManager_.getPersistenceSnapshot(persistenceSnapshot);
+	Result resumeResult = torrentManager_.flushForShutdown(persistenceSnapshot, SHUTDOWN_FLUSH_BUDGET, progress);
 	if (!resumeResult)
 		Utils::Logger::warning("torrent", resumeResult.message);
-	torrentsConfigManager_.saveTorrents(persistenceSnapshot);
-
-	// Save favorites and search history
-	searchEngine_.saveFavoritesAndHistory(settingsConfigManager_);
+	const std::size_t savedTorrents = persistenceSnapshot.size();
+	torrentsConfigManager_.saveTorrents(std::move(persistenceSnapshot));
+	Result sessionResult = torrentManager_.saveSessionState();
+	if (!sessionResult)
+		Utils::Logger::warning("torrent", sessionResult.message);
+	const auto flushMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - flushStarted).count();
+	Utils::Logger::info("torrent", "Saved state for " + std::to_string(savedTorrents) +
+		" torrent(s) in " + std::to_string(flushMilliseconds) + " ms");
 
 	// Wait for background save worker threads to finish writing files
 	torrentsConfigManager_.waitForAsyncOperations();
@@ -2,13 +2,19 @@
 #include "SearchEngine.hpp"
 #include "AppPaths.hpp"
 #include "Logger.hpp"
+#include "MappedFile.hpp"
+#include "DurableFile.hpp"
+#include "utils/TorrentIdentity.hpp"
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
 #include <algorithm>
+#include <array>
 #include <filesystem>
 #include <system_error>
 #include <unordered_map>
+#include <iomanip>
+#include <string_view>
 
 namespace
 {
@@ -25,34 +31,189 @@ std::string encodeHex(const std::vector<char> &data)
 	return encoded;
 }
 
-bool decodeHex(const std::string &encoded, std::vector<char> &data)
+// Branchless so the compiler can vectorise the loop: digits and letters of
+// either case map through their low nibble, and validity is checked for the
+// whole blob at once instead of per byte.
+bool decodeHex(std::string_view encoded, std::vector<char> &data)
 {
 	static constexpr std::size_t maxResumeDataSize = 16 * 1024 * 1024;
 	if (encoded.size() % 2 != 0 || encoded.size() / 2 > maxResumeDataSize)
 		return false;
-	auto value = [](char character) -> int
+	auto nibble = [](unsigned char character) -> unsigned char
 	{
-		if (character >= '0' && character <= '9') return character - '0';
-		if (character >= 'a' && character <= 'f') return character - 'a' + 10;
-		if (character >= 'A' && character <= 'F') return character - 'A' + 10;
-		return -1;
+		return static_cast<unsigned char>((character & 0x0f) + 9 * (character >> 6));
 	};
-	data.clear();
-	data.reserve(encoded.size() / 2);
-	for (std::size_t index = 0; index < encoded.size(); index += 2)
+	auto invalid = [](unsigned char character) -> unsigned char
 	{
-		const int high = value(encoded[index]);
-		const int low = value(encoded[index + 1]);
-		if (high < 0 || low < 0)
-		{
-			data.clear();
-			return false;
-		}
-		data.push_back(static_cast<char>((high << 4) | low));
+		const bool digit = static_cast<unsigned char>(character - '0') < 10;
+		const bool letter = static_cast<unsigned char>((character | 0x20) - 'a') < 6;
+		return !(digit || letter);
+	};
+	data.resize(encoded.size() / 2);
+	const auto *input = reinterpret_cast<const unsigned char *>(encoded.data());
+	auto *output = reinterpret_cast<unsigned char *>(data.data());
+	unsigned char rejected = 0;
+	for (std::size_t index = 0; index < data.size(); ++index)
+	{
+		const unsigned char high = input[2 * index];
+		const unsigned char low = input[2 * index + 1];
+		rejected |= invalid(high) | invalid(low);
+		output[index] = static_cast<unsigned char>((nibble(high) << 4) | nibble(low));
+	}
+	if (rejected)
+	{
+		data.clear();
+		return false;
 	}
 	return true;
 }
 
+std::uint64_t readSnapshotGeneration(const json &value)
+{
+	if (value.is_number_unsigned())
+		return value.get<std::uint64_t>();
+	if (value.is_number_integer() && value.get<std::int64_t>() > 0)
+		return static_cast<std::uint64_t>(value.get<std::int64_t>());
+	return 0;
+}
+
+// Streams a torrents.json snapshot straight into journal entries. Only one
+// torrent entry is materialised as a json value at a time; everything outside
+// "generation" and "torrents" is skipped without being stored.
+class TorrentSnapshotReader : public nlohmann::json_sax<json>
+{
+public:
+	std::uint64_t generation = 0;
+	std::vector<TorrentJournal::Entry> entries;
+	std::string error;
+
+	bool null() override { return scalar(json()); }
+	bool boolean(bool value) override { return scalar(json(value)); }
+	bool number_integer(number_integer_t value) override { return scalar(json(value)); }
+	bool number_unsigned(number_unsigned_t value) override { return scalar(json(value)); }
+	bool number_float(number_float_t value, const string_t &) override { return scalar(json(value)); }
+	bool binary(binary_t &value) override { return scalar(json(std::move(value))); }
+
+	bool string(string_t &value) override
+	{
+		if (pendingEntryKey_)
+		{
+			pendingEntryKey_ = false;
+			entry_.key = std::move(value);
+			return true;
+		}
+		return scalar(json(std::move(value)));
+	}
+
+	bool key(string_t &value) override
+	{
+		// A string "key" member is the entry's journal key, not part of the value.
+		pendingEntryKey_ = building_.size() == 1 && building_.back()->is_object() && value == "key";
+		key_ = std::move(value);
+		return true;
+	}
+
+	bool start_object(std::size_t) override { return open(json::value_t::object); }
+	bool start_array(std::size_t) override { return open(json::value_t::array); }
+	bool end_object() override { return close(); }
+	bool end_array() override { return close(); }
+
+	bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &exception) override
+	{
+		error = "Failed to parse torrents configuration: " + std::string(exception.what());
+		return false;
+	}
+
+private:
+	json *place(json value)
+	{
+		if (pendingEntryKey_)
+		{
+			// A non-string "key" stays in the entry, as the DOM loader did.
+			pendingEntryKey_ = false;
+			key_ = "key";
+		}
+		json &parent = *building_.back();
+		if (parent.is_object())
+			return &(parent[key_] = std::move(value));
+		parent.push_back(std::move(value));
+		return &parent.back();
+	}
+
+	bool scalar(json value)
+	{
+		if (!building_.empty())
+		{
+			place(std::move(value));
+			return true;
+		}
+		if (depth_ == 0)
+			return fail("Invalid torrents configuration: root must be an object");
+		if (depth_ == 1 && key_ == "torrents")
+			return fail("Invalid torrents configuration: 'torrents' must be an array");
+		if (depth_ == 1 && key_ == "generation")
+			generation = readSnapshotGeneration(value);
+		else if (inTorrents_ && depth_ == 2)
+			entries.push_back({{}, std::move(value)});
+		return true;
+	}
+
+	bool open(json::value_t type)
+	{
+		if (!building_.empty())
+		{
+			building_.push_back(place(json(type)));
+		}
+		else if (inTorrents_ && depth_ == 2)
+		{
+			entry_ = {{}, json(type)};
+			building_.push_back(&entry_.value);
+		}
+		else if (depth_ == 0 && type != json::value_t::object)
+		{
+			return fail("Invalid torrents configuration: root must be an object");
+		}
+		else if (depth_ == 1 && key_ == "torrents")
+		{
+			if (type != json::value_t::array)
+				return fail("Invalid torrents configuration: 'torrents' must be an array");
+			inTorrents_ = true;
+			entries.clear();
+		}
+		++depth_;
+		return true;
+	}
+
+	bool close()
+	{
+		--depth_;
+		if (!building_.empty())
+		{
+			building_.pop_back();
+			if (building_.empty())
+				entries.push_back(std::move(entry_));
+		}
+		else if (inTorrents_ && depth_ == 1)
+		{
+			inTorrents_ = false;
+		}
+		return true;
+	}
+
+	bool fail(std::string message)
+	{
+		error = std::move(message);
+		return false;
+	}
+
+	std::size_t depth_ = 0;
+	std::string key_;
+	bool inTorrents_ = false;
+	bool pendingEntryKey_ = false;
+	TorrentJournal::Entry entry_;
+	std::vector<json *> building_;
+};
+
 void applyMissingDefaults(json &target, const json &defaults)
 {
 	if (!target.is_object() || !defaults.is_object())
@@ -66,64 +227,106 @@ void applyMissingDefaults(json &target, const json &defaults)
 	}
 }
 
-bool writeJsonAtomically(const std::string &path, const json &data, std::string &errorMessage)
+// Counts the bytes written through it without storing them.
+class CountingBuffer : public std::streambuf
 {
-	const std::filesystem::path target(path);
-	std::error_code error;
-	if (!target.parent_path().empty())
-		std::filesystem::create_directories(target.parent_path(), error);
-	if (error)
+public:
+	std::uintmax_t count = 0;
+
+protected:
+	int_type overflow(int_type character) override
 	{
-		errorMessage = "Unable to create configuration directory: " + error.message();
-		return false;
+		if (!traits_type::eq_int_type(character, traits_type::eof()))
+			++count;
+		return traits_type::not_eof(character);
 	}
 
-	const std::filesystem::path temporary = target.string() + ".tmp";
+	std::streamsize xsputn(const char *, std::streamsize size) override
 	{
-		std::ofstream file(temporary, std::ios::trunc);
-		if (!file.is_open())
-		{
-			errorMessage = "Unable to open temporary configuration file";
-			return false;
-		}
-		file << data.dump(4) << '\n';
-		file.flush();
-		if (!file.good())
-		{
-			errorMessage = "Unable to flush temporary configuration file";
-			std::filesystem::remove(temporary, error);
-			return false;
-		}
+		count += static_cast<std::uintmax_t>(size);
+		return size;
 	}
+};
+
+void writeJsonDocument(std::ostream &stream, const json &data, JsonFormat format)
+{
+	if (format == JsonFormat::Pretty)
+		stream << std::setw(4);
+	stream << data << '\n';
+}
 
-	if (std::filesystem::exists(target, error))
+std::uintmax_t serializedJsonSize(const json &data, JsonFormat format)
+{
+	CountingBuffer buffer;
+	std::ostream stream(&buffer);
+	writeJsonDocument(stream, data, format);
+	return buffer.count;
+}
+
+bool writeJsonAtomically(const std::string &path, const json &data, JsonFormat format, std::string &errorMessage)
+{
+	// The JSON serializer streams straight to the file, so no document-sized
+	// string is built. The backup lets load() recover from a bad primary file.
+	Result result = Utils::writeFileAtomically(path, [&data, format](std::ostream &stream)
 	{
-		const std::filesystem::path backup = target.string() + ".bak";
-		std::filesystem::copy_file(target, backup, std::filesystem::copy_options::overwrite_existing, error);
-		if (error)
-		{
-			errorMessage = "Unable to create configuration backup: " + error.message();
-			std::filesystem::remove(temporary, error);
-			return false;
-		}
-	}
+		writeJsonDocument(stream, data, format);
+	}, true);
+	if (!result)
+		errorMessage = result.message;
+	return result.success;
+}
 
-	std::filesystem::rename(temporary, target, error);
-	if (error)
+PreferencesSettings readPreferences(const json &config)
+{
+	PreferencesSettings settings;
+	if (!config.is_object())
+		return settings;
+	const json empty = json::object();
+	const json &root = config.contains("settings") && config["settings"].is_object() ? config["settings"] : empty;
+	// Unversioned files kept the speed limits at the top level.
+	const json &speed = root.contains("speed_limits") && root["speed_limits"].is_object() ? root["speed_limits"]
+		: config.contains("speed_limits") && config["speed_limits"].is_object() ? config["speed_limits"] : empty;
+	const json &search = root.contains("search") && root["search"].is_object() ? root["search"] : empty;
+	const json &proxy = root.contains("proxy") && root["proxy"].is_object() ? root["proxy"] : empty;
+	const json &queue = root.contains("queue") && root["queue"].is_object() ? root["queue"] : empty;
+	const json &control = root.contains("control_socket") && root["control_socket"].is_object() ? root["control_socket"] : empty;
+	settings.downloadSpeedLimit = std::max(speed.value("download", 0), 0);
+	settings.uploadSpeedLimit = std::max(speed.value("upload", 0), 0);
+	if (config.contains("theme") && config["theme"].is_string())
 	{
-		// Windows does not replace an existing file with rename(). The backup
-		// above makes this fallback recoverable while preserving the same API.
-		std::filesystem::remove(target, error);
-		error.clear();
-		std::filesystem::rename(temporary, target, error);
+		// Legacy files stored the theme by name.
+		static const std::array<std::string_view, 5> themeNames{"dark", "ocean", "nord", "dracula", "cyberpunk"};
+		const std::string name = config["theme"].get<std::string>();
+		const auto found = std::find(themeNames.begin(), themeNames.end(), name);
+		settings.theme = found == themeNames.end() ? 0 : static_cast<int>(found - themeNames.begin());
 	}
-	if (error)
+	else if (config.contains("theme") && config["theme"].is_number())
 	{
-		errorMessage = "Unable to replace configuration file: " + error.message();
-		std::filesystem::remove(temporary, error);
-		return false;
+		settings.theme = config["theme"].get<int>();
 	}
-	return true;
+	settings.downloadPath = root.value("download_path", "~/Downloads");
+	settings.enableDht = root.value("enable_dht", true);
+	settings.enableUpnp = root.value("enable_upnp", true);
+	settings.enableNatPmp = root.value("enable_natpmp", true);
+	settings.torznabEnabled = search.value("torznab_enabled", false);
+	settings.torznabUrl = search.value("torznab_url", "");
+	settings.searchFanOut = search.value("fan_out", false);
+	settings.proxyEnabled = proxy.value("enabled", false);
+	settings.proxyType = proxy.value("type", "socks5");
+	settings.proxyHost = proxy.value("host", "127.0.0.1");
+	settings.proxyPort = std::clamp(proxy.value("port", 1080), 1, 65535);
+	settings.proxyUsername = proxy.value("username", "");
+	settings.activeDownloads = std::max(queue.value("active_downloads", 3), 0);
+	settings.activeSeeds = std::max(queue.value("active_seeds", 5), 0);
+	settings.activeLimit = std::max(queue.value("active_limit", 500), 0);
+	settings.controlSocketEnabled = control.value("enabled", false);
+	const json &ui = config.contains("ui") && config["ui"].is_object() ? config["ui"] : empty;
+	settings.ui.sidebarWidth = std::clamp(ui.value("sidebar_width", 240), 120, 600);
+	settings.ui.bottomPanelHeight = std::clamp(ui.value("bottom_panel_height", 300), 120, 1000);
+	settings.ui.sidebarCollapsed = ui.value("sidebar_collapsed", false);
+	settings.ui.selectedMainTab = std::max(ui.value("selected_main_tab", 0), 0);
+	settings.ui.selectedDetailsTab = std::max(ui.value("selected_details_tab", 0), 0);
+	return settings;
 }
 
 void applyPreferencesToJson(json &config, const PreferencesSettings &settings)
@@ -144,11 +347,16 @@ void applyPreferencesToJson(json &config, const PreferencesSettings &settings)
 	target["enable_natpmp"] = settings.enableNatPmp;
 	target["search"]["torznab_enabled"] = settings.torznabEnabled;
 	target["search"]["torznab_url"] = settings.torznabUrl;
+	target["search"]["fan_out"] = settings.searchFanOut;
 	target["proxy"]["enabled"] = settings.proxyEnabled;
 	target["proxy"]["type"] = settings.proxyType == "http" ? "http" : "socks5";
 	target["proxy"]["host"] = settings.proxyHost;
 	target["proxy"]["port"] = std::clamp(settings.proxyPort, 1, 65535);
 	target["proxy"]["username"] = settings.proxyUsername;
+	target["queue"]["active_downloads"] = std::max(settings.activeDownloads, 0);
+	target["queue"]["active_seeds"] = std::max(settings.activeSeeds, 0);
+	target["queue"]["active_limit"] = std::max(settings.activeLimit, 0);
+	target["control_socket"]["enabled"] = settings.controlSocketEnabled;
 	config["ui"] = {
 		{"sidebar_width", std::clamp(settings.ui.sidebarWidth, 120, 600)},
 		{"bottom_panel_height", std::clamp(settings.ui.bottomPanelHeight, 120, 1000)},
@@ -156,10 +364,108 @@ void applyPreferencesToJson(json &config, const PreferencesSettings &settings)
 		{"selected_main_tab", std::max(settings.ui.selectedMainTab, 0)},
 		{"selected_details_tab", std::max(settings.ui.selectedDetailsTab, 0)}};
 }
+
+// Favorites are stored as positional rows; the document names its columns so
+// readers can map rows written with a different column set.
+constexpr int FAVORITES_VERSION = 1;
+constexpr std::array<const char *, 11> FAVORITE_COLUMNS{
+	"info_hash", "name", "magnet_uri", "size_bytes", "seeders", "leechers",
+	"date_uploaded", "category", "created_unix", "scraped_date", "completed"};
+
+void assignFavoriteField(TorrentSearchResult &favorite, std::size_t column, const json &value)
+{
+	switch (column)
+	{
+	case 0: if (value.is_string()) favorite.infoHash = value.get<std::string>(); break;
+	case 1: if (value.is_string()) favorite.name = value.get<std::string>(); break;
+	case 2: if (value.is_string()) favorite.magnetUri = value.get<std::string>(); break;
+	case 3: if (value.is_number_unsigned()) favorite.sizeBytes = value.get<std::size_t>(); break;
+	case 4: if (value.is_number_integer()) favorite.seeders = value.get<int>(); break;
+	case 5: if (value.is_number_integer()) favorite.leechers = value.get<int>(); break;
+	case 6: if (value.is_string()) favorite.dateUploaded = value.get<std::string>(); break;
+	case 7: if (value.is_string()) favorite.category = value.get<std::string>(); break;
+	case 8: if (value.is_number_integer()) favorite.createdUnix = value.get<int64_t>(); break;
+	case 9: if (value.is_number_integer()) favorite.scrapedDate = value.get<int64_t>(); break;
+	case 10: if (value.is_number_integer()) favorite.completed = value.get<int>(); break;
+	default: break;
+	}
+}
+
+json encodeFavorites(const std::vector<TorrentSearchResult> &favorites, const std::vector<std::string> &searchHistory)
+{
+	json rows = json::array();
+	rows.get_ref<json::array_t &>().reserve(favorites.size());
+	for (const auto &fav : favorites)
+	{
+		rows.push_back(json::array({fav.infoHash, fav.name, fav.magnetUri, fav.sizeBytes, fav.seeders, fav.leechers,
+			fav.dateUploaded, fav.category, fav.createdUnix, fav.scrapedDate, fav.completed}));
+	}
+	return {
+		{"version", FAVORITES_VERSION},
+		{"columns", FAVORITE_COLUMNS},
+		{"favorites", std::move(rows)},
+		{"search_history", searchHistory}};
+}
+
+void decodeSearchHistory(const json &document, std::vector<std::string> &searchHistory)
+{
+	if (!document.contains("search_history") || !document["search_history"].is_array())
+		return;
+	for (const auto &historyItem : document["search_history"])
+	{
+		if (historyItem.is_string())
+			searchHistory.push_back(historyItem.get<std::string>());
+	}
+}
+
+void decodeFavoriteRows(const json &document, std::vector<TorrentSearchResult> &favorites)
+{
+	std::vector<std::size_t> columns;
+	for (const auto &name : document["columns"])
+	{
+		const auto found = name.is_string()
+			? std::find(FAVORITE_COLUMNS.begin(), FAVORITE_COLUMNS.end(), name.get<std::string>())
+			: FAVORITE_COLUMNS.end();
+		columns.push_back(static_cast<std::size_t>(found - FAVORITE_COLUMNS.begin()));
+	}
+	const json &rows = document["favorites"];
+	favorites.reserve(rows.size());
+	for (const auto &row : rows)
+	{
+		if (!row.is_array())
+			continue;
+		TorrentSearchResult fav;
+		for (std::size_t index = 0; index < row.size() && index < columns.size(); ++index)
+			assignFavoriteField(fav, columns[index], row[index]);
+		if (!fav.infoHash.empty())
+			favorites.push_back(std::move(fav));
+	}
+}
+
+// Older versions kept one object per favorite in settings.json.
+void decodeLegacyFavorites(const json &entries, std::vector<TorrentSearchResult> &favorites)
+{
+	for (const auto &favJson : entries)
+	{
+		if (!favJson.is_object())
+			continue;
+		TorrentSearchResult fav;
+		for (std::size_t column = 0; column < FAVORITE_COLUMNS.size(); ++column)
+		{
+			if (favJson.contains(FAVORITE_COLUMNS[column]))
+				assignFavoriteField(fav, column, favJson[FAVORITE_COLUMNS[column]]);
+		}
+		favorites.push_back(std::move(fav));
+	}
+}
 } // namespace
 
 ConfigManager::ConfigManager()
 {
+	{
+		std::lock_guard<std::mutex> lock(configMutex);
+		publishPreferencesUnlocked();
+	}
 	saveThread = std::thread(&ConfigManager::workerLoop, this);
 }
 
@@ -181,6 +487,7 @@ void ConfigManager::workerLoop()
 	while (true)
 	{
 		SaveRequest req;
+		std::vector<std::shared_ptr<std::promise<Result>>> superseded;
 		{
 			std::unique_lock<std::mutex> lock(queueMutex);
 			queueCv.wait(lock, [this] { return stopWorker || !saveQueue.empty(); });
@@ -192,8 +499,7 @@ void ConfigManager::workerLoop()
 
 			if (!saveQueue.empty())
 			{
-				req = std::move(saveQueue.front());
-				saveQueue.pop();
+				req = takeNextSaveRequest(superseded);
 			}
 			else
 			{
@@ -205,28 +511,122 @@ void ConfigManager::workerLoop()
 		// the last valid configuration usable after an interruption or crash.
 		std::string errorMessage;
 		Result result = Result::Success();
-		if (!writeJsonAtomically(req.path, req.data, errorMessage))
+		if (req.favorites)
+			req.data = encodeFavorites(req.favorites->first, req.favorites->second);
+		if (!req.data.is_null())
 		{
-			std::cerr << "Failed to save configuration '" << req.path << "': " << errorMessage << std::endl;
-			Utils::Logger::error("config", "Failed to save '" + req.path + "': " + errorMessage);
-			result = Result::Failure(errorMessage, ResultCode::Storage, true);
+			// The hash alone may collide; the serialized length must match too
+			// before a write is skipped.
+			const std::size_t contentHash = std::hash<json>{}(req.data);
+			const std::uintmax_t serializedSize = serializedJsonSize(req.data, req.format);
+			if (isPersisted(req.path, contentHash, serializedSize))
+			{
+				// Identical content is already on disk; skip the temporary
+				// write, backup copy, and rename.
+			}
+			else if (!writeJsonAtomically(req.path, req.data, req.format, errorMessage))
+			{
+				persistedDocuments.erase(req.path);
+				std::cerr << "Failed to save configuration '" << req.path << "': " << errorMessage << std::endl;
+				Utils::Logger::error("config", "Failed to save '" + req.path + "': " + errorMessage);
+				result = Result::Failure(errorMessage, ResultCode::Storage, true);
+			}
+			else
+			{
+				std::error_code timeError;
+				std::error_code sizeError;
+				const auto writeTime = std::filesystem::last_write_time(req.path, timeError);
+				const auto size = std::filesystem::file_size(req.path, sizeError);
+				if (timeError || sizeError)
+					persistedDocuments.erase(req.path);
+				else
+					persistedDocuments[req.path] = {contentHash, serializedSize, writeTime, size};
+			}
 		}
+		else if (req.torrents)
+		{
+			result = writeTorrentSet(req.path, *req.torrents);
+		}
+
 		if (req.completion)
 			req.completion->set_value(result);
+		for (const auto &completion : superseded)
+		{
+			if (completion)
+				completion->set_value(result);
+		}
 
-		activeJobs--;
+		activeJobs -= static_cast<int>(superseded.size()) + 1;
 		queueCv.notify_all();
 	}
 }
 
+ConfigManager::SaveRequest ConfigManager::takeNextSaveRequest(std::vector<std::shared_ptr<std::promise<Result>>> &superseded)
+{
+	// Requires queueMutex. Each request carries the complete state for its
+	// path, so the latest queued one replaces earlier saves of that path.
+	const std::string path = saveQueue.front().path;
+	std::size_t winner = 0;
+	if (saveQueue.front().supersedable)
+	{
+		for (std::size_t index = 1; index < saveQueue.size(); ++index)
+		{
+			const SaveRequest &candidate = saveQueue[index];
+			if (candidate.path != path)
+				continue;
+			winner = index;
+			if (!candidate.supersedable)
+				break;
+		}
+	}
+
+	SaveRequest chosen = std::move(saveQueue[winner]);
+	saveQueue.erase(saveQueue.begin() + static_cast<std::ptrdiff_t>(winner));
+	std::size_t remaining = winner;
+	for (auto it = saveQueue.begin(); remaining > 0 && it != saveQueue.end(); --remaining)
+	{
+		if (it->path != path)
+		{
+			++it;
+			continue;
+		}
+		superseded.push_back(std::move(it->completion));
+		it = saveQueue.erase(it);
+	}
+	return chosen;
+}
+
+bool ConfigManager::isPersisted(const std::string &path, std::size_t contentHash, std::uintmax_t serializedSize) const
+{
+	auto found = persistedDocuments.find(path);
+	if (found == persistedDocuments.end() || found->second.contentHash != contentHash ||
+		found->second.serializedSize != serializedSize)
+		return false;
+	// A file replaced or edited outside the worker must be written again.
+	std::error_code timeError;
+	std::error_code sizeError;
+	const auto writeTime = std::filesystem::last_write_time(path, timeError);
+	const auto size = std::filesystem::file_size(path, sizeError);
+	return !timeError && !sizeError && writeTime == found->second.writeTime && size == found->second.size;
+}
+
 SaveHandle ConfigManager::enqueueSave(const std::string& path, json data)
+{
+	SaveRequest request;
+	request.path = path;
+	request.data = std::move(data);
+	return enqueueSave(std::move(request));
+}
+
+SaveHandle ConfigManager::enqueueSave(SaveRequest request)
 {
 	auto completion = std::make_shared<std::promise<Result>>();
 	SaveHandle handle = completion->get_future().share();
+	request.completion = completion;
 	{
 		std::lock_guard<std::mutex> lock(queueMutex);
 		activeJobs++;
-		saveQueue.push({path, std::move(data), completion});
+		saveQueue.push_back(std::move(request));
 	}
 	queueCv.notify_one();
 	return handle;
@@ -247,7 +647,8 @@ json ConfigManager::createDefaultConfig() const
 			{"enable_natpmp", true},
 			{"search", {
 				{"torznab_enabled", false},
-				{"torznab_url", "http://127.0.0.1:9696/api/v1/indexer/all/results/torznab/api"}
+				{"torznab_url", "http://127.0.0.1:9696/api/v1/indexer/all/results/torznab/api"},
+				{"fan_out", false}
 			}},
 			{"proxy", {
 				{"enabled", false},
@@ -255,6 +656,14 @@ json ConfigManager::createDefaultConfig() const
 				{"host", "127.0.0.1"},
 				{"port", 1080},
 				{"username", ""}
+			}},
+			{"queue", {
+				{"active_downloads", 3},
+				{"active_seeds", 5},
+				{"active_limit", 500}
+			}},
+			{"control_socket", {
+				{"enabled", false}
 			}}
 		}},
 		{"ui", {
@@ -275,6 +684,7 @@ Result ConfigManager::load(const std::string &path, bool fullConfig)
 	{
 		std::lock_guard<std::mutex> lock(configMutex);
 		config = fullConfig ? createDefaultConfig() : json{{"torrents", json::array()}};
+		publishPreferencesUnlocked();
 	};
 
 	bool fileFound = false;
@@ -364,6 +774,7 @@ Result ConfigManager::load(const std::string &path, bool fullConfig)
 			// Ensure all default settings exist
 			ensureDefaultConfigUnlocked();
 		}
+		publishPreferencesUnlocked();
 
 		return Result::Success();
 	}
@@ -395,35 +806,26 @@ void ConfigManager::save(const std::string &path)
 
 PreferencesSettings ConfigManager::getPreferencesSettings() const
 {
-	PreferencesSettings settings;
-	std::lock_guard<std::mutex> lock(configMutex);
-	const json empty = json::object();
-	const json &root = config.contains("settings") && config["settings"].is_object() ? config["settings"] : empty;
-	const json &speed = root.contains("speed_limits") && root["speed_limits"].is_object() ? root["speed_limits"] : empty;
-	const json &search = root.contains("search") && root["search"].is_object() ? root["search"] : empty;
-	const json &proxy = root.contains("proxy") && root["proxy"].is_object() ? root["proxy"] : empty;
-	settings.downloadSpeedLimit = std::max(speed.value("download", 0), 0);
-	settings.uploadSpeedLimit = std::max(speed.value("upload", 0), 0);
-	if (config.contains("theme") && config["theme"].is_number_integer())
-		settings.theme = config["theme"].get<int>();
-	settings.downloadPath = root.value("download_path", "~/Downloads");
-	settings.enableDht = root.value("enable_dht", true);
-	settings.enableUpnp = root.value("enable_upnp", true);
-	settings.enableNatPmp = root.value("enable_natpmp", true);
-	settings.torznabEnabled = search.value("torznab_enabled", false);
-	settings.torznabUrl = search.value("torznab_url", "");
-	settings.proxyEnabled = proxy.value("enabled", false);
-	settings.proxyType = proxy.value("type", "socks5");
-	settings.proxyHost = proxy.value("host", "127.0.0.1");
-	settings.proxyPort = std::clamp(proxy.value("port", 1080), 1, 65535);
-	settings.proxyUsername = proxy.value("username", "");
-	const json &ui = config.contains("ui") && config["ui"].is_object() ? config["ui"] : empty;
-	settings.ui.sidebarWidth = std::clamp(ui.value("sidebar_width", 240), 120, 600);
-	settings.ui.bottomPanelHeight = std::clamp(ui.value("bottom_panel_height", 300), 120, 1000);
-	settings.ui.sidebarCollapsed = ui.value("sidebar_collapsed", false);
-	settings.ui.selectedMainTab = std::max(ui.value("selected_main_tab", 0), 0);
-	settings.ui.selectedDetailsTab = std::max(ui.value("selected_details_tab", 0), 0);
-	return settings;
+	return *currentPreferences();
+}
+
+ConfigManager::PreferencesSnapshot ConfigManager::currentPreferences() const
+{
+	return preferences.load(std::memory_order_acquire);
+}
+
+void ConfigManager::publishPreferencesUnlocked()
+{
+	PreferencesSettings next = readPreferences(config);
+	const PreferencesSnapshot current = preferences.load(std::memory_order_relaxed);
+	if (current && *current == next)
+		return;
+#if defined(__cpp_lib_atomic_shared_ptr)
+	preferences.store(std::make_shared<const PreferencesSettings>(std::move(next)), std::memory_order_release);
+#else
+	publishedPreferences.push_back(std::make_unique<const PreferencesSettings>(std::move(next)));
+	preferences.store(publishedPreferences.back().get(), std::memory_order_release);
+#endif
 }
 
 SaveHandle ConfigManager::savePreferencesCandidate(const std::string &path, const PreferencesSettings &settings)
@@ -434,38 +836,56 @@ SaveHandle ConfigManager::savePreferencesCandidate(const std::string &path, cons
 		candidate = config;
 	}
 	applyPreferencesToJson(candidate, settings);
-	return enqueueSave(path, std::move(candidate));
+	SaveRequest request;
+	request.path = path;
+	request.data = std::move(candidate);
+	request.supersedable = false;
+	return enqueueSave(std::move(request));
 }
 
 Result ConfigManager::commitPreferences(const PreferencesSettings &settings)
 {
 	std::lock_guard<std::mutex> lock(configMutex);
 	applyPreferencesToJson(config, settings);
+	publishPreferencesUnlocked();
 	return Result::Success();
 }
 
-void ConfigManager::saveTorrents(const std::vector<ManagedTorrent> &torrents)
+void ConfigManager::saveTorrents(std::vector<ManagedTorrent> torrents)
 {
-	json torrentsJson;
-	std::unordered_map<std::string, std::string> previousResumeData;
+	SaveRequest request;
 	{
 		std::lock_guard<std::mutex> lock(configMutex);
-		if (config.contains("torrents") && config["torrents"].is_array())
+		request.path = torrentsPath.empty() ? Utils::AppPaths::torrentsConfigPath().string() : torrentsPath;
+	}
+	request.torrents = std::move(torrents);
+	enqueueSave(std::move(request));
+}
+
+Result ConfigManager::writeTorrentSet(const std::string &path, const std::vector<ManagedTorrent> &torrents)
+{
+	std::vector<TorrentJournal::Entry> entries;
+	entries.reserve(torrents.size());
+	for (const auto &torrent : torrents)
+	{
+		std::string magnetUri = torrent.magnetUri;
+		std::string savePath = torrent.savePath;
+		if (magnetUri.empty() || savePath.empty())
 		{
-			for (const auto &entry : config["torrents"])
+			// Fallback for snapshots taken without cached state.
+			try
 			{
-				if (entry.is_object() && entry.value("magnet_uri", "").size() > 0 && entry.contains("resume_data") && entry["resume_data"].is_string())
-					previousResumeData.emplace(entry["magnet_uri"].get<std::string>(), entry["resume_data"].get<std::string>());
+				const lt::torrent_status status = torrent.handle.status(lt::torrent_handle::query_save_path | lt::torrent_handle::query_name);
+				if (magnetUri.empty())
+					magnetUri = lt::make_magnet_uri(torrent.handle);
+				if (savePath.empty())
+					savePath = status.save_path;
+			}
+			catch (const std::exception &e)
+			{
+				Utils::Logger::warning("config", "Unable to read torrent state for persistence: " + std::string(e.what()));
 			}
 		}
-	}
-	for (const auto &torrent : torrents)
-	{
-		const auto &hash = torrent.hash;
-		const auto &handle = torrent.handle;
-		lt::torrent_status status = handle.status(lt::torrent_handle::query_save_path | lt::torrent_handle::query_name);
-		std::string magnetUri = lt::make_magnet_uri(handle);
-		std::string savePath = status.save_path;
 
 		json torrentEntry = {
 			{"magnet_uri", magnetUri},
@@ -475,27 +895,57 @@ void ConfigManager::saveTorrents(const std::vector<ManagedTorrent> &torrents)
 			torrentEntry["torrent_path"] = torrent.torrentFilePath;
 		if (!torrent.resumeData.empty())
 			torrentEntry["resume_data"] = encodeHex(torrent.resumeData);
-		else if (auto previous = previousResumeData.find(magnetUri); previous != previousResumeData.end())
-			torrentEntry["resume_data"] = previous->second;
 
-		torrentsJson.push_back(torrentEntry);
+		// Key by the v1 hash when present so it matches the magnet's btih.
+		entries.push_back({Utils::TorrentIdentity::digestHex(torrent.hash.has_v1() ? torrent.hash.v1 : torrent.hash.get_best()), std::move(torrentEntry)});
+	}
+
+	std::optional<TorrentJournal::Write> write;
+	{
+		std::lock_guard<std::mutex> lock(configMutex);
+		for (auto &entry : entries)
+		{
+			if (entry.value.contains("resume_data"))
+				continue;
+			const json *previous = torrentJournal.find(entry.key);
+			if (previous && previous->contains("resume_data"))
+				entry.value["resume_data"] = (*previous)["resume_data"];
+		}
+		write = torrentJournal.stage(std::move(entries));
+	}
+	if (!write)
+		return Result::Success();
+
+	const std::filesystem::path journalPath = TorrentJournal::journalPathFor(path);
+	Result result = Result::Success();
+	std::string errorMessage;
+	if (write->compact)
+	{
+		if (!writeJsonAtomically(path, write->snapshot, JsonFormat::Compact, errorMessage))
+			result = Result::Failure(errorMessage, ResultCode::Storage, true);
+		else
+			result = TorrentJournal::begin(journalPath, write->generation);
 	}
-	json torrentsFile;
+	else
 	{
+		result = TorrentJournal::append(journalPath, write->records);
+	}
+	if (!result)
+	{
+		Utils::Logger::error("config", "Failed to save torrents to '" + path + "': " + result.message);
+		// The files now lag the in-memory set; the next save rewrites both.
 		std::lock_guard<std::mutex> lock(configMutex);
-		config["torrents"] = torrentsJson;
-		torrentsFile = {{"version", 2}, {"torrents", config["torrents"]}};
+		torrentJournal.invalidate();
 	}
-	enqueueSave(Utils::AppPaths::torrentsConfigPath().string(), std::move(torrentsFile));
+	return result;
 }
 
 Result ConfigManager::loadTorrents(const std::string &path, std::vector<TorrentConfigData> &outTorrents)
 {
 	outTorrents.clear();
 
-	json sourceConfig;
+	std::optional<TorrentSnapshotReader> snapshot;
 	bool fileFound = false;
-	bool loadedFromFile = false;
 	std::string loadError;
 	std::vector<std::filesystem::path> candidates;
 	if (!path.empty())
@@ -504,83 +954,84 @@ Result ConfigManager::loadTorrents(const std::string &path, std::vector<TorrentC
 		candidates.emplace_back(std::filesystem::path(path).string() + ".bak");
 	}
 
+	// The snapshot is mapped and parsed in one pass into journal entries, so
+	// no document-sized DOM or read buffer is ever built.
 	for (const auto &candidate : candidates)
 	{
-		std::ifstream file(candidate);
-		if (!file.is_open())
+		Utils::MappedFile file;
+		if (!file.open(candidate))
 			continue;
 		fileFound = true;
 		try
 		{
-			json candidateConfig;
-			file >> candidateConfig;
-			if (!candidateConfig.is_object())
+			TorrentSnapshotReader reader;
+			const std::string_view content = file.view();
+			if (!json::sax_parse(content.begin(), content.end(), &reader))
 			{
-				loadError = "Invalid torrents configuration: root must be an object";
-				continue;
-			}
-			if (candidateConfig.contains("torrents") && !candidateConfig["torrents"].is_array())
-			{
-				loadError = "Invalid torrents configuration: 'torrents' must be an array";
+				loadError = reader.error.empty() ? "Unable to load torrents configuration" : reader.error;
 				continue;
 			}
 
-			sourceConfig = std::move(candidateConfig);
-			loadedFromFile = true;
+			snapshot = std::move(reader);
 			if (candidate.extension() == ".bak")
 				Utils::Logger::warning("config", "Loading backup torrents configuration: " + candidate.string());
 			break;
 		}
-		catch (const json::parse_error &e)
-		{
-			loadError = "Failed to parse torrents configuration: " + std::string(e.what());
-		}
 		catch (const std::exception &e)
 		{
 			loadError = "Error loading torrents configuration: " + std::string(e.what());
 		}
 	}
 
-	if (!loadedFromFile)
+	json legacyConfig = json::object();
+	if (!snapshot)
 	{
 		if (fileFound)
 			return Result::Failure(loadError.empty() ? "Unable to load torrents configuration" : loadError);
 
+		// Older releases kept the torrent list inside settings.json.
 		std::lock_guard<std::mutex> lock(configMutex);
-		sourceConfig = config;
+		if (config.contains("torrents"))
+		{
+			if (!config["torrents"].is_array())
+				return Result::Failure("Invalid torrents configuration: 'torrents' must be an array");
+			legacyConfig["torrents"] = config["torrents"];
+		}
 	}
 
-	if (!sourceConfig.contains("torrents"))
-		return Result::Success(); // No torrents to load is not an error
+	// Replay changes journaled since the snapshot was compacted.
+	std::vector<TorrentJournal::Entry> entries;
+	{
+		const std::filesystem::path journalPath = path.empty() ? std::filesystem::path() : TorrentJournal::journalPathFor(path);
+		std::lock_guard<std::mutex> lock(configMutex);
+		torrentsPath = path;
+		entries = snapshot
+			? torrentJournal.restore(snapshot->generation, std::move(snapshot->entries), journalPath)
+			: torrentJournal.restore(legacyConfig, journalPath);
+	}
 
 	try
 	{
-		const auto &torrentsJson = sourceConfig["torrents"];
-		if (!torrentsJson.is_array())
+		outTorrents.reserve(entries.size());
+		for (auto &entry : entries)
 		{
-			return Result::Failure("Invalid torrents configuration: 'torrents' must be an array");
-		}
-
-		outTorrents.reserve(torrentsJson.size());
-		for (const auto &torrent : torrentsJson)
-		{
-			if (!torrent.is_object())
-			{
-				Utils::Logger::warning("config", "Skipping a non-object torrent entry");
-				continue;
-			}
+			json &torrent = entry.value;
 			TorrentConfigData data;
-			if (torrent.contains("magnet_uri") && torrent["magnet_uri"].is_string())
-				data.magnetUri = torrent["magnet_uri"];
-			if (torrent.contains("save_path") && torrent["save_path"].is_string())
-				data.savePath = torrent["save_path"];
-			if (torrent.contains("torrent_path") && torrent["torrent_path"].is_string())
-				data.torrentFilePath = torrent["torrent_path"];
-			if (torrent.contains("resume_data") && torrent["resume_data"].is_string())
+			auto takeString = [&torrent](const char *field, std::string &target)
+			{
+				if (auto found = torrent.find(field); found != torrent.end() && found->is_string())
+					target = std::move(found->get_ref<std::string &>());
+			};
+			takeString("magnet_uri", data.magnetUri);
+			takeString("save_path", data.savePath);
+			takeString("torrent_path", data.torrentFilePath);
+			if (auto found = torrent.find("resume_data"); found != torrent.end() && found->is_string())
 			{
-				if (!decodeHex(torrent["resume_data"].get<std::string>(), data.resumeData))
+				if (!decodeHex(found->get_ref<const std::string &>(), data.resumeData))
 					Utils::Logger::warning("config", "Ignoring invalid or oversized fast-resume data");
 			}
+			// Release this entry's copy now rather than after the whole list.
+			torrent = nullptr;
 
 			if (data.savePath.empty() || (data.magnetUri.empty() && data.torrentFilePath.empty() && data.resumeData.empty()))
 			{
@@ -621,6 +1072,7 @@ void ConfigManager::setDownloadSpeedLimit(int bytesPerSecond)
 		config["settings"]["speed_limits"] = json::object();
 	}
 	config["settings"]["speed_limits"]["download"] = std::max(bytesPerSecond, 0);
+	publishPreferencesUnlocked();
 }
 
 void ConfigManager::setUploadSpeedLimit(int bytesPerSecond)
@@ -632,36 +1084,17 @@ void ConfigManager::setUploadSpeedLimit(int bytesPerSecond)
 		config["settings"]["speed_limits"] = json::object();
 	}
 	config["settings"]["speed_limits"]["upload"] = std::max(bytesPerSecond, 0);
+	publishPreferencesUnlocked();
 }
 
 int ConfigManager::getDownloadSpeedLimit() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("speed_limits") && config["speed_limits"].contains("download"))
-	{
-		return config["speed_limits"]["download"];
-	}
-	if (config.contains("settings") && config["settings"].contains("speed_limits") &&
-		config["settings"]["speed_limits"].contains("download"))
-	{
-		return config["settings"]["speed_limits"]["download"];
-	}
-	return 0; // 0 means unlimited
+	return currentPreferences()->downloadSpeedLimit;
 }
 
 int ConfigManager::getUploadSpeedLimit() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("speed_limits") && config["speed_limits"].contains("upload"))
-	{
-		return config["speed_limits"]["upload"];
-	}
-	if (config.contains("settings") && config["settings"].contains("speed_limits") &&
-		config["settings"]["speed_limits"].contains("upload"))
-	{
-		return config["settings"]["speed_limits"]["upload"];
-	}
-	return 0; // 0 means unlimited
+	return currentPreferences()->uploadSpeedLimit;
 }
 
 void ConfigManager::setDownloadPath(const std::string &path)
@@ -669,16 +1102,12 @@ void ConfigManager::setDownloadPath(const std::string &path)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["download_path"] = path;
+	publishPreferencesUnlocked();
 }
 
 std::string ConfigManager::getDownloadPath() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("settings") && config["settings"].contains("download_path"))
-	{
-		return config["settings"]["download_path"];
-	}
-	return "~/Downloads";
+	return currentPreferences()->downloadPath;
 }
 
 void ConfigManager::setEnableDHT(bool enable)
@@ -686,16 +1115,12 @@ void ConfigManager::setEnableDHT(bool enable)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["enable_dht"] = enable;
+	publishPreferencesUnlocked();
 }
 
 bool ConfigManager::getEnableDHT() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("settings") && config["settings"].contains("enable_dht"))
-	{
-		return config["settings"]["enable_dht"];
-	}
-	return true; // Default to enabled
+	return currentPreferences()->enableDht;
 }
 
 void ConfigManager::setEnableUPnP(bool enable)
@@ -703,16 +1128,12 @@ void ConfigManager::setEnableUPnP(bool enable)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["enable_upnp"] = enable;
+	publishPreferencesUnlocked();
 }
 
 bool ConfigManager::getEnableUPnP() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("settings") && config["settings"].contains("enable_upnp"))
-	{
-		return config["settings"]["enable_upnp"];
-	}
-	return true; // Default to enabled
+	return currentPreferences()->enableUpnp;
 }
 
 void ConfigManager::setEnableNATPMP(bool enable)
@@ -720,16 +1141,12 @@ void ConfigManager::setEnableNATPMP(bool enable)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["enable_natpmp"] = enable;
+	publishPreferencesUnlocked();
 }
 
 bool ConfigManager::getEnableNATPMP() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("settings") && config["settings"].contains("enable_natpmp"))
-	{
-		return config["settings"]["enable_natpmp"];
-	}
-	return true; // Default to enabled
+	return currentPreferences()->enableNatPmp;
 }
 
 void ConfigManager::setTorznabUrl(const std::string &url)
@@ -737,14 +1154,12 @@ void ConfigManager::setTorznabUrl(const std::string &url)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["search"]["torznab_url"] = url;
+	publishPreferencesUnlocked();
 }
 
 std::string ConfigManager::getTorznabUrl() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("settings") && config["settings"].contains("search"))
-		return config["settings"]["search"].value("torznab_url", "");
-	return {};
+	return currentPreferences()->torznabUrl;
 }
 
 void ConfigManager::setTorznabEnabled(bool enable)
@@ -752,14 +1167,12 @@ void ConfigManager::setTorznabEnabled(bool enable)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["search"]["torznab_enabled"] = enable;
+	publishPreferencesUnlocked();
 }
 
 bool ConfigManager::getTorznabEnabled() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("settings") && config["settings"].contains("search"))
-		return config["settings"]["search"].value("torznab_enabled", false);
-	return false;
+	return currentPreferences()->torznabEnabled;
 }
 
 void ConfigManager::setProxyEnabled(bool enable)
@@ -767,13 +1180,12 @@ void ConfigManager::setProxyEnabled(bool enable)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["proxy"]["enabled"] = enable;
+	publishPreferencesUnlocked();
 }
 
 bool ConfigManager::getProxyEnabled() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	return config.contains("settings") && config["settings"].contains("proxy")
-		? config["settings"]["proxy"].value("enabled", false) : false;
+	return currentPreferences()->proxyEnabled;
 }
 
 void ConfigManager::setProxyType(const std::string &type)
@@ -781,13 +1193,12 @@ void ConfigManager::setProxyType(const std::string &type)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["proxy"]["type"] = type == "http" ? "http" : "socks5";
+	publishPreferencesUnlocked();
 }
 
 std::string ConfigManager::getProxyType() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	return config.contains("settings") && config["settings"].contains("proxy")
-		? config["settings"]["proxy"].value("type", "socks5") : "socks5";
+	return currentPreferences()->proxyType;
 }
 
 void ConfigManager::setProxyHost(const std::string &host)
@@ -795,13 +1206,12 @@ void ConfigManager::setProxyHost(const std::string &host)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["proxy"]["host"] = host;
+	publishPreferencesUnlocked();
 }
 
 std::string ConfigManager::getProxyHost() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	return config.contains("settings") && config["settings"].contains("proxy")
-		? config["settings"]["proxy"].value("host", "127.0.0.1") : "127.0.0.1";
+	return currentPreferences()->proxyHost;
 }
 
 void ConfigManager::setProxyPort(int port)
@@ -809,14 +1219,12 @@ void ConfigManager::setProxyPort(int port)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["proxy"]["port"] = std::clamp(port, 1, 65535);
+	publishPreferencesUnlocked();
 }
 
 int ConfigManager::getProxyPort() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (!config.contains("settings") || !config["settings"].contains("proxy"))
-		return 1080;
-	return std::clamp(config["settings"]["proxy"].value("port", 1080), 1, 65535);
+	return currentPreferences()->proxyPort;
 }
 
 void ConfigManager::setProxyUsername(const std::string &username)
@@ -824,13 +1232,25 @@ void ConfigManager::setProxyUsername(const std::string &username)
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureSettingsStructure();
 	config["settings"]["proxy"]["username"] = username;
+	publishPreferencesUnlocked();
 }
 
 std::string ConfigManager::getProxyUsername() const
+{
+	return currentPreferences()->proxyUsername;
+}
+
+void ConfigManager::setControlSocketEnabled(bool enable)
 {
 	std::lock_guard<std::mutex> lock(configMutex);
-	return config.contains("settings") && config["settings"].contains("proxy")
-		? config["settings"]["proxy"].value("username", "") : "";
+	ensureSettingsStructure();
+	config["settings"]["control_socket"]["enabled"] = enable;
+	publishPreferencesUnlocked();
+}
+
+bool ConfigManager::getControlSocketEnabled() const
+{
+	return currentPreferences()->controlSocketEnabled;
 }
 
 int ConfigManager::getConfigVersion() const
@@ -847,6 +1267,7 @@ void ConfigManager::ensureDefaultConfig()
 {
 	std::lock_guard<std::mutex> lock(configMutex);
 	ensureDefaultConfigUnlocked();
+	publishPreferencesUnlocked();
 }
 
 void ConfigManager::ensureDefaultConfigUnlocked()
@@ -876,6 +1297,7 @@ void ConfigManager::migrateConfig(int fromVersion, int toVersion)
 {
 	std::lock_guard<std::mutex> lock(configMutex);
 	migrateConfigUnlocked(fromVersion, toVersion);
+	publishPreferencesUnlocked();
 }
 
 void ConfigManager::migrateConfigUnlocked(int fromVersion, int toVersion)
@@ -935,135 +1357,87 @@ void ConfigManager::migrateConfigUnlocked(int fromVersion, int toVersion)
 	}
 }
 
-void ConfigManager::saveFavoritesAndHistory(const std::vector<TorrentSearchResult> &favorites, const std::vector<std::string> &searchHistory)
+void ConfigManager::saveFavoritesAndHistory(const std::string &path, std::vector<TorrentSearchResult> favorites, std::vector<std::string> searchHistory)
 {
-	// Save favorites
-	json favoritesJson = json::array();
-	for (const auto &fav : favorites)
-	{
-		json favEntry = {
-			{"name", fav.name},
-			{"magnet_uri", fav.magnetUri},
-			{"info_hash", fav.infoHash},
-			{"size_bytes", fav.sizeBytes},
-			{"seeders", fav.seeders},
-			{"leechers", fav.leechers},
-			{"date_uploaded", fav.dateUploaded},
-			{"category", fav.category},
-			{"created_unix", fav.createdUnix},
-			{"scraped_date", fav.scrapedDate},
-			{"completed", fav.completed}};
-		favoritesJson.push_back(favEntry);
-	}
-	json configSnapshot;
-	{
-		std::lock_guard<std::mutex> lock(configMutex);
-		config["favorites"] = std::move(favoritesJson);
-
-		// Save search history
-		config["search_history"] = searchHistory;
-
-		// Ensure version is always present before saving
-		if (!config.contains("version"))
-		{
-			config["version"] = CURRENT_CONFIG_VERSION;
-		}
-		configSnapshot = config;
-	}
-
-	// Save to file
-	enqueueSave(Utils::AppPaths::settingsConfigPath().string(), std::move(configSnapshot));
+	SaveRequest request;
+	request.path = path;
+	request.format = JsonFormat::Compact;
+	request.favorites.emplace(std::move(favorites), std::move(searchHistory));
+	enqueueSave(std::move(request));
 }
 
-void ConfigManager::loadFavoritesAndHistory(std::vector<TorrentSearchResult> &favorites, std::vector<std::string> &searchHistory)
+Result ConfigManager::loadFavoritesAndHistory(const std::string &path, std::vector<TorrentSearchResult> &favorites, std::vector<std::string> &searchHistory)
 {
 	favorites.clear();
 	searchHistory.clear();
 
-	json configSnapshot;
-	{
-		std::lock_guard<std::mutex> lock(configMutex);
-		configSnapshot = config;
-	}
-
-	// Load favorites
-	if (configSnapshot.contains("favorites") && configSnapshot["favorites"].is_array())
+	bool fileFound = false;
+	std::string loadError;
+	for (const auto &candidate : {std::filesystem::path(path), std::filesystem::path(path + ".bak")})
 	{
-		for (const auto &favJson : configSnapshot["favorites"])
+		std::ifstream file(candidate);
+		if (!file.is_open())
+			continue;
+		fileFound = true;
+		try
 		{
-			TorrentSearchResult fav;
-			if (favJson.contains("name"))
-				fav.name = favJson["name"];
-			if (favJson.contains("magnet_uri"))
-				fav.magnetUri = favJson["magnet_uri"];
-			if (favJson.contains("info_hash"))
-				fav.infoHash = favJson["info_hash"];
-			if (favJson.contains("size_bytes"))
-				fav.sizeBytes = favJson["size_bytes"];
-			if (favJson.contains("seeders"))
-				fav.seeders = favJson["seeders"];
-			if (favJson.contains("leechers"))
-				fav.leechers = favJson["leechers"];
-			if (favJson.contains("date_uploaded"))
-				fav.dateUploaded = favJson["date_uploaded"];
-			if (favJson.contains("category"))
-				fav.category = favJson["category"];
-			if (favJson.contains("created_unix"))
-				fav.createdUnix = favJson["created_unix"];
-			if (favJson.contains("scraped_date"))
-				fav.scrapedDate = favJson["scraped_date"];
-			if (favJson.contains("completed"))
-				fav.completed = favJson["completed"];
-			favorites.push_back(fav);
+			json document;
+			file >> document;
+			if (!document.is_object() || !document.contains("columns") || !document["columns"].is_array()
+				|| !document.contains("favorites") || !document["favorites"].is_array())
+			{
+				loadError = "Invalid favorites file: expected 'columns' and 'favorites' arrays";
+				continue;
+			}
+			decodeFavoriteRows(document, favorites);
+			decodeSearchHistory(document, searchHistory);
+			if (candidate.extension() == ".bak")
+				Utils::Logger::warning("config", "Loading backup favorites: " + candidate.string());
+			return Result::Success();
+		}
+		catch (const std::exception &e)
+		{
+			loadError = "Failed to parse favorites: " + std::string(e.what());
 		}
 	}
+	if (fileFound)
+		return Result::Failure(loadError);
 
-	// Load search history
-	if (configSnapshot.contains("search_history") && configSnapshot["search_history"].is_array())
+	// First run after the split: move entries out of the settings document
+	// so preference saves no longer carry them.
+	json legacy = json::object();
 	{
-		for (const auto &historyItem : configSnapshot["search_history"])
+		std::lock_guard<std::mutex> lock(configMutex);
+		for (const char *key : {"favorites", "search_history"})
 		{
-			if (historyItem.is_string())
-			{
-				searchHistory.push_back(historyItem);
-			}
+			if (!config.contains(key))
+				continue;
+			legacy[key] = std::move(config[key]);
+			config.erase(key);
 		}
 	}
+	if (legacy.empty())
+		return Result::Success();
+	if (legacy.contains("favorites") && legacy["favorites"].is_array())
+		decodeLegacyFavorites(legacy["favorites"], favorites);
+	decodeSearchHistory(legacy, searchHistory);
+	Utils::Logger::info("config", "Moved " + std::to_string(favorites.size()) + " favorite(s) from settings to " + path);
+	// Queued ahead of the next settings save, so the entries reach their new
+	// file before the settings document drops them.
+	saveFavoritesAndHistory(path, favorites, searchHistory);
+	return Result::Success();
 }
 
 void ConfigManager::setTheme(int themeIndex)
 {
 	std::lock_guard<std::mutex> lock(configMutex);
 	config["theme"] = themeIndex;
+	publishPreferencesUnlocked();
 }
 
 int ConfigManager::getTheme() const
 {
-	std::lock_guard<std::mutex> lock(configMutex);
-	if (config.contains("theme"))
-	{
-		// Handle both string (legacy) and number formats
-		if (config["theme"].is_string())
-		{
-			std::string themeStr = config["theme"];
-			if (themeStr == "dark")
-				return 0;
-			if (themeStr == "ocean")
-				return 1;
-			if (themeStr == "nord")
-				return 2;
-			if (themeStr == "dracula")
-				return 3;
-			if (themeStr == "cyberpunk")
-				return 4;
-			return 0; // Default to dark if unknown
-		}
-		else if (config["theme"].is_number())
-		{
-			return config["theme"];
-		}
-	}
-	return 0; // Default to Dark theme
+	return currentPreferences()->theme;
 }
 
 void ConfigManager::waitForAsyncOperations()
@@ -1104,6 +1478,7 @@ void ConfigManager::applyDefaultConfig()
 	// Update the download path in the default config with the platform-appropriate path
 	defaultConfig["settings"]["download_path"] = default_path;
 	config = defaultConfig;
+	publishPreferencesUnlocked();
 }
 
 bool ConfigManager::validateConfig()
@@ -0,0 +1,1321 @@
+#include "ControlServer.hpp"
+#include "SearchEngine.hpp"
+#include "AppPaths.hpp"
+#include "Logger.hpp"
+#include "utils/TorrentIdentity.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace
+{
+#ifdef _WIN32
+using NativeSocket = SOCKET;
+using PollDescriptor = WSAPOLLFD;
+const NativeSocket invalidSocket = INVALID_SOCKET;
+
+int pollSockets(PollDescriptor *descriptors, std::size_t count, int timeoutMs)
+{
+	return WSAPoll(descriptors, static_cast<ULONG>(count), timeoutMs);
+}
+
+void closeSocket(NativeSocket socket)
+{
+	closesocket(socket);
+}
+
+bool setNonBlocking(NativeSocket socket)
+{
+	u_long mode = 1;
+	return ioctlsocket(socket, FIONBIO, &mode) == 0;
+}
+
+bool interrupted()
+{
+	const int error = WSAGetLastError();
+	return error == WSAEWOULDBLOCK || error == WSAEINTR;
+}
+
+long long sendSome(NativeSocket socket, const char *data, std::size_t size)
+{
+	return send(socket, data, static_cast<int>(std::min<std::size_t>(size, std::numeric_limits<int>::max())), 0);
+}
+
+long long receiveSome(NativeSocket socket, char *data, std::size_t size)
+{
+	return recv(socket, data, static_cast<int>(size), 0);
+}
+#else
+using NativeSocket = int;
+using PollDescriptor = pollfd;
+constexpr NativeSocket invalidSocket = -1;
+
+int pollSockets(PollDescriptor *descriptors, std::size_t count, int timeoutMs)
+{
+	return ::poll(descriptors, static_cast<nfds_t>(count), timeoutMs);
+}
+
+void closeSocket(NativeSocket socket)
+{
+	::close(socket);
+}
+
+bool setNonBlocking(NativeSocket socket)
+{
+	const int flags = fcntl(socket, F_GETFL, 0);
+	return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool interrupted()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+long long sendSome(NativeSocket socket, const char *data, std::size_t size)
+{
+#ifdef MSG_NOSIGNAL
+	return ::send(socket, data, size, MSG_NOSIGNAL);
+#else
+	return ::send(socket, data, size, 0);
+#endif
+}
+
+long long receiveSome(NativeSocket socket, char *data, std::size_t size)
+{
+	return ::recv(socket, data, size, 0);
+}
+#endif
+
+NativeSocket nativeSocket(std::intptr_t socket)
+{
+	return static_cast<NativeSocket>(socket);
+}
+
+void disableSigPipe([[maybe_unused]] NativeSocket socket)
+{
+#ifdef SO_NOSIGPIPE
+	const int enabled = 1;
+	setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+}
+
+constexpr int pollIntervalMs = 50;
+constexpr std::size_t maxPendingEvents = 4096;
+constexpr std::size_t maxReadsPerWakeup = 64;
+
+constexpr int parseError = -32700;
+constexpr int invalidRequest = -32600;
+constexpr int methodNotFound = -32601;
+constexpr int invalidParams = -32602;
+
+const char *resultCodeName(ResultCode code)
+{
+	switch (code)
+	{
+	case ResultCode::None: return "None";
+	case ResultCode::InvalidInput: return "InvalidInput";
+	case ResultCode::NotFound: return "NotFound";
+	case ResultCode::Duplicate: return "Duplicate";
+	case ResultCode::Busy: return "Busy";
+	case ResultCode::Cancelled: return "Cancelled";
+	case ResultCode::Network: return "Network";
+	case ResultCode::Unauthorized: return "Unauthorized";
+	case ResultCode::RateLimited: return "RateLimited";
+	case ResultCode::Parse: return "Parse";
+	case ResultCode::Storage: return "Storage";
+	case ResultCode::Unavailable: return "Unavailable";
+	case ResultCode::Partial: return "Partial";
+	case ResultCode::Internal: return "Internal";
+	}
+	return "Internal";
+}
+
+// Invalid input maps to the standard "Invalid params" code; every other
+// ResultCode gets a stable value in the implementation-defined server range.
+json errorObject(const Result &result)
+{
+	const int code = result.code == ResultCode::InvalidInput ? invalidParams : -32000 - static_cast<int>(result.code);
+	return {
+		{"code", code},
+		{"message", result.message},
+		{"data", {{"reason", resultCodeName(result.code)}, {"retryable", result.retryable}}}};
+}
+
+json errorResponse(const json &id, int code, const std::string &message)
+{
+	return {{"jsonrpc", "2.0"}, {"id", id}, {"error", {{"code", code}, {"message", message}}}};
+}
+
+json itemResult(const Result &result)
+{
+	if (result)
+		return {{"ok", true}};
+	return {{"ok", false}, {"error", errorObject(result)}};
+}
+
+std::string serialize(const json &message)
+{
+	// Torrent names come from remote metadata and are not guaranteed to be
+	// valid UTF-8; replacement keeps one bad name from failing a whole batch.
+	return message.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+std::string notificationText(const char *method, json params)
+{
+	return serialize({{"jsonrpc", "2.0"}, {"method", method}, {"params", std::move(params)}});
+}
+
+const char *severityName(Utils::LogLevel level)
+{
+	switch (level)
+	{
+	case Utils::LogLevel::Debug: return "debug";
+	case Utils::LogLevel::Info: return "info";
+	case Utils::LogLevel::Warning: return "warning";
+	case Utils::LogLevel::Error: return "error";
+	}
+	return "info";
+}
+
+using FieldReader = json (*)(const Presentation::TorrentRowDto &);
+
+const std::vector<std::pair<std::string_view, FieldReader>> &torrentFields()
+{
+	using Row = Presentation::TorrentRowDto;
+	static const std::vector<std::pair<std::string_view, FieldReader>> fields = {
+		{"id", [](const Row &row) -> json { return row.id; }},
+		{"name", [](const Row &row) -> json { return row.name; }},
+		{"state", [](const Row &row) -> json { return row.stateLabel; }},
+		{"progress", [](const Row &row) -> json { return row.progress; }},
+		{"sizeBytes", [](const Row &row) -> json { return row.sizeBytes; }},
+		{"downloadRate", [](const Row &row) -> json { return row.downloadRateBytes; }},
+		{"uploadRate", [](const Row &row) -> json { return row.uploadRateBytes; }},
+		{"etaSeconds", [](const Row &row) -> json { return row.etaSeconds; }},
+		{"queuePosition", [](const Row &row) -> json { return row.queuePosition; }},
+		{"peers", [](const Row &row) -> json { return row.peers; }},
+		{"seeds", [](const Row &row) -> json { return row.seeds; }},
+		{"paused", [](const Row &row) -> json { return row.paused; }},
+		{"active", [](const Row &row) -> json { return row.active; }},
+		{"finished", [](const Row &row) -> json { return row.finished; }},
+		{"error", [](const Row &row) -> json { return row.error; }},
+		{"metadataPending", [](const Row &row) -> json { return row.metadataPending; }}};
+	return fields;
+}
+
+// Resolves requested field names to reader indices. The id is always present
+// so streamed deltas can be keyed by the client.
+Result readFields(const json &params, std::vector<std::size_t> &indices)
+{
+	const auto &fields = torrentFields();
+	indices.clear();
+	if (!params.contains("fields"))
+	{
+		for (std::size_t index = 0; index < fields.size(); ++index)
+			indices.push_back(index);
+		return Result::Success();
+	}
+	if (!params["fields"].is_array())
+		return Result::Failure("fields must be an array of strings", ResultCode::InvalidInput);
+	indices.push_back(0);
+	for (const auto &field : params["fields"])
+	{
+		if (!field.is_string())
+			return Result::Failure("fields must be an array of strings", ResultCode::InvalidInput);
+		const auto name = field.get<std::string>();
+		const auto found = std::find_if(fields.begin(), fields.end(), [&name](const auto &entry) { return entry.first == name; });
+		if (found == fields.end())
+			return Result::Failure("Unknown torrent field: " + name, ResultCode::InvalidInput);
+		const auto index = static_cast<std::size_t>(found - fields.begin());
+		if (std::find(indices.begin(), indices.end(), index) == indices.end())
+			indices.push_back(index);
+	}
+	return Result::Success();
+}
+
+json projectRow(const Presentation::TorrentRowDto &row, const std::vector<std::size_t> &indices)
+{
+	const auto &fields = torrentFields();
+	json projected = json::object();
+	for (const auto index : indices)
+		projected[std::string(fields[index].first)] = fields[index].second(row);
+	return projected;
+}
+
+Result readStringList(const json &params, const char *key, std::size_t limit, std::vector<std::string> &values)
+{
+	values.clear();
+	if (!params.contains(key) || !params[key].is_array())
+		return Result::Failure(std::string(key) + " must be an array of strings", ResultCode::InvalidInput);
+	if (params[key].size() > limit)
+		return Result::Failure(std::string(key) + " exceeds " + std::to_string(limit) + " entries", ResultCode::InvalidInput);
+	values.reserve(params[key].size());
+	for (const auto &value : params[key])
+	{
+		if (!value.is_string())
+			return Result::Failure(std::string(key) + " must be an array of strings", ResultCode::InvalidInput);
+		values.push_back(value.get<std::string>());
+	}
+	return Result::Success();
+}
+
+std::optional<TorrentCommand> commandForName(const std::string &name)
+{
+	static const std::unordered_map<std::string, TorrentCommand> commands = {
+		{"pause", TorrentCommand::Pause},
+		{"resume", TorrentCommand::Resume},
+		{"force_start", TorrentCommand::ForceStart},
+		{"recheck", TorrentCommand::ForceRecheck},
+		{"queue_up", TorrentCommand::MoveQueueUp},
+		{"queue_down", TorrentCommand::MoveQueueDown},
+		{"queue_top", TorrentCommand::MoveQueueTop},
+		{"queue_bottom", TorrentCommand::MoveQueueBottom},
+		{"reannounce", TorrentCommand::ForceReannounce},
+		{"sequential_on", TorrentCommand::EnableSequential},
+		{"sequential_off", TorrentCommand::DisableSequential}};
+	const auto found = commands.find(name);
+	if (found == commands.end())
+		return std::nullopt;
+	return found->second;
+}
+
+std::optional<Utils::LogLevel> severityForName(const std::string &name)
+{
+	if (name == "debug") return Utils::LogLevel::Debug;
+	if (name == "info") return Utils::LogLevel::Info;
+	if (name == "warning") return Utils::LogLevel::Warning;
+	if (name == "error") return Utils::LogLevel::Error;
+	return std::nullopt;
+}
+} // namespace
+
+ControlOutbox::ControlOutbox(std::size_t watermarkBytes, std::size_t limitBytes)
+	: watermarkBytes_(watermarkBytes), limitBytes_(std::max(limitBytes, watermarkBytes))
+{
+}
+
+bool ControlOutbox::pushResponse(std::string_view message)
+{
+	if (size() + message.size() + 1 > limitBytes_)
+		return false;
+	append(message);
+	return true;
+}
+
+bool ControlOutbox::pushNotification(std::string_view message)
+{
+	if (!acceptsNotifications() || size() + message.size() + 1 > limitBytes_)
+		return false;
+	append(message);
+	return true;
+}
+
+std::string_view ControlOutbox::pending() const
+{
+	return std::string_view(buffer_).substr(offset_);
+}
+
+void ControlOutbox::consume(std::size_t bytes)
+{
+	offset_ = std::min(offset_ + bytes, buffer_.size());
+	if (offset_ == buffer_.size())
+	{
+		buffer_.clear();
+		offset_ = 0;
+	}
+}
+
+void ControlOutbox::append(std::string_view message)
+{
+	// Reclaim the sent prefix lazily so partial writes stay O(1).
+	if (offset_ > 0 && offset_ >= buffer_.size() / 2)
+	{
+		buffer_.erase(0, offset_);
+		offset_ = 0;
+	}
+	buffer_.append(message);
+	buffer_.push_back('\n');
+}
+
+struct ControlServer::Client
+{
+	Client(std::uint64_t id, NativeSocket socket, const ControlServerOptions &options)
+		: id(id), socket(socket), outbox(options.notificationWatermarkBytes, options.maxOutgoingBytes) {}
+
+	const std::uint64_t id;
+	const NativeSocket socket;
+	// Only the I/O thread touches the inbound buffer.
+	std::string inbound;
+
+	// Everything below is shared with the search worker.
+	std::mutex mutex;
+	ControlOutbox outbox;
+	bool closing = false;
+	bool overflowed = false;
+	int pendingSlowRequests = 0;
+	bool statusSubscribed = false;
+	bool eventsSubscribed = false;
+	Utils::LogLevel minimumSeverity = Utils::LogLevel::Info;
+	std::vector<std::size_t> statusFields;
+	std::unordered_map<std::string, json> statusSent;
+	std::pair<std::uint64_t, std::uint64_t> statusRevisionSent{
+		std::numeric_limits<std::uint64_t>::max(), std::numeric_limits<std::uint64_t>::max()};
+	std::uint64_t droppedEvents = 0;
+};
+
+ControlServer::ControlServer(TorrentManager &torrentManager, SearchEngine &searchEngine)
+	: torrentManager_(torrentManager), searchEngine_(searchEngine), presenter_(torrentManager)
+{
+}
+
+ControlServer::~ControlServer()
+{
+	stop();
+}
+
+std::filesystem::path ControlServer::defaultSocketPath()
+{
+	return Utils::AppPaths::dataDirectory() / "hypertube.sock";
+}
+
+std::filesystem::path ControlServer::socketPath() const
+{
+	return socketPath_;
+}
+
+Result ControlServer::start(const std::filesystem::path &socketPath, ControlServerOptions options)
+{
+	if (running_.load())
+		return Result::Failure("Control server is already running", ResultCode::Busy);
+	if (socketPath.empty())
+		return Result::Failure("Control socket path cannot be empty", ResultCode::InvalidInput);
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	const std::string native = socketPath.string();
+	if (native.size() >= sizeof(address.sun_path))
+		return Result::Failure("Control socket path is too long: " + native, ResultCode::InvalidInput);
+	std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return Result::Failure("Unable to initialize Winsock", ResultCode::Unavailable);
+#endif
+	auto fail = [](NativeSocket socket, const std::string &message, ResultCode code)
+	{
+		if (socket != invalidSocket)
+			closeSocket(socket);
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return Result::Failure(message, code);
+	};
+
+	std::error_code error;
+	if (!socketPath.parent_path().empty())
+		std::filesystem::create_directories(socketPath.parent_path(), error);
+	if (std::filesystem::exists(socketPath, error))
+	{
+		// A live instance still accepts connections; anything else is a socket
+		// left behind by a crash and can be replaced.
+		const NativeSocket probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		const bool live = probe != invalidSocket
+			&& ::connect(probe, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+		if (probe != invalidSocket)
+			closeSocket(probe);
+		if (live)
+			return fail(invalidSocket, "Another instance is already serving " + native, ResultCode::Busy);
+		std::filesystem::remove(socketPath, error);
+	}
+
+	const NativeSocket listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == invalidSocket)
+		return fail(listener, "Unable to create control socket", ResultCode::Unavailable);
+	if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+		return fail(listener, "Unable to bind control socket: " + native, ResultCode::Storage);
+#ifndef _WIN32
+	// Restrict access before listen() so no other user can connect in between.
+	::chmod(native.c_str(), S_IRUSR | S_IWUSR);
+#endif
+	if (::listen(listener, 16) != 0 || !setNonBlocking(listener))
+	{
+		std::filesystem::remove(socketPath, error);
+		return fail(listener, "Unable to listen on control socket: " + native, ResultCode::Unavailable);
+	}
+
+	options_ = std::move(options);
+	socketPath_ = socketPath;
+	listenSocket_ = static_cast<std::intptr_t>(listener);
+	stopRequested_ = false;
+	lastStatusPublish_ = {};
+	eventListenerId_ = torrentManager_.addEventListener([this](const TorrentEvent &event)
+	{
+		std::lock_guard<std::mutex> lock(eventMutex_);
+		if (pendingEvents_.size() >= maxPendingEvents)
+		{
+			++droppedEvents_;
+			return;
+		}
+		pendingEvents_.push_back(event);
+	});
+	running_ = true;
+	ioThread_ = std::thread(&ControlServer::ioLoop, this);
+	slowWorker_ = std::thread(&ControlServer::slowWorkerLoop, this);
+	Utils::Logger::info("control", "Control socket listening on " + native);
+	return Result::Success();
+}
+
+void ControlServer::stop()
+{
+	if (!running_.exchange(false))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(slowMutex_);
+		stopRequested_ = true;
+		slowRequests_.clear();
+	}
+	if (slowBusy_.load())
+		searchEngine_.cancelCurrentSearch();
+	slowCv_.notify_all();
+	if (slowWorker_.joinable())
+		slowWorker_.join();
+	if (ioThread_.joinable())
+		ioThread_.join();
+	torrentManager_.removeEventListener(eventListenerId_);
+	eventListenerId_ = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(clientsMutex_);
+		for (const auto &[id, client] : clients_)
+			closeSocket(client->socket);
+		clients_.clear();
+	}
+	{
+		std::lock_guard<std::mutex> lock(eventMutex_);
+		pendingEvents_.clear();
+		droppedEvents_ = 0;
+	}
+	closeSocket(nativeSocket(listenSocket_));
+	listenSocket_ = -1;
+	std::error_code error;
+	std::filesystem::remove(socketPath_, error);
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	Utils::Logger::info("control", "Control socket closed");
+}
+
+void ControlServer::ioLoop()
+{
+	std::vector<PollDescriptor> descriptors;
+	std::vector<std::shared_ptr<Client>> polled;
+	while (!stopRequested_.load())
+	{
+		descriptors.clear();
+		polled.clear();
+		PollDescriptor listener{};
+		listener.fd = nativeSocket(listenSocket_);
+		listener.events = POLLIN;
+		descriptors.push_back(listener);
+		{
+			std::lock_guard<std::mutex> lock(clientsMutex_);
+			for (const auto &[id, client] : clients_)
+			{
+				std::lock_guard<std::mutex> clientLock(client->mutex);
+				// A half-closed peer keeps reporting POLLHUP; leave it out of the
+				// poll set until there is something left to flush.
+				if (client->closing && client->outbox.empty())
+					continue;
+				PollDescriptor descriptor{};
+				descriptor.fd = client->socket;
+				if (!client->closing)
+					descriptor.events |= POLLIN;
+				if (!client->outbox.empty())
+					descriptor.events |= POLLOUT;
+				descriptors.push_back(descriptor);
+				polled.push_back(client);
+			}
+		}
+
+		const int ready = pollSockets(descriptors.data(), descriptors.size(), pollIntervalMs);
+		if (ready < 0 && !interrupted())
+		{
+			Utils::Logger::error("control", "Control socket poll failed; stopping the server loop");
+			return;
+		}
+		if (ready > 0)
+		{
+			if (descriptors.front().revents & POLLIN)
+				acceptClients();
+			for (std::size_t index = 0; index < polled.size(); ++index)
+			{
+				const auto &client = polled[index];
+				const auto revents = descriptors[index + 1].revents;
+				bool keep = (revents & (POLLERR | POLLNVAL)) == 0;
+				if (keep && (descriptors[index + 1].events & POLLIN) && (revents & (POLLIN | POLLHUP)))
+					keep = readClient(client);
+				if (keep && (revents & POLLOUT))
+					keep = writeClient(client);
+				if (!keep)
+					closeClient(client);
+			}
+		}
+
+		publishEvents();
+		publishStatus();
+
+		std::vector<std::shared_ptr<Client>> finished;
+		{
+			std::lock_guard<std::mutex> lock(clientsMutex_);
+			for (const auto &[id, client] : clients_)
+			{
+				std::lock_guard<std::mutex> clientLock(client->mutex);
+				if (client->overflowed || (client->closing && client->outbox.empty() && client->pendingSlowRequests == 0))
+					finished.push_back(client);
+			}
+		}
+		for (const auto &client : finished)
+			closeClient(client);
+	}
+}
+
+void ControlServer::acceptClients()
+{
+	while (true)
+	{
+		const NativeSocket socket = ::accept(nativeSocket(listenSocket_), nullptr, nullptr);
+		if (socket == invalidSocket)
+			return;
+		if (!setNonBlocking(socket))
+		{
+			closeSocket(socket);
+			continue;
+		}
+		disableSigPipe(socket);
+		std::lock_guard<std::mutex> lock(clientsMutex_);
+		if (clients_.size() >= options_.maxClients)
+		{
+			closeSocket(socket);
+			Utils::Logger::warning("control", "Rejected a control connection: client limit reached");
+			continue;
+		}
+		const std::uint64_t id = nextClientId_++;
+		clients_.emplace(id, std::make_shared<Client>(id, socket, options_));
+	}
+}
+
+bool ControlServer::readClient(const std::shared_ptr<Client> &client)
+{
+	std::array<char, 16384> buffer;
+	for (std::size_t reads = 0; reads < maxReadsPerWakeup; ++reads)
+	{
+		const long long received = receiveSome(client->socket, buffer.data(), buffer.size());
+		if (received < 0)
+			return interrupted();
+		if (received == 0)
+		{
+			// The peer may half-close after its last request; answer what was
+			// already received and close once the responses are flushed.
+			std::lock_guard<std::mutex> lock(client->mutex);
+			client->closing = true;
+			return true;
+		}
+
+		client->inbound.append(buffer.data(), static_cast<std::size_t>(received));
+		std::size_t start = 0;
+		for (std::size_t newline = client->inbound.find('\n'); newline != std::string::npos;
+			newline = client->inbound.find('\n', start))
+		{
+			handleLine(client, std::string_view(client->inbound).substr(start, newline - start));
+			start = newline + 1;
+		}
+		client->inbound.erase(0, start);
+		if (client->inbound.size() > options_.maxMessageBytes)
+		{
+			client->inbound.clear();
+			deliver(*client, errorResponse(nullptr, parseError,
+				"Message exceeds " + std::to_string(options_.maxMessageBytes) + " bytes"));
+			std::lock_guard<std::mutex> lock(client->mutex);
+			client->closing = true;
+			return true;
+		}
+	}
+	return true;
+}
+
+bool ControlServer::writeClient(const std::shared_ptr<Client> &client)
+{
+	std::lock_guard<std::mutex> lock(client->mutex);
+	while (!client->outbox.empty())
+	{
+		const auto pending = client->outbox.pending();
+		const long long sent = sendSome(client->socket, pending.data(), std::min<std::size_t>(pending.size(), 64 * 1024));
+		if (sent < 0)
+			return interrupted();
+		client->outbox.consume(static_cast<std::size_t>(sent));
+	}
+	return true;
+}
+
+void ControlServer::closeClient(const std::shared_ptr<Client> &client)
+{
+	std::lock_guard<std::mutex> lock(clientsMutex_);
+	if (clients_.erase(client->id) > 0)
+		closeSocket(client->socket);
+}
+
+void ControlServer::handleLine(const std::shared_ptr<Client> &client, std::string_view line)
+{
+	while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+		line.remove_suffix(1);
+	if (line.empty())
+		return;
+
+	json message;
+	try
+	{
+		message = json::parse(line);
+	}
+	catch (const json::parse_error &)
+	{
+		deliver(*client, errorResponse(nullptr, parseError, "Parse error"));
+		return;
+	}
+
+	if (requiresSlowLane(message))
+	{
+		{
+			std::lock_guard<std::mutex> lock(client->mutex);
+			++client->pendingSlowRequests;
+		}
+		{
+			std::lock_guard<std::mutex> lock(slowMutex_);
+			slowRequests_.push_back({client->id, std::move(message)});
+		}
+		slowCv_.notify_one();
+		return;
+	}
+	deliver(*client, dispatchMessage(*client, message));
+}
+
+void ControlServer::deliver(Client &client, const std::optional<json> &response)
+{
+	if (!response)
+		return;
+	const std::string text = serialize(*response);
+	std::lock_guard<std::mutex> lock(client.mutex);
+	if (!client.outbox.pushResponse(text))
+	{
+		client.overflowed = true;
+		Utils::Logger::warning("control", "Disconnecting a control client that stopped reading responses");
+	}
+}
+
+void ControlServer::slowWorkerLoop()
+{
+	while (true)
+	{
+		SlowRequest request;
+		{
+			std::unique_lock<std::mutex> lock(slowMutex_);
+			slowCv_.wait(lock, [this] { return stopRequested_.load() || !slowRequests_.empty(); });
+			if (stopRequested_.load())
+				return;
+			request = std::move(slowRequests_.front());
+			slowRequests_.pop_front();
+			slowBusy_ = true;
+		}
+
+		std::shared_ptr<Client> client;
+		{
+			std::lock_guard<std::mutex> lock(clientsMutex_);
+			const auto found = clients_.find(request.clientId);
+			if (found != clients_.end())
+				client = found->second;
+		}
+		if (client)
+		{
+			deliver(*client, dispatchMessage(*client, request.message));
+			std::lock_guard<std::mutex> lock(client->mutex);
+			--client->pendingSlowRequests;
+		}
+		slowBusy_ = false;
+	}
+}
+
+bool ControlServer::requiresSlowLane(const json &message)
+{
+	auto isSearch = [](const json &call)
+	{
+		return call.is_object() && call.contains("method") && call["method"].is_string()
+			&& call["method"].get<std::string>() == "search.query";
+	};
+	if (!message.is_array())
+		return isSearch(message);
+	return std::any_of(message.begin(), message.end(), isSearch);
+}
+
+const std::unordered_map<std::string, ControlServer::Method> &ControlServer::methods()
+{
+	static const std::unordered_map<std::string, Method> table = {
+		{"server.info", &ControlServer::serverInfo},
+		{"torrent.add", &ControlServer::addTorrents},
+		{"torrent.command", &ControlServer::commandTorrents},
+		{"torrent.remove", &ControlServer::removeTorrents},
+		{"torrent.move", &ControlServer::moveTorrents},
+		{"torrent.queue", &ControlServer::queueTorrents},
+		{"torrent.list", &ControlServer::listTorrents},
+		{"search.query", &ControlServer::search},
+		{"subscribe", &ControlServer::subscribe},
+		{"unsubscribe", &ControlServer::unsubscribe}};
+	return table;
+}
+
+std::optional<json> ControlServer::dispatchMessage(Client &client, const json &message)
+{
+	if (!message.is_array())
+		return dispatchCall(client, message);
+	if (message.empty())
+		return errorResponse(nullptr, invalidRequest, "Invalid Request: empty batch");
+	if (message.size() > options_.maxBatchItems)
+		return errorResponse(nullptr, invalidRequest,
+			"Invalid Request: batch exceeds " + std::to_string(options_.maxBatchItems) + " calls");
+
+	json responses = json::array();
+	for (const auto &call : message)
+	{
+		if (auto response = dispatchCall(client, call))
+			responses.push_back(std::move(*response));
+	}
+	// A batch made only of notifications produces no response at all.
+	if (responses.empty())
+		return std::nullopt;
+	return responses;
+}
+
+std::optional<json> ControlServer::dispatchCall(Client &client, const json &call)
+{
+	const bool hasId = call.is_object() && call.contains("id");
+	const bool validId = hasId && (call["id"].is_string() || call["id"].is_number() || call["id"].is_null());
+	const json id = validId ? call["id"] : json(nullptr);
+	if (!call.is_object() || (hasId && !validId) || !call.contains("jsonrpc") || call["jsonrpc"] != "2.0"
+		|| !call.contains("method") || !call["method"].is_string())
+		return errorResponse(id, invalidRequest, "Invalid Request");
+
+	const std::string method = call["method"].get<std::string>();
+	const auto found = methods().find(method);
+	if (found == methods().end())
+		return hasId ? std::optional<json>(errorResponse(id, methodNotFound, "Method not found: " + method)) : std::nullopt;
+
+	const json empty = json::object();
+	const json &params = call.contains("params") ? call["params"] : empty;
+	if (!params.is_object())
+		return hasId ? std::optional<json>(errorResponse(id, invalidParams, "params must be an object")) : std::nullopt;
+
+	json result = json::object();
+	Result outcome = Result::Success();
+	try
+	{
+		outcome = (this->*(found->second))(client, params, result);
+	}
+	catch (const json::exception &e)
+	{
+		outcome = Result::Failure("Invalid params: " + std::string(e.what()), ResultCode::InvalidInput);
+	}
+	catch (const std::exception &e)
+	{
+		outcome = Result::Failure(e.what(), ResultCode::Internal);
+	}
+	if (!hasId)
+		return std::nullopt;
+	if (!outcome)
+		return json{{"jsonrpc", "2.0"}, {"id", id}, {"error", errorObject(outcome)}};
+	return json{{"jsonrpc", "2.0"}, {"id", id}, {"result", std::move(result)}};
+}
+
+Result ControlServer::serverInfo(Client &, const json &, json &result)
+{
+	json names = json::array();
+	for (const auto &[name, method] : methods())
+		names.push_back(name);
+	std::sort(names.begin(), names.end());
+	std::size_t clientCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(clientsMutex_);
+		clientCount = clients_.size();
+	}
+	result = {
+		{"protocol", 1},
+		{"torrents", torrentManager_.getTorrentSnapshot().size()},
+		{"clients", clientCount},
+		{"methods", std::move(names)}};
+	return Result::Success();
+}
+
+Result ControlServer::addTorrents(Client &, const json &params, json &result)
+{
+	if (!params.contains("items") || !params["items"].is_array())
+		return Result::Failure("items must be an array", ResultCode::InvalidInput);
+	const auto &items = params["items"];
+	if (items.size() > options_.maxBatchItems)
+		return Result::Failure("items exceeds " + std::to_string(options_.maxBatchItems) + " entries", ResultCode::InvalidInput);
+
+	const std::string sharedSavePath = params.value("savePath", std::string());
+	std::optional<std::string> defaultSavePath;
+	json results = json::array();
+	int added = 0;
+	for (const auto &item : items)
+	{
+		Result outcome = Result::Failure("Item must be an object with a magnet or file", ResultCode::InvalidInput);
+		if (item.is_object())
+		{
+			std::string savePath = item.contains("savePath") && item["savePath"].is_string()
+				? item["savePath"].get<std::string>() : sharedSavePath;
+			if (savePath.empty())
+			{
+				if (!defaultSavePath)
+					defaultSavePath = options_.defaultSavePath ? options_.defaultSavePath() : std::string();
+				savePath = *defaultSavePath;
+			}
+			if (item.contains("magnet") && item["magnet"].is_string())
+				outcome = torrentManager_.addMagnetTorrent(item["magnet"].get<std::string>(), savePath);
+			else if (item.contains("file") && item["file"].is_string())
+				outcome = torrentManager_.addTorrent(item["file"].get<std::string>(), savePath);
+		}
+		if (outcome)
+			++added;
+		results.push_back(itemResult(outcome));
+	}
+	result = {{"added", added}, {"results", std::move(results)}};
+	return Result::Success();
+}
+
+Result ControlServer::commandTorrents(Client &, const json &params, json &result)
+{
+	if (!params.contains("command") || !params["command"].is_string())
+		return Result::Failure("command must be a string", ResultCode::InvalidInput);
+	const auto command = commandForName(params["command"].get<std::string>());
+	if (!command)
+		return Result::Failure("Unknown command: " + params["command"].get<std::string>(), ResultCode::InvalidInput);
+	std::vector<std::string> ids;
+	if (Result idsResult = readStringList(params, "ids", options_.maxBatchItems, ids); !idsResult)
+		return idsResult;
+
+	json results = json::array();
+	std::lock_guard<std::mutex> lock(presenterMutex_);
+	for (const auto &id : ids)
+		results.push_back(itemResult(presenter_.executeCommand(id, *command)));
+	result = {{"results", std::move(results)}};
+	return Result::Success();
+}
+
+Result ControlServer::removeTorrents(Client &, const json &params, json &result)
+{
+	std::vector<std::string> ids;
+	if (Result idsResult = readStringList(params, "ids", options_.maxBatchItems, ids); !idsResult)
+		return idsResult;
+	const bool deleteData = params.value("deleteData", false);
+	const bool deleteTorrentFile = params.value("deleteTorrentFile", false);
+	const TorrentRemovalMode mode = deleteData
+		? (deleteTorrentFile ? TorrentRemovalMode::DeleteDataAndSourceTorrent : TorrentRemovalMode::DeleteData)
+		: (deleteTorrentFile ? TorrentRemovalMode::DeleteSourceTorrent : TorrentRemovalMode::KeepAllFiles);
+
+	json results = json::array();
+	std::lock_guard<std::mutex> lock(presenterMutex_);
+	for (const auto &id : ids)
+		results.push_back(itemResult(presenter_.removeTorrent(id, mode)));
+	result = {{"results", std::move(results)}};
+	return Result::Success();
+}
+
+Result ControlServer::moveTorrents(Client &, const json &params, json &result)
+{
+	if (!params.contains("destination") || !params["destination"].is_string())
+		return Result::Failure("destination must be a string", ResultCode::InvalidInput);
+	StorageMovePolicy policy = StorageMovePolicy::FailIfExists;
+	const std::string policyName = params.value("policy", "fail");
+	if (policyName == "replace")
+		policy = StorageMovePolicy::ReplaceExisting;
+	else if (policyName == "keep")
+		policy = StorageMovePolicy::KeepExisting;
+	else if (policyName != "fail")
+		return Result::Failure("policy must be fail, replace, or keep", ResultCode::InvalidInput);
+	std::vector<std::string> ids;
+	if (Result idsResult = readStringList(params, "ids", options_.maxBatchItems, ids); !idsResult)
+		return idsResult;
+
+	std::vector<lt::info_hash_t> hashes;
+	json results = json::array();
+	{
+		std::lock_guard<std::mutex> lock(presenterMutex_);
+		for (const auto &id : ids)
+		{
+			const auto hash = presenter_.hashForId(id);
+			results.push_back(itemResult(hash ? Result::Success() : Result::Failure("Torrent not found", ResultCode::NotFound)));
+			if (hash)
+				hashes.push_back(*hash);
+		}
+	}
+	const Result queued = hashes.empty() ? Result::Success() : torrentManager_.moveStorage(hashes, params["destination"].get<std::string>(), policy);
+	if (!queued && queued.code != ResultCode::Partial)
+		return queued;
+
+	const StorageMoveProgress progress = torrentManager_.getStorageMoveProgress();
+	result = {
+		{"results", std::move(results)},
+		{"progress", {
+			{"total", progress.total},
+			{"queued", progress.queued},
+			{"active", progress.active},
+			{"completed", progress.completed},
+			{"failed", progress.failed},
+			{"bytesMoved", progress.bytesMoved},
+			{"bytesTotal", progress.bytesTotal},
+			{"bytesPerSecond", progress.bytesPerSecond}}}};
+	return Result::Success();
+}
+
+Result ControlServer::queueTorrents(Client &, const json &params, json &result)
+{
+	if (!params.contains("position") || !(params["position"].is_string() || params["position"].is_number_integer()))
+		return Result::Failure("position must be top, bottom, or a queue index", ResultCode::InvalidInput);
+	const json &position = params["position"];
+	std::optional<QueueMove> move;
+	if (position.is_string())
+	{
+		const std::string name = position.get<std::string>();
+		if (name != "top" && name != "bottom")
+			return Result::Failure("position must be top, bottom, or a queue index", ResultCode::InvalidInput);
+		move = name == "top" ? QueueMove::Top : QueueMove::Bottom;
+	}
+	else if (position.get<int>() < 0)
+	{
+		return Result::Failure("position cannot be negative", ResultCode::InvalidInput);
+	}
+	std::vector<std::string> ids;
+	if (Result idsResult = readStringList(params, "ids", options_.maxBatchItems, ids); !idsResult)
+		return idsResult;
+
+	// Each found torrent is moved on its own so its result lands on its id.
+	std::vector<std::pair<std::size_t, lt::info_hash_t>> targets;
+	json results = json::array();
+	{
+		std::lock_guard<std::mutex> lock(presenterMutex_);
+		std::unordered_set<lt::info_hash_t> seen;
+		for (std::size_t index = 0; index < ids.size(); ++index)
+		{
+			const auto hash = presenter_.hashForId(ids[index]);
+			results.push_back(itemResult(hash ? Result::Success() : Result::Failure("Torrent not found", ResultCode::NotFound)));
+			if (hash && seen.insert(*hash).second)
+				targets.emplace_back(index, *hash);
+		}
+	}
+
+	if (move)
+	{
+		// Moving to the top in reverse order leaves the first listed torrent
+		// first; moving to the bottom in order leaves the last one last.
+		if (*move == QueueMove::Top)
+			std::reverse(targets.begin(), targets.end());
+		for (const auto &[index, hash] : targets)
+			results[index] = itemResult(torrentManager_.moveQueue(std::span<const lt::info_hash_t>(&hash, 1), *move));
+	}
+	else
+	{
+		// Consecutive positions keep the listed order starting at the index.
+		const int first = position.get<int>();
+		for (std::size_t offset = 0; offset < targets.size(); ++offset)
+			results[targets[offset].first] = itemResult(torrentManager_.setQueuePosition(targets[offset].second, first + static_cast<int>(offset)));
+	}
+	result = {{"results", std::move(results)}};
+	return Result::Success();
+}
+
+Result ControlServer::listTorrents(Client &, const json &params, json &result)
+{
+	std::vector<std::size_t> fields;
+	if (Result fieldsResult = readFields(params, fields); !fieldsResult)
+		return fieldsResult;
+	std::unordered_set<std::string> filter;
+	if (params.contains("ids"))
+	{
+		std::vector<std::string> ids;
+		if (Result idsResult = readStringList(params, "ids", options_.maxBatchItems, ids); !idsResult)
+			return idsResult;
+		filter.insert(ids.begin(), ids.end());
+	}
+
+	// Headless instances have no UI driving status refreshes, so each listing
+	// schedules the next one without waiting for it.
+	torrentManager_.requestStatusRefresh();
+	std::vector<Presentation::TorrentRowDto> rows;
+	{
+		std::lock_guard<std::mutex> lock(presenterMutex_);
+		rows = presenter_.buildRows();
+	}
+	json torrents = json::array();
+	for (const auto &row : rows)
+	{
+		if (filter.empty() || filter.count(row.id) > 0)
+			torrents.push_back(projectRow(row, fields));
+	}
+	result = {{"revision", torrentManager_.getStatusRevision()}, {"torrents", std::move(torrents)}};
+	return Result::Success();
+}
+
+Result ControlServer::search(Client &, const json &params, json &result)
+{
+	if (!params.contains("query") || !params["query"].is_string() || params["query"].get<std::string>().empty())
+		return Result::Failure("query must be a non-empty string", ResultCode::InvalidInput);
+	const int maxResults = params.value("maxResults", 0);
+	if (maxResults < 0)
+		return Result::Failure("maxResults cannot be negative", ResultCode::InvalidInput);
+
+	SearchResponse response;
+	Result outcome = searchEngine_.searchTorrents(
+		SearchQuery(params["query"].get<std::string>(), maxResults, params.value("nextToken", std::string())), response);
+	if (!outcome)
+		return outcome;
+
+	json torrents = json::array();
+	for (const auto &torrent : response.torrents)
+	{
+		torrents.push_back({
+			{"name", torrent.name},
+			{"magnetUri", torrent.magnetUri},
+			{"infoHash", torrent.infoHash},
+			{"sizeBytes", torrent.sizeBytes},
+			{"seeders", torrent.seeders},
+			{"leechers", torrent.leechers},
+			{"dateUploaded", torrent.dateUploaded},
+			{"category", torrent.category}});
+	}
+	result = {{"torrents", std::move(torrents)}, {"nextToken", response.nextToken}, {"hasMore", response.hasMore}};
+	return Result::Success();
+}
+
+Result ControlServer::subscribe(Client &client, const json &params, json &result)
+{
+	std::vector<std::string> topics;
+	if (Result topicsResult = readStringList(params, "topics", 2, topics); !topicsResult)
+		return topicsResult;
+	std::vector<std::size_t> fields;
+	if (Result fieldsResult = readFields(params, fields); !fieldsResult)
+		return fieldsResult;
+	std::optional<Utils::LogLevel> severity = Utils::LogLevel::Info;
+	if (params.contains("minSeverity"))
+	{
+		severity = params["minSeverity"].is_string() ? severityForName(params["minSeverity"].get<std::string>()) : std::nullopt;
+		if (!severity)
+			return Result::Failure("minSeverity must be debug, info, warning, or error", ResultCode::InvalidInput);
+	}
+	for (const auto &topic : topics)
+	{
+		if (topic != "status" && topic != "events")
+			return Result::Failure("Unknown subscription topic: " + topic, ResultCode::InvalidInput);
+	}
+
+	std::lock_guard<std::mutex> lock(client.mutex);
+	for (const auto &topic : topics)
+	{
+		if (topic == "status")
+		{
+			// A fresh baseline makes the first delta a complete snapshot.
+			client.statusSubscribed = true;
+			client.statusFields = fields;
+			client.statusSent.clear();
+			client.statusRevisionSent = {std::numeric_limits<std::uint64_t>::max(), std::numeric_limits<std::uint64_t>::max()};
+		}
+		else
+		{
+			client.eventsSubscribed = true;
+			client.minimumSeverity = *severity;
+		}
+	}
+	json active = json::array();
+	if (client.statusSubscribed)
+		active.push_back("status");
+	if (client.eventsSubscribed)
+		active.push_back("events");
+	result = {{"topics", std::move(active)}};
+	return Result::Success();
+}
+
+Result ControlServer::unsubscribe(Client &client, const json &params, json &result)
+{
+	std::vector<std::string> topics;
+	if (Result topicsResult = readStringList(params, "topics", 2, topics); !topicsResult)
+		return topicsResult;
+	std::lock_guard<std::mutex> lock(client.mutex);
+	for (const auto &topic : topics)
+	{
+		if (topic == "status")
+		{
+			client.statusSubscribed = false;
+			client.statusSent.clear();
+		}
+		else if (topic == "events")
+		{
+			client.eventsSubscribed = false;
+			client.droppedEvents = 0;
+		}
+		else
+			return Result::Failure("Unknown subscription topic: " + topic, ResultCode::InvalidInput);
+	}
+	json active = json::array();
+	if (client.statusSubscribed)
+		active.push_back("status");
+	if (client.eventsSubscribed)
+		active.push_back("events");
+	result = {{"topics", std::move(active)}};
+	return Result::Success();
+}
+
+void ControlServer::publishEvents()
+{
+	std::vector<TorrentEvent> events;
+	std::uint64_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(eventMutex_);
+		events.swap(pendingEvents_);
+		dropped = std::exchange(droppedEvents_, 0);
+	}
+
+	std::vector<std::pair<Utils::LogLevel, std::string>> messages;
+	messages.reserve(events.size());
+	for (const auto &event : events)
+	{
+		json params = {
+			{"category", event.category},
+			{"severity", severityName(event.severity)},
+			{"message", event.message}};
+		if (event.hash)
+			params["id"] = Utils::TorrentIdentity::id(*event.hash);
+		messages.emplace_back(event.severity, notificationText("event", std::move(params)));
+	}
+
+	std::vector<std::shared_ptr<Client>> clients;
+	{
+		std::lock_guard<std::mutex> lock(clientsMutex_);
+		for (const auto &[id, client] : clients_)
+			clients.push_back(client);
+	}
+	for (const auto &client : clients)
+	{
+		std::lock_guard<std::mutex> lock(client->mutex);
+		if (!client->eventsSubscribed)
+			continue;
+		client->droppedEvents += dropped;
+		for (const auto &[severity, text] : messages)
+		{
+			if (severity < client->minimumSeverity)
+				continue;
+			if (client->droppedEvents > 0 && client->outbox.pushNotification(
+				notificationText("events.dropped", {{"count", client->droppedEvents}})))
+				client->droppedEvents = 0;
+			if (!client->outbox.pushNotification(text))
+				++client->droppedEvents;
+		}
+		// Report loss as soon as the reader catches up, even without new events.
+		if (client->droppedEvents > 0 && client->outbox.pushNotification(
+			notificationText("events.dropped", {{"count", client->droppedEvents}})))
+			client->droppedEvents = 0;
+	}
+}
+
+void ControlServer::publishStatus()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (now - lastStatusPublish_ < options_.statusInterval)
+		return;
+	lastStatusPublish_ = now;
+
+	const std::pair<std::uint64_t, std::uint64_t> revision{
+		torrentManager_.getStatusRevision(), torrentManager_.getTorrentCollectionRevision()};
+	std::vector<std::shared_ptr<Client>> subscribers;
+	bool anySubscribed = false;
+	{
+		std::lock_guard<std::mutex> lock(clientsMutex_);
+		for (const auto &[id, client] : clients_)
+		{
+			std::lock_guard<std::mutex> clientLock(client->mutex);
+			anySubscribed = anySubscribed || client->statusSubscribed;
+			if (client->statusSubscribed && client->statusRevisionSent != revision && client->outbox.acceptsNotifications())
+				subscribers.push_back(client);
+		}
+	}
+	// Headless instances have no UI timer refreshing the status cache.
+	if (anySubscribed)
+		torrentManager_.requestStatusRefresh();
+	if (subscribers.empty())
+		return;
+
+	std::vector<Presentation::TorrentRowDto> rows;
+	{
+		std::lock_guard<std::mutex> lock(presenterMutex_);
+		rows = presenter_.buildRows();
+	}
+
+	for (const auto &client : subscribers)
+	{
+		std::lock_guard<std::mutex> lock(client->mutex);
+		if (!client->statusSubscribed)
+			continue;
+		// Deltas are computed against what this client last accepted. When a
+		// delta is withheld for backpressure, the baseline stays put and the next
+		// publish naturally coalesces every intermediate change.
+		json changed = json::array();
+		std::vector<std::pair<std::string, json>> accepted;
+		std::unordered_set<std::string> present;
+		present.reserve(rows.size());
+		for (const auto &row : rows)
+		{
+			present.insert(row.id);
+			json projected = projectRow(row, client->statusFields);
+			const auto previous = client->statusSent.find(row.id);
+			if (previous == client->statusSent.end() || previous->second != projected)
+			{
+				changed.push_back(projected);
+				accepted.emplace_back(row.id, std::move(projected));
+			}
+		}
+		json removed = json::array();
+		for (const auto &[id, value] : client->statusSent)
+		{
+			if (present.count(id) == 0)
+				removed.push_back(id);
+		}
+		if (!changed.empty() || !removed.empty())
+		{
+			const std::string text = notificationText("status.delta",
+				{{"revision", revision.first}, {"changed", std::move(changed)}, {"removed", removed}});
+			if (!client->outbox.pushNotification(text))
+				continue;
+		}
+		for (auto &[id, value] : accepted)
+			client->statusSent[id] = std::move(value);
+		for (const auto &id : removed)
+			client->statusSent.erase(id.get<std::string>());
+		client->statusRevisionSent = revision;
+	}
+}
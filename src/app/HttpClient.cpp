@@ -0,0 +1,648 @@
+#include "HttpClient.hpp"
+#include "Logger.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+namespace
+{
+// Longest the loop sleeps when nothing is due, so a missed wakeup costs at
+// most this much latency.
+constexpr int MAX_POLL_MS = 1000;
+// Enough for a fan-out across several indexers; extra handles are freed.
+constexpr std::size_t MAX_IDLE_HANDLES = 8;
+// Transfers queued behind a half-open circuit check back this often.
+constexpr std::chrono::milliseconds PROBE_WAIT{250};
+// Longest Retry-After honoured; anything beyond it is likely a bogus date.
+constexpr std::chrono::hours MAX_RETRY_AFTER{1};
+}
+
+struct HttpClient::Transfer
+{
+	uint64_t id = 0;
+	HttpRequest request;
+	Completion completion;
+	CURL *handle = nullptr;
+	std::string body;
+	std::size_t received = 0;
+	bool rejected = false;
+	int attempt = 0;
+	bool active = false;
+	// An inactive transfer asks its host for admission at retryAt; it has
+	// been waiting since waitStarted.
+	std::chrono::steady_clock::time_point retryAt;
+	std::chrono::steady_clock::time_point waitStarted;
+	long lastResponseCode = 0;
+	std::string host;
+	HostPolicy policy;
+	bool probe = false;
+};
+
+struct HttpClient::Loop
+{
+	CURLM *multi = nullptr;
+	// Easy handles in one multi already share its connection cache and DNS
+	// cache; the share adds TLS session resumption across handles.
+	CURLSH *share = nullptr;
+	std::vector<CURL *> idle;
+	std::unordered_map<uint64_t, std::unique_ptr<Transfer>> transfers;
+
+	// State shared by every request to one host, across searches.
+	struct Host
+	{
+		// Token bucket kept as the time it would next be full (GCRA), so
+		// admission is one comparison and spacing falls out of it.
+		std::chrono::steady_clock::time_point fullAt;
+		std::chrono::steady_clock::time_point blockedUntil;
+		int failures = 0;
+		int openings = 0;
+		bool probing = false;
+	};
+	std::unordered_map<std::string, Host> hosts;
+
+	Loop()
+		: multi(curl_multi_init()),
+		  share(curl_share_init())
+	{
+		if (share)
+			curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	}
+
+	~Loop()
+	{
+		for (auto &[id, transfer] : transfers)
+			detach(*transfer);
+		// Handles must leave the share before it can be cleaned up.
+		for (CURL *handle : idle)
+			curl_easy_cleanup(handle);
+		if (share)
+			curl_share_cleanup(share);
+		if (multi)
+			curl_multi_cleanup(multi);
+	}
+
+	Loop(const Loop &) = delete;
+	Loop &operator=(const Loop &) = delete;
+
+	static size_t write(void *contents, size_t size, size_t nmemb, void *userData)
+	{
+		auto *transfer = static_cast<Transfer *>(userData);
+		const size_t length = size * nmemb;
+		if (transfer->received + length > transfer->request.maxResponseBytes)
+			return 0; // Abort download if exceeding max size
+		transfer->received += length;
+		try
+		{
+			long status = 0;
+			if (transfer->request.onBody)
+				curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &status);
+			if (status != 200)
+			{
+				transfer->body.append(static_cast<const char *>(contents), length);
+				return length;
+			}
+			if (transfer->request.onBody(std::string_view(static_cast<const char *>(contents), length)))
+				return length;
+		}
+		catch (const std::bad_alloc &)
+		{
+			return 0;
+		}
+		catch (const std::exception &e)
+		{
+			Utils::Logger::error("http", "HTTP body consumer failed: " + std::string(e.what()));
+		}
+		transfer->rejected = true;
+		return 0;
+	}
+
+	// Returns a handle with default options, attached to the share.
+	CURL *acquire()
+	{
+		CURL *handle = nullptr;
+		if (!idle.empty())
+		{
+			handle = idle.back();
+			idle.pop_back();
+			curl_easy_reset(handle);
+		}
+		else
+		{
+			handle = curl_easy_init();
+		}
+		if (handle && share)
+			curl_easy_setopt(handle, CURLOPT_SHARE, share);
+		return handle;
+	}
+
+	void release(CURL *handle)
+	{
+		if (idle.size() < MAX_IDLE_HANDLES)
+			idle.push_back(handle);
+		else
+			curl_easy_cleanup(handle);
+	}
+
+	bool prepare(Transfer &transfer)
+	{
+		CURL *curl = acquire();
+		if (!curl)
+			return false;
+		transfer.handle = curl;
+		const HttpRequest &request = transfer.request;
+		const long timeout = static_cast<long>(request.timeoutSeconds);
+		curl_easy_setopt(curl, CURLOPT_PRIVATE, &transfer);
+		curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &Loop::write);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+		curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, std::min(timeout, 10L));
+		curl_easy_setopt(curl, CURLOPT_MAXFILESIZE_LARGE, static_cast<curl_off_t>(request.maxResponseBytes));
+		curl_easy_setopt(curl, CURLOPT_USERAGENT, "Hypertube/1.0");
+		// Every encoding this libcurl build can decode.
+		curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+		curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+		// Lets concurrent requests to one host multiplex over a single
+		// HTTP/2 connection instead of opening another.
+		curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+		curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+		curl_easy_setopt(curl, CURLOPT_PROTOCOLS_STR, "http,https");
+		curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+		if (request.useProxy)
+		{
+			curl_easy_setopt(curl, CURLOPT_PROXY, request.proxyHost.c_str());
+			curl_easy_setopt(curl, CURLOPT_PROXYPORT, static_cast<long>(request.proxyPort));
+			curl_easy_setopt(curl, CURLOPT_PROXYTYPE,
+				request.proxyType == "http" ? CURLPROXY_HTTP : CURLPROXY_SOCKS5_HOSTNAME);
+			if (!request.proxyUsername.empty())
+			{
+				curl_easy_setopt(curl, CURLOPT_PROXYUSERNAME, request.proxyUsername.c_str());
+				curl_easy_setopt(curl, CURLOPT_PROXYPASSWORD, request.proxyPassword.c_str());
+			}
+		}
+		transfer.retryAt = std::chrono::steady_clock::now();
+		transfer.waitStarted = transfer.retryAt;
+		return true;
+	}
+
+	// Starts a waiting transfer if its host takes it now, or moves retryAt to
+	// when it might. Fails the transfer while the host's circuit is open or if
+	// the wait would outlast its timeout.
+	void admit(Transfer &transfer, std::chrono::steady_clock::time_point now)
+	{
+		Host &host = hosts[transfer.host];
+		const HostPolicy &policy = transfer.policy;
+		const bool open = policy.failureThreshold > 0 && host.failures >= policy.failureThreshold;
+		auto notBefore = host.blockedUntil;
+		if (open && notBefore > now)
+		{
+			const auto seconds = std::chrono::ceil<std::chrono::seconds>(notBefore - now).count();
+			return finish(transfer.id, Result::Failure(transfer.host + " is failing; not retrying for "
+				+ std::to_string(seconds) + " s", ResultCode::Unavailable, true));
+		}
+		if (open && host.probing)
+			notBefore = now + PROBE_WAIT;
+
+		if (notBefore <= now)
+		{
+			if (policy.requestsPerSecond <= 0)
+				return launch(transfer, host, open);
+			const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(1.0 / policy.requestsPerSecond));
+			const auto fullAt = std::max(host.fullAt, now);
+			const auto allowedAt = fullAt - interval * (std::max(policy.burst, 1) - 1);
+			if (allowedAt <= now)
+			{
+				host.fullAt = fullAt + interval;
+				return launch(transfer, host, open);
+			}
+			notBefore = allowedAt;
+		}
+
+		if (notBefore - transfer.waitStarted > std::chrono::seconds(std::max(transfer.request.timeoutSeconds, 1)))
+		{
+			const auto seconds = std::chrono::ceil<std::chrono::seconds>(notBefore - now).count();
+			if (open)
+				return finish(transfer.id, Result::Failure(transfer.host + " is failing; another request is checking it",
+					ResultCode::Unavailable, true));
+			return finish(transfer.id, Result::Failure("Rate limited by " + transfer.host + " for "
+				+ std::to_string(seconds) + " s", ResultCode::RateLimited, true));
+		}
+		transfer.retryAt = notBefore;
+	}
+
+	void launch(Transfer &transfer, Host &host, bool probe)
+	{
+		if (probe)
+		{
+			host.probing = true;
+			transfer.probe = true;
+		}
+		if (!resume(transfer))
+		{
+			releaseProbe(transfer);
+			finish(transfer.id, Result::Failure("Failed to start HTTP request", ResultCode::Network, true));
+		}
+	}
+
+	void releaseProbe(Transfer &transfer)
+	{
+		if (!transfer.probe)
+			return;
+		transfer.probe = false;
+		hosts[transfer.host].probing = false;
+	}
+
+	void recordSuccess(Transfer &transfer)
+	{
+		releaseProbe(transfer);
+		Host &host = hosts[transfer.host];
+		if (host.failures >= transfer.policy.failureThreshold && transfer.policy.failureThreshold > 0)
+			Utils::Logger::info("http", transfer.host + " is answering again");
+		host.failures = 0;
+		host.openings = 0;
+	}
+
+	// Pushes back every request to the host, not just this one.
+	void recordFailure(Transfer &transfer, std::chrono::steady_clock::duration retryAfter)
+	{
+		const bool probe = transfer.probe;
+		releaseProbe(transfer);
+		Host &host = hosts[transfer.host];
+		const HostPolicy &policy = transfer.policy;
+		++host.failures;
+		auto delay = retryAfter;
+		if (delay <= std::chrono::steady_clock::duration::zero())
+			delay = policy.backoffBase * (1 << std::min(host.failures - 1, 6));
+		if (policy.failureThreshold > 0 && (host.failures == policy.failureThreshold || (probe && host.failures > policy.failureThreshold)))
+		{
+			const auto cooldown = policy.cooldown * (1 << std::min(host.openings, 8));
+			++host.openings;
+			delay = std::max<std::chrono::steady_clock::duration>(delay, cooldown);
+			Utils::Logger::warning("http", transfer.host + " failed " + std::to_string(host.failures)
+				+ " times in a row; pausing requests for "
+				+ std::to_string(std::chrono::ceil<std::chrono::seconds>(delay).count()) + " s");
+		}
+		host.blockedUntil = std::max(host.blockedUntil, std::chrono::steady_clock::now() + delay);
+	}
+
+	static std::chrono::steady_clock::duration retryAfter(CURL *handle)
+	{
+		// Covers both delta-seconds and HTTP-date forms.
+		curl_off_t seconds = -1;
+		if (curl_easy_getinfo(handle, CURLINFO_RETRY_AFTER, &seconds) != CURLE_OK || seconds <= 0)
+			return {};
+		return std::min<std::chrono::steady_clock::duration>(std::chrono::seconds(seconds), MAX_RETRY_AFTER);
+	}
+
+	bool resume(Transfer &transfer)
+	{
+		transfer.body.clear();
+		transfer.received = 0;
+		if (curl_multi_add_handle(multi, transfer.handle) != CURLM_OK)
+			return false;
+		transfer.active = true;
+		return true;
+	}
+
+	void detach(Transfer &transfer)
+	{
+		if (!transfer.handle)
+			return;
+		if (transfer.active)
+			curl_multi_remove_handle(multi, transfer.handle);
+		transfer.active = false;
+		release(transfer.handle);
+		transfer.handle = nullptr;
+	}
+
+	void finish(uint64_t id, Result result)
+	{
+		auto found = transfers.find(id);
+		if (found == transfers.end())
+			return;
+		std::unique_ptr<Transfer> transfer = std::move(found->second);
+		transfers.erase(found);
+		// A cancelled probe lets the next waiting transfer probe instead.
+		releaseProbe(*transfer);
+		detach(*transfer);
+		try
+		{
+			transfer->completion(std::move(result), std::move(transfer->body));
+		}
+		catch (const std::exception &e)
+		{
+			Utils::Logger::error("http", "HTTP completion failed: " + std::string(e.what()));
+		}
+	}
+
+	// Decides between success, failure and a timed retry once curl is done
+	// with one attempt.
+	void completeAttempt(Transfer &transfer, CURLcode code)
+	{
+		const bool lastAttempt = transfer.attempt + 1 >= std::max(transfer.request.maxAttempts, 1);
+		if (transfer.rejected)
+		{
+			recordSuccess(transfer);
+			return finish(transfer.id, Result::Failure("Response body rejected", ResultCode::Parse));
+		}
+		if (code == CURLE_OK)
+		{
+			curl_easy_getinfo(transfer.handle, CURLINFO_RESPONSE_CODE, &transfer.lastResponseCode);
+			const long status = transfer.lastResponseCode;
+			const bool transientHttpError = status == 429 || status >= 500;
+			if (!transientHttpError)
+				recordSuccess(transfer);
+			else
+				recordFailure(transfer, retryAfter(transfer.handle));
+			if (status == 200)
+				return finish(transfer.id, Result::Success());
+			if (status == 401 || status == 403)
+				return finish(transfer.id, Result::Failure("HTTP Error: " + std::to_string(status), ResultCode::Unauthorized));
+			if (!transientHttpError || lastAttempt)
+			{
+				if (status == 429)
+					return finish(transfer.id, Result::Failure("HTTP Error: 429", ResultCode::RateLimited, true));
+				return finish(transfer.id, Result::Failure("HTTP Error: " + std::to_string(status), ResultCode::Network, transientHttpError));
+			}
+		}
+		else
+		{
+			recordFailure(transfer, {});
+			if (lastAttempt)
+			{
+				std::string message = transfer.lastResponseCode != 0
+					? "HTTP Error: " + std::to_string(transfer.lastResponseCode)
+					: "cURL Error: " + std::string(curl_easy_strerror(code));
+				return finish(transfer.id, Result::Failure(message, ResultCode::Network, true));
+			}
+		}
+
+		// The handle keeps its options while the host backs off; admit()
+		// decides when the retry goes out.
+		curl_multi_remove_handle(multi, transfer.handle);
+		transfer.active = false;
+		if (transfer.request.onRestart)
+			transfer.request.onRestart();
+		transfer.retryAt = std::chrono::steady_clock::now();
+		transfer.waitStarted = transfer.retryAt;
+		++transfer.attempt;
+	}
+};
+
+HttpClient::HttpClient() = default;
+
+HttpClient::~HttpClient()
+{
+	shutdown();
+}
+
+void HttpClient::ensureStarted()
+{
+	if (thread_.joinable())
+		return;
+	loop_ = std::make_unique<Loop>();
+	thread_ = std::thread([this, loop = loop_.get()]()
+	{
+		for (;;)
+		{
+			std::vector<std::unique_ptr<Transfer>> added;
+			std::vector<uint64_t> cancels;
+			bool stopping = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				added.swap(submitted_);
+				cancels.swap(cancelled_);
+				stopping = stopping_;
+			}
+			for (auto &transfer : added)
+			{
+				const uint64_t id = transfer->id;
+				Transfer &started = *transfer;
+				loop->transfers.emplace(id, std::move(transfer));
+				if (!loop->prepare(started))
+					loop->finish(id, Result::Failure("Failed to initialize cURL"));
+			}
+			for (uint64_t id : cancels)
+				loop->finish(id, Result::Failure("HTTP request cancelled", ResultCode::Cancelled));
+			if (stopping)
+			{
+				while (!loop->transfers.empty())
+					loop->finish(loop->transfers.begin()->first, Result::Failure("HTTP request cancelled", ResultCode::Cancelled));
+				break;
+			}
+
+			// Offers waiting transfers to their hosts; admit() may finish
+			// one, so the due ids are collected first.
+			const auto now = std::chrono::steady_clock::now();
+			std::vector<uint64_t> due;
+			for (auto &[id, transfer] : loop->transfers)
+			{
+				if (!transfer->active && transfer->retryAt <= now)
+					due.push_back(id);
+			}
+			std::sort(due.begin(), due.end());
+			for (uint64_t id : due)
+			{
+				auto found = loop->transfers.find(id);
+				if (found != loop->transfers.end())
+					loop->admit(*found->second, now);
+			}
+
+			int running = 0;
+			curl_multi_perform(loop->multi, &running);
+			int queued = 0;
+			while (CURLMsg *message = curl_multi_info_read(loop->multi, &queued))
+			{
+				if (message->msg != CURLMSG_DONE)
+					continue;
+				Transfer *transfer = nullptr;
+				curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+				// Removing the handle invalidates the message, so the result
+				// is read first.
+				const CURLcode code = message->data.result;
+				if (transfer)
+					loop->completeAttempt(*transfer, code);
+			}
+
+			// Sleeps until the next waiting transfer is due at the latest.
+			int pollMs = MAX_POLL_MS;
+			const auto pollStart = std::chrono::steady_clock::now();
+			for (const auto &[id, transfer] : loop->transfers)
+			{
+				if (transfer->active)
+					continue;
+				const auto wait = std::chrono::ceil<std::chrono::milliseconds>(transfer->retryAt - pollStart).count();
+				pollMs = static_cast<int>(std::clamp<long long>(wait, 0, pollMs));
+			}
+			// curl lowers the timeout further when one of its own timers is due.
+			curl_multi_poll(loop->multi, nullptr, 0, pollMs, nullptr);
+		}
+	});
+}
+
+void HttpClient::wake()
+{
+	if (loop_ && loop_->multi)
+		curl_multi_wakeup(loop_->multi);
+}
+
+std::string HttpClient::hostKey(const std::string &url)
+{
+	CURLU *parsed = curl_url();
+	if (!parsed)
+		return {};
+	std::string key;
+	char *host = nullptr;
+	if (curl_url_set(parsed, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK
+		&& curl_url_get(parsed, CURLUPART_HOST, &host, 0) == CURLUE_OK)
+	{
+		key = host;
+		std::transform(key.begin(), key.end(), key.begin(), [](unsigned char character)
+		{
+			return static_cast<char>(std::tolower(character));
+		});
+		char *port = nullptr;
+		if (curl_url_get(parsed, CURLUPART_PORT, &port, CURLU_NO_DEFAULT_PORT) == CURLUE_OK)
+		{
+			key += ":" + std::string(port);
+			curl_free(port);
+		}
+		curl_free(host);
+	}
+	curl_url_cleanup(parsed);
+	return key;
+}
+
+void HttpClient::setHostPolicy(const std::string &host, HostPolicy policy)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	hostPolicies_[host] = policy;
+}
+
+void HttpClient::setDefaultHostPolicy(HostPolicy policy)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	defaultPolicy_ = policy;
+}
+
+uint64_t HttpClient::submit(HttpRequest request, Completion completion)
+{
+	auto transfer = std::make_unique<Transfer>();
+	transfer->id = nextId_.fetch_add(1);
+	transfer->host = hostKey(request.url);
+	if (transfer->host.empty())
+		transfer->host = request.url;
+	transfer->request = std::move(request);
+	transfer->completion = std::move(completion);
+	const uint64_t id = transfer->id;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto policy = hostPolicies_.find(transfer->host);
+		transfer->policy = policy == hostPolicies_.end() ? defaultPolicy_ : policy->second;
+		if (!stopping_)
+		{
+			try
+			{
+				ensureStarted();
+			}
+			catch (const std::exception &e)
+			{
+				Utils::Logger::error("http", "Failed to start the HTTP thread: " + std::string(e.what()));
+				loop_.reset();
+			}
+		}
+		if (!stopping_ && thread_.joinable())
+		{
+			submitted_.push_back(std::move(transfer));
+			wake();
+			return id;
+		}
+	}
+	transfer->completion(Result::Failure("HTTP client is shutting down", ResultCode::Unavailable), std::string());
+	return id;
+}
+
+void HttpClient::cancel(uint64_t id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!thread_.joinable())
+		return;
+	cancelled_.push_back(id);
+	wake();
+}
+
+Result HttpClient::perform(HttpRequest request, std::string &body, const std::function<bool()> &cancelled)
+{
+	struct Outcome
+	{
+		bool done = false;
+		Result result = Result::Failure("HTTP request did not complete", ResultCode::Internal);
+		std::string body;
+	};
+	auto outcome = std::make_shared<Outcome>();
+	const uint64_t id = submit(std::move(request), [this, outcome](Result result, std::string responseBody)
+	{
+		{
+			std::lock_guard<std::mutex> lock(waitMutex_);
+			outcome->done = true;
+			outcome->result = std::move(result);
+			outcome->body = std::move(responseBody);
+		}
+		waitChanged_.notify_all();
+	});
+
+	bool cancelSent = false;
+	for (;;)
+	{
+		uint64_t generation = 0;
+		{
+			std::lock_guard<std::mutex> lock(waitMutex_);
+			if (outcome->done)
+				break;
+			generation = wakeGeneration_;
+		}
+		// Checked without the wait lock; a wakeup that lands in between
+		// changes the generation, so the wait below returns at once.
+		if (!cancelSent && cancelled && cancelled())
+		{
+			cancel(id);
+			cancelSent = true;
+		}
+		std::unique_lock<std::mutex> lock(waitMutex_);
+		waitChanged_.wait_for(lock, std::chrono::milliseconds(250), [&]()
+		{
+			return outcome->done || wakeGeneration_ != generation;
+		});
+	}
+	body = std::move(outcome->body);
+	return outcome->result;
+}
+
+void HttpClient::wakeWaiters()
+{
+	{
+		std::lock_guard<std::mutex> lock(waitMutex_);
+		++wakeGeneration_;
+	}
+	waitChanged_.notify_all();
+}
+
+void HttpClient::shutdown()
+{
+	std::thread threadToJoin;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+		wake();
+		threadToJoin = std::move(thread_);
+	}
+	if (threadToJoin.joinable())
+		threadToJoin.join();
+	std::lock_guard<std::mutex> lock(mutex_);
+	loop_.reset();
+}
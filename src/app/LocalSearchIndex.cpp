@@ -0,0 +1,372 @@
+#include "LocalSearchIndex.hpp"
+#include "DurableFile.hpp"
+#include "SearchResponseParser.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <unordered_set>
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr int indexFileVersion = 1;
+// Share of the query's trigrams a document must contain to match.
+constexpr double minimumScore = 0.6;
+
+const char *const indexColumns[] = {"name", "magnet", "hash", "size", "seeders", "leechers", "date", "category", "created", "seen", "favorite"};
+
+int64_t toSeconds(LocalSearchIndex::Clock::time_point point)
+{
+	return std::chrono::duration_cast<std::chrono::seconds>(point.time_since_epoch()).count();
+}
+
+// Lowercase ASCII letters and digits separated by single spaces. Bytes of
+// multi-byte UTF-8 sequences are kept as they are, so non-Latin names still
+// index, case-sensitively.
+std::string foldText(std::string_view text)
+{
+	std::string folded;
+	folded.reserve(text.size());
+	for (const unsigned char character : text)
+	{
+		if (std::isalnum(character) || character >= 0x80)
+			folded.push_back(static_cast<char>(std::tolower(character)));
+		else if (!folded.empty() && folded.back() != ' ')
+			folded.push_back(' ');
+	}
+	if (!folded.empty() && folded.back() == ' ')
+		folded.pop_back();
+	return folded;
+}
+
+std::string documentText(const TorrentSearchResult &result)
+{
+	return foldText(result.name + " " + result.category);
+}
+}
+
+LocalSearchIndex::LocalSearchIndex()
+	: LocalSearchIndex(std::chrono::hours(24 * 30))
+{
+}
+
+LocalSearchIndex::LocalSearchIndex(Clock::duration maxAge)
+	: maxAge_(maxAge)
+{
+}
+
+std::string LocalSearchIndex::documentKey(const TorrentSearchResult &result)
+{
+	std::string key = result.infoHash;
+	if (normalizeInfoHash(key))
+		return key;
+	return result.magnetUri.empty() ? std::string() : "magnet:" + result.magnetUri;
+}
+
+std::vector<uint32_t> LocalSearchIndex::trigrams(std::string_view text)
+{
+	// Each word is padded like "  word " so short words and word starts
+	// carry weight of their own.
+	std::vector<uint32_t> result;
+	std::size_t start = 0;
+	while (start < text.size())
+	{
+		std::size_t end = text.find(' ', start);
+		if (end == std::string_view::npos)
+			end = text.size();
+		std::string padded = "  ";
+		padded.append(text.substr(start, end - start));
+		padded.push_back(' ');
+		for (std::size_t index = 0; index + 3 <= padded.size(); ++index)
+		{
+			result.push_back(static_cast<uint32_t>(static_cast<unsigned char>(padded[index])) << 16
+				| static_cast<uint32_t>(static_cast<unsigned char>(padded[index + 1])) << 8
+				| static_cast<uint32_t>(static_cast<unsigned char>(padded[index + 2])));
+		}
+		start = end + 1;
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+void LocalSearchIndex::record(const std::vector<TorrentSearchResult> &results, Clock::time_point now)
+{
+	const int64_t seen = toSeconds(now);
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto &result : results)
+		upsertUnlocked(result, seen, false, true);
+	if (liveCount_ > MAX_DOCUMENTS)
+		pruneUnlocked(seen);
+}
+
+void LocalSearchIndex::setFavorite(const TorrentSearchResult &result, bool favorite, Clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	const std::string key = documentKey(result);
+	auto found = idByKey_.find(key);
+	if (found == idByKey_.end())
+	{
+		if (favorite)
+			upsertUnlocked(result, toSeconds(now), true, false);
+		return;
+	}
+	Document &document = documents_[found->second];
+	if (document.favorite == favorite)
+		return;
+	document.favorite = favorite;
+	// A removed favorite ages out like any other result from now on.
+	if (!favorite)
+		document.lastSeen = std::max(document.lastSeen, toSeconds(now));
+	dirty_ = true;
+}
+
+void LocalSearchIndex::syncFavorites(const std::vector<TorrentSearchResult> &favorites, Clock::time_point now)
+{
+	std::unordered_set<std::string> keys;
+	for (const auto &favorite : favorites)
+		keys.insert(documentKey(favorite));
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto &[key, id] : idByKey_)
+		{
+			Document &document = documents_[id];
+			if (document.favorite && keys.find(key) == keys.end())
+			{
+				document.favorite = false;
+				document.lastSeen = std::max(document.lastSeen, toSeconds(now));
+				dirty_ = true;
+			}
+		}
+	}
+	for (const auto &favorite : favorites)
+		setFavorite(favorite, true, now);
+}
+
+std::vector<TorrentSearchResult> LocalSearchIndex::search(std::string_view query, std::size_t limit) const
+{
+	const std::vector<uint32_t> wanted = trigrams(foldText(query));
+	if (wanted.empty() || limit == 0)
+		return {};
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<uint16_t> hits(documents_.size(), 0);
+	std::vector<uint32_t> touched;
+	for (const uint32_t trigram : wanted)
+	{
+		auto postings = postings_.find(trigram);
+		if (postings == postings_.end())
+			continue;
+		for (const uint32_t id : postings->second)
+		{
+			if (hits[id]++ == 0)
+				touched.push_back(id);
+		}
+	}
+
+	const std::size_t required = static_cast<std::size_t>(std::ceil(static_cast<double>(wanted.size()) * minimumScore));
+	std::vector<uint32_t> matches;
+	for (const uint32_t id : touched)
+	{
+		if (documents_[id].live && hits[id] >= required)
+			matches.push_back(id);
+	}
+	auto better = [&](uint32_t left, uint32_t right)
+	{
+		const Document &a = documents_[left];
+		const Document &b = documents_[right];
+		if (hits[left] != hits[right])
+			return hits[left] > hits[right];
+		if (a.favorite != b.favorite)
+			return a.favorite;
+		if (a.result.seeders != b.result.seeders)
+			return a.result.seeders > b.result.seeders;
+		return a.lastSeen > b.lastSeen;
+	};
+	const std::size_t count = std::min(limit, matches.size());
+	std::partial_sort(matches.begin(), matches.begin() + static_cast<std::ptrdiff_t>(count), matches.end(), better);
+
+	std::vector<TorrentSearchResult> results;
+	results.reserve(count);
+	for (std::size_t index = 0; index < count; ++index)
+		results.push_back(documents_[matches[index]].result);
+	return results;
+}
+
+std::size_t LocalSearchIndex::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return liveCount_;
+}
+
+bool LocalSearchIndex::dirty() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return dirty_;
+}
+
+void LocalSearchIndex::upsertUnlocked(const TorrentSearchResult &result, int64_t seen, bool favorite, bool keepFavorite)
+{
+	const std::string key = documentKey(result);
+	if (key.empty())
+		return;
+	dirty_ = true;
+	auto found = idByKey_.find(key);
+	if (found != idByKey_.end())
+	{
+		Document &document = documents_[found->second];
+		if (keepFavorite)
+			favorite = document.favorite;
+		seen = std::max(seen, document.lastSeen);
+		std::string text = documentText(result);
+		if (text == document.text)
+		{
+			document.result = result;
+			document.lastSeen = seen;
+			document.favorite = favorite;
+			return;
+		}
+		// Postings cannot be edited in place; the old entry is left for
+		// the next rebuild.
+		dropUnlocked(found->second);
+	}
+	Document document;
+	document.result = result;
+	document.lastSeen = seen;
+	document.favorite = favorite;
+	document.text = documentText(result);
+	addUnlocked(std::move(document), key);
+}
+
+void LocalSearchIndex::addUnlocked(Document document, const std::string &key)
+{
+	const uint32_t id = static_cast<uint32_t>(documents_.size());
+	for (const uint32_t trigram : trigrams(document.text))
+		postings_[trigram].push_back(id);
+	documents_.push_back(std::move(document));
+	idByKey_[key] = id;
+	++liveCount_;
+}
+
+void LocalSearchIndex::dropUnlocked(uint32_t id)
+{
+	Document &document = documents_[id];
+	if (!document.live)
+		return;
+	document.live = false;
+	idByKey_.erase(documentKey(document.result));
+	--liveCount_;
+	dirty_ = true;
+}
+
+void LocalSearchIndex::pruneUnlocked(int64_t now)
+{
+	const int64_t oldest = now - std::chrono::duration_cast<std::chrono::seconds>(maxAge_).count();
+	std::vector<uint32_t> candidates;
+	for (uint32_t id = 0; id < documents_.size(); ++id)
+	{
+		const Document &document = documents_[id];
+		if (!document.live || document.favorite)
+			continue;
+		if (document.lastSeen < oldest)
+			dropUnlocked(id);
+		else
+			candidates.push_back(id);
+	}
+	// Over the cap, the least recently seen results go first, down to 90%
+	// so that the next few searches do not prune again.
+	if (liveCount_ > MAX_DOCUMENTS)
+	{
+		const std::size_t excess = std::min(candidates.size(), liveCount_ - MAX_DOCUMENTS * 9 / 10);
+		std::nth_element(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(excess), candidates.end(),
+			[this](uint32_t left, uint32_t right) { return documents_[left].lastSeen < documents_[right].lastSeen; });
+		for (std::size_t index = 0; index < excess; ++index)
+			dropUnlocked(candidates[index]);
+	}
+	if (documents_.size() > liveCount_ * 2)
+		rebuildUnlocked();
+}
+
+void LocalSearchIndex::rebuildUnlocked()
+{
+	std::vector<Document> documents = std::move(documents_);
+	documents_.clear();
+	idByKey_.clear();
+	postings_.clear();
+	liveCount_ = 0;
+	for (auto &document : documents)
+	{
+		if (!document.live)
+			continue;
+		const std::string key = documentKey(document.result);
+		addUnlocked(std::move(document), key);
+	}
+}
+
+Result LocalSearchIndex::load(const std::filesystem::path &path, Clock::time_point now)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return Result::Success();
+	json document = json::parse(file, nullptr, false);
+	if (!document.is_object() || document.value("version", 0) != indexFileVersion
+		|| !document.contains("rows") || !document["rows"].is_array())
+		return Result::Failure("Invalid local search index: " + path.string(), ResultCode::Parse);
+
+	const int64_t oldest = toSeconds(now) - std::chrono::duration_cast<std::chrono::seconds>(maxAge_).count();
+	std::lock_guard<std::mutex> lock(mutex_);
+	const bool wasDirty = dirty_;
+	for (const auto &row : document["rows"])
+	{
+		if (!row.is_array() || row.size() != std::size(indexColumns))
+			continue;
+		try
+		{
+			TorrentSearchResult result(row[0].get<std::string>(), row[1].get<std::string>(), row[2].get<std::string>(),
+				row[3].get<size_t>(), row[4].get<int>(), row[5].get<int>(), row[6].get<std::string>(),
+				row[7].get<std::string>(), row[8].get<int64_t>());
+			const int64_t seen = row[9].get<int64_t>();
+			const bool favorite = row[10].get<int>() != 0;
+			const std::string key = documentKey(result);
+			if (key.empty() || idByKey_.count(key) || (!favorite && seen < oldest))
+				continue;
+			upsertUnlocked(result, seen, favorite, false);
+		}
+		catch (const json::exception &)
+		{
+		}
+	}
+	dirty_ = wasDirty;
+	return Result::Success();
+}
+
+Result LocalSearchIndex::save(const std::filesystem::path &path, Clock::time_point now)
+{
+	json document = {{"version", indexFileVersion}, {"columns", indexColumns}, {"rows", json::array()}};
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pruneUnlocked(toSeconds(now));
+		json &rows = document["rows"];
+		for (const auto &entry : documents_)
+		{
+			if (!entry.live)
+				continue;
+			const TorrentSearchResult &result = entry.result;
+			rows.push_back({result.name, result.magnetUri, result.infoHash, result.sizeBytes, result.seeders, result.leechers,
+				result.dateUploaded, result.category, result.createdUnix, entry.lastSeen, entry.favorite ? 1 : 0});
+		}
+	}
+
+	Result result = Utils::writeFileAtomically(path, [&document](std::ostream &stream)
+	{
+		stream << document.dump(-1, ' ', false, json::error_handler_t::replace);
+	});
+	if (!result)
+		return Result::Failure("Unable to save local search index: " + result.message, ResultCode::Storage);
+	std::lock_guard<std::mutex> lock(mutex_);
+	dirty_ = false;
+	return Result::Success();
+}
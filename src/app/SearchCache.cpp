@@ -0,0 +1,237 @@
+#include "SearchCache.hpp"
+#include "DurableFile.hpp"
+#include <nlohmann/json.hpp>
+#include <fstream>
+
+using json = nlohmann::json;
+
+namespace
+{
+constexpr int cacheFileVersion = 1;
+
+// FNV-1a: unlike std::hash it is the same on every run and platform, so keys
+// written to disk still match after a restart.
+void hashBytes(uint64_t &hash, std::string_view bytes)
+{
+	for (const unsigned char byte : bytes)
+	{
+		hash ^= byte;
+		hash *= 0x100000001b3ULL;
+	}
+}
+
+void hashField(uint64_t &hash, std::string_view field)
+{
+	// Length-prefixed so that ("ab", "c") and ("a", "bc") differ.
+	hashBytes(hash, std::to_string(field.size()));
+	hashBytes(hash, ":");
+	hashBytes(hash, field);
+}
+
+int64_t toSeconds(SearchCache::Clock::time_point point)
+{
+	return std::chrono::duration_cast<std::chrono::seconds>(point.time_since_epoch()).count();
+}
+}
+
+SearchCache::SearchCache()
+	: SearchCache(Limits{})
+{
+}
+
+SearchCache::SearchCache(Limits limits)
+	: limits_(limits)
+{
+}
+
+uint64_t SearchCache::makeKey(std::string_view provider, std::string_view query, int maxResults, std::string_view pageToken)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hashField(hash, provider);
+	hashField(hash, query);
+	hashField(hash, std::to_string(maxResults));
+	hashField(hash, pageToken);
+	return hash;
+}
+
+std::size_t SearchCache::estimateBytes(const SearchResponse &response)
+{
+	std::size_t total = sizeof(Entry) + response.nextToken.size();
+	for (const auto &torrent : response.torrents)
+	{
+		total += sizeof(TorrentSearchResult) + torrent.name.size() + torrent.magnetUri.size()
+			+ torrent.infoHash.size() + torrent.dateUploaded.size() + torrent.category.size();
+	}
+	return total;
+}
+
+SearchCache::Hit SearchCache::lookup(uint64_t key, SearchResponse &response, bool &refresh, Clock::time_point now)
+{
+	refresh = false;
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = index_.find(key);
+	if (found == index_.end())
+		return Hit::Miss;
+	auto entry = found->second;
+	const Clock::duration age = now - entry->storedAt;
+	if (age >= limits_.freshFor + limits_.staleFor)
+	{
+		eraseUnlocked(entry);
+		return Hit::Miss;
+	}
+	entries_.splice(entries_.begin(), entries_, entry);
+	response = entry->response;
+	if (age < limits_.freshFor)
+		return Hit::Fresh;
+	if (!entry->refreshing)
+	{
+		entry->refreshing = true;
+		refresh = true;
+	}
+	return Hit::Stale;
+}
+
+void SearchCache::store(uint64_t key, SearchResponse response, Clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	insertUnlocked(key, std::move(response), now, true);
+}
+
+void SearchCache::releaseRefresh(uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = index_.find(key);
+	if (found != index_.end())
+		found->second->refreshing = false;
+}
+
+bool SearchCache::isFresh(uint64_t key, Clock::time_point now) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = index_.find(key);
+	return found != index_.end() && now - found->second->storedAt < limits_.freshFor;
+}
+
+void SearchCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_.clear();
+	index_.clear();
+	bytes_ = 0;
+}
+
+std::size_t SearchCache::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.size();
+}
+
+std::size_t SearchCache::bytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return bytes_;
+}
+
+void SearchCache::insertUnlocked(uint64_t key, SearchResponse &&response, Clock::time_point storedAt, bool mostRecent)
+{
+	if (auto found = index_.find(key); found != index_.end())
+		eraseUnlocked(found->second);
+	const std::size_t size = estimateBytes(response);
+	if (size > limits_.maxBytes)
+		return;
+	// Loading appends in recency order, so a full cache drops the newcomer.
+	while (bytes_ + size > limits_.maxBytes)
+	{
+		if (!mostRecent)
+			return;
+		eraseUnlocked(std::prev(entries_.end()));
+	}
+	auto position = mostRecent ? entries_.begin() : entries_.end();
+	auto entry = entries_.insert(position, Entry{key, std::move(response), size, storedAt, false});
+	index_.emplace(key, entry);
+	bytes_ += size;
+}
+
+void SearchCache::eraseUnlocked(std::list<Entry>::iterator entry)
+{
+	bytes_ -= entry->bytes;
+	index_.erase(entry->key);
+	entries_.erase(entry);
+}
+
+Result SearchCache::load(const std::filesystem::path &path, std::string_view scope, Clock::time_point now)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return Result::Success();
+	json document = json::parse(file, nullptr, false);
+	if (!document.is_object() || !document.contains("entries") || !document["entries"].is_array())
+		return Result::Failure("Invalid search cache file: " + path.string(), ResultCode::Parse);
+	if (document.value("version", 0) != cacheFileVersion || document.value("scope", std::string()) != scope)
+		return Result::Success();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto &saved : document["entries"])
+	{
+		if (!saved.is_object() || !saved.contains("key") || !saved["key"].is_number_unsigned()
+			|| !saved.contains("stored") || !saved["stored"].is_number_integer()
+			|| !saved.contains("torrents") || !saved["torrents"].is_array())
+			continue;
+		const uint64_t key = saved["key"].get<uint64_t>();
+		const Clock::time_point storedAt{std::chrono::seconds(saved["stored"].get<int64_t>())};
+		if (index_.count(key) || storedAt > now || now - storedAt >= limits_.freshFor + limits_.staleFor)
+			continue;
+		SearchResponse response;
+		response.nextToken = saved.value("next", std::string());
+		response.hasMore = saved.value("more", false);
+		for (const auto &row : saved["torrents"])
+		{
+			if (!row.is_array() || row.size() != 11)
+				continue;
+			try
+			{
+				response.torrents.emplace_back(row[0].get<std::string>(), row[1].get<std::string>(), row[2].get<std::string>(),
+					row[3].get<size_t>(), row[4].get<int>(), row[5].get<int>(), row[6].get<std::string>(),
+					row[7].get<std::string>(), row[8].get<int64_t>(), row[9].get<int64_t>(), row[10].get<int>());
+			}
+			catch (const json::exception &)
+			{
+			}
+		}
+		insertUnlocked(key, std::move(response), storedAt, false);
+	}
+	return Result::Success();
+}
+
+Result SearchCache::save(const std::filesystem::path &path, std::string_view scope) const
+{
+	json document = {{"version", cacheFileVersion}, {"scope", scope}, {"entries", json::array()}};
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::size_t budget = limits_.diskBytes;
+		for (const auto &entry : entries_)
+		{
+			if (entry.bytes > budget)
+				break;
+			budget -= entry.bytes;
+			json torrents = json::array();
+			for (const auto &torrent : entry.response.torrents)
+			{
+				torrents.push_back({torrent.name, torrent.magnetUri, torrent.infoHash, torrent.sizeBytes, torrent.seeders,
+					torrent.leechers, torrent.dateUploaded, torrent.category, torrent.createdUnix, torrent.scrapedDate,
+					torrent.completed});
+			}
+			document["entries"].push_back({{"key", entry.key}, {"stored", toSeconds(entry.storedAt)},
+				{"next", entry.response.nextToken}, {"more", entry.response.hasMore}, {"torrents", std::move(torrents)}});
+		}
+	}
+
+	// Cached names come from remote providers and may not be valid UTF-8.
+	Result result = Utils::writeFileAtomically(path, [&document](std::ostream &stream)
+	{
+		stream << document.dump(-1, ' ', false, json::error_handler_t::replace);
+	});
+	if (!result)
+		return Result::Failure("Unable to save search cache: " + result.message, ResultCode::Storage);
+	return Result::Success();
+}
@@ -1,8 +1,11 @@
 #include "SearchEngine.hpp"
 #include "ConfigManager.hpp"
+#include "HttpClient.hpp"
+#include "SearchCache.hpp"
+#include "LocalSearchIndex.hpp"
+#include "SearchResponseParser.hpp"
 #include "utils/StringUtils.hpp"
 #include "Logger.hpp"
-#include <curl/curl.h>
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include <sstream>
@@ -10,165 +13,106 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
-#include <set>
-#include <cctype>
 #include <cstring>
-#include <climits>
+#include <condition_variable>
 
 namespace
 {
-bool normalizeInfoHash(std::string &hash)
-{
-	if (hash.size() != 40 && hash.size() != 64)
-		return false;
-	for (char &character : hash)
-	{
-		if (!std::isxdigit(static_cast<unsigned char>(character)))
-			return false;
-		character = static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
-	}
-	return true;
-}
+constexpr const char *fanOutTokenPrefix = "fanout:";
 
-std::string decodeXml(std::string value)
+// Merges results by normalized info hash, keeping the first copy and
+// filling in what later providers know better.
+class ResultMerger
 {
-	const std::pair<const char *, const char *> entities[] = {
-		{"&amp;", "&"}, {"&quot;", "\""}, {"&apos;", "'"}, {"&lt;", "<"}, {"&gt;", ">"}};
-	for (const auto &[encoded, decoded] : entities)
+public:
+	void add(std::vector<TorrentSearchResult> &&results)
 	{
-		std::size_t position = 0;
-		while ((position = value.find(encoded, position)) != std::string::npos)
+		for (auto &result : results)
 		{
-			value.replace(position, std::strlen(encoded), decoded);
-			position += std::strlen(decoded);
+			std::string key = result.infoHash;
+			if (!normalizeInfoHash(key))
+			{
+				if (result.magnetUri.empty())
+					continue;
+				key = "magnet:" + result.magnetUri;
+			}
+			auto [found, inserted] = indexByKey_.try_emplace(std::move(key), merged_.size());
+			if (inserted)
+			{
+				merged_.push_back(std::move(result));
+				continue;
+			}
+			TorrentSearchResult &existing = merged_[found->second];
+			existing.seeders = std::max(existing.seeders, result.seeders);
+			existing.leechers = std::max(existing.leechers, result.leechers);
+			existing.completed = std::max(existing.completed, result.completed);
+			if (existing.sizeBytes == 0)
+				existing.sizeBytes = result.sizeBytes;
+			if (existing.dateUploaded.empty())
+				existing.dateUploaded = std::move(result.dateUploaded);
+			if (existing.createdUnix == 0)
+				existing.createdUnix = result.createdUnix;
+			if (existing.category.empty() || existing.category == "General")
+				existing.category = result.category.empty() ? existing.category : std::move(result.category);
 		}
 	}
-	return value;
-}
 
-std::string xmlTagValue(const std::string &item, const std::string &tag)
-{
-	const std::string opening = "<" + tag;
-	const auto openingPosition = item.find(opening);
-	if (openingPosition == std::string::npos)
-		return {};
-	const auto valuePosition = item.find('>', openingPosition + opening.size());
-	if (valuePosition == std::string::npos)
-		return {};
-	const auto closingPosition = item.find("</" + tag + ">", valuePosition + 1);
-	if (closingPosition == std::string::npos)
-		return {};
-	return decodeXml(item.substr(valuePosition + 1, closingPosition - valuePosition - 1));
-}
-
-std::string xmlAttribute(const std::string &element, const std::string &attribute)
-{
-	const std::string marker = attribute + "=\"";
-	const auto start = element.find(marker);
-	if (start == std::string::npos)
-		return {};
-	const auto valueStart = start + marker.size();
-	const auto end = element.find('"', valueStart);
-	return end == std::string::npos ? std::string{} : decodeXml(element.substr(valueStart, end - valueStart));
-}
-
-std::string torznabAttribute(const std::string &item, const std::string &name)
-{
-	std::size_t position = 0;
-	while ((position = item.find("<torznab:attr", position)) != std::string::npos)
+	std::vector<TorrentSearchResult> take()
 	{
-		const auto end = item.find('>', position);
-		if (end == std::string::npos)
-			return {};
-		const std::string element = item.substr(position, end - position + 1);
-		if (xmlAttribute(element, "name") == name)
-			return xmlAttribute(element, "value");
-		position = end + 1;
+		// Healthier swarms first; ties keep the order in which they arrived.
+		std::stable_sort(merged_.begin(), merged_.end(), [](const TorrentSearchResult &left, const TorrentSearchResult &right)
+		{
+			return left.seeders > right.seeders;
+		});
+		indexByKey_.clear();
+		return std::move(merged_);
 	}
-	return {};
-}
 
-long long parseNonNegative(const std::string &value)
-{
-	if (value.empty())
-		return 0;
-	try
-	{
-		std::size_t consumed = 0;
-		const long long parsed = std::stoll(value, &consumed);
-		return consumed == value.size() && parsed >= 0 ? parsed : 0;
-	}
-	catch (...)
-	{
-		return 0;
-	}
-}
+private:
+	std::vector<TorrentSearchResult> merged_;
+	std::unordered_map<std::string, std::size_t> indexByKey_;
+};
 
-uint64_t jsonNonNegativeInteger(const nlohmann::json &value, uint64_t maximum)
+// Hands the sink whatever a parser appended to the response since the last
+// flush. A retried transfer starts over, so its results are sent again.
+class BatchForwarder
 {
-	try
+public:
+	BatchForwarder(const SearchResponse &response, const SearchEngine::SearchResultSink &sink)
+		: response_(response), sink_(sink), start_(response.torrents.size()), sent_(start_)
 	{
-		uint64_t parsed = 0;
-		if (value.is_number_unsigned())
-			parsed = value.get<uint64_t>();
-		else if (value.is_number_integer())
-		{
-			const int64_t signedValue = value.get<int64_t>();
-			if (signedValue < 0)
-				return 0;
-			parsed = static_cast<uint64_t>(signedValue);
-		}
-		else
-			return 0;
-		return std::min(parsed, maximum);
 	}
-	catch (...)
+
+	void flush()
 	{
-		return 0;
+		const auto &torrents = response_.torrents;
+		if (!sink_ || torrents.size() <= sent_)
+			return;
+		sink_(std::vector<TorrentSearchResult>(torrents.begin() + static_cast<std::ptrdiff_t>(sent_), torrents.end()));
+		sent_ = torrents.size();
 	}
-}
-}
 
-using json = nlohmann::json;
+	void restart() { sent_ = start_; }
 
-// Callback function for cURL to write data with max size protection (10MB limit)
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *s)
-{
-	size_t newLength = size * nmemb;
-	static constexpr size_t MAX_RESPONSE_SIZE = 10 * 1024 * 1024; // 10 MB
-	if (s->size() + newLength > MAX_RESPONSE_SIZE)
-	{
-		return 0; // Abort download if exceeding max size
-	}
-	try
-	{
-		s->append((char *)contents, newLength);
-		return newLength;
-	}
-	catch (std::bad_alloc &e)
-	{
-		return 0;
-	}
+private:
+	const SearchResponse &response_;
+	const SearchEngine::SearchResultSink &sink_;
+	std::size_t start_;
+	std::size_t sent_;
+};
 }
 
-// Progress callback for cURL to support cancellation
-static int ProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
-{
-	SearchEngine *engine = static_cast<SearchEngine *>(clientp);
-	// Return non-zero to abort the transfer if cancellation was requested
-	if (engine && engine->isCancellationRequested())
-	{
-		return 1; // Abort transfer
-	}
-	return 0; // Continue transfer
-}
+using json = nlohmann::json;
 
 SearchEngine::SearchEngine()
 	: apiUrl("https://torrents-csv.com/service/search"),
 	  timeoutSeconds(30),
 	  maxRetries(3),
 	  searching(false),
-	  cancelRequested(false)
+	  cancelRequested(false),
+	  searchCache(std::make_unique<SearchCache>()),
+	  localIndex(std::make_unique<LocalSearchIndex>()),
+	  httpClient(std::make_unique<HttpClient>())
 {
 }
 
@@ -181,14 +125,59 @@ void SearchEngine::shutdown()
 {
 	shuttingDown = true;
 	cancelRequested = true;
-	std::thread threadToJoin;
+	httpClient->wakeWaiters();
+	// Queued jobs still run, and see the cancellation.
+	std::vector<std::thread> threadsToJoin;
 	{
-		std::lock_guard<std::mutex> lock(threadMutex);
-		threadToJoin = std::move(searchThread);
+		std::lock_guard<std::mutex> lock(workerMutex);
+		workersStopping = true;
+		threadsToJoin = std::move(workers);
 	}
-	if (threadToJoin.joinable())
+	workAvailable.notify_all();
+	for (auto &worker : threadsToJoin)
+		worker.join();
+	httpClient->shutdown();
+}
+
+Result SearchEngine::post(std::function<void()> job)
+{
+	std::lock_guard<std::mutex> lock(workerMutex);
+	if (workersStopping)
+		return Result::Failure("Search service is shutting down", ResultCode::Unavailable);
+	workQueue.push_back(std::move(job));
+	// Every queued job needs a worker of its own: a search blocks its worker
+	// until the fan-out members it queued have run.
+	if (workQueue.size() > idleWorkers)
 	{
-		threadToJoin.join();
+		try
+		{
+			workers.emplace_back(&SearchEngine::runWorker, this);
+		}
+		catch (const std::exception &e)
+		{
+			workQueue.pop_back();
+			return Result::Failure("Failed to start search worker: " + std::string(e.what()), ResultCode::Internal);
+		}
+	}
+	workAvailable.notify_one();
+	return Result::Success();
+}
+
+void SearchEngine::runWorker()
+{
+	std::unique_lock<std::mutex> lock(workerMutex);
+	for (;;)
+	{
+		++idleWorkers;
+		workAvailable.wait(lock, [this] { return workersStopping || !workQueue.empty(); });
+		--idleWorkers;
+		if (workQueue.empty())
+			return;
+		std::function<void()> job = std::move(workQueue.front());
+		workQueue.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
 	}
 }
 
@@ -238,6 +227,20 @@ Result SearchEngine::searchTorrents(const SearchQuery &query, SearchResponse &re
 }
 
 Result SearchEngine::registerSearchProvider(const std::string &id, SearchProvider provider)
+{
+	if (!provider)
+		return Result::Failure("Search provider id and callback are required", ResultCode::InvalidInput);
+	return registerStreamingSearchProvider(id, [provider = std::move(provider)](const SearchQuery &query, SearchResponse &response,
+		const std::function<bool()> &cancelled, const SearchResultSink &sink)
+	{
+		Result result = provider(query, response, cancelled);
+		if (result && sink && !response.torrents.empty())
+			sink(std::vector<TorrentSearchResult>(response.torrents));
+		return result;
+	});
+}
+
+Result SearchEngine::registerStreamingSearchProvider(const std::string &id, StreamingSearchProvider provider)
 {
 	if (id.empty() || !provider)
 		return Result::Failure("Search provider id and callback are required", ResultCode::InvalidInput);
@@ -281,7 +284,12 @@ Result SearchEngine::configureTorznabProvider(const std::string &url, const std:
 	std::string endpoint = url;
 	while (!endpoint.empty() && endpoint.back() == '/')
 		endpoint.pop_back();
-	return registerSearchProvider("torznab", [this, endpoint, apiKey](const SearchQuery &query, SearchResponse &response, const std::function<bool()> &cancelled)
+	{
+		std::lock_guard<std::mutex> lock(providersMutex);
+		torznabEndpoint = endpoint;
+	}
+	return registerStreamingSearchProvider("torznab", [this, endpoint, apiKey](const SearchQuery &query, SearchResponse &response,
+		const std::function<bool()> &cancelled, const SearchResultSink &sink)
 	{
 		if (cancelled())
 			return Result::Failure("Search cancelled", ResultCode::Cancelled);
@@ -293,11 +301,32 @@ Result SearchEngine::configureTorznabProvider(const std::string &url, const std:
 			requestUrl += "&offset=" + Utils::urlEncode(query.nextToken);
 		if (!apiKey.empty())
 			requestUrl += "&apikey=" + Utils::urlEncode(apiKey);
-		std::string body;
-		Result request = makeHttpRequest(requestUrl, body);
-		if (!request)
-			return request;
-		return parseTorznabResponse(body, response);
+		HttpRequest request = buildHttpRequest(requestUrl);
+		TorznabParser parser(response);
+		BatchForwarder forwarder(response, sink);
+		request.onBody = [&parser, &forwarder](std::string_view chunk)
+		{
+			const bool accepted = parser.feed(chunk);
+			forwarder.flush();
+			return accepted;
+		};
+		request.onRestart = [&parser, &forwarder]()
+		{
+			parser.reset();
+			forwarder.restart();
+		};
+		std::string errorBody;
+		Result result = performHttpRequest(std::move(request), errorBody, cancelled);
+		// The parser stops the transfer at a provider <error> element.
+		if (!result && result.code != ResultCode::Parse)
+		{
+			parser.reset();
+			return result;
+		}
+		result = parser.finish();
+		if (!result)
+			parser.reset();
+		return result;
 	});
 }
 
@@ -312,70 +341,197 @@ Result SearchEngine::validateTorznabConfig(const std::string &url)
 
 void SearchEngine::clearSearchCache()
 {
-	std::lock_guard<std::mutex> lock(cacheMutex);
-	searchCache.clear();
+	// A prefetch still running was started under the old configuration.
+	cancelPrefetch();
+	searchCache->clear();
+}
+
+void SearchEngine::attachSearchCacheFile(std::string path)
+{
+	std::lock_guard<std::mutex> lock(searchCacheFileMutex);
+	searchCachePath = std::move(path);
+	searchCacheLoaded = false;
+}
+
+std::string SearchEngine::searchCacheScope() const
+{
+	std::string scope;
+	{
+		std::lock_guard<std::mutex> lock(settingsMutex);
+		scope = apiUrl;
+	}
+	std::lock_guard<std::mutex> lock(providersMutex);
+	return scope + "\n" + torznabEndpoint;
+}
+
+void SearchEngine::ensureSearchCacheLoaded()
+{
+	std::lock_guard<std::mutex> lock(searchCacheFileMutex);
+	if (searchCacheLoaded || searchCachePath.empty())
+		return;
+	searchCacheLoaded = true;
+	Result result = searchCache->load(searchCachePath, searchCacheScope());
+	if (!result)
+		Utils::Logger::warning("search", "Search cache was not loaded: " + result.message);
+}
+
+void SearchEngine::saveSearchCache()
+{
+	std::lock_guard<std::mutex> lock(searchCacheFileMutex);
+	// Without a search this session the file is still current.
+	if (!searchCacheLoaded)
+		return;
+	Result result = searchCache->save(searchCachePath, searchCacheScope());
+	if (!result)
+		Utils::Logger::warning("search", "Search cache was not saved: " + result.message);
+}
+
+std::vector<TorrentSearchResult> SearchEngine::searchLocal(const std::string &query, std::size_t limit)
+{
+	ensureLocalIndexLoaded();
+	return localIndex->search(query, limit);
 }
 
-Result SearchEngine::performSearch(const SearchQuery &query, SearchResponse &response)
+void SearchEngine::attachLocalIndexFile(std::string path)
+{
+	std::lock_guard<std::mutex> lock(localIndexFileMutex);
+	localIndexPath = std::move(path);
+	localIndexLoaded = false;
+}
+
+void SearchEngine::ensureLocalIndexLoaded()
+{
+	std::lock_guard<std::mutex> lock(localIndexFileMutex);
+	if (localIndexLoaded)
+		return;
+	localIndexLoaded = true;
+	if (!localIndexPath.empty())
+	{
+		Result result = localIndex->load(localIndexPath);
+		if (!result)
+			Utils::Logger::warning("search", "Local search index was not loaded: " + result.message);
+	}
+	// The favorites file is authoritative for which entries are favorites.
+	localIndex->syncFavorites(getFavorites());
+}
+
+void SearchEngine::saveLocalIndex()
+{
+	if (!localIndex->dirty())
+		return;
+	// Merges the file first, so results from earlier sessions are kept.
+	ensureLocalIndexLoaded();
+	std::lock_guard<std::mutex> lock(localIndexFileMutex);
+	if (localIndexPath.empty())
+		return;
+	Result result = localIndex->save(localIndexPath);
+	if (!result)
+		Utils::Logger::warning("search", "Local search index was not saved: " + result.message);
+}
+
+void SearchEngine::setFanOutEnabled(bool enabled)
+{
+	{
+		std::lock_guard<std::mutex> lock(providersMutex);
+		fanOutEnabled = enabled;
+	}
+	clearSearchCache();
+}
+
+bool SearchEngine::getFanOutEnabled() const
+{
+	std::lock_guard<std::mutex> lock(providersMutex);
+	return fanOutEnabled;
+}
+
+void SearchEngine::setProviderTimeout(const std::string &id, std::chrono::milliseconds timeout)
+{
+	std::lock_guard<std::mutex> lock(providersMutex);
+	providerTimeouts[id] = std::max(timeout, std::chrono::milliseconds(1));
+}
+
+void SearchEngine::setFanOutGrace(std::chrono::milliseconds grace)
+{
+	std::lock_guard<std::mutex> lock(providersMutex);
+	fanOutGrace = std::max(grace, std::chrono::milliseconds(0));
+}
+
+Result SearchEngine::performSearch(const SearchQuery &query, SearchResponse &response, const SearchResultSink &sink)
 {
 	try
 	{
-		SearchProvider provider;
+		StreamingSearchProvider provider;
 		std::string providerId;
+		bool fanOut = false;
 		{
 			std::lock_guard<std::mutex> lock(providersMutex);
+			fanOut = fanOutEnabled || query.nextToken.rfind(fanOutTokenPrefix, 0) == 0;
 			providerId = activeProvider;
 			auto it = providers.find(activeProvider);
 			if (it != providers.end())
 				provider = it->second;
-		}
-		const std::string cacheKey = providerId + "\n" + query.query + "\n" + std::to_string(query.maxResults) + "\n" + query.nextToken;
-		{
-			std::lock_guard<std::mutex> lock(cacheMutex);
-			auto cached = searchCache.find(cacheKey);
-			if (cached != searchCache.end())
+			if (fanOut)
 			{
-				if (cached->second.expiresAt > std::chrono::steady_clock::now())
-				{
-					response = cached->second.response;
-					return Result::Success();
-				}
-				searchCache.erase(cached);
+				// Registering another provider changes what a fan-out returns.
+				providerId = "fanout";
+				for (const auto &[id, registered] : providers)
+					providerId += "," + id;
 			}
 		}
-
-		if (provider)
+		// A first page starts a new query; pages prefetched for the old one
+		// are no longer wanted.
+		if (query.nextToken.empty())
+			cancelPrefetch();
+		ensureSearchCacheLoaded();
+		const uint64_t cacheKey = SearchCache::makeKey(providerId, query.query, query.maxResults, query.nextToken);
+		bool refresh = false;
+		SearchCache::Hit hit = searchCache->lookup(cacheKey, response, refresh);
+		if (hit == SearchCache::Hit::Miss && waitForPrefetch(cacheKey))
+			hit = searchCache->lookup(cacheKey, response, refresh);
+		if (hit == SearchCache::Hit::Fresh)
 		{
-			Result providerResult = provider(query, response, [this] { return cancelRequested.load(); });
-			if (providerResult)
+			schedulePrefetch(query, response, providerId, fanOut, provider);
+			return Result::Success();
+		}
+		if (hit == SearchCache::Hit::Stale)
+		{
+			// Serve the stale page now; the refreshed one answers the next search.
+			if (refresh)
 			{
-				std::lock_guard<std::mutex> lock(cacheMutex);
-				if (searchCache.size() >= 100)
-					searchCache.clear();
-				searchCache[cacheKey] = CachedSearch{response, std::chrono::steady_clock::now() + std::chrono::minutes(5)};
-				return providerResult;
+				Result queued = post([this, query, cacheKey, fanOut, provider]()
+				{
+					SearchResponse refreshed;
+					Result result = Result::Failure("Search refresh failed");
+					try
+					{
+						result = fetchSearch(query, refreshed, fanOut, provider);
+					}
+					catch (const std::exception &e)
+					{
+						result = Result::Failure("Search refresh failed: " + std::string(e.what()));
+					}
+					if (result)
+						searchCache->store(cacheKey, std::move(refreshed));
+					else
+					{
+						Utils::Logger::debug("search", "Cached page was not refreshed: " + result.message);
+						searchCache->releaseRefresh(cacheKey);
+					}
+				});
+				if (!queued)
+					searchCache->releaseRefresh(cacheKey);
 			}
-			if (providerResult.code == ResultCode::Cancelled || !query.nextToken.empty())
-				return providerResult;
-			Utils::Logger::warning("search", "Active provider failed; falling back to torrents-csv: " + providerResult.message);
-			response = SearchResponse{};
+			schedulePrefetch(query, response, providerId, fanOut, provider);
+			return Result::Success();
 		}
 
-		std::string httpResponse;
-		Result httpResult = makeHttpRequest(buildSearchUrl(query), httpResponse);
-		if (!httpResult)
-			return httpResult;
-		if (cancelRequested.load())
-			return Result::Failure("Search cancelled by user", ResultCode::Cancelled);
-		Result parseResult = parseSearchResponse(httpResponse, response);
-		if (parseResult)
+		Result result = fetchSearch(query, response, fanOut, provider, {}, sink);
+		if (result)
 		{
-			std::lock_guard<std::mutex> lock(cacheMutex);
-			if (searchCache.size() >= 100)
-				searchCache.clear();
-			searchCache[cacheKey] = CachedSearch{response, std::chrono::steady_clock::now() + std::chrono::minutes(5)};
+			searchCache->store(cacheKey, response);
+			schedulePrefetch(query, response, providerId, fanOut, provider);
 		}
-		return parseResult;
+		return result;
 	}
 	catch (const std::exception &e)
 	{
@@ -389,489 +545,463 @@ Result SearchEngine::performSearch(const SearchQuery &query, SearchResponse &res
 	}
 }
 
-Result SearchEngine::makeHttpRequest(const std::string &url, std::string &response)
+void SearchEngine::schedulePrefetch(const SearchQuery &query, const SearchResponse &response, const std::string &providerId,
+	bool fanOut, const StreamingSearchProvider &provider)
 {
-	int timeout = 30;
-	int retries = 3;
-	bool useProxy = false;
-	std::string configuredProxyType;
-	std::string configuredProxyHost;
-	std::string configuredProxyUsername;
-	std::string configuredProxyPassword;
-	int configuredProxyPort = 0;
-	{
-		std::lock_guard<std::mutex> lock(settingsMutex);
-		timeout = timeoutSeconds;
-		retries = maxRetries;
-		useProxy = proxyEnabled;
-		configuredProxyType = proxyType;
-		configuredProxyHost = proxyHost;
-		configuredProxyPort = proxyPort;
-		configuredProxyUsername = proxyUsername;
-		configuredProxyPassword = proxyPassword;
-	}
-	retries = std::max(retries, 1);
-	CURL *curl = curl_easy_init();
-	if (!curl)
-	{
-		return Result::Failure("Failed to initialize cURL");
-	}
+	if (!response.hasMore || response.nextToken.empty() || shuttingDown.load())
+		return;
+	const SearchQuery next(query.query, query.maxResults, response.nextToken);
+	const uint64_t cacheKey = SearchCache::makeKey(providerId, next.query, next.maxResults, next.nextToken);
+	if (searchCache->isFresh(cacheKey))
+		return;
 
-	CURLcode res = CURLE_OK;
-	long lastResponseCode = 0;
-	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, static_cast<long>(timeout));
-	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, static_cast<long>(std::min(timeout, 10)));
-	curl_easy_setopt(curl, CURLOPT_MAXFILESIZE, 10L * 1024L * 1024L); // 10 MB limit
-	curl_easy_setopt(curl, CURLOPT_USERAGENT, "Hypertube/1.0");
-	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-	curl_easy_setopt(curl, CURLOPT_PROTOCOLS_STR, "http,https");
-	curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
-	if (useProxy)
+	uint64_t generation = 0;
 	{
-		curl_easy_setopt(curl, CURLOPT_PROXY, configuredProxyHost.c_str());
-		curl_easy_setopt(curl, CURLOPT_PROXYPORT, static_cast<long>(configuredProxyPort));
-		curl_easy_setopt(curl, CURLOPT_PROXYTYPE,
-			configuredProxyType == "http" ? CURLPROXY_HTTP : CURLPROXY_SOCKS5_HOSTNAME);
-		if (!configuredProxyUsername.empty())
-		{
-			curl_easy_setopt(curl, CURLOPT_PROXYUSERNAME, configuredProxyUsername.c_str());
-			curl_easy_setopt(curl, CURLOPT_PROXYPASSWORD, configuredProxyPassword.c_str());
-		}
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		if (prefetchingKey)
+			return;
+		// Fan-out pages spend one budget, whichever providers they include.
+		const std::string budgetId = fanOut ? "fanout" : providerId;
+		auto budget = prefetchBudgets.find(budgetId);
+		const int pagesPerMinute = budget == prefetchBudgets.end() ? 6 : budget->second;
+		const auto now = std::chrono::steady_clock::now();
+		auto &recent = prefetchHistory[budgetId];
+		while (!recent.empty() && now - recent.front() >= std::chrono::minutes(1))
+			recent.pop_front();
+		if (recent.size() >= static_cast<std::size_t>(pagesPerMinute))
+			return;
+		recent.push_back(now);
+		prefetchingKey = cacheKey;
+		generation = prefetchGeneration.load();
 	}
 
-	// Enable progress callback for cancellation support
-	curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
-	curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
-	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-
-	// Perform the request
-	for (int attempt = 0; attempt < retries; ++attempt)
+	Result queued = post([this, next, cacheKey, generation, fanOut, provider]()
 	{
-		response.clear();
-		res = curl_easy_perform(curl);
-
-		// Check if operation was cancelled
-		if (res == CURLE_ABORTED_BY_CALLBACK)
+		auto superseded = [this, generation]() { return prefetchGeneration.load() != generation || shuttingDown.load(); };
+		SearchResponse page;
+		Result result = Result::Failure("Prefetch failed");
+		try
 		{
-			curl_easy_cleanup(curl);
-			return Result::Failure("Search cancelled by user", ResultCode::Cancelled);
+			result = fetchSearch(next, page, fanOut, provider, superseded);
 		}
-
-		if (res == CURLE_OK)
+		catch (const std::exception &e)
 		{
-			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &lastResponseCode);
-
-			if (lastResponseCode == 200)
-			{
-				curl_easy_cleanup(curl);
-				return Result::Success();
-			}
-			if (lastResponseCode == 401 || lastResponseCode == 403)
-			{
-				curl_easy_cleanup(curl);
-				return Result::Failure("HTTP Error: " + std::to_string(lastResponseCode), ResultCode::Unauthorized);
-			}
-			const bool transientHttpError = lastResponseCode == 429 || lastResponseCode >= 500;
-			if (!transientHttpError || attempt == retries - 1)
-			{
-				curl_easy_cleanup(curl);
-				if (lastResponseCode == 429)
-					return Result::Failure("HTTP Error: 429", ResultCode::RateLimited, true);
-				return Result::Failure("HTTP Error: " + std::to_string(lastResponseCode), ResultCode::Network, transientHttpError);
-			}
+			result = Result::Failure("Prefetch failed: " + std::string(e.what()));
 		}
-
-		// If not the last attempt, wait a bit before retrying
-		if (attempt < retries - 1)
+		if (result && !superseded())
+			searchCache->store(cacheKey, std::move(page));
+		else if (!result && result.code != ResultCode::Cancelled)
+			Utils::Logger::debug("search", "Next page was not prefetched: " + result.message);
 		{
-			const auto deadline = std::chrono::steady_clock::now()
-				+ std::chrono::milliseconds(500 * (1 << std::min(attempt, 4)));
-			while (std::chrono::steady_clock::now() < deadline)
-			{
-				if (cancelRequested.load())
-				{
-					curl_easy_cleanup(curl);
-					return Result::Failure("Search cancelled by user", ResultCode::Cancelled);
-				}
-				std::this_thread::sleep_for(std::chrono::milliseconds(25));
-			}
+			std::lock_guard<std::mutex> lock(prefetchMutex);
+			prefetchingKey.reset();
 		}
+		prefetchChanged.notify_all();
+	});
+	if (!queued)
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		prefetchingKey.reset();
 	}
+}
 
-	std::string error_msg = lastResponseCode != 0
-		? "HTTP Error: " + std::to_string(lastResponseCode)
-		: "cURL Error: " + std::string(curl_easy_strerror(res));
-	curl_easy_cleanup(curl);
-	return Result::Failure(error_msg, ResultCode::Network, true);
+bool SearchEngine::waitForPrefetch(uint64_t cacheKey)
+{
+	std::unique_lock<std::mutex> lock(prefetchMutex);
+	if (prefetchingKey != cacheKey)
+		return false;
+	prefetchChanged.wait(lock, [&] { return prefetchingKey != cacheKey || cancelRequested.load(); });
+	return true;
 }
 
-std::string SearchEngine::buildSearchUrl(const SearchQuery &query) const
+void SearchEngine::cancelPrefetch()
 {
-	std::string configuredApiUrl;
 	{
-		std::lock_guard<std::mutex> lock(settingsMutex);
-		configuredApiUrl = apiUrl;
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		if (!prefetchingKey)
+			return;
+		++prefetchGeneration;
 	}
-	std::string url = configuredApiUrl + "?q=" + Utils::urlEncode(query.query);
+	httpClient->wakeWaiters();
+}
 
-	// Add size parameter only if explicitly set and not default
-	if (query.maxResults > 0 && query.maxResults != 50)
+void SearchEngine::setPrefetchBudget(const std::string &id, int pagesPerMinute)
+{
+	std::lock_guard<std::mutex> lock(prefetchMutex);
+	prefetchBudgets[id] = std::max(pagesPerMinute, 0);
+}
+
+Result SearchEngine::setProviderRateLimit(const std::string &id, int requestsPerMinute, int burst)
+{
+	std::string url;
+	if (id == "torrents-csv")
 	{
-		url += "&size=" + std::to_string(query.maxResults);
+		std::lock_guard<std::mutex> lock(settingsMutex);
+		url = apiUrl;
 	}
-
-	// Add after parameter for pagination using next token
-	if (!query.nextToken.empty())
+	else if (id == "torznab")
 	{
-		url += "&after=" + Utils::urlEncode(query.nextToken);
+		std::lock_guard<std::mutex> lock(providersMutex);
+		url = torznabEndpoint;
 	}
-
-	return url;
+	const std::string host = HttpClient::hostKey(url);
+	if (host.empty())
+		return Result::Failure("No HTTP host for provider: " + id, ResultCode::NotFound);
+	HostPolicy policy;
+	policy.requestsPerSecond = std::max(requestsPerMinute, 0) / 60.0;
+	policy.burst = std::max(burst, 1);
+	httpClient->setHostPolicy(host, policy);
+	return Result::Success();
 }
 
-Result SearchEngine::parseSearchResponse(const std::string &response, std::vector<TorrentSearchResult> &results)
+Result SearchEngine::fetchSearch(const SearchQuery &query, SearchResponse &response, bool fanOut, const StreamingSearchProvider &provider,
+	const std::function<bool()> &cancelled, const SearchResultSink &sink)
 {
-	try
+	Result result = Result::Failure("Search did not run", ResultCode::Internal);
+	if (fanOut)
+		result = performFanOutSearch(query, response, cancelled, sink);
+	else if (provider)
 	{
-		json j = json::parse(response);
-
-		// Handle different possible response formats
-		json torrentsArray;
-
-		if (j.is_array())
-		{
-			// Direct array of torrents
-			torrentsArray = j;
-		}
-		else if (j.contains("torrents") && j["torrents"].is_array())
-		{
-			// Object with torrents array (this matches the actual API response)
-			torrentsArray = j["torrents"];
-		}
-		else if (j.contains("data") && j["data"].is_array())
-		{
-			// Object with data array
-			torrentsArray = j["data"];
-		}
-		else
+		result = provider(query, response, [this, &cancelled] { return cancelRequested.load() || (cancelled && cancelled()); }, sink);
+		if (!result && result.code != ResultCode::Cancelled && query.nextToken.empty())
 		{
-			return Result::Failure("Invalid response format: no torrent data found");
+			Utils::Logger::warning("search", "Active provider failed; falling back to torrents-csv: " + result.message);
+			response = SearchResponse{};
+			result = searchTorrentsCsv(query, response, cancelled, sink);
 		}
+	}
+	else
+		result = searchTorrentsCsv(query, response, cancelled, sink);
 
-		for (const auto &item : torrentsArray)
-		{
-			TorrentSearchResult result;
-
-			// Parse name field
-			auto itName = item.find("name");
-			if (itName != item.end() && itName->is_string())
-			{
-				result.name = itName->get<std::string>();
-			}
-			else
-			{
-				continue; // Skip if no valid name
-			}
-
-			// Parse infohash field
-			auto itInfoHash = item.find("infohash");
-			if (itInfoHash != item.end() && itInfoHash->is_string())
-			{
-				result.infoHash = itInfoHash->get<std::string>();
-				if (!normalizeInfoHash(result.infoHash))
-					continue;
-			}
-			else
-			{
-				continue; // Skip if no valid infohash
-			}
-
-			// Generate magnet URI
-			result.magnetUri = Utils::formatMagnetUri(result.infoHash, result.name);
-
-			// Parse numeric fields safely
-			auto itSizeBytes = item.find("size_bytes");
-			if (itSizeBytes != item.end())
-				result.sizeBytes = static_cast<size_t>(jsonNonNegativeInteger(*itSizeBytes, SIZE_MAX));
-
-			auto itSeeders = item.find("seeders");
-			if (itSeeders != item.end())
-				result.seeders = static_cast<int>(jsonNonNegativeInteger(*itSeeders, INT_MAX));
-
-			auto itLeechers = item.find("leechers");
-			if (itLeechers != item.end())
-				result.leechers = static_cast<int>(jsonNonNegativeInteger(*itLeechers, INT_MAX));
-
-			// Handle created_unix as number and convert to string (legacy field)
-			auto itCreatedUnix = item.find("created_unix");
-			if (itCreatedUnix != item.end())
-			{
-				result.createdUnix = static_cast<int64_t>(jsonNonNegativeInteger(*itCreatedUnix, INT64_MAX));
-				result.dateUploaded = result.createdUnix == 0 ? "" : std::to_string(result.createdUnix);
-			}
-			else
-			{
-				result.dateUploaded = "";
-				result.createdUnix = 0;
-			}
-
-			// Handle scraped_date field
-			auto itScrapedDate = item.find("scraped_date");
-			if (itScrapedDate != item.end())
-				result.scrapedDate = static_cast<int64_t>(jsonNonNegativeInteger(*itScrapedDate, INT64_MAX));
-
-			// Handle completed field
-			auto itCompleted = item.find("completed");
-			if (itCompleted != item.end())
-				result.completed = static_cast<int>(jsonNonNegativeInteger(*itCompleted, INT_MAX));
-
-			// Category is often not present in torrents-csv, set default
-			result.category = "General";
-
-			results.push_back(result);
-		}
+	if (result)
+		localIndex->record(response.torrents);
+	return result;
+}
 
-		Utils::Logger::debug("search", "Parsed " + std::to_string(results.size()) + " search results");
-		return Result::Success();
+Result SearchEngine::searchTorrentsCsv(const SearchQuery &query, SearchResponse &response, const std::function<bool()> &cancelled,
+	const SearchResultSink &sink)
+{
+	// Results are parsed as the body arrives, and each chunk's worth goes to
+	// the sink; nothing is buffered beyond the string being read.
+	HttpRequest request = buildHttpRequest(buildSearchUrl(query));
+	TorrentsCsvParser parser(response, true);
+	BatchForwarder forwarder(response, sink);
+	request.onBody = [&parser, &forwarder](std::string_view chunk)
+	{
+		const bool accepted = parser.feed(chunk);
+		forwarder.flush();
+		return accepted;
+	};
+	request.onRestart = [&parser, &forwarder]()
+	{
+		parser.reset();
+		forwarder.restart();
+	};
+	std::string errorBody;
+	Result httpResult = performHttpRequest(std::move(request), errorBody, cancelled);
+	if (!httpResult)
+	{
+		// A rejected body reports why the parser rejected it.
+		if (httpResult.code == ResultCode::Parse)
+			httpResult = parser.finish();
+		parser.reset();
+		return httpResult;
 	}
-	catch (const json::exception &e)
+	if (cancelRequested.load() || (cancelled && cancelled()))
 	{
-		return Result::Failure("JSON Parse Error: " + std::string(e.what()));
+		parser.reset();
+		return Result::Failure("Search cancelled by user", ResultCode::Cancelled);
 	}
-	catch (const std::exception &e)
+	Result parsed = parser.finish();
+	if (!parsed)
 	{
-		return Result::Failure("Parse Error: " + std::string(e.what()));
+		parser.reset();
+		return parsed;
 	}
+	// A "data" list is only known to be the answer once the body has ended.
+	forwarder.flush();
+	Utils::Logger::debug("search", "Parsed " + std::to_string(parser.parsedCount()) + " search results");
+	return Result::Success();
 }
 
-Result SearchEngine::parseSearchResponse(const std::string &response, SearchResponse &searchResponse)
+Result SearchEngine::performFanOutSearch(const SearchQuery &query, SearchResponse &response, const std::function<bool()> &cancelled,
+	const SearchResultSink &sink)
 {
-	try
+	auto isCancelled = [this, &cancelled]() { return cancelRequested.load() || (cancelled && cancelled()); };
+	struct Member
 	{
-		json j = json::parse(response);
+		std::string id;
+		StreamingSearchProvider provider;
+		std::chrono::milliseconds timeout;
+		std::string token;
+	};
 
-		// Handle different possible response formats
-		json torrentsArray;
+	std::chrono::milliseconds defaultTimeout;
+	{
+		std::lock_guard<std::mutex> lock(settingsMutex);
+		defaultTimeout = std::chrono::seconds(timeoutSeconds);
+	}
 
-		if (j.is_array())
+	// Later pages carry one continuation token per provider that had more.
+	json pageTokens;
+	const bool continuation = query.nextToken.rfind(fanOutTokenPrefix, 0) == 0;
+	if (continuation)
+	{
+		pageTokens = json::parse(query.nextToken.substr(std::strlen(fanOutTokenPrefix)), nullptr, false);
+		if (!pageTokens.is_object())
+			return Result::Failure("Invalid fan-out page token", ResultCode::InvalidInput);
+	}
+
+	std::vector<Member> members;
+	std::chrono::milliseconds grace;
+	{
+		std::lock_guard<std::mutex> lock(providersMutex);
+		grace = fanOutGrace;
+		auto add = [&](const std::string &id, StreamingSearchProvider provider)
+		{
+			std::string token;
+			if (continuation)
+			{
+				auto found = pageTokens.find(id);
+				if (found == pageTokens.end() || !found->is_string())
+					return;
+				token = found->get<std::string>();
+			}
+			auto timeout = providerTimeouts.find(id);
+			members.push_back({id, std::move(provider), timeout == providerTimeouts.end() ? defaultTimeout : timeout->second, std::move(token)});
+		};
+		add("torrents-csv", [this](const SearchQuery &memberQuery, SearchResponse &memberResponse, const std::function<bool()> &cancelled,
+			const SearchResultSink &memberSink)
+		{
+			return searchTorrentsCsv(memberQuery, memberResponse, cancelled, memberSink);
+		});
+		std::vector<std::string> ids;
+		for (const auto &[id, provider] : providers)
+			ids.push_back(id);
+		std::sort(ids.begin(), ids.end());
+		for (const auto &id : ids)
+			add(id, providers.at(id));
+	}
+	if (members.empty())
+		return Result::Failure("Invalid fan-out page token", ResultCode::InvalidInput);
+
+	std::mutex stateMutex;
+	std::condition_variable stateChanged;
+	ResultMerger merger;
+	json nextTokens = json::object();
+	std::size_t pending = members.size();
+	std::size_t answered = 0;
+	std::optional<std::chrono::steady_clock::time_point> graceDeadline;
+	std::optional<Result> failure;
+	std::atomic<bool> stop{false};
+	const auto started = std::chrono::steady_clock::now();
+
+	auto runMember = [&](const Member &member)
+	{
+		const auto deadline = started + member.timeout;
+		const std::function<bool()> memberCancelled = [&]()
 		{
-			// Direct array of torrents
-			torrentsArray = j;
+			return stop.load() || isCancelled() || std::chrono::steady_clock::now() >= deadline;
+		};
+		// Cut-off members stop streaming with the rest of their answer.
+		SearchResultSink memberSink;
+		if (sink)
+		{
+			memberSink = [&](std::vector<TorrentSearchResult> &&batch)
+			{
+				if (!stop.load())
+					sink(std::move(batch));
+			};
 		}
-		else if (j.contains("torrents") && j["torrents"].is_array())
+		SearchResponse part;
+		Result result = Result::Failure("Search cancelled by user", ResultCode::Cancelled);
+		try
 		{
-			// Object with torrents array (this matches the actual API response)
-			torrentsArray = j["torrents"];
+			if (!stop.load())
+				result = member.provider(SearchQuery(query.query, query.maxResults, member.token), part, memberCancelled, memberSink);
 		}
-		else if (j.contains("data") && j["data"].is_array())
+		catch (const std::exception &e)
 		{
-			// Object with data array
-			torrentsArray = j["data"];
+			result = Result::Failure("Search failed: " + std::string(e.what()));
 		}
-		else
+		catch (...)
 		{
-			return Result::Failure("Invalid response format: no torrent data found");
+			result = Result::Failure("Search failed with an unknown error");
 		}
+		if (!result && !stop.load() && !isCancelled() && std::chrono::steady_clock::now() >= deadline)
+			result = Result::Failure("Timed out after " + std::to_string(member.timeout.count()) + " ms", ResultCode::Network, true);
 
-		// Parse the next token for pagination
-		if (j.contains("next"))
+		std::lock_guard<std::mutex> lock(stateMutex);
+		if (result && !stop.load())
 		{
-			if (j["next"].is_number())
-			{
-				searchResponse.nextToken = std::to_string(j["next"].get<long long>());
-				searchResponse.hasMore = true;
-			}
-			else if (j["next"].is_string())
-			{
-				searchResponse.nextToken = j["next"].get<std::string>();
-				searchResponse.hasMore = !searchResponse.nextToken.empty();
-			}
+			merger.add(std::move(part.torrents));
+			if (part.hasMore && !part.nextToken.empty())
+				nextTokens[member.id] = part.nextToken;
+			if (answered++ == 0)
+				graceDeadline = std::chrono::steady_clock::now() + grace;
 		}
-
-		// Track seen infohashes to prevent duplicates
-		std::set<std::string> seenHashes;
-		for (const auto &existing : searchResponse.torrents)
+		else if (!result && result.code != ResultCode::Cancelled)
 		{
-			seenHashes.insert(existing.infoHash);
+			Utils::Logger::warning("search", "Search provider '" + member.id + "' failed: " + result.message);
+			if (!failure)
+				failure = result;
 		}
+		--pending;
+		stateChanged.notify_all();
+	};
 
-		for (const auto &item : torrentsArray)
+	// Members reference this frame, so every queued one must have run
+	// before it returns; stopped members return without searching.
+	auto stopMembers = [&](std::unique_lock<std::mutex> &lock)
+	{
+		stop = true;
+		httpClient->wakeWaiters();
+		stateChanged.wait(lock, [&] { return pending == 0; });
+	};
+	for (std::size_t index = 0; index < members.size(); ++index)
+	{
+		Result queued = post([&runMember, &member = members[index]] { runMember(member); });
+		if (!queued)
 		{
-			TorrentSearchResult result;
-
-			// Parse name field
-			auto itName = item.find("name");
-			if (itName != item.end() && itName->is_string())
-			{
-				result.name = itName->get<std::string>();
-			}
-			else
-			{
-				continue; // Skip if no valid name
-			}
-
-			// Parse infohash field
-			auto itInfoHash = item.find("infohash");
-			if (itInfoHash != item.end() && itInfoHash->is_string())
-			{
-				result.infoHash = itInfoHash->get<std::string>();
-				if (!normalizeInfoHash(result.infoHash))
-					continue;
-			}
-			else
-			{
-				continue; // Skip if no valid infohash
-			}
-
-			// Skip duplicates
-			if (seenHashes.find(result.infoHash) != seenHashes.end())
-			{
-				continue;
-			}
-			seenHashes.insert(result.infoHash);
-
-			// Generate magnet URI
-			result.magnetUri = Utils::formatMagnetUri(result.infoHash, result.name);
-
-			// Parse numeric fields safely
-			auto itSizeBytes = item.find("size_bytes");
-			if (itSizeBytes != item.end())
-				result.sizeBytes = static_cast<size_t>(jsonNonNegativeInteger(*itSizeBytes, SIZE_MAX));
-
-			auto itSeeders = item.find("seeders");
-			if (itSeeders != item.end())
-				result.seeders = static_cast<int>(jsonNonNegativeInteger(*itSeeders, INT_MAX));
-
-			auto itLeechers = item.find("leechers");
-			if (itLeechers != item.end())
-				result.leechers = static_cast<int>(jsonNonNegativeInteger(*itLeechers, INT_MAX));
+			std::unique_lock<std::mutex> lock(stateMutex);
+			pending -= members.size() - index;
+			stopMembers(lock);
+			return queued;
+		}
+	}
 
-			// Handle created_unix as number and convert to string (legacy field)
-			auto itCreatedUnix = item.find("created_unix");
-			if (itCreatedUnix != item.end())
-			{
-				result.createdUnix = static_cast<int64_t>(jsonNonNegativeInteger(*itCreatedUnix, INT64_MAX));
-				result.dateUploaded = result.createdUnix == 0 ? "" : std::to_string(result.createdUnix);
-			}
-			else
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+		while (pending > 0 && !isCancelled())
+		{
+			// Wakes periodically so cancellation is noticed promptly.
+			auto wakeAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+			if (graceDeadline)
 			{
-				result.dateUploaded = "";
-				result.createdUnix = 0;
+				if (std::chrono::steady_clock::now() >= *graceDeadline)
+				{
+					Utils::Logger::info("search", "Cutting off " + std::to_string(pending) + " slow search provider(s)");
+					break;
+				}
+				wakeAt = std::min(wakeAt, *graceDeadline);
 			}
+			stateChanged.wait_until(lock, wakeAt);
+		}
+		stopMembers(lock);
+	}
 
-			// Handle scraped_date field
-			auto itScrapedDate = item.find("scraped_date");
-			if (itScrapedDate != item.end())
-				result.scrapedDate = static_cast<int64_t>(jsonNonNegativeInteger(*itScrapedDate, INT64_MAX));
+	if (isCancelled())
+		return Result::Failure("Search cancelled by user", ResultCode::Cancelled);
+	if (answered == 0)
+		return failure.value_or(Result::Failure("No search provider answered", ResultCode::Network, true));
 
-			// Handle completed field
-			auto itCompleted = item.find("completed");
-			if (itCompleted != item.end())
-				result.completed = static_cast<int>(jsonNonNegativeInteger(*itCompleted, INT_MAX));
+	response.torrents = merger.take();
+	response.hasMore = !nextTokens.empty();
+	response.nextToken = response.hasMore ? fanOutTokenPrefix + nextTokens.dump() : std::string();
+	Utils::Logger::debug("search", "Merged " + std::to_string(response.torrents.size()) + " results from "
+		+ std::to_string(answered) + " of " + std::to_string(members.size()) + " search providers");
+	return Result::Success();
+}
 
-			// Category is often not present in torrents-csv, set default
-			result.category = "General";
+HttpRequest SearchEngine::buildHttpRequest(const std::string &url) const
+{
+	HttpRequest request;
+	request.url = url;
+	std::lock_guard<std::mutex> lock(settingsMutex);
+	request.timeoutSeconds = timeoutSeconds;
+	request.maxAttempts = std::max(maxRetries, 1);
+	request.useProxy = proxyEnabled;
+	request.proxyType = proxyType;
+	request.proxyHost = proxyHost;
+	request.proxyPort = proxyPort;
+	request.proxyUsername = proxyUsername;
+	request.proxyPassword = proxyPassword;
+	return request;
+}
 
-			searchResponse.torrents.push_back(result);
-		}
+Result SearchEngine::makeHttpRequest(const std::string &url, std::string &response, const std::function<bool()> &cancelled)
+{
+	return performHttpRequest(buildHttpRequest(url), response, cancelled);
+}
 
-		Utils::Logger::debug("search", "Parsed " + std::to_string(searchResponse.torrents.size()) + " search results");
-		if (searchResponse.hasMore)
-			Utils::Logger::debug("search", "More results available with next token");
-		return Result::Success();
-	}
-	catch (const json::exception &e)
-	{
-		return Result::Failure("JSON Parse Error: " + std::string(e.what()));
-	}
-	catch (const std::exception &e)
+Result SearchEngine::performHttpRequest(HttpRequest request, std::string &response, const std::function<bool()> &cancelled)
+{
+	// cancelCurrentSearch() and fan-out cut-offs wake the wait, so the
+	// transfer is dropped without waiting for curl to call back.
+	Result result = httpClient->perform(std::move(request), response, [this, &cancelled]()
 	{
-		return Result::Failure("Parse Error: " + std::string(e.what()));
-	}
+		return cancelRequested.load() || (cancelled && cancelled());
+	});
+	if (result.code == ResultCode::Cancelled)
+		return Result::Failure("Search cancelled by user", ResultCode::Cancelled);
+	return result;
 }
 
-Result SearchEngine::parseTorznabResponse(const std::string &response, SearchResponse &searchResponse)
+std::string SearchEngine::buildSearchUrl(const SearchQuery &query) const
 {
-	searchResponse = SearchResponse{};
-	if (response.empty())
-		return Result::Failure("Torznab returned an empty response", ResultCode::Parse);
-	if (response.find("<error") != std::string::npos)
+	std::string configuredApiUrl;
 	{
-		const auto errorPosition = response.find("<error");
-		const auto errorEnd = response.find('>', errorPosition);
-		const std::string element = errorEnd == std::string::npos ? std::string{} : response.substr(errorPosition, errorEnd - errorPosition + 1);
-		const std::string description = xmlAttribute(element, "description");
-		return Result::Failure(description.empty() ? "Torznab provider returned an error" : description, ResultCode::Unavailable);
+		std::lock_guard<std::mutex> lock(settingsMutex);
+		configuredApiUrl = apiUrl;
 	}
+	std::string url = configuredApiUrl + "?q=" + Utils::urlEncode(query.query);
 
-	std::unordered_set<std::string> seen;
-	std::size_t position = 0;
-	while (searchResponse.torrents.size() < 500 && (position = response.find("<item", position)) != std::string::npos)
+	// Add size parameter only if explicitly set and not default
+	if (query.maxResults > 0 && query.maxResults != 50)
 	{
-		const auto itemStart = response.find('>', position);
-		const auto itemEnd = response.find("</item>", itemStart);
-		if (itemStart == std::string::npos || itemEnd == std::string::npos)
-			return Result::Failure("Malformed Torznab item", ResultCode::Parse);
-		const std::string item = response.substr(itemStart + 1, itemEnd - itemStart - 1);
-		position = itemEnd + 7;
-
-		TorrentSearchResult result;
-		result.name = xmlTagValue(item, "title");
-		result.infoHash = torznabAttribute(item, "infohash");
-		result.magnetUri = torznabAttribute(item, "magneturl");
-		if (result.magnetUri.empty())
-		{
-			const std::string link = xmlTagValue(item, "link");
-			if (link.rfind("magnet:?", 0) == 0)
-				result.magnetUri = link;
-		}
-		if (result.infoHash.empty() && !result.magnetUri.empty())
-		{
-			const auto hashPosition = result.magnetUri.find("btih:");
-			if (hashPosition != std::string::npos && hashPosition + 45 <= result.magnetUri.size())
-				result.infoHash = result.magnetUri.substr(hashPosition + 5, 40);
-		}
-		if (result.infoHash.empty())
-			result.infoHash = xmlTagValue(item, "guid");
-		if (result.name.empty() || !normalizeInfoHash(result.infoHash) || !seen.insert(result.infoHash).second)
-			continue;
-		if (result.magnetUri.empty())
-			result.magnetUri = Utils::formatMagnetUri(result.infoHash, result.name);
-
-		result.sizeBytes = static_cast<std::size_t>(parseNonNegative(xmlTagValue(item, "size")));
-		result.seeders = static_cast<int>(std::min<long long>(parseNonNegative(torznabAttribute(item, "seeders")), INT_MAX));
-		result.leechers = static_cast<int>(std::min<long long>(parseNonNegative(torznabAttribute(item, "peers")), INT_MAX));
-		result.category = xmlTagValue(item, "category");
-		if (result.category.empty())
-			result.category = "General";
-		result.dateUploaded = xmlTagValue(item, "pubDate");
-		searchResponse.torrents.push_back(std::move(result));
+		url += "&size=" + std::to_string(query.maxResults);
 	}
 
-	const auto responsePosition = response.find("newznab:response");
-	if (responsePosition != std::string::npos)
+	// Add after parameter for pagination using next token
+	if (!query.nextToken.empty())
 	{
-		const auto responseEnd = response.find('>', responsePosition);
-		const std::string element = responseEnd == std::string::npos ? std::string{} : response.substr(responsePosition, responseEnd - responsePosition + 1);
-		const long long offset = parseNonNegative(xmlAttribute(element, "offset"));
-		const long long total = parseNonNegative(xmlAttribute(element, "total"));
-		const long long next = offset + static_cast<long long>(searchResponse.torrents.size());
-		searchResponse.hasMore = next < total;
-		if (searchResponse.hasMore)
-			searchResponse.nextToken = std::to_string(next);
+		url += "&after=" + Utils::urlEncode(query.nextToken);
 	}
+
+	return url;
+}
+
+Result SearchEngine::parseSearchResponse(const std::string &response, std::vector<TorrentSearchResult> &results)
+{
+	SearchResponse parsed;
+	TorrentsCsvParser parser(parsed, false);
+	parser.feed(response);
+	Result result = parser.finish();
+	if (!result)
+		return result;
+	results.insert(results.end(), std::make_move_iterator(parsed.torrents.begin()), std::make_move_iterator(parsed.torrents.end()));
+	Utils::Logger::debug("search", "Parsed " + std::to_string(parser.parsedCount()) + " search results");
 	return Result::Success();
 }
 
+Result SearchEngine::parseSearchResponse(const std::string &response, SearchResponse &searchResponse)
+{
+	TorrentsCsvParser parser(searchResponse, true);
+	parser.feed(response);
+	Result result = parser.finish();
+	if (!result)
+	{
+		parser.reset();
+		return result;
+	}
+	Utils::Logger::debug("search", "Parsed " + std::to_string(searchResponse.torrents.size()) + " search results");
+	if (searchResponse.hasMore)
+		Utils::Logger::debug("search", "More results available with next token");
+	return Result::Success();
+}
+
+Result SearchEngine::parseTorznabResponse(const std::string &response, SearchResponse &searchResponse)
+{
+	TorznabParser parser(searchResponse);
+	parser.feed(response);
+	return parser.finish();
+}
+
 void SearchEngine::addToSearchHistory(const std::string &query)
 {
 	if (query.empty())
 		return;
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(historyMutex);
 	// Remove if already exists to move to front
 	auto it = std::find(searchHistory.begin(), searchHistory.end(), query);
@@ -887,22 +1017,27 @@ void SearchEngine::addToSearchHistory(const std::string &query)
 	{
 		searchHistory.resize(20);
 	}
+	historyRevision++;
 }
 
 std::vector<std::string> SearchEngine::getSearchHistory() const
 {
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(historyMutex);
 	return searchHistory;
 }
 
 void SearchEngine::clearSearchHistory()
 {
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(historyMutex);
 	searchHistory.clear();
+	historyRevision++;
 }
 
 void SearchEngine::addToFavorites(const TorrentSearchResult &result)
 {
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(favoritesMutex);
 
 	// Check if already in favorites using the set (O(1))
@@ -911,21 +1046,24 @@ void SearchEngine::addToFavorites(const TorrentSearchResult &result)
 		favorites.push_back(result);
 		favoriteHashes.insert(result.infoHash);
 		favoritesRevision++;
+		localIndex->setFavorite(result, true);
 	}
 }
 
 void SearchEngine::removeFromFavorites(const std::string &infoHash)
 {
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(favoritesMutex);
 
 	auto initialSize = favorites.size();
-	favorites.erase(
-		std::remove_if(favorites.begin(), favorites.end(),
-					   [&infoHash](const TorrentSearchResult &fav)
-					   {
-						   return fav.infoHash == infoHash;
-					   }),
-		favorites.end());
+	auto removed = std::stable_partition(favorites.begin(), favorites.end(),
+		[&infoHash](const TorrentSearchResult &fav)
+		{
+			return fav.infoHash != infoHash;
+		});
+	for (auto it = removed; it != favorites.end(); ++it)
+		localIndex->setFavorite(*it, false);
+	favorites.erase(removed, favorites.end());
 
 	favoriteHashes.erase(infoHash);
 	if (favorites.size() != initialSize)
@@ -936,43 +1074,77 @@ void SearchEngine::removeFromFavorites(const std::string &infoHash)
 
 std::vector<TorrentSearchResult> SearchEngine::getFavorites() const
 {
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(favoritesMutex);
 	return favorites;
 }
 
+uint64_t SearchEngine::getFavoritesRevision() const
+{
+	ensureFavoritesLoaded();
+	return favoritesRevision;
+}
+
 bool SearchEngine::isFavorite(const std::string &infoHash) const
 {
+	ensureFavoritesLoaded();
 	std::lock_guard<std::mutex> lock(favoritesMutex);
 	return favoriteHashes.find(infoHash) != favoriteHashes.end();
 }
 
-void SearchEngine::saveFavoritesAndHistory(ConfigManager &configManager)
+void SearchEngine::attachFavoritesStore(ConfigManager &configManager, std::string path)
 {
-	std::vector<TorrentSearchResult> favoritesSnapshot;
-	std::vector<std::string> historySnapshot;
-	{
-		std::scoped_lock lock(favoritesMutex, historyMutex);
-		favoritesSnapshot = favorites;
-		historySnapshot = searchHistory;
-	}
-	configManager.saveFavoritesAndHistory(favoritesSnapshot, historySnapshot);
+	std::lock_guard<std::mutex> lock(favoritesStoreMutex);
+	favoritesStore = &configManager;
+	favoritesPath = std::move(path);
+	favoritesLoaded = false;
 }
 
-void SearchEngine::loadFavoritesAndHistory(ConfigManager &configManager)
+void SearchEngine::ensureFavoritesLoaded() const
 {
+	std::lock_guard<std::mutex> lock(favoritesStoreMutex);
+	if (favoritesLoaded || !favoritesStore)
+		return;
+	favoritesLoaded = true;
+
 	std::vector<TorrentSearchResult> favoritesSnapshot;
 	std::vector<std::string> historySnapshot;
-	configManager.loadFavoritesAndHistory(favoritesSnapshot, historySnapshot);
-	std::scoped_lock lock(favoritesMutex, historyMutex);
+	Result result = favoritesStore->loadFavoritesAndHistory(favoritesPath, favoritesSnapshot, historySnapshot);
+	if (!result)
+		Utils::Logger::warning("search", "Favorites were not loaded: " + result.message);
+
+	std::scoped_lock dataLock(favoritesMutex, historyMutex);
 	favorites = std::move(favoritesSnapshot);
 	searchHistory = std::move(historySnapshot);
-
 	favoriteHashes.clear();
 	for (const auto &fav : favorites)
 	{
 		favoriteHashes.insert(fav.infoHash);
 	}
-	favoritesRevision++;
+	savedFavoritesRevision = ++favoritesRevision;
+	savedHistoryRevision = historyRevision;
+}
+
+void SearchEngine::saveFavoritesAndHistory()
+{
+	std::vector<TorrentSearchResult> favoritesSnapshot;
+	std::vector<std::string> historySnapshot;
+	std::lock_guard<std::mutex> lock(favoritesStoreMutex);
+	// Nothing can have changed before the store was read.
+	if (!favoritesLoaded || !favoritesStore)
+		return;
+	{
+		std::scoped_lock dataLock(favoritesMutex, historyMutex);
+		const uint64_t favoritesVersion = favoritesRevision;
+		const uint64_t historyVersion = historyRevision;
+		if (favoritesVersion == savedFavoritesRevision && historyVersion == savedHistoryRevision)
+			return;
+		favoritesSnapshot = favorites;
+		historySnapshot = searchHistory;
+		savedFavoritesRevision = favoritesVersion;
+		savedHistoryRevision = historyVersion;
+	}
+	favoritesStore->saveFavoritesAndHistory(favoritesPath, std::move(favoritesSnapshot), std::move(historySnapshot));
 }
 
 void SearchEngine::setApiUrl(const std::string &url)
@@ -1034,7 +1206,12 @@ bool SearchEngine::isSearching() const
 void SearchEngine::cancelCurrentSearch()
 {
 	if (searching.load())
+	{
 		cancelRequested = true;
+		httpClient->wakeWaiters();
+		std::lock_guard<std::mutex> lock(prefetchMutex);
+		prefetchChanged.notify_all();
+	}
 }
 
 bool SearchEngine::tryStartSearch()
@@ -1061,20 +1238,9 @@ Result SearchEngine::startSearch(const SearchQuery &query, uint64_t &requestId)
 	if (!tryStartSearch())
 		return Result::Failure("Search already in progress", ResultCode::Busy);
 
-	std::thread previousThread;
-	{
-		std::lock_guard<std::mutex> lock(threadMutex);
-		previousThread = std::move(searchThread);
-	}
-	if (previousThread.joinable())
-		previousThread.join();
-
 	requestId = nextRequestId.fetch_add(1);
 	const uint64_t workerRequestId = requestId;
-	std::thread worker;
-	try
-	{
-		worker = std::thread([this, query, workerRequestId]()
+	Result queued = post([this, query, workerRequestId]()
 	{
 		SearchResponse response;
 		Result result = Result::Failure("Unknown error");
@@ -1087,7 +1253,11 @@ Result SearchEngine::startSearch(const SearchQuery &query, uint64_t &requestId)
 			}
 			else
 			{
-				Result httpResult = performSearch(query, response);
+				Result httpResult = performSearch(query, response, [this, workerRequestId](std::vector<TorrentSearchResult> &&torrents)
+				{
+					if (!cancelRequested.load())
+						searchBatches.tryPush(SearchBatch{workerRequestId, std::move(torrents)});
+				});
 				if (cancelRequested.load())
 					result = Result::Failure("Search cancelled", ResultCode::Cancelled);
 				else
@@ -1115,17 +1285,17 @@ Result SearchEngine::startSearch(const SearchQuery &query, uint64_t &requestId)
 		}
 		finishSearch();
 	});
-	}
-	catch (const std::exception &e)
-	{
+	if (!queued)
 		finishSearch();
-		return Result::Failure("Failed to start search worker: " + std::string(e.what()), ResultCode::Internal);
-	}
-	{
-		std::lock_guard<std::mutex> lock(threadMutex);
-		searchThread = std::move(worker);
-	}
-	return Result::Success();
+	return queued;
+}
+
+std::optional<SearchBatch> SearchEngine::takeSearchBatch()
+{
+	SearchBatch batch;
+	if (!searchBatches.tryPop(batch))
+		return std::nullopt;
+	return batch;
 }
 
 std::optional<CompletedSearch> SearchEngine::takeCompletedSearch()
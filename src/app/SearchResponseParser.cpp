@@ -0,0 +1,1155 @@
+#include "SearchResponseParser.hpp"
+#include "utils/StringUtils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+
+bool normalizeInfoHash(std::string &hash)
+{
+	if (hash.size() != 40 && hash.size() != 64)
+		return false;
+	for (char &character : hash)
+	{
+		if (!std::isxdigit(static_cast<unsigned char>(character)))
+			return false;
+		character = static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
+	}
+	return true;
+}
+
+namespace
+{
+bool isWhitespace(char character)
+{
+	return character == ' ' || character == '\t' || character == '\n' || character == '\r';
+}
+
+bool isDigit(char character)
+{
+	return character >= '0' && character <= '9';
+}
+
+bool isNumberCharacter(char character)
+{
+	return isDigit(character) || character == '-' || character == '+' || character == '.' || character == 'e' || character == 'E';
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+bool isValidNumber(std::string_view text)
+{
+	std::size_t index = 0;
+	auto digits = [&]()
+	{
+		const std::size_t start = index;
+		while (index < text.size() && isDigit(text[index]))
+			++index;
+		return index > start;
+	};
+	if (index < text.size() && text[index] == '-')
+		++index;
+	if (index < text.size() && text[index] == '0')
+		++index;
+	else if (!digits())
+		return false;
+	if (index < text.size() && text[index] == '.')
+	{
+		++index;
+		if (!digits())
+			return false;
+	}
+	if (index < text.size() && (text[index] == 'e' || text[index] == 'E'))
+	{
+		++index;
+		if (index < text.size() && (text[index] == '+' || text[index] == '-'))
+			++index;
+		if (!digits())
+			return false;
+	}
+	return index == text.size();
+}
+
+// Integers only, as in the API; fractions, negatives, and values too large
+// for 64 bits read as 0.
+uint64_t nonNegativeInteger(std::string_view text, uint64_t maximum)
+{
+	if (text.empty() || text.front() == '-' || text.find_first_of(".eE") != std::string_view::npos)
+		return 0;
+	uint64_t value = 0;
+	for (const char character : text)
+	{
+		const auto digit = static_cast<uint64_t>(character - '0');
+		if (value > (UINT64_MAX - digit) / 10)
+			return 0;
+		value = value * 10 + digit;
+	}
+	return std::min(value, maximum);
+}
+
+void appendUtf8(std::string &output, uint32_t codePoint)
+{
+	if (codePoint < 0x80)
+		output.push_back(static_cast<char>(codePoint));
+	else if (codePoint < 0x800)
+	{
+		output.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+		output.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+	}
+	else if (codePoint < 0x10000)
+	{
+		output.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+		output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+		output.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+	}
+	else
+	{
+		output.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+		output.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+		output.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+		output.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+	}
+}
+}
+
+TorrentsCsvParser::TorrentsCsvParser(SearchResponse &response, bool deduplicate)
+	: response_(response),
+	  deduplicate_(deduplicate),
+	  initialSize_(response.torrents.size()),
+	  initialNextToken_(response.nextToken),
+	  initialHasMore_(response.hasMore)
+{
+	reset();
+}
+
+void TorrentsCsvParser::reset()
+{
+	response_.torrents.erase(response_.torrents.begin() + static_cast<std::ptrdiff_t>(initialSize_), response_.torrents.end());
+	response_.nextToken = initialNextToken_;
+	response_.hasMore = initialHasMore_;
+	expect_ = Expect::Value;
+	token_ = Token::None;
+	stack_.clear();
+	text_.clear();
+	escape_ = false;
+	unicodeDigits_ = -1;
+	highSurrogate_ = 0;
+	consumed_ = 0;
+	position_ = 0;
+	bomBytes_ = 0;
+	error_.clear();
+	rootKey_ = Field::Other;
+	list_ = List::None;
+	listDepth_ = 0;
+	sawList_ = false;
+	sawTorrents_ = false;
+	dataItems_.clear();
+	seenHashes_.clear();
+	if (deduplicate_)
+	{
+		for (const auto &existing : response_.torrents)
+			seenHashes_.insert(existing.infoHash);
+	}
+	parsed_ = 0;
+	inItem_ = false;
+	field_ = Field::Other;
+}
+
+bool TorrentsCsvParser::fail(std::string message)
+{
+	if (error_.empty())
+		error_ = message + " at byte " + std::to_string(position_);
+	return false;
+}
+
+bool TorrentsCsvParser::feed(std::string_view chunk)
+{
+	if (!error_.empty())
+		return false;
+	static constexpr std::string_view byteOrderMark = "\xEF\xBB\xBF";
+	std::size_t index = 0;
+	while (index < chunk.size())
+	{
+		position_ = consumed_ + index;
+		// A UTF-8 byte order mark is tolerated, as json::parse does.
+		if (position_ < byteOrderMark.size() && bomBytes_ == position_ && chunk[index] == byteOrderMark[position_])
+		{
+			++bomBytes_;
+			++index;
+			continue;
+		}
+		if (bomBytes_ != 0 && bomBytes_ < byteOrderMark.size())
+			return fail("incomplete byte order mark");
+		if (token_ == Token::String)
+		{
+			if (!consumeString(chunk, index))
+				return false;
+			continue;
+		}
+		if (!step(chunk[index]))
+			return false;
+		++index;
+	}
+	consumed_ += chunk.size();
+	return true;
+}
+
+bool TorrentsCsvParser::step(char character)
+{
+	if (token_ == Token::Number)
+	{
+		if (isNumberCharacter(character))
+		{
+			text_.push_back(character);
+			return true;
+		}
+		if (!endNumber())
+			return false;
+	}
+	else if (token_ == Token::Literal)
+	{
+		if (character >= 'a' && character <= 'z')
+		{
+			text_.push_back(character);
+			return true;
+		}
+		if (!endLiteral())
+			return false;
+	}
+	if (isWhitespace(character))
+		return true;
+
+	switch (expect_)
+	{
+	case Expect::FirstValueOrEnd:
+		if (character == ']')
+			return closeContainer(character);
+		[[fallthrough]];
+	case Expect::Value:
+		if (character == '{' || character == '[')
+			return openContainer(character);
+		text_.clear();
+		if (character == '"')
+		{
+			token_ = Token::String;
+			stringIsKey_ = false;
+			return true;
+		}
+		if (character == '-' || isDigit(character))
+		{
+			token_ = Token::Number;
+			text_.push_back(character);
+			return true;
+		}
+		if (character >= 'a' && character <= 'z')
+		{
+			token_ = Token::Literal;
+			text_.push_back(character);
+			return true;
+		}
+		return fail("unexpected character");
+	case Expect::FirstKeyOrEnd:
+		if (character == '}')
+			return closeContainer(character);
+		[[fallthrough]];
+	case Expect::Key:
+		if (character != '"')
+			return fail("expected an object key");
+		text_.clear();
+		token_ = Token::String;
+		stringIsKey_ = true;
+		return true;
+	case Expect::Colon:
+		if (character != ':')
+			return fail("expected ':'");
+		expect_ = Expect::Value;
+		return true;
+	case Expect::CommaOrEnd:
+		if (character == ',')
+		{
+			expect_ = stack_.back() == '{' ? Expect::Key : Expect::Value;
+			return true;
+		}
+		if (character == '}' || character == ']')
+			return closeContainer(character);
+		return fail("expected ',' or a closing bracket");
+	case Expect::Done:
+		return fail("unexpected content after the document");
+	}
+	return fail("unexpected character");
+}
+
+bool TorrentsCsvParser::consumeString(std::string_view chunk, std::size_t &index)
+{
+	while (index < chunk.size())
+	{
+		position_ = consumed_ + index;
+		const char character = chunk[index];
+		if (unicodeDigits_ >= 0)
+		{
+			const int digit = std::isxdigit(static_cast<unsigned char>(character))
+				? (isDigit(character) ? character - '0' : (std::tolower(static_cast<unsigned char>(character)) - 'a' + 10))
+				: -1;
+			if (digit < 0)
+				return fail("invalid \\u escape");
+			unicodeValue_ = (unicodeValue_ << 4) | static_cast<uint32_t>(digit);
+			++index;
+			if (++unicodeDigits_ < 4)
+				continue;
+			unicodeDigits_ = -1;
+			if (highSurrogate_ != 0)
+			{
+				if (unicodeValue_ < 0xDC00 || unicodeValue_ > 0xDFFF)
+					return fail("unpaired UTF-16 surrogate");
+				appendUtf8(text_, 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (unicodeValue_ - 0xDC00));
+				highSurrogate_ = 0;
+			}
+			else if (unicodeValue_ >= 0xD800 && unicodeValue_ <= 0xDBFF)
+				highSurrogate_ = unicodeValue_;
+			else if (unicodeValue_ >= 0xDC00 && unicodeValue_ <= 0xDFFF)
+				return fail("unpaired UTF-16 surrogate");
+			else
+				appendUtf8(text_, unicodeValue_);
+			continue;
+		}
+		if (escape_)
+		{
+			escape_ = false;
+			++index;
+			if (character == 'u')
+			{
+				unicodeDigits_ = 0;
+				unicodeValue_ = 0;
+				continue;
+			}
+			if (highSurrogate_ != 0)
+				return fail("unpaired UTF-16 surrogate");
+			switch (character)
+			{
+			case '"': text_.push_back('"'); break;
+			case '\\': text_.push_back('\\'); break;
+			case '/': text_.push_back('/'); break;
+			case 'b': text_.push_back('\b'); break;
+			case 'f': text_.push_back('\f'); break;
+			case 'n': text_.push_back('\n'); break;
+			case 'r': text_.push_back('\r'); break;
+			case 't': text_.push_back('\t'); break;
+			default: return fail("invalid escape");
+			}
+			continue;
+		}
+
+		// Copies the plain run up to the next quote, escape, or control
+		// character in one go.
+		std::size_t end = index;
+		while (end < chunk.size() && chunk[end] != '"' && chunk[end] != '\\' && static_cast<unsigned char>(chunk[end]) >= 0x20)
+			++end;
+		if (end > index)
+		{
+			if (highSurrogate_ != 0)
+				return fail("unpaired UTF-16 surrogate");
+			text_.append(chunk.data() + index, end - index);
+			index = end;
+			continue;
+		}
+		if (character == '\\')
+		{
+			escape_ = true;
+			++index;
+			continue;
+		}
+		if (character != '"')
+			return fail("control character in string");
+		if (highSurrogate_ != 0)
+			return fail("unpaired UTF-16 surrogate");
+		++index;
+		token_ = Token::None;
+		if (stringIsKey_)
+		{
+			onKey();
+			expect_ = Expect::Colon;
+			return true;
+		}
+		onScalar(Kind::String);
+		return endValue();
+	}
+	return true;
+}
+
+bool TorrentsCsvParser::endNumber()
+{
+	token_ = Token::None;
+	if (!isValidNumber(text_))
+		return fail("invalid number");
+	onScalar(Kind::Number);
+	return endValue();
+}
+
+bool TorrentsCsvParser::endLiteral()
+{
+	token_ = Token::None;
+	if (text_ == "true" || text_ == "false")
+		onScalar(Kind::Boolean);
+	else if (text_ == "null")
+		onScalar(Kind::Null);
+	else
+		return fail("invalid literal");
+	return endValue();
+}
+
+bool TorrentsCsvParser::endValue()
+{
+	expect_ = stack_.empty() ? Expect::Done : Expect::CommaOrEnd;
+	return true;
+}
+
+bool TorrentsCsvParser::openContainer(char type)
+{
+	const std::size_t depth = stack_.size();
+	if (inItem_ && depth == listDepth_ + 1)
+		applyField(Kind::Container);
+	else if (list_ != List::None && depth == listDepth_)
+	{
+		if (type == '{')
+			beginItem();
+	}
+	else if (depth == 0 && type == '[')
+	{
+		list_ = List::Torrents;
+		listDepth_ = 1;
+		sawList_ = sawTorrents_ = true;
+	}
+	else if (depth == 1 && stack_[0] == '{' && type == '[' && (rootKey_ == Field::Torrents || rootKey_ == Field::Data))
+	{
+		list_ = rootKey_ == Field::Torrents ? List::Torrents : List::Data;
+		listDepth_ = 2;
+		sawList_ = true;
+		sawTorrents_ = sawTorrents_ || list_ == List::Torrents;
+	}
+	stack_.push_back(type);
+	expect_ = type == '{' ? Expect::FirstKeyOrEnd : Expect::FirstValueOrEnd;
+	return true;
+}
+
+bool TorrentsCsvParser::closeContainer(char type)
+{
+	if (stack_.empty() || stack_.back() != (type == '}' ? '{' : '['))
+		return fail("mismatched closing bracket");
+	stack_.pop_back();
+	const std::size_t depth = stack_.size();
+	if (inItem_ && depth == listDepth_)
+		endItem();
+	else if (list_ != List::None && depth + 1 == listDepth_)
+		list_ = List::None;
+	return endValue();
+}
+
+void TorrentsCsvParser::onKey()
+{
+	const std::size_t depth = stack_.size();
+	if (inItem_ && depth == listDepth_ + 1)
+	{
+		if (text_ == "name")
+			field_ = Field::Name;
+		else if (text_ == "infohash")
+			field_ = Field::InfoHash;
+		else if (text_ == "size_bytes")
+			field_ = Field::SizeBytes;
+		else if (text_ == "seeders")
+			field_ = Field::Seeders;
+		else if (text_ == "leechers")
+			field_ = Field::Leechers;
+		else if (text_ == "created_unix")
+			field_ = Field::CreatedUnix;
+		else if (text_ == "scraped_date")
+			field_ = Field::ScrapedDate;
+		else if (text_ == "completed")
+			field_ = Field::Completed;
+		else
+			field_ = Field::Other;
+	}
+	else if (depth == 1 && stack_[0] == '{')
+	{
+		if (text_ == "torrents")
+			rootKey_ = Field::Torrents;
+		else if (text_ == "data")
+			rootKey_ = Field::Data;
+		else if (text_ == "next")
+			rootKey_ = Field::Next;
+		else
+			rootKey_ = Field::Other;
+	}
+}
+
+void TorrentsCsvParser::onScalar(Kind kind)
+{
+	const std::size_t depth = stack_.size();
+	if (inItem_ && depth == listDepth_ + 1)
+	{
+		applyField(kind);
+		return;
+	}
+	if (depth != 1 || stack_[0] != '{' || rootKey_ != Field::Next)
+		return;
+	if (kind == Kind::Number)
+	{
+		const bool integral = text_.find_first_of(".eE") == std::string::npos;
+		const long long value = integral
+			? std::strtoll(text_.c_str(), nullptr, 10)
+			: static_cast<long long>(std::strtod(text_.c_str(), nullptr));
+		response_.nextToken = std::to_string(value);
+		response_.hasMore = true;
+	}
+	else if (kind == Kind::String)
+	{
+		response_.nextToken = text_;
+		response_.hasMore = !response_.nextToken.empty();
+	}
+}
+
+void TorrentsCsvParser::applyField(Kind kind)
+{
+	const bool number = kind == Kind::Number;
+	switch (field_)
+	{
+	case Field::Name:
+		nameValid_ = kind == Kind::String;
+		if (nameValid_)
+			item_.name.swap(text_);
+		break;
+	case Field::InfoHash:
+		hashValid_ = kind == Kind::String;
+		if (hashValid_)
+			item_.infoHash.swap(text_);
+		break;
+	case Field::SizeBytes:
+		item_.sizeBytes = static_cast<size_t>(number ? nonNegativeInteger(text_, SIZE_MAX) : 0);
+		break;
+	case Field::Seeders:
+		item_.seeders = static_cast<int>(number ? nonNegativeInteger(text_, INT_MAX) : 0);
+		break;
+	case Field::Leechers:
+		item_.leechers = static_cast<int>(number ? nonNegativeInteger(text_, INT_MAX) : 0);
+		break;
+	case Field::CreatedUnix:
+		hasCreated_ = true;
+		item_.createdUnix = static_cast<int64_t>(number ? nonNegativeInteger(text_, INT64_MAX) : 0);
+		break;
+	case Field::ScrapedDate:
+		item_.scrapedDate = static_cast<int64_t>(number ? nonNegativeInteger(text_, INT64_MAX) : 0);
+		break;
+	case Field::Completed:
+		item_.completed = static_cast<int>(number ? nonNegativeInteger(text_, INT_MAX) : 0);
+		break;
+	default:
+		break;
+	}
+}
+
+void TorrentsCsvParser::beginItem()
+{
+	inItem_ = true;
+	field_ = Field::Other;
+	item_ = TorrentSearchResult{};
+	nameValid_ = false;
+	hashValid_ = false;
+	hasCreated_ = false;
+}
+
+void TorrentsCsvParser::endItem()
+{
+	inItem_ = false;
+	if (!nameValid_ || !hashValid_ || !normalizeInfoHash(item_.infoHash))
+		return;
+	item_.magnetUri = Utils::formatMagnetUri(item_.infoHash, item_.name);
+	// created_unix doubles as the displayed upload date.
+	item_.dateUploaded = hasCreated_ && item_.createdUnix != 0 ? std::to_string(item_.createdUnix) : std::string();
+	if (!hasCreated_)
+		item_.createdUnix = 0;
+	// Category is often not present in torrents-csv.
+	item_.category = "General";
+	if (list_ == List::Data)
+		dataItems_.push_back(std::move(item_));
+	else
+		emit(std::move(item_));
+}
+
+void TorrentsCsvParser::emit(TorrentSearchResult &&result)
+{
+	if (deduplicate_ && !seenHashes_.insert(result.infoHash).second)
+		return;
+	response_.torrents.push_back(std::move(result));
+	++parsed_;
+}
+
+Result TorrentsCsvParser::finish()
+{
+	position_ = consumed_;
+	if (error_.empty())
+	{
+		if (token_ == Token::Number)
+			endNumber();
+		else if (token_ == Token::Literal)
+			endLiteral();
+		else if (token_ == Token::String)
+			fail("unterminated string");
+	}
+	if (error_.empty() && expect_ != Expect::Done)
+		fail(consumed_ == 0 ? "empty input" : "unexpected end of input");
+	if (!error_.empty())
+		return Result::Failure("JSON Parse Error: " + error_, ResultCode::Parse);
+	if (!sawList_)
+		return Result::Failure("Invalid response format: no torrent data found", ResultCode::Parse);
+
+	// A "data" list only counts when there is no "torrents" list.
+	if (!sawTorrents_)
+	{
+		for (auto &item : dataItems_)
+			emit(std::move(item));
+	}
+	dataItems_.clear();
+	return Result::Success();
+}
+
+namespace
+{
+bool isXmlSpace(char character)
+{
+	return character == ' ' || character == '\t' || character == '\n' || character == '\r';
+}
+
+// Decimal digits only, after optional leading spaces and '+'; anything else
+// reads as 0.
+long long parseNonNegative(std::string_view value)
+{
+	while (!value.empty() && isXmlSpace(value.front()))
+		value.remove_prefix(1);
+	if (!value.empty() && value.front() == '+')
+		value.remove_prefix(1);
+	if (value.empty() || value.size() > 18)
+		return 0;
+	long long parsed = 0;
+	for (const char character : value)
+	{
+		if (!isDigit(character))
+			return 0;
+		parsed = parsed * 10 + (character - '0');
+	}
+	return parsed;
+}
+}
+
+TorznabParser::TorznabParser(SearchResponse &response)
+	: response_(response)
+{
+	reset();
+}
+
+void TorznabParser::reset()
+{
+	response_ = SearchResponse{};
+	state_ = State::Text;
+	name_.clear();
+	markup_.clear();
+	entity_.clear();
+	inEntity_ = false;
+	pendingBrackets_ = 0;
+	pendingDashes_ = 0;
+	previous_ = 0;
+	attributeCount_ = 0;
+	consumed_ = 0;
+	depth_ = 0;
+	errorSeen_ = false;
+	errorDescription_.clear();
+	pageSeen_ = false;
+	offset_ = 0;
+	total_ = 0;
+	inItem_ = false;
+	capture_ = Field::None;
+	seenHashes_.clear();
+}
+
+bool TorznabParser::feed(std::string_view chunk)
+{
+	std::size_t index = 0;
+	// Advances over a run of bytes the current state treats alike and
+	// returns it, so most of the feed is handled by find and append.
+	auto run = [&](auto stop)
+	{
+		std::size_t end = index;
+		while (end < chunk.size() && !stop(chunk[end]))
+			++end;
+		const std::string_view span = chunk.substr(index, end - index);
+		index = end;
+		return span;
+	};
+	while (index < chunk.size() && !errorSeen_)
+	{
+		switch (state_)
+		{
+		case State::Text:
+			if (inEntity_)
+				break;
+			// Text outside the captured fields is skipped wholesale.
+			if (capture_ == Field::None)
+			{
+				const auto tag = chunk.find('<', index);
+				index = tag == std::string_view::npos ? chunk.size() : tag;
+			}
+			else
+				fields_[static_cast<std::size_t>(capture_)] += run([](char c) { return c == '<' || c == '&'; });
+			break;
+		case State::TagName:
+			name_ += run([](char c) { return c == '>' || c == '/' || isXmlSpace(c); });
+			break;
+		case State::EndTagName:
+			name_ += run([](char c) { return c == '>' || isXmlSpace(c); });
+			break;
+		case State::AttributeValue:
+			if (!inEntity_)
+				attributes_[attributeCount_ - 1].second += run([this](char c) { return c == quote_ || c == '&'; });
+			break;
+		case State::IgnoredAttributes:
+			if (quote_ != 0)
+				run([this](char c) { return c == quote_; });
+			else
+			{
+				const auto found = chunk.find_first_of("\"'>", index);
+				const std::size_t end = found == std::string_view::npos ? chunk.size() : found;
+				// Only the last byte before '>' matters, for "/>".
+				for (std::size_t position = end; position > index; --position)
+				{
+					if (!isXmlSpace(chunk[position - 1]))
+					{
+						previous_ = chunk[position - 1];
+						break;
+					}
+				}
+				index = end;
+			}
+			break;
+		default:
+			break;
+		}
+		if (index < chunk.size())
+			consume(chunk[index++]);
+	}
+	consumed_ += chunk.size();
+	return !errorSeen_;
+}
+
+void TorznabParser::flushEntity(std::string &output)
+{
+	inEntity_ = false;
+	const std::string_view entity = entity_;
+	uint32_t codePoint = 0;
+	bool numeric = false;
+	if (entity.size() > 1 && entity[0] == '#')
+	{
+		const bool hex = entity[1] == 'x' || entity[1] == 'X';
+		const std::string_view digits = entity.substr(hex ? 2 : 1);
+		numeric = !digits.empty() && digits.size() <= 6;
+		for (const char character : digits)
+		{
+			const int digit = isDigit(character) ? character - '0'
+				: hex && std::isxdigit(static_cast<unsigned char>(character)) ? std::tolower(static_cast<unsigned char>(character)) - 'a' + 10
+				: -1;
+			if (digit < 0)
+			{
+				numeric = false;
+				break;
+			}
+			codePoint = codePoint * (hex ? 16 : 10) + static_cast<uint32_t>(digit);
+		}
+		numeric = numeric && codePoint != 0 && codePoint <= 0x10FFFF && (codePoint < 0xD800 || codePoint > 0xDFFF);
+	}
+	if (numeric)
+		appendUtf8(output, codePoint);
+	else if (entity == "amp")
+		output.push_back('&');
+	else if (entity == "lt")
+		output.push_back('<');
+	else if (entity == "gt")
+		output.push_back('>');
+	else if (entity == "quot")
+		output.push_back('"');
+	else if (entity == "apos")
+		output.push_back('\'');
+	else
+	{
+		// Unknown entities are kept as written.
+		output.push_back('&');
+		output += entity;
+		output.push_back(';');
+	}
+	entity_.clear();
+}
+
+void TorznabParser::abandonEntity(std::string &output)
+{
+	// Not an entity after all; keep the text as written.
+	inEntity_ = false;
+	output.push_back('&');
+	output += entity_;
+	entity_.clear();
+}
+
+void TorznabParser::appendDecoded(std::string &output, char character)
+{
+	if (inEntity_)
+	{
+		if (character == ';')
+			return flushEntity(output);
+		if (entity_.size() < 10 && !isXmlSpace(character) && character != '&' && character != '<')
+		{
+			entity_.push_back(character);
+			return;
+		}
+		abandonEntity(output);
+	}
+	if (character == '&')
+		inEntity_ = true;
+	else
+		output.push_back(character);
+}
+
+void TorznabParser::consume(char character)
+{
+	switch (state_)
+	{
+	case State::Text:
+		if (character == '<')
+		{
+			if (inEntity_)
+				abandonEntity(fields_[static_cast<std::size_t>(capture_)]);
+			state_ = State::Markup;
+		}
+		else if (capture_ != Field::None)
+			appendDecoded(fields_[static_cast<std::size_t>(capture_)], character);
+		return;
+	case State::Markup:
+		if (character == '/')
+		{
+			name_.clear();
+			state_ = State::EndTagName;
+		}
+		else if (character == '?')
+		{
+			previous_ = 0;
+			state_ = State::Instruction;
+		}
+		else if (character == '!')
+		{
+			markup_.clear();
+			state_ = State::Declaration;
+		}
+		else
+		{
+			name_.assign(1, character);
+			attributeCount_ = 0;
+			state_ = State::TagName;
+		}
+		return;
+	case State::Declaration:
+		markup_.push_back(character);
+		if (markup_ == "--")
+		{
+			pendingDashes_ = 0;
+			state_ = State::Comment;
+		}
+		else if (markup_ == "[CDATA[")
+		{
+			pendingBrackets_ = 0;
+			state_ = State::CData;
+		}
+		else if (std::string_view("--").substr(0, markup_.size()) != markup_
+			&& std::string_view("[CDATA[").substr(0, markup_.size()) != markup_)
+			state_ = character == '>' ? State::Text : State::Skip;
+		return;
+	case State::Comment:
+		if (character == '>' && pendingDashes_ >= 2)
+			state_ = State::Text;
+		pendingDashes_ = character == '-' ? pendingDashes_ + 1 : 0;
+		return;
+	case State::CData:
+		if (character == ']')
+		{
+			++pendingBrackets_;
+			return;
+		}
+		if (character == '>' && pendingBrackets_ >= 2)
+		{
+			pendingBrackets_ -= 2;
+			state_ = State::Text;
+		}
+		if (capture_ != Field::None)
+		{
+			std::string &output = fields_[static_cast<std::size_t>(capture_)];
+			output.append(static_cast<std::size_t>(pendingBrackets_), ']');
+			if (state_ == State::CData)
+				output.push_back(character);
+		}
+		pendingBrackets_ = 0;
+		return;
+	case State::Instruction:
+		if (character == '>' && previous_ == '?')
+			state_ = State::Text;
+		previous_ = character;
+		return;
+	case State::Skip:
+		if (character == '>')
+			state_ = State::Text;
+		return;
+	case State::TagName:
+		if (character == '>')
+			startElement(false);
+		else if (character == '/')
+			state_ = State::SelfClose;
+		else if (isXmlSpace(character))
+		{
+			// Only these elements carry attributes the parser reads.
+			if (name_ == "torznab:attr" || name_ == "newznab:response" || name_ == "error")
+				state_ = State::Attributes;
+			else
+			{
+				quote_ = 0;
+				previous_ = 0;
+				state_ = State::IgnoredAttributes;
+			}
+		}
+		else
+			name_.push_back(character);
+		return;
+	case State::IgnoredAttributes:
+		if (quote_ != 0)
+		{
+			if (character == quote_)
+				quote_ = 0;
+			previous_ = character;
+		}
+		else if (character == '"' || character == '\'')
+		{
+			quote_ = character;
+			previous_ = character;
+		}
+		else if (character == '>')
+			startElement(previous_ == '/');
+		else if (!isXmlSpace(character))
+			previous_ = character;
+		return;
+	case State::EndTagName:
+		if (character == '>')
+			endElement();
+		else if (!isXmlSpace(character))
+			name_.push_back(character);
+		return;
+	case State::Attributes:
+		if (character == '>')
+			startElement(false);
+		else if (character == '/')
+			state_ = State::SelfClose;
+		else if (!isXmlSpace(character))
+		{
+			if (attributeCount_ == attributes_.size())
+				attributes_.emplace_back();
+			auto &[attributeName, value] = attributes_[attributeCount_++];
+			attributeName.assign(1, character);
+			value.clear();
+			state_ = State::AttributeName;
+		}
+		return;
+	case State::AttributeName:
+		if (character == '=')
+			state_ = State::BeforeValue;
+		else if (character == '>')
+			startElement(false);
+		else if (!isXmlSpace(character))
+			attributes_[attributeCount_ - 1].first.push_back(character);
+		return;
+	case State::BeforeValue:
+		if (character == '"' || character == '\'')
+		{
+			quote_ = character;
+			state_ = State::AttributeValue;
+		}
+		else if (character == '>')
+			startElement(false);
+		else if (!isXmlSpace(character))
+			state_ = State::Attributes;
+		return;
+	case State::AttributeValue:
+	{
+		std::string &value = attributes_[attributeCount_ - 1].second;
+		if (character == quote_)
+		{
+			if (inEntity_)
+				abandonEntity(value);
+			state_ = State::Attributes;
+		}
+		else
+			appendDecoded(value, character);
+		return;
+	}
+	case State::SelfClose:
+		if (character == '>')
+			startElement(true);
+		else
+			state_ = State::Attributes;
+		return;
+	}
+}
+
+std::string_view TorznabParser::attribute(std::string_view name) const
+{
+	for (std::size_t index = 0; index < attributeCount_; ++index)
+	{
+		if (attributes_[index].first == name)
+			return attributes_[index].second;
+	}
+	return {};
+}
+
+void TorznabParser::startElement(bool selfClosing)
+{
+	state_ = State::Text;
+	const std::size_t depth = depth_;
+	if (!selfClosing)
+		++depth_;
+
+	if (name_ == "error")
+	{
+		errorSeen_ = true;
+		errorDescription_ = attribute("description");
+		return;
+	}
+	if (name_ == "newznab:response" && !pageSeen_)
+	{
+		pageSeen_ = true;
+		offset_ = parseNonNegative(attribute("offset"));
+		total_ = parseNonNegative(attribute("total"));
+		return;
+	}
+	if (name_ == "item")
+	{
+		if (inItem_ || response_.torrents.size() >= MAX_RESULTS)
+			return;
+		inItem_ = true;
+		itemDepth_ = depth;
+		for (std::size_t index = 0; index < static_cast<std::size_t>(Field::Count); ++index)
+		{
+			fields_[index].clear();
+			fieldSeen_[index] = false;
+		}
+		if (selfClosing)
+			endItem();
+		return;
+	}
+	if (!inItem_)
+		return;
+
+	// The first occurrence of each field wins, as the feed lists them.
+	auto claim = [&](Field field)
+	{
+		const auto index = static_cast<std::size_t>(field);
+		if (fieldSeen_[index])
+			return false;
+		fieldSeen_[index] = true;
+		return true;
+	};
+	if (name_ == "torznab:attr")
+	{
+		const std::string_view attributeName = attribute("name");
+		Field field = Field::None;
+		if (attributeName == "infohash")
+			field = Field::InfoHash;
+		else if (attributeName == "magneturl")
+			field = Field::MagnetUri;
+		else if (attributeName == "seeders")
+			field = Field::Seeders;
+		else if (attributeName == "peers")
+			field = Field::Peers;
+		if (field != Field::None && claim(field))
+			fields_[static_cast<std::size_t>(field)] = attribute("value");
+		return;
+	}
+	if (capture_ != Field::None)
+		return;
+	Field field = Field::None;
+	if (name_ == "title")
+		field = Field::Title;
+	else if (name_ == "guid")
+		field = Field::Guid;
+	else if (name_ == "link")
+		field = Field::Link;
+	else if (name_ == "size")
+		field = Field::Size;
+	else if (name_ == "category")
+		field = Field::Category;
+	else if (name_ == "pubDate")
+		field = Field::PubDate;
+	if (field == Field::None || !claim(field) || selfClosing)
+		return;
+	capture_ = field;
+	captureDepth_ = depth;
+}
+
+void TorznabParser::endElement()
+{
+	state_ = State::Text;
+	if (depth_ > 0)
+		--depth_;
+	if (capture_ != Field::None && depth_ == captureDepth_)
+		capture_ = Field::None;
+	if (inItem_ && depth_ == itemDepth_ && name_ == "item")
+		endItem();
+}
+
+void TorznabParser::endItem()
+{
+	inItem_ = false;
+	capture_ = Field::None;
+	auto take = [this](Field field) -> std::string & { return fields_[static_cast<std::size_t>(field)]; };
+
+	TorrentSearchResult result;
+	result.name = std::move(take(Field::Title));
+	result.infoHash = std::move(take(Field::InfoHash));
+	result.magnetUri = std::move(take(Field::MagnetUri));
+	if (result.magnetUri.empty() && take(Field::Link).rfind("magnet:?", 0) == 0)
+		result.magnetUri = std::move(take(Field::Link));
+	if (result.infoHash.empty() && !result.magnetUri.empty())
+	{
+		const auto hashPosition = result.magnetUri.find("btih:");
+		if (hashPosition != std::string::npos && hashPosition + 45 <= result.magnetUri.size())
+			result.infoHash = result.magnetUri.substr(hashPosition + 5, 40);
+	}
+	if (result.infoHash.empty())
+		result.infoHash = std::move(take(Field::Guid));
+	if (result.name.empty() || !normalizeInfoHash(result.infoHash) || !seenHashes_.insert(result.infoHash).second)
+		return;
+	if (result.magnetUri.empty())
+		result.magnetUri = Utils::formatMagnetUri(result.infoHash, result.name);
+
+	result.sizeBytes = static_cast<std::size_t>(parseNonNegative(take(Field::Size)));
+	result.seeders = static_cast<int>(std::min<long long>(parseNonNegative(take(Field::Seeders)), INT_MAX));
+	result.leechers = static_cast<int>(std::min<long long>(parseNonNegative(take(Field::Peers)), INT_MAX));
+	result.category = take(Field::Category).empty() ? std::string("General") : std::move(take(Field::Category));
+	result.dateUploaded = std::move(take(Field::PubDate));
+	response_.torrents.push_back(std::move(result));
+}
+
+Result TorznabParser::finish()
+{
+	if (errorSeen_)
+		return Result::Failure(errorDescription_.empty() ? "Torznab provider returned an error" : errorDescription_, ResultCode::Unavailable);
+	if (consumed_ == 0)
+		return Result::Failure("Torznab returned an empty response", ResultCode::Parse);
+	if (inItem_)
+		return Result::Failure("Malformed Torznab item", ResultCode::Parse);
+	if (pageSeen_)
+	{
+		const long long next = offset_ + static_cast<long long>(response_.torrents.size());
+		response_.hasMore = next < total_;
+		if (response_.hasMore)
+			response_.nextToken = std::to_string(next);
+	}
+	return Result::Success();
+}
@@ -0,0 +1,386 @@
+#include "TorrentJournal.hpp"
+#include "Logger.hpp"
+#include "DurableFile.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+constexpr std::array<std::uint32_t, 256> makeCrcTable()
+{
+	std::array<std::uint32_t, 256> table{};
+	for (std::uint32_t index = 0; index < table.size(); ++index)
+	{
+		std::uint32_t value = index;
+		for (int bit = 0; bit < 8; ++bit)
+			value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+		table[index] = value;
+	}
+	return table;
+}
+
+std::uint32_t crc32(std::string_view data)
+{
+	static constexpr auto table = makeCrcTable();
+	std::uint32_t crc = 0xFFFFFFFFu;
+	for (const unsigned char byte : data)
+		crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+// A record is "<crc32 as 8 hex digits> <json payload>\n".
+std::string encodeRecord(const std::string &payload)
+{
+	char checksum[9];
+	std::snprintf(checksum, sizeof(checksum), "%08x", crc32(payload));
+	std::string record;
+	record.reserve(payload.size() + 10);
+	record.append(checksum, 8);
+	record.push_back(' ');
+	record.append(payload);
+	record.push_back('\n');
+	return record;
+}
+
+bool decodeRecord(const std::string &line, nlohmann::json &record)
+{
+	if (line.size() < 10 || line[8] != ' ')
+		return false;
+	std::uint32_t expected = 0;
+	for (std::size_t index = 0; index < 8; ++index)
+	{
+		const char character = line[index];
+		int value = -1;
+		if (character >= '0' && character <= '9') value = character - '0';
+		else if (character >= 'a' && character <= 'f') value = character - 'a' + 10;
+		if (value < 0)
+			return false;
+		expected = (expected << 4) | static_cast<std::uint32_t>(value);
+	}
+	const std::string_view payload(line.data() + 9, line.size() - 9);
+	if (crc32(payload) != expected)
+		return false;
+	record = nlohmann::json::parse(payload, nullptr, false);
+	return !record.is_discarded() && record.is_object() && record.contains("op") && record["op"].is_string();
+}
+
+// Snapshots written before the journal existed carry no keys. Derive the key
+// ConfigManager would use from the magnet so carried-over resume data still
+// matches its torrent; anything else is rekeyed by the first compaction.
+std::string legacyKey(const nlohmann::json &torrent, std::size_t index)
+{
+	const std::string magnet = torrent.contains("magnet_uri") && torrent["magnet_uri"].is_string() ? torrent["magnet_uri"].get<std::string>() : std::string();
+	auto hexAfter = [&](std::string_view marker, std::size_t length) -> std::string
+	{
+		const auto position = magnet.find(marker);
+		if (position == std::string::npos || magnet.size() < position + marker.size() + length)
+			return {};
+		std::string hex = magnet.substr(position + marker.size(), length);
+		for (char &character : hex)
+		{
+			if (!std::isxdigit(static_cast<unsigned char>(character)))
+				return {};
+			character = static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
+		}
+		return hex;
+	};
+	if (std::string key = hexAfter("xt=urn:btih:", 40); !key.empty())
+		return key;
+	if (std::string key = hexAfter("xt=urn:btmh:1220", 40); !key.empty())
+		return key;
+	return "legacy:" + std::to_string(index);
+}
+
+std::uint64_t readGeneration(const nlohmann::json &value)
+{
+	if (value.is_number_unsigned())
+		return value.get<std::uint64_t>();
+	if (value.is_number_integer() && value.get<std::int64_t>() > 0)
+		return static_cast<std::uint64_t>(value.get<std::int64_t>());
+	return 0;
+}
+
+// Length of value.dump() without building the string; restoring a large
+// snapshot would otherwise serialize every resume blob a second time.
+std::size_t serializedSize(const nlohmann::json &value)
+{
+	auto quotedSize = [](const std::string &text)
+	{
+		std::size_t size = text.size() + 2;
+		for (const unsigned char character : text)
+		{
+			if (character == '"' || character == '\\' || character == '\b' || character == '\f'
+				|| character == '\n' || character == '\r' || character == '\t')
+				size += 1;
+			else if (character < 0x20)
+				size += 5;
+		}
+		return size;
+	};
+	switch (value.type())
+	{
+	case nlohmann::json::value_t::string:
+		return quotedSize(value.get_ref<const std::string &>());
+	case nlohmann::json::value_t::object:
+	{
+		std::size_t size = 2 + (value.empty() ? 0 : value.size() - 1);
+		for (const auto &[key, member] : value.items())
+			size += quotedSize(key) + 1 + serializedSize(member);
+		return size;
+	}
+	case nlohmann::json::value_t::array:
+	{
+		std::size_t size = 2 + (value.empty() ? 0 : value.size() - 1);
+		for (const auto &element : value)
+			size += serializedSize(element);
+		return size;
+	}
+	default:
+		return value.dump().size();
+	}
+}
+
+std::string beginRecord(std::uint64_t generation)
+{
+	return encodeRecord(nlohmann::json{{"op", "begin"}, {"generation", generation}}.dump());
+}
+}
+
+std::filesystem::path TorrentJournal::journalPathFor(const std::filesystem::path &snapshotPath)
+{
+	return snapshotPath.string() + ".journal";
+}
+
+std::vector<TorrentJournal::Entry> TorrentJournal::restore(const nlohmann::json &snapshot, const std::filesystem::path &journalPath)
+{
+	std::uint64_t generation = 0;
+	std::vector<Entry> entries;
+	if (snapshot.is_object() && snapshot.contains("generation"))
+		generation = readGeneration(snapshot["generation"]);
+	if (snapshot.is_object() && snapshot.contains("torrents") && snapshot["torrents"].is_array())
+	{
+		entries.reserve(snapshot["torrents"].size());
+		for (const auto &torrent : snapshot["torrents"])
+		{
+			Entry entry{{}, torrent};
+			if (entry.value.is_object() && entry.value.contains("key") && entry.value["key"].is_string())
+			{
+				entry.key = entry.value["key"].get<std::string>();
+				entry.value.erase("key");
+			}
+			entries.push_back(std::move(entry));
+		}
+	}
+	return restore(generation, std::move(entries), journalPath);
+}
+
+std::vector<TorrentJournal::Entry> TorrentJournal::restore(std::uint64_t generation, std::vector<Entry> snapshot, const std::filesystem::path &journalPath)
+{
+	generation_ = generation;
+	order_.clear();
+	entries_.clear();
+	entries_.reserve(snapshot.size());
+	order_.reserve(snapshot.size());
+	snapshotBytes_ = 0;
+	journalBytes_ = 0;
+
+	std::size_t index = 0;
+	for (auto &torrent : snapshot)
+	{
+		++index;
+		if (!torrent.value.is_object())
+		{
+			Utils::Logger::warning("config", "Skipping a non-object torrent entry");
+			continue;
+		}
+		const std::string key = torrent.key.empty() ? legacyKey(torrent.value, index) : std::move(torrent.key);
+		const std::size_t bytes = serializedSize(torrent.value);
+		store(key, std::move(torrent.value), bytes);
+	}
+	snapshot.clear();
+	snapshot.shrink_to_fit();
+
+	needsCompaction_ = journalPath.empty() || !replay(journalPath);
+
+	std::vector<Entry> restored;
+	restored.reserve(order_.size());
+	for (const auto &key : order_)
+		restored.push_back({key, entries_.at(key).value});
+	return restored;
+}
+
+bool TorrentJournal::replay(const std::filesystem::path &journalPath)
+{
+	std::ifstream file(journalPath, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	bool begun = false;
+	std::size_t applied = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		// A final line without its newline was cut short by a crash.
+		if (file.eof())
+		{
+			Utils::Logger::warning("config", "Dropping a truncated torrent journal record after " + std::to_string(applied) + " change(s)");
+			return false;
+		}
+		nlohmann::json record;
+		if (!decodeRecord(line, record))
+		{
+			Utils::Logger::warning("config", "Torrent journal checksum mismatch; keeping the first " + std::to_string(applied) + " change(s)");
+			return false;
+		}
+		const std::string op = record["op"].get<std::string>();
+		if (!begun)
+		{
+			// A journal from another generation was superseded by a compaction
+			// that completed before its own journal could be restarted.
+			if (op != "begin" || !record.contains("generation") || readGeneration(record["generation"]) != generation_)
+			{
+				Utils::Logger::info("config", "Ignoring a torrent journal from an earlier snapshot");
+				journalBytes_ = 0;
+				return false;
+			}
+			begun = true;
+		}
+		else if (op == "put" && record.contains("key") && record["key"].is_string() && record.contains("entry") && record["entry"].is_object())
+		{
+			const std::size_t bytes = serializedSize(record["entry"]);
+			store(record["key"].get<std::string>(), std::move(record["entry"]), bytes);
+			++applied;
+		}
+		else if (op == "remove" && record.contains("key") && record["key"].is_string())
+		{
+			const std::string key = record["key"].get<std::string>();
+			if (auto found = entries_.find(key); found != entries_.end())
+			{
+				snapshotBytes_ -= found->second.bytes;
+				entries_.erase(found);
+				order_.erase(std::remove(order_.begin(), order_.end(), key), order_.end());
+			}
+			++applied;
+		}
+		else
+		{
+			Utils::Logger::warning("config", "Stopping torrent journal replay at an unknown record");
+			return false;
+		}
+		journalBytes_ += line.size() + 1;
+	}
+	if (applied > 0)
+		Utils::Logger::info("config", "Replayed " + std::to_string(applied) + " torrent journal change(s)");
+	return begun;
+}
+
+void TorrentJournal::store(const std::string &key, nlohmann::json value, std::size_t bytes)
+{
+	auto [found, inserted] = entries_.try_emplace(key);
+	if (inserted)
+		order_.push_back(key);
+	else
+		snapshotBytes_ -= found->second.bytes;
+	found->second.value = std::move(value);
+	found->second.bytes = bytes;
+	snapshotBytes_ += bytes;
+}
+
+std::optional<TorrentJournal::Write> TorrentJournal::stage(std::vector<Entry> entries)
+{
+	std::string records;
+	std::vector<std::string> order;
+	std::unordered_map<std::string, Stored> next;
+	order.reserve(entries.size());
+	next.reserve(entries.size());
+	std::uintmax_t snapshotBytes = 0;
+
+	for (auto &entry : entries)
+	{
+		if (next.find(entry.key) != next.end())
+			continue;
+		Stored stored;
+		auto previous = entries_.find(entry.key);
+		if (previous != entries_.end() && previous->second.value == entry.value)
+		{
+			stored = std::move(previous->second);
+		}
+		else
+		{
+			// Serialize the entry once; the record embeds it verbatim.
+			const std::string serialized = entry.value.dump();
+			records += encodeRecord(R"({"op":"put","key":)" + nlohmann::json(entry.key).dump() + R"(,"entry":)" + serialized + "}");
+			stored = {std::move(entry.value), serialized.size()};
+		}
+		snapshotBytes += stored.bytes;
+		order.push_back(entry.key);
+		next.emplace(std::move(entry.key), std::move(stored));
+	}
+	for (const auto &key : order_)
+	{
+		if (next.find(key) == next.end())
+			records += encodeRecord(nlohmann::json{{"op", "remove"}, {"key", key}}.dump());
+	}
+
+	entries_ = std::move(next);
+	order_ = std::move(order);
+	snapshotBytes_ = snapshotBytes;
+
+	if (records.empty() && !needsCompaction_)
+		return std::nullopt;
+
+	Write write;
+	if (needsCompaction_ || journalBytes_ + records.size() > std::max(MIN_COMPACTION_BYTES, snapshotBytes_))
+	{
+		write.compact = true;
+		write.generation = ++generation_;
+		nlohmann::json torrents = nlohmann::json::array();
+		for (const auto &key : order_)
+		{
+			nlohmann::json value = entries_.at(key).value;
+			value["key"] = key;
+			torrents.push_back(std::move(value));
+		}
+		write.snapshot = {{"version", 2}, {"generation", generation_}, {"torrents", std::move(torrents)}};
+		journalBytes_ = beginRecord(generation_).size();
+		needsCompaction_ = false;
+		return write;
+	}
+
+	write.generation = generation_;
+	journalBytes_ += records.size();
+	write.records = std::move(records);
+	return write;
+}
+
+void TorrentJournal::invalidate()
+{
+	needsCompaction_ = true;
+}
+
+const nlohmann::json *TorrentJournal::find(const std::string &key) const
+{
+	auto found = entries_.find(key);
+	return found == entries_.end() ? nullptr : &found->second.value;
+}
+
+Result TorrentJournal::begin(const std::filesystem::path &journalPath, std::uint64_t generation)
+{
+	// Records are only acknowledged once they are on disk; the directory is
+	// synced too so the new journal itself survives a crash.
+	Result result = Utils::appendDurably(journalPath, beginRecord(generation), true);
+	if (!result)
+		return Result::Failure("Unable to start torrent journal: " + result.message, ResultCode::Storage, true);
+	return Result::Success();
+}
+
+Result TorrentJournal::append(const std::filesystem::path &journalPath, const std::string &records)
+{
+	Result result = Utils::appendDurably(journalPath, records);
+	if (!result)
+		return Result::Failure("Unable to append to torrent journal: " + result.message, ResultCode::Storage, true);
+	return Result::Success();
+}
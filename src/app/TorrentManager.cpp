@@ -4,18 +4,90 @@
 #include "Logger.hpp"
 #include "StringUtils.hpp"
 #include "SystemUtils.hpp"
+#include "DurableFile.hpp"
 #include "utils/TorrentIdentity.hpp"
 #include <iostream>
 #include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <type_traits>
 #include <unordered_set>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 #include <libtorrent/alert_types.hpp>
 #include <libtorrent/read_resume_data.hpp>
+#include <libtorrent/session_params.hpp>
 #include <libtorrent/write_resume_data.hpp>
 
 namespace
 {
+// Stand-in for lt::make_magnet_uri() built from state the manager already
+// holds; torrents added from a magnet keep their original URI instead.
+std::string persistenceMagnet(const lt::info_hash_t &hash, const std::string &name, const std::vector<std::string> &trackers = {})
+{
+	std::string magnet = "magnet:?";
+	if (hash.has_v1())
+		magnet += "xt=urn:btih:" + Utils::TorrentIdentity::digestHex(hash.v1);
+	if (hash.has_v2())
+		magnet += std::string(hash.has_v1() ? "&" : "") + "xt=urn:btmh:1220" + Utils::TorrentIdentity::digestHex(hash.v2);
+	if (!name.empty())
+		magnet += "&dn=" + Utils::urlEncode(name);
+	for (const auto &tracker : trackers)
+		magnet += "&tr=" + Utils::urlEncode(tracker);
+	return magnet;
+}
+
+// Settings are re-applied from settings.json on startup; they are persisted so
+// the session starts with the last known listen and discovery configuration.
+const lt::save_state_flags_t sessionStateFlags = lt::session_handle::save_settings | lt::session_handle::save_dht_state;
+constexpr std::uintmax_t maxSessionStateBytes = 4 * 1024 * 1024;
+// A save request without a reply after this long is reissued; libtorrent may
+// drop alerts when its queue overflows.
+constexpr std::chrono::seconds resumeRequestExpiry{30};
+
+void scrubSessionSecrets(lt::settings_pack &settings)
+{
+	// The proxy password lives in the platform credential store only.
+	settings.set_str(lt::settings_pack::proxy_password, "");
+}
+
+lt::session_params loadSessionParams(const std::filesystem::path &path)
+{
+	std::error_code error;
+	if (path.empty() || !std::filesystem::is_regular_file(path, error))
+		return {};
+	const std::uintmax_t size = std::filesystem::file_size(path, error);
+	if (error || size == 0 || size > maxSessionStateBytes)
+	{
+		Utils::Logger::warning("torrent", "Ignoring unusable session state: " + path.string());
+		return {};
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!file.good() && !file.eof())
+	{
+		Utils::Logger::warning("torrent", "Unable to read session state: " + path.string());
+		return {};
+	}
+
+	try
+	{
+		lt::session_params params = lt::read_session_params(buffer, sessionStateFlags);
+		scrubSessionSecrets(params.settings);
+		Utils::Logger::info("torrent", "Restored session state with " +
+			std::to_string(params.dht_state.nodes.size() + params.dht_state.nodes6.size()) + " DHT nodes");
+		return params;
+	}
+	catch (const std::exception &e)
+	{
+		Utils::Logger::warning("torrent", std::string("Ignoring corrupt session state: ") + e.what());
+		return {};
+	}
+}
+
 void markStatusCacheStale(std::mutex &cacheMutex, std::chrono::steady_clock::time_point &lastCacheRefresh)
 {
 	std::lock_guard<std::mutex> lock(cacheMutex);
@@ -50,6 +122,43 @@ Result validateAddPaths(std::string &savePath, const std::string *torrentPath =
 	return Result::Success();
 }
 
+// Identifies the volume holding path so moves sharing a disk can be
+// serialized. Unknown paths fall back to their root, which is conservative.
+std::string volumeKey(const std::filesystem::path &path)
+{
+#ifdef _WIN32
+	std::error_code error;
+	const std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	return (error ? path : absolute).root_name().string();
+#else
+	struct stat info{};
+	if (::stat(path.c_str(), &info) == 0)
+		return "dev:" + std::to_string(static_cast<std::uint64_t>(info.st_dev));
+	return path.root_path().string();
+#endif
+}
+
+lt::move_flags_t moveFlagsForPolicy(StorageMovePolicy policy)
+{
+	switch (policy)
+	{
+	case StorageMovePolicy::ReplaceExisting:
+		return lt::move_flags_t::always_replace_files;
+	case StorageMovePolicy::KeepExisting:
+		return lt::move_flags_t::dont_replace;
+	case StorageMovePolicy::FailIfExists:
+		break;
+	}
+	return lt::move_flags_t::fail_if_exist;
+}
+
+std::string formatByteCount(std::uint64_t bytes, bool speed)
+{
+	char buffer[32];
+	Utils::formatBytes(static_cast<std::size_t>(bytes), speed, buffer, sizeof(buffer));
+	return buffer;
+}
+
 std::size_t detailSectionIndex(TorrentDetailSection section)
 {
 	return static_cast<std::size_t>(section);
@@ -82,6 +191,13 @@ TorrentEvent makeTorrentEvent(lt::alert *alert)
 		event.severity = Utils::LogLevel::Error;
 		event.hash = fileError->handle.info_hashes();
 	}
+	else if (auto *moved = lt::alert_cast<lt::storage_moved_alert>(alert))
+	{
+		event.category = "storage";
+		event.message = std::string("Storage moved for '") + moved->torrent_name() + "' to " + moved->storage_path();
+		event.severity = Utils::LogLevel::Info;
+		event.hash = moved->handle.info_hashes();
+	}
 	else if (auto *movedFailed = lt::alert_cast<lt::storage_moved_failed_alert>(alert))
 	{
 		event.category = "storage";
@@ -167,6 +283,11 @@ Result TorrentManager::addTorrent(const std::string &torrentPath, const std::str
 			torrentFilePaths.emplace(hash, torrentPath);
 			if (params.ti && !params.ti->name().empty())
 				torrentDisplayNames.emplace(hash, params.ti->name());
+			std::vector<std::string> trackers;
+			for (const auto &tracker : params.ti->trackers())
+				trackers.push_back(tracker.url);
+			if (!trackers.empty())
+				torrentTrackers.emplace(hash, std::move(trackers));
 			if (inserted)
 				++torrentCollectionRevision;
 		}
@@ -214,6 +335,7 @@ Result TorrentManager::addMagnetTorrent(const std::string &magnetUri, const std:
 			const auto [_, inserted] = torrents.emplace(hash, handle);
 			if (!params.name.empty())
 				torrentDisplayNames.emplace(hash, params.name);
+			torrentMagnetUris.emplace(hash, magnetUri);
 			if (inserted)
 				++torrentCollectionRevision;
 		}
@@ -231,47 +353,174 @@ Result TorrentManager::addMagnetTorrent(const std::string &magnetUri, const std:
 	}
 }
 
-void TorrentManager::addTorrentsFromConfig(const std::vector<TorrentConfigData> &torrents)
+void TorrentManager::addTorrentsFromConfig(const std::vector<TorrentConfigData> &torrents, const TorrentRestoreTimingCallback &timing)
 {
 	for (const auto &data : torrents)
 	{
+		const auto restoreStarted = std::chrono::steady_clock::now();
+		restoreTorrentFromConfig(data);
+		if (timing)
+			timing(std::chrono::steady_clock::now() - restoreStarted);
+	}
+}
+
+void TorrentManager::restoreTorrentsInBackground(std::vector<TorrentConfigData> torrents, TorrentRestoreTimingCallback timing, std::function<void()> completed)
+{
+	if (restoreWorker_.joinable())
+		restoreWorker_.join();
+	{
+		std::lock_guard<std::mutex> lock(restoreMutex_);
+		pendingRestore_ = std::move(torrents);
+		restoreCursor_ = 0;
+	}
+	restoringTorrents_.store(true);
+	restoreWorker_ = std::thread([this, timing = std::move(timing), completed = std::move(completed)]()
+	{
+		while (true)
+		{
+			const TorrentConfigData *data = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(restoreMutex_);
+				if (restoreCursor_ < pendingRestore_.size())
+					data = &pendingRestore_[restoreCursor_];
+			}
+			if (!data)
+				break;
+			if (stopRestore_.load())
+			{
+				Utils::Logger::warning("torrent", "Torrent restore stopped before all torrents were added");
+				break;
+			}
+			const auto restoreStarted = std::chrono::steady_clock::now();
+			restoreTorrentFromConfig(*data);
+			if (timing)
+				timing(std::chrono::steady_clock::now() - restoreStarted);
+			// Advanced only once the torrent is in the session, so a snapshot
+			// sees it in one place or both, never in neither.
+			std::lock_guard<std::mutex> lock(restoreMutex_);
+			++restoreCursor_;
+		}
+		{
+			std::lock_guard<std::mutex> lock(restoreMutex_);
+			if (restoreCursor_ == pendingRestore_.size())
+			{
+				pendingRestore_.clear();
+				pendingRestore_.shrink_to_fit();
+				restoreCursor_ = 0;
+			}
+		}
+		restoringTorrents_.store(false);
+		if (completed)
+			completed();
+	});
+}
+
+std::vector<ManagedTorrent> TorrentManager::unrestoredTorrents() const
+{
+	std::vector<TorrentConfigData> pending;
+	{
+		std::lock_guard<std::mutex> lock(restoreMutex_);
+		pending.assign(pendingRestore_.begin() + static_cast<std::ptrdiff_t>(restoreCursor_), pendingRestore_.end());
+	}
+
+	std::vector<ManagedTorrent> torrents;
+	torrents.reserve(pending.size());
+	for (auto &data : pending)
+	{
+		// The hash keys the persisted entry; take it from whichever source
+		// the restore itself would use.
+		lt::info_hash_t hash;
+		lt::error_code error;
 		if (!data.resumeData.empty())
 		{
-			std::lock_guard<std::mutex> operationLock(operationMutex);
+			const lt::add_torrent_params params = lt::read_resume_data(data.resumeData, error);
+			if (!error)
+				hash = params.info_hashes;
+		}
+		if (!hash.has_v1() && !hash.has_v2() && !data.magnetUri.empty())
+		{
+			error.clear();
+			const lt::add_torrent_params params = lt::parse_magnet_uri(data.magnetUri, error);
+			if (!error)
+				hash = params.info_hashes;
+		}
+		if (!hash.has_v1() && !hash.has_v2() && !data.torrentFilePath.empty())
+		{
 			try
 			{
-				lt::add_torrent_params params = lt::read_resume_data(data.resumeData);
-				if (!data.savePath.empty())
-					params.save_path = Utils::AppPaths::expandUserPath(data.savePath).string();
-				params.flags |= lt::torrent_flags::duplicate_is_error;
-				lt::torrent_handle handle = session.add_torrent(params);
-				const lt::info_hash_t hash = handle.info_hashes();
-				{
-					std::lock_guard<std::mutex> lock(stateMutex);
-					const auto [_, inserted] = this->torrents.emplace(hash, handle);
-					if (!data.torrentFilePath.empty())
-						torrentFilePaths.emplace(hash, data.torrentFilePath);
-					if (inserted)
-						++torrentCollectionRevision;
-				}
-				Utils::Logger::info("torrent", "Restored torrent from fast-resume data");
-				continue;
+				hash = lt::torrent_info(data.torrentFilePath).info_hashes();
 			}
-			catch (const std::exception &e)
+			catch (const std::exception &)
 			{
-				Utils::Logger::warning("torrent", "Fast-resume data was rejected; using the persisted source: " + std::string(e.what()));
 			}
 		}
-		// Try to add from file if path exists
-		if (!data.torrentFilePath.empty() && std::filesystem::exists(data.torrentFilePath))
+		if (!hash.has_v1() && !hash.has_v2())
 		{
-			this->addTorrent(data.torrentFilePath, data.savePath);
+			Utils::Logger::warning("torrent", "Dropping an unrestored torrent entry with no readable info hash");
+			continue;
+		}
+
+		ManagedTorrent torrent;
+		torrent.hash = hash;
+		torrent.torrentFilePath = std::move(data.torrentFilePath);
+		torrent.resumeData = std::move(data.resumeData);
+		torrent.savePath = std::move(data.savePath);
+		torrent.magnetUri = data.magnetUri.empty() ? persistenceMagnet(hash, {}) : std::move(data.magnetUri);
+		torrents.push_back(std::move(torrent));
+	}
+	return torrents;
+}
+
+void TorrentManager::restoreTorrentFromConfig(const TorrentConfigData &data)
+{
+	if (!data.resumeData.empty())
+	{
+		std::lock_guard<std::mutex> operationLock(operationMutex);
+		try
+		{
+			lt::add_torrent_params params = lt::read_resume_data(data.resumeData);
+			if (!data.savePath.empty())
+				params.save_path = Utils::AppPaths::expandUserPath(data.savePath).string();
+			params.flags |= lt::torrent_flags::duplicate_is_error;
+			lt::torrent_handle handle = session.add_torrent(params);
+			const lt::info_hash_t hash = handle.info_hashes();
+			{
+				std::lock_guard<std::mutex> lock(stateMutex);
+				const auto [_, inserted] = this->torrents.emplace(hash, handle);
+				if (!data.torrentFilePath.empty())
+					torrentFilePaths.emplace(hash, data.torrentFilePath);
+				if (!data.magnetUri.empty())
+					torrentMagnetUris.emplace(hash, data.magnetUri);
+				else if (!params.trackers.empty())
+					torrentTrackers.emplace(hash, params.trackers);
+				const std::string name = params.ti ? params.ti->name() : params.name;
+				if (!name.empty())
+					torrentDisplayNames.emplace(hash, name);
+				if (inserted)
+					++torrentCollectionRevision;
+			}
+			{
+				// The persisted data stays valid until the torrent changes.
+				std::lock_guard<std::mutex> lock(alertMutex_);
+				resumeDataStore_.emplace(hash, data.resumeData);
+			}
+			Utils::Logger::info("torrent", "Restored torrent from fast-resume data");
+			return;
 		}
-		else if (!data.magnetUri.empty())
+		catch (const std::exception &e)
 		{
-			this->addMagnetTorrent(data.magnetUri, data.savePath);
+			Utils::Logger::warning("torrent", "Fast-resume data was rejected; using the persisted source: " + std::string(e.what()));
 		}
 	}
+	// Try to add from file if path exists
+	if (!data.torrentFilePath.empty() && std::filesystem::exists(data.torrentFilePath))
+	{
+		this->addTorrent(data.torrentFilePath, data.savePath);
+	}
+	else if (!data.magnetUri.empty())
+	{
+		this->addMagnetTorrent(data.magnetUri, data.savePath);
+	}
 }
 
 Result TorrentManager::removeTorrent(const lt::info_hash_t &hash, TorrentRemovalMode removeMode)
@@ -324,7 +573,28 @@ Result TorrentManager::removeTorrent(const lt::info_hash_t &hash, TorrentRemoval
 				++torrentCollectionRevision;
 			torrentFilePaths.erase(hash);
 			torrentDisplayNames.erase(hash);
+			torrentMagnetUris.erase(hash);
+			torrentTrackers.erase(hash);
 		}
+		{
+			std::lock_guard<std::mutex> lock(alertMutex_);
+			resumeDataStore_.erase(hash);
+			pendingResumeHashes_.erase(hash);
+			reportedSavePaths_.erase(hash);
+		}
+		{
+			std::lock_guard<std::mutex> lock(moveMutex_);
+			const auto queuedCount = queuedMoves_.size();
+			queuedMoves_.erase(std::remove_if(queuedMoves_.begin(), queuedMoves_.end(),
+				[&hash](const StorageMove &move) { return move.hash == hash; }), queuedMoves_.end());
+			if (queuedMoves_.size() != queuedCount)
+			{
+				--moveProgress_.queued;
+				++moveProgress_.failed;
+			}
+		}
+		finishStorageMove(hash, false);
+		alertCv_.notify_all();
 		markStatusCacheStale(cacheMutex, lastCacheRefresh);
 		Utils::Logger::info("torrent", "Removed torrent " + hashForLog(hash));
 
@@ -372,6 +642,12 @@ Result TorrentManager::executeCommand(const lt::info_hash_t &hash, TorrentComman
 		case TorrentCommand::MoveQueueDown:
 			handle.queue_position_down();
 			break;
+		case TorrentCommand::MoveQueueTop:
+			handle.queue_position_top();
+			break;
+		case TorrentCommand::MoveQueueBottom:
+			handle.queue_position_bottom();
+			break;
 		case TorrentCommand::ForceReannounce:
 			handle.force_reannounce();
 			break;
@@ -399,7 +675,7 @@ std::vector<ManagedTorrent> TorrentManager::getTorrentSnapshot() const
 	snapshot.reserve(torrents.size());
 	for (const auto &[hash, handle] : torrents)
 	{
-		ManagedTorrent entry{hash, handle, {}, {}, {}};
+		ManagedTorrent entry{hash, handle, {}, {}, {}, {}, {}};
 		auto pathIt = torrentFilePaths.find(hash);
 		if (pathIt != torrentFilePaths.end())
 			entry.torrentFilePath = pathIt->second;
@@ -417,45 +693,198 @@ Result TorrentManager::getPersistenceSnapshot(std::vector<ManagedTorrent> &snaps
 		return Result::Failure("Torrent manager is shutting down", ResultCode::Unavailable);
 
 	std::lock_guard<std::mutex> operationLock(operationMutex);
-	snapshot = getTorrentSnapshot();
+	return collectResumeData(snapshot, std::chrono::steady_clock::now() + timeout, true, {});
+}
+
+Result TorrentManager::flushForShutdown(std::vector<ManagedTorrent> &snapshot, std::chrono::milliseconds budget, const PersistenceProgressCallback &progress)
+{
+	// Torrents the restore has not reached are saved from their persisted
+	// entries, so there is no need to wait for it.
+	stopRestore_.store(true);
+	if (restoreWorker_.joinable())
+		restoreWorker_.join();
+	const auto deadline = std::chrono::steady_clock::now() + budget;
+
+	// Refuse new checkpoints and release one that is waiting. Its outstanding
+	// requests stay pending and are awaited below instead of being reissued.
+	shuttingDown_.store(true);
+	alertCv_.notify_all();
+	{
+		std::lock_guard<std::mutex> lock(asyncPersistenceMutex_);
+		if (asyncPersistenceFuture_.valid())
+			asyncPersistenceFuture_.wait_until(deadline);
+	}
 
+	// A paused session stops transferring, so the collected state is final.
+	session.pause();
+	std::lock_guard<std::mutex> operationLock(operationMutex);
+	return collectResumeData(snapshot, deadline, false, progress);
+}
+
+Result TorrentManager::collectResumeData(std::vector<ManagedTorrent> &snapshot, std::chrono::steady_clock::time_point deadline, bool interruptible, const PersistenceProgressCallback &progress)
+{
+	// Read before the live set: a torrent restored in between then shows up
+	// in both and the live entry wins below.
+	std::vector<ManagedTorrent> unrestored = unrestoredTorrents();
+	snapshot = getTorrentSnapshot();
+	std::unordered_set<lt::info_hash_t> waiting;
+	auto awaitingReply = [this](const lt::info_hash_t &hash, std::chrono::steady_clock::time_point now)
+	{
+		auto pending = pendingResumeHashes_.find(hash);
+		return pending != pendingResumeHashes_.end() && now - pending->second < resumeRequestExpiry;
+	};
+	// Torrents with captured data are only asked again when dirty.
+	std::vector<std::pair<const ManagedTorrent *, bool>> candidates;
 	{
 		std::lock_guard<std::mutex> lock(alertMutex_);
-		resumeDataStore_.clear();
-		pendingResumeHashes_.clear();
+		const auto now = std::chrono::steady_clock::now();
 		for (const auto &torrent : snapshot)
 		{
 			if (!torrent.handle.is_valid())
 				continue;
+			if (awaitingReply(torrent.hash, now))
+				waiting.insert(torrent.hash);
+			else
+				candidates.emplace_back(&torrent, resumeDataStore_.count(torrent.hash) > 0);
+		}
+	}
+
+	// need_save_resume_data() is a round trip into the network thread, so
+	// the dirty check runs without alertMutex_ and the alert worker keeps
+	// draining replies meanwhile.
+	std::vector<const ManagedTorrent *> dirty;
+	dirty.reserve(candidates.size());
+	for (const auto &[torrent, captured] : candidates)
+	{
+		try
+		{
+			if (!captured || torrent->handle.need_save_resume_data())
+				dirty.push_back(torrent);
+		}
+		catch (const std::exception &e)
+		{
+			Utils::Logger::warning("torrent", "Unable to check fast-resume state: " + std::string(e.what()));
+		}
+	}
+
+	// The request is marked pending before it is issued, so its reply can
+	// never arrive ahead of the record it clears.
+	if (!dirty.empty())
+	{
+		std::lock_guard<std::mutex> lock(alertMutex_);
+		const auto now = std::chrono::steady_clock::now();
+		for (const ManagedTorrent *torrent : dirty)
+		{
 			try
 			{
-				torrent.handle.save_resume_data();
-				pendingResumeHashes_.insert(torrent.hash);
+				if (!awaitingReply(torrent->hash, now))
+				{
+					pendingResumeHashes_[torrent->hash] = now;
+					torrent->handle.save_resume_data();
+				}
+				waiting.insert(torrent->hash);
 			}
 			catch (const std::exception &e)
 			{
+				pendingResumeHashes_.erase(torrent->hash);
 				Utils::Logger::warning("torrent", "Unable to request fast-resume data: " + std::string(e.what()));
 			}
 		}
 	}
 
-	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	const std::size_t total = waiting.size();
+	std::size_t reported = total == 0 ? 0 : static_cast<std::size_t>(-1);
+	bool interrupted = false;
 	std::unique_lock<std::mutex> lock(alertMutex_);
-	alertCv_.wait_until(lock, deadline, [this] {
-		return pendingResumeHashes_.empty();
-	});
+	while (true)
+	{
+		for (auto it = waiting.begin(); it != waiting.end();)
+			it = pendingResumeHashes_.count(*it) == 0 ? waiting.erase(it) : std::next(it);
+
+		const std::size_t completed = total - waiting.size();
+		if (progress && completed != reported)
+		{
+			reported = completed;
+			lock.unlock();
+			progress(PersistenceProgress{completed, total});
+			lock.lock();
+			continue;
+		}
+		if (waiting.empty())
+			break;
+		if (interruptible && shuttingDown_.load())
+		{
+			interrupted = true;
+			break;
+		}
+		if (alertCv_.wait_until(lock, deadline) == std::cv_status::timeout && std::chrono::steady_clock::now() >= deadline)
+		{
+			for (auto it = waiting.begin(); it != waiting.end();)
+				it = pendingResumeHashes_.count(*it) == 0 ? waiting.erase(it) : std::next(it);
+			break;
+		}
+	}
 
+	// Torrents that missed the deadline keep their last captured resume data.
+	// The save path comes from the same reports, so a torrent that just moved
+	// is recorded at its new location.
 	for (auto &torrent : snapshot)
 	{
 		auto found = resumeDataStore_.find(torrent.hash);
 		if (found != resumeDataStore_.end())
-		{
 			torrent.resumeData = found->second;
+		auto reported = reportedSavePaths_.find(torrent.hash);
+		if (reported != reportedSavePaths_.end())
+			torrent.savePath = reported->second;
+	}
+	lock.unlock();
+
+	// Fill in the rest from cached state. A torrent missing from both keeps an
+	// empty save path, and ConfigManager queries its handle from the save
+	// worker instead.
+	const auto statuses = getStatusCache();
+	{
+		std::lock_guard<std::mutex> stateLock(stateMutex);
+		for (auto &torrent : snapshot)
+		{
+			if (statuses && torrent.savePath.empty())
+			{
+				auto status = statuses->find(torrent.hash);
+				if (status != statuses->end())
+					torrent.savePath = status->second.save_path;
+			}
+			auto magnet = torrentMagnetUris.find(torrent.hash);
+			if (magnet != torrentMagnetUris.end())
+			{
+				torrent.magnetUri = magnet->second;
+			}
+			else
+			{
+				static const std::vector<std::string> noTrackers;
+				auto trackers = torrentTrackers.find(torrent.hash);
+				torrent.magnetUri = persistenceMagnet(torrent.hash, torrent.displayName,
+					trackers != torrentTrackers.end() ? trackers->second : noTrackers);
+			}
 		}
 	}
 
-	if (!pendingResumeHashes_.empty())
-		return Result::Failure("Timed out while collecting fast-resume data for " + std::to_string(pendingResumeHashes_.size()) + " torrent(s)", ResultCode::Storage, true);
+	if (!unrestored.empty())
+	{
+		std::unordered_set<lt::info_hash_t> live;
+		live.reserve(snapshot.size());
+		for (const auto &torrent : snapshot)
+			live.insert(torrent.hash);
+		for (auto &torrent : unrestored)
+		{
+			if (live.count(torrent.hash) == 0)
+				snapshot.push_back(std::move(torrent));
+		}
+	}
+
+	if (interrupted)
+		return Result::Failure("Fast-resume collection was interrupted by shutdown", ResultCode::Cancelled);
+	if (!waiting.empty())
+		return Result::Failure("Timed out while collecting fast-resume data for " + std::to_string(waiting.size()) + " torrent(s)", ResultCode::Storage, true);
 	return Result::Success();
 }
 
@@ -472,6 +901,10 @@ Result TorrentManager::requestPersistenceSnapshot()
 	asyncPersistenceFuture_ = std::async(std::launch::async, [this]() {
 		std::vector<ManagedTorrent> snapshot;
 		Result res = getPersistenceSnapshot(snapshot);
+		// Checkpoint the DHT routing table alongside torrent state so a crash
+		// still leaves a recent node cache for the next start.
+		if (Result sessionResult = saveSessionState(); !sessionResult)
+			Utils::Logger::warning("torrent", sessionResult.message);
 		PersistenceSnapshotResult result;
 		result.success = static_cast<bool>(res);
 		if (result.success)
@@ -506,6 +939,27 @@ std::vector<TorrentEvent> TorrentManager::drainEvents()
 	return events;
 }
 
+std::uint64_t TorrentManager::addEventListener(TorrentEventListener listener)
+{
+	if (!listener)
+		return 0;
+	std::lock_guard<std::mutex> lock(listenerMutex_);
+	const std::uint64_t id = nextEventListenerId_++;
+	eventListeners_.emplace_back(id, std::move(listener));
+	hasEventListeners_ = true;
+	return id;
+}
+
+void TorrentManager::removeEventListener(std::uint64_t id)
+{
+	// Holding listenerMutex_ while erasing guarantees the listener is not
+	// running and will not be invoked after this call returns.
+	std::lock_guard<std::mutex> lock(listenerMutex_);
+	eventListeners_.erase(std::remove_if(eventListeners_.begin(), eventListeners_.end(),
+		[id](const auto &entry) { return entry.first == id; }), eventListeners_.end());
+	hasEventListeners_ = !eventListeners_.empty();
+}
+
 void TorrentManager::alertWorkerLoop()
 {
 	while (!stopAlertWorker_.load())
@@ -516,17 +970,33 @@ void TorrentManager::alertWorkerLoop()
 		if (alerts.empty())
 			continue;
 
-		std::lock_guard<std::mutex> lock(alertMutex_);
+		std::vector<TorrentEvent> published;
+		std::vector<std::pair<lt::info_hash_t, bool>> finishedMoves;
+		const bool publish = hasEventListeners_.load();
+		std::unique_lock<std::mutex> lock(alertMutex_);
 		for (lt::alert *alert : alerts)
 		{
 			if (!alert)
 				continue;
 
+			if (auto *moved = lt::alert_cast<lt::storage_moved_alert>(alert))
+			{
+				finishedMoves.emplace_back(moved->handle.info_hashes(), true);
+				reportedSavePaths_[moved->handle.info_hashes()] = moved->storage_path();
+			}
+			else if (auto *movedFailed = lt::alert_cast<lt::storage_moved_failed_alert>(alert))
+				finishedMoves.emplace_back(movedFailed->handle.info_hashes(), false);
+
 			if (auto *saved = lt::alert_cast<lt::save_resume_data_alert>(alert))
 			{
 				const lt::info_hash_t hash = saved->handle.info_hashes();
-				resumeDataStore_[hash] = lt::write_resume_data_buf(saved->params);
-				pendingResumeHashes_.erase(hash);
+				// Replies for torrents removed while a request was pending are dropped.
+				if (pendingResumeHashes_.erase(hash) > 0)
+				{
+					resumeDataStore_[hash] = lt::write_resume_data_buf(saved->params);
+					if (!saved->params.save_path.empty())
+						reportedSavePaths_[hash] = saved->params.save_path;
+				}
 				alertCv_.notify_all();
 			}
 			else if (auto *failed = lt::alert_cast<lt::save_resume_data_failed_alert>(alert))
@@ -556,8 +1026,28 @@ void TorrentManager::alertWorkerLoop()
 			}
 
 			TorrentEvent event = makeTorrentEvent(alert);
+			if (publish)
+				published.push_back(event);
 			eventsQueue_.push_back(std::move(event));
 		}
+		lock.unlock();
+
+		bool movesDrained = false;
+		for (const auto &[hash, success] : finishedMoves)
+			movesDrained = finishStorageMove(hash, success) || movesDrained;
+		if (!finishedMoves.empty())
+			markStatusCacheStale(cacheMutex, lastCacheRefresh);
+		// New save paths reach torrents.json through the regular autosave poll.
+		if (movesDrained)
+			requestPersistenceSnapshot();
+
+		if (!published.empty())
+		{
+			std::lock_guard<std::mutex> listenerLock(listenerMutex_);
+			for (const auto &event : published)
+				for (const auto &[id, listener] : eventListeners_)
+					listener(event);
+		}
 	}
 }
 
@@ -893,6 +1383,247 @@ void TorrentManager::detailWorkerLoop()
 
 
 
+void TorrentManager::setQueueLimits(int activeDownloads, int activeSeeds, int activeLimit)
+{
+	const auto limit = [](int value) { return value > 0 ? value : -1; };
+	lt::settings_pack settings;
+	settings.set_int(lt::settings_pack::active_downloads, limit(activeDownloads));
+	settings.set_int(lt::settings_pack::active_seeds, limit(activeSeeds));
+	settings.set_int(lt::settings_pack::active_limit, limit(activeLimit));
+	session.apply_settings(settings);
+}
+
+Result TorrentManager::setQueuePosition(const lt::info_hash_t &hash, int position)
+{
+	if (position < 0)
+		return Result::Failure("Queue position cannot be negative", ResultCode::InvalidInput);
+	lt::torrent_handle handle;
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		auto found = torrents.find(hash);
+		if (found == torrents.end())
+			return Result::Failure("Torrent not found", ResultCode::NotFound);
+		handle = found->second;
+	}
+	if (!handle.is_valid())
+		return Result::Failure("Torrent handle is invalid");
+	try
+	{
+		handle.queue_position_set(lt::queue_position_t{position});
+	}
+	catch (const std::exception &e)
+	{
+		return Result::Failure(std::string("Unable to set queue position: ") + e.what());
+	}
+	markStatusCacheStale(cacheMutex, lastCacheRefresh);
+	requestStatusRefresh();
+	return Result::Success();
+}
+
+Result TorrentManager::moveQueue(std::span<const lt::info_hash_t> hashes, QueueMove move)
+{
+	if (hashes.empty())
+		return Result::Failure("No torrents selected", ResultCode::InvalidInput);
+	std::vector<lt::torrent_handle> handles;
+	handles.reserve(hashes.size());
+	std::size_t missing = 0;
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		std::unordered_set<lt::info_hash_t> seen;
+		for (const auto &hash : hashes)
+		{
+			auto found = torrents.find(hash);
+			if (found == torrents.end() || !found->second.is_valid())
+				++missing;
+			else if (seen.insert(hash).second)
+				handles.push_back(found->second);
+		}
+	}
+
+	// Moving to the top in reverse order leaves the first selected torrent
+	// first; moving to the bottom in order leaves the last selected one last.
+	try
+	{
+		if (move == QueueMove::Top)
+			for (auto it = handles.rbegin(); it != handles.rend(); ++it)
+				it->queue_position_top();
+		else
+			for (const auto &handle : handles)
+				handle.queue_position_bottom();
+	}
+	catch (const std::exception &e)
+	{
+		return Result::Failure(std::string("Unable to reorder queue: ") + e.what());
+	}
+	markStatusCacheStale(cacheMutex, lastCacheRefresh);
+	requestStatusRefresh();
+
+	if (handles.empty())
+		return Result::Failure("Torrent not found", ResultCode::NotFound);
+	if (missing > 0)
+		return Result::Failure(std::to_string(missing) + " torrent(s) were not found", ResultCode::Partial);
+	return Result::Success();
+}
+
+Result TorrentManager::moveStorage(std::span<const lt::info_hash_t> hashes, const std::string &destination, StorageMovePolicy policy)
+{
+	if (hashes.empty())
+		return Result::Failure("No torrents selected", ResultCode::InvalidInput);
+	std::string resolvedDestination = destination;
+	Result validation = validateAddPaths(resolvedDestination);
+	if (!validation)
+		return validation;
+	const std::string destinationVolume = volumeKey(resolvedDestination);
+
+	std::vector<StorageMove> moves;
+	std::size_t skipped = 0;
+	{
+		const auto cache = getStatusCache();
+		std::lock_guard<std::mutex> lock(stateMutex);
+		for (const auto &hash : hashes)
+		{
+			auto found = torrents.find(hash);
+			if (found == torrents.end() || !found->second.is_valid())
+			{
+				++skipped;
+				continue;
+			}
+			StorageMove move{hash, found->second, resolvedDestination, moveFlagsForPolicy(policy), {destinationVolume}, 0};
+			if (auto status = cache->find(hash); status != cache->end())
+			{
+				move.bytes = static_cast<std::uint64_t>(std::max<std::int64_t>(status->second.total_done, 0));
+				move.volumes.push_back(volumeKey(status->second.save_path));
+			}
+			moves.push_back(std::move(move));
+		}
+	}
+	// Status may be stale for torrents that were never displayed; asking the
+	// handle keeps the source volume accurate for throttling. This waits on
+	// the session thread, so it runs before moveMutex_ is taken: the alert
+	// worker finishes moves under that lock.
+	for (auto &move : moves)
+	{
+		if (move.volumes.size() != 1)
+			continue;
+		try
+		{
+			const lt::torrent_status status = move.handle.status(lt::torrent_handle::query_save_path);
+			move.bytes = static_cast<std::uint64_t>(std::max<std::int64_t>(status.total_done, 0));
+			move.volumes.push_back(volumeKey(status.save_path));
+		}
+		catch (const std::exception &) {}
+	}
+
+	std::size_t queued = 0;
+	{
+		std::lock_guard<std::mutex> lock(moveMutex_);
+		if (queuedMoves_.empty() && activeMoves_.empty())
+		{
+			moveProgress_ = {};
+			moveBatchStarted_ = std::chrono::steady_clock::now();
+		}
+		std::unordered_set<lt::info_hash_t> pending;
+		for (const auto &move : queuedMoves_)
+			pending.insert(move.hash);
+		for (auto &move : moves)
+		{
+			if (activeMoves_.count(move.hash) > 0 || !pending.insert(move.hash).second)
+			{
+				++skipped;
+				continue;
+			}
+			++moveProgress_.total;
+			++moveProgress_.queued;
+			moveProgress_.bytesTotal += move.bytes;
+			queuedMoves_.push_back(std::move(move));
+			++queued;
+		}
+		startQueuedMoves();
+	}
+
+	Utils::Logger::info("storage", "Queued " + std::to_string(queued) + " storage move(s) to " + resolvedDestination);
+	if (queued == 0)
+		return Result::Failure("No torrents could be queued for moving", ResultCode::NotFound);
+	if (skipped > 0)
+		return Result::Failure(std::to_string(skipped) + " torrent(s) were missing or already moving", ResultCode::Partial);
+	return Result::Success();
+}
+
+StorageMoveProgress TorrentManager::getStorageMoveProgress() const
+{
+	std::lock_guard<std::mutex> lock(moveMutex_);
+	return moveProgress_;
+}
+
+// Requires moveMutex_. Starts every queued move whose volumes are idle while
+// preserving queue order for moves that are still blocked.
+void TorrentManager::startQueuedMoves()
+{
+	for (auto it = queuedMoves_.begin(); it != queuedMoves_.end();)
+	{
+		const bool blocked = std::any_of(it->volumes.begin(), it->volumes.end(),
+			[this](const std::string &volume) { return busyVolumes_.count(volume) > 0; });
+		if (blocked)
+		{
+			++it;
+			continue;
+		}
+
+		StorageMove move = std::move(*it);
+		it = queuedMoves_.erase(it);
+		--moveProgress_.queued;
+		try
+		{
+			move.handle.move_storage(move.destination, move.flags);
+		}
+		catch (const std::exception &e)
+		{
+			++moveProgress_.failed;
+			Utils::Logger::warning("storage", "Unable to start storage move for " + hashForLog(move.hash) + ": " + e.what());
+			continue;
+		}
+		busyVolumes_.insert(move.volumes.begin(), move.volumes.end());
+		++moveProgress_.active;
+		const lt::info_hash_t hash = move.hash;
+		activeMoves_.emplace(hash, std::move(move));
+	}
+}
+
+// Returns true when this completion drained the last queued or active move.
+bool TorrentManager::finishStorageMove(const lt::info_hash_t &hash, bool success)
+{
+	std::lock_guard<std::mutex> lock(moveMutex_);
+	auto found = activeMoves_.find(hash);
+	if (found == activeMoves_.end())
+		return false;
+
+	for (const auto &volume : found->second.volumes)
+		busyVolumes_.erase(volume);
+	--moveProgress_.active;
+	if (success)
+	{
+		++moveProgress_.completed;
+		moveProgress_.bytesMoved += found->second.bytes;
+	}
+	else
+	{
+		++moveProgress_.failed;
+	}
+	activeMoves_.erase(found);
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - moveBatchStarted_).count();
+	if (elapsed > 0)
+		moveProgress_.bytesPerSecond = moveProgress_.bytesMoved * 1000 / static_cast<std::uint64_t>(elapsed);
+	Utils::Logger::info("storage", "Storage moves: " +
+		std::to_string(moveProgress_.completed + moveProgress_.failed) + "/" + std::to_string(moveProgress_.total) +
+		" done, " + formatByteCount(moveProgress_.bytesMoved, false) + " of " + formatByteCount(moveProgress_.bytesTotal, false) +
+		" at " + formatByteCount(moveProgress_.bytesPerSecond, true));
+
+	startQueuedMoves();
+	return queuedMoves_.empty() && activeMoves_.empty();
+}
+
 void TorrentManager::setSequentialDownload(const lt::info_hash_t &hash, bool sequential)
 {
 	lt::torrent_handle handle;
@@ -942,7 +1673,30 @@ void TorrentManager::setProxyConfig(const std::string &hostname, int port, const
 	settings.set_int(lt::settings_pack::proxy_type, libtorrentProxyType);
 	session.apply_settings(settings);
 }
-TorrentManager::TorrentManager()
+
+Result TorrentManager::saveSessionState()
+{
+	if (sessionStatePath_.empty())
+		return Result::Success();
+
+	std::lock_guard<std::mutex> lock(sessionStateMutex_);
+	lt::session_params params = session.session_state(sessionStateFlags);
+	scrubSessionSecrets(params.settings);
+	std::vector<char> buffer = lt::write_session_params_buf(params, sessionStateFlags);
+	if (buffer == lastSessionState_)
+		return Result::Success();
+
+	Result result = Utils::writeFileAtomically(sessionStatePath_, [&buffer](std::ostream &stream)
+	{
+		stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	});
+	if (!result)
+		return Result::Failure("Unable to save session state: " + result.message, ResultCode::Storage, true);
+	lastSessionState_ = std::move(buffer);
+	return Result::Success();
+}
+TorrentManager::TorrentManager(std::filesystem::path sessionStatePath)
+	: session(loadSessionParams(sessionStatePath)), sessionStatePath_(std::move(sessionStatePath))
 {
 	alertWorker_ = std::thread(&TorrentManager::alertWorkerLoop, this);
 	statusWorker = std::thread(&TorrentManager::statusWorkerLoop, this);
@@ -951,7 +1705,11 @@ TorrentManager::TorrentManager()
 
 TorrentManager::~TorrentManager()
 {
+	stopRestore_.store(true);
+	if (restoreWorker_.joinable())
+		restoreWorker_.join();
 	shuttingDown_.store(true);
+	alertCv_.notify_all();
 
 	stopStatusWorker = true;
 	statusWorkerCv.notify_all();
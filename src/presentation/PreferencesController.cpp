@@ -242,6 +242,7 @@ Result PreferencesController::applyRuntime(const PreferencesSettings &settings)
 	torrentManager.setDownloadSpeedLimit(settings.downloadSpeedLimit);
 	torrentManager.setUploadSpeedLimit(settings.uploadSpeedLimit);
 	torrentManager.configureDiscovery(settings.enableDht, settings.enableUpnp, settings.enableNatPmp);
+	torrentManager.setQueueLimits(settings.activeDownloads, settings.activeSeeds, settings.activeLimit);
 
 	const std::string proxyPassword = credentialStore.load("proxy_password").value_or("");
 	torrentManager.setProxyConfig(settings.proxyHost, settings.proxyPort, settings.proxyUsername, proxyPassword,
@@ -250,6 +251,7 @@ Result PreferencesController::applyRuntime(const PreferencesSettings &settings)
 		settings.proxyHost, settings.proxyPort, settings.proxyUsername, proxyPassword);
 	if (!searchProxy)
 		return searchProxy;
+	searchEngine.setFanOutEnabled(settings.searchFanOut);
 
 	if (settings.torznabEnabled)
 	{
@@ -25,7 +25,14 @@ Result SearchPresenter::startSearch(const std::string &query)
 
 	currentQuery_ = query;
 	nextToken_.clear();
-	results_.clear();
+	// Local matches show while the providers are queried; their answers
+	// replace these entries as they arrive.
+	resetResults(searchEngine.searchLocal(query));
+	for (const auto &result : results_)
+	{
+		if (!resultKey(result).empty())
+			localResults_.insert(resultKey(result));
+	}
 	hasMore_ = true;
 	loadingMore_ = false;
 	activeRequestId_ = requestId;
@@ -73,6 +80,19 @@ void SearchPresenter::update()
 		++revision_;
 	}
 
+	// Batches of the active request show while it runs; older ones are stale.
+	bool streamed = false;
+	while (auto batch = searchEngine.takeSearchBatch())
+	{
+		if (batch->requestId != activeRequestId_ || !isSearching())
+			continue;
+		for (auto &result : batch->torrents)
+			mergeResult(std::move(result), true);
+		streamed = true;
+	}
+	if (streamed)
+		++revision_;
+
 	const auto completion = searchEngine.takeCompletedSearch();
 	if (!completion || completion->requestId != activeRequestId_)
 		return;
@@ -82,11 +102,14 @@ void SearchPresenter::update()
 	{
 		if (completion->result.code == ResultCode::Cancelled)
 		{
+			// What arrived before the cancellation stays listed.
+			streamedResults_.clear();
 			state_ = SearchState::Cancelled;
 			stateMessage_ = "Search cancelled.";
 		}
 		else
 		{
+			dropUnconfirmed();
 			state_ = SearchState::Failed;
 			stateMessage_ = completion->result.message;
 		}
@@ -97,6 +120,9 @@ void SearchPresenter::update()
 	nextToken_ = completion->response.nextToken;
 	hasMore_ = completion->response.hasMore && !nextToken_.empty();
 	mergeUnique(completion->response.torrents);
+	// Streamed results the final answer left out, e.g. from a provider that
+	// failed or was cut off, are withdrawn.
+	dropUnconfirmed();
 	if (results_.empty())
 	{
 		state_ = SearchState::Empty;
@@ -110,17 +136,67 @@ void SearchPresenter::update()
 	++revision_;
 }
 
+const std::string &SearchPresenter::resultKey(const TorrentSearchResult &result)
+{
+	return result.infoHash.empty() ? result.magnetUri : result.infoHash;
+}
+
+void SearchPresenter::resetResults(std::vector<TorrentSearchResult> results)
+{
+	results_ = std::move(results);
+	localResults_.clear();
+	streamedResults_.clear();
+	resultIndex_.clear();
+	for (std::size_t index = 0; index < results_.size(); ++index)
+	{
+		if (!resultKey(results_[index]).empty())
+			resultIndex_.try_emplace(resultKey(results_[index]), index);
+	}
+}
+
+void SearchPresenter::mergeResult(TorrentSearchResult &&result, bool streamed)
+{
+	const std::string key = resultKey(result);
+	if (key.empty())
+	{
+		// Without a key it cannot be matched later, so only the completion adds it.
+		if (!streamed)
+			results_.push_back(std::move(result));
+		return;
+	}
+	const auto [found, inserted] = resultIndex_.try_emplace(key, results_.size());
+	if (inserted)
+		results_.push_back(std::move(result));
+	else if (localResults_.erase(key) > 0 || streamedResults_.count(key) > 0)
+		results_[found->second] = std::move(result);
+	else
+		return;
+	if (streamed)
+		streamedResults_.insert(key);
+	else
+		streamedResults_.erase(key);
+}
+
 void SearchPresenter::mergeUnique(std::vector<TorrentSearchResult> incoming)
 {
 	for (auto &result : incoming)
+		mergeResult(std::move(result), false);
+}
+
+void SearchPresenter::dropUnconfirmed()
+{
+	if (streamedResults_.empty())
+		return;
+	std::vector<TorrentSearchResult> kept;
+	kept.reserve(results_.size());
+	for (auto &result : results_)
 	{
-		const auto duplicate = std::find_if(results_.begin(), results_.end(), [&result](const TorrentSearchResult &existing)
-		{
-			return !result.infoHash.empty() && result.infoHash == existing.infoHash;
-		});
-		if (duplicate == results_.end())
-			results_.push_back(std::move(result));
+		if (streamedResults_.count(resultKey(result)) == 0)
+			kept.push_back(std::move(result));
 	}
+	std::unordered_set<std::string> local = std::move(localResults_);
+	resetResults(std::move(kept));
+	localResults_ = std::move(local);
 }
 
 SearchResultDto SearchPresenter::toDto(const TorrentSearchResult &result, bool favorite)
@@ -188,6 +188,7 @@ void SlintAppController::start()
 	window->set_preference_enable_natpmp(currentPreferences.enableNatPmp);
 	window->set_preference_torznab_enabled(currentPreferences.torznabEnabled);
 	window->set_preference_torznab_url(SlintUi::toSharedString(currentPreferences.torznabUrl));
+	window->set_preference_search_fan_out(currentPreferences.searchFanOut);
 	window->set_preference_torznab_secret_stored(Utils::CredentialStore::load("torznab_api_key").has_value());
 	window->set_preference_torznab_secret(slint::SharedString());
 	window->set_preference_proxy_enabled(currentPreferences.proxyEnabled);
@@ -221,16 +222,7 @@ Result SlintAppController::stop()
 	autosaveTimer.stop();
 	started = false;
 
-	std::vector<ManagedTorrent> finalSnapshot;
-	if (app.torrentManager().getPersistenceSnapshot(finalSnapshot, std::chrono::seconds(3)))
-	{
-		app.torrentsConfigManager().saveTorrents(finalSnapshot);
-	}
-	else
-	{
-		app.torrentsConfigManager().saveTorrents(app.torrentManager().getTorrentSnapshot());
-	}
-
+	// Torrent state is collected once by App::shutdown after the window closes.
 	Result result = uiStateController.flush();
 	const Result preferences = preferencesController.waitForSave();
 	if (!preferences)
@@ -269,7 +261,7 @@ void SlintAppController::refresh()
 	{
 		if (snapshotRes->success)
 		{
-			app.torrentsConfigManager().saveTorrents(snapshotRes->torrents);
+			app.torrentsConfigManager().saveTorrents(std::move(snapshotRes->torrents));
 		}
 		else
 		{
@@ -303,7 +295,7 @@ void SlintAppController::autosave()
 		return;
 	}
 
-	app.searchEngine().saveFavoritesAndHistory(app.settingsConfigManager());
+	app.searchEngine().saveFavoritesAndHistory();
 	app.settingsConfigManager().save(Utils::AppPaths::settingsConfigPath().string());
 }
 
@@ -68,6 +68,8 @@ Presentation::TorrentSortField sortField(TorrentSort field, bool &valid)
 	case UiTorrentCommand::ForceRecheck: return ::TorrentCommand::ForceRecheck;
 	case UiTorrentCommand::QueueUp: return ::TorrentCommand::MoveQueueUp;
 	case UiTorrentCommand::QueueDown: return ::TorrentCommand::MoveQueueDown;
+	case UiTorrentCommand::QueueTop: return ::TorrentCommand::MoveQueueTop;
+	case UiTorrentCommand::QueueBottom: return ::TorrentCommand::MoveQueueBottom;
 	case UiTorrentCommand::ForceReannounce: return ::TorrentCommand::ForceReannounce;
 	}
 	valid = false;
@@ -474,6 +476,7 @@ void PreferencesUiController::apply()
 	preferences.enableNatPmp = window_.get_preference_enable_natpmp();
 	preferences.torznabEnabled = window_.get_preference_torznab_enabled();
 	preferences.torznabUrl = stringProperty(window_.get_preference_torznab_url());
+	preferences.searchFanOut = window_.get_preference_search_fan_out();
 	preferences.proxyEnabled = window_.get_preference_proxy_enabled();
 	preferences.proxyType = stringProperty(window_.get_preference_proxy_type());
 	preferences.proxyHost = stringProperty(window_.get_preference_proxy_host());
@@ -125,6 +125,31 @@ std::filesystem::path AppPaths::logFilePath()
 	return dataDirectory() / "hypertube.log";
 }
 
+std::filesystem::path AppPaths::sessionStatePath()
+{
+	return dataDirectory() / "session.dat";
+}
+
+std::filesystem::path AppPaths::favoritesPath()
+{
+	return dataDirectory() / "favorites.json";
+}
+
+std::filesystem::path AppPaths::startupReportPath()
+{
+	return cacheDirectory() / "startup-report.json";
+}
+
+std::filesystem::path AppPaths::searchCachePath()
+{
+	return cacheDirectory() / "search-cache.json";
+}
+
+std::filesystem::path AppPaths::localSearchIndexPath()
+{
+	return cacheDirectory() / "local-index.json";
+}
+
 void AppPaths::ensureDirectories()
 {
 	std::error_code error;
@@ -0,0 +1,202 @@
+#include "DurableFile.hpp"
+#include <algorithm>
+#include <exception>
+#include <streambuf>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Utils
+{
+namespace
+{
+#ifdef _WIN32
+int openForAppend(const std::filesystem::path &path, bool truncate)
+{
+	return _wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : _O_APPEND), _S_IREAD | _S_IWRITE);
+}
+
+bool writeDescriptor(int descriptor, const char *data, std::size_t size)
+{
+	while (size > 0)
+	{
+		const int chunk = static_cast<int>(std::min<std::size_t>(size, 1 << 30));
+		const int written = _write(descriptor, data, static_cast<unsigned int>(chunk));
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= static_cast<std::size_t>(written);
+	}
+	return true;
+}
+
+bool syncDescriptor(int descriptor) { return _commit(descriptor) == 0; }
+bool closeDescriptor(int descriptor) { return _close(descriptor) == 0; }
+#else
+int openForAppend(const std::filesystem::path &path, bool truncate)
+{
+	return ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : O_APPEND), 0666);
+}
+
+bool writeDescriptor(int descriptor, const char *data, std::size_t size)
+{
+	while (size > 0)
+	{
+		const ssize_t written = ::write(descriptor, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= static_cast<std::size_t>(written);
+	}
+	return true;
+}
+
+bool syncDescriptor(int descriptor) { return ::fsync(descriptor) == 0; }
+bool closeDescriptor(int descriptor) { return ::close(descriptor) == 0; }
+#endif
+
+// Fixed-size output buffer over a file descriptor. Serializers write through
+// it in chunks, so no document-sized string is ever built.
+class DescriptorBuffer : public std::streambuf
+{
+public:
+	explicit DescriptorBuffer(int descriptor)
+		: descriptor_(descriptor), buffer_(64 * 1024)
+	{
+		setp(buffer_.data(), buffer_.data() + buffer_.size());
+	}
+
+protected:
+	int_type overflow(int_type character) override
+	{
+		if (!drain())
+			return traits_type::eof();
+		if (!traits_type::eq_int_type(character, traits_type::eof()))
+		{
+			*pptr() = traits_type::to_char_type(character);
+			pbump(1);
+		}
+		return traits_type::not_eof(character);
+	}
+
+	int sync() override
+	{
+		return drain() ? 0 : -1;
+	}
+
+private:
+	bool drain()
+	{
+		const std::size_t pending = static_cast<std::size_t>(pptr() - pbase());
+		if (pending > 0 && !writeDescriptor(descriptor_, pbase(), pending))
+			return false;
+		setp(buffer_.data(), buffer_.data() + buffer_.size());
+		return true;
+	}
+
+	int descriptor_;
+	std::vector<char> buffer_;
+};
+} // namespace
+
+Result appendDurably(const std::filesystem::path &path, std::string_view data, bool truncate)
+{
+	const int descriptor = openForAppend(path, truncate);
+	if (descriptor < 0)
+		return Result::Failure("Unable to open " + path.filename().string(), ResultCode::Storage, true);
+	const bool written = writeDescriptor(descriptor, data.data(), data.size()) && syncDescriptor(descriptor);
+	const bool closed = closeDescriptor(descriptor);
+	if (!written || !closed)
+		return Result::Failure("Unable to write " + path.filename().string(), ResultCode::Storage, true);
+	if (truncate)
+		syncDirectory(path.parent_path());
+	return Result::Success();
+}
+
+Result writeFileAtomically(const std::filesystem::path &path, const std::function<void(std::ostream &)> &write, bool keepBackup)
+{
+	const std::string name = path.filename().string();
+	std::error_code error;
+	if (!path.parent_path().empty())
+		std::filesystem::create_directories(path.parent_path(), error);
+	if (error)
+		return Result::Failure("Unable to create the directory for " + name + ": " + error.message(), ResultCode::Storage, true);
+
+	const std::filesystem::path temporary = path.string() + ".tmp";
+	const int descriptor = openForAppend(temporary, true);
+	if (descriptor < 0)
+		return Result::Failure("Unable to open " + temporary.filename().string(), ResultCode::Storage, true);
+	std::string failure;
+	{
+		DescriptorBuffer buffer(descriptor);
+		std::ostream stream(&buffer);
+		try
+		{
+			write(stream);
+			stream.flush();
+			// The data must be on disk before the rename publishes it, or a
+			// crash can leave an empty file under the real name.
+			if (!stream.good() || !syncDescriptor(descriptor))
+				failure = "Unable to write " + temporary.filename().string();
+		}
+		catch (const std::exception &e)
+		{
+			failure = "Unable to serialize " + name + ": " + e.what();
+		}
+	}
+	if (!closeDescriptor(descriptor) && failure.empty())
+		failure = "Unable to close " + temporary.filename().string();
+	if (!failure.empty())
+	{
+		std::filesystem::remove(temporary, error);
+		return Result::Failure(failure, ResultCode::Storage, true);
+	}
+
+	if (keepBackup && std::filesystem::exists(path, error))
+	{
+		std::filesystem::copy_file(path, path.string() + ".bak", std::filesystem::copy_options::overwrite_existing, error);
+		if (error)
+		{
+			const std::string message = error.message();
+			std::filesystem::remove(temporary, error);
+			return Result::Failure("Unable to back up " + name + ": " + message, ResultCode::Storage, true);
+		}
+	}
+
+	// std::filesystem::rename replaces an existing target on every platform
+	// (MoveFileEx with MOVEFILE_REPLACE_EXISTING on Windows).
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+	{
+		const std::string message = error.message();
+		std::filesystem::remove(temporary, error);
+		return Result::Failure("Unable to replace " + name + ": " + message, ResultCode::Storage, true);
+	}
+	syncDirectory(path.parent_path());
+	return Result::Success();
+}
+
+#ifdef _WIN32
+void syncDirectory(const std::filesystem::path &) {}
+#else
+void syncDirectory(const std::filesystem::path &directory)
+{
+	const int descriptor = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (descriptor < 0)
+		return;
+	::fsync(descriptor);
+	::close(descriptor);
+}
+#endif
+} // namespace Utils
@@ -0,0 +1,115 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Utils
+{
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+Result MappedFile::open(const std::filesystem::path &path)
+{
+	close();
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return Result::Failure("Unable to open '" + path.string() + "'", ResultCode::NotFound);
+
+	LARGE_INTEGER size {};
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return Result::Failure("Unable to read the size of '" + path.string() + "'", ResultCode::Storage, true);
+	}
+	if (size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		open_ = true;
+		return Result::Success();
+	}
+
+	// The mapping keeps its own reference to the file.
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return Result::Failure("Unable to map '" + path.string() + "'", ResultCode::Storage, true);
+	const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		return Result::Failure("Unable to map '" + path.string() + "'", ResultCode::Storage, true);
+	}
+
+	mapping_ = mapping;
+	data_ = static_cast<const char *>(view);
+	size_ = static_cast<std::size_t>(size.QuadPart);
+	open_ = true;
+	return Result::Success();
+}
+
+void MappedFile::close()
+{
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle(static_cast<HANDLE>(mapping_));
+	mapping_ = nullptr;
+	data_ = nullptr;
+	size_ = 0;
+	open_ = false;
+}
+#else
+Result MappedFile::open(const std::filesystem::path &path)
+{
+	close();
+	const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		return Result::Failure("Unable to open '" + path.string() + "'", ResultCode::NotFound);
+
+	struct stat status {};
+	if (::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+	{
+		::close(descriptor);
+		return Result::Failure("'" + path.string() + "' is not a readable file", ResultCode::Storage);
+	}
+	if (status.st_size == 0)
+	{
+		::close(descriptor);
+		open_ = true;
+		return Result::Success();
+	}
+
+	// The mapping outlives the descriptor.
+	void *view = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	::close(descriptor);
+	if (view == MAP_FAILED)
+		return Result::Failure("Unable to map '" + path.string() + "'", ResultCode::Storage, true);
+	// Parsers read the file front to back exactly once.
+	::madvise(view, static_cast<std::size_t>(status.st_size), MADV_SEQUENTIAL);
+
+	data_ = static_cast<const char *>(view);
+	size_ = static_cast<std::size_t>(status.st_size);
+	open_ = true;
+	return Result::Success();
+}
+
+void MappedFile::close()
+{
+	if (data_)
+		::munmap(const_cast<char *>(data_), size_);
+	data_ = nullptr;
+	size_ = 0;
+	open_ = false;
+}
+#endif
+} // namespace Utils
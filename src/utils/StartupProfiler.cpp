@@ -0,0 +1,221 @@
+#include "StartupProfiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+namespace Utils
+{
+namespace
+{
+double toMilliseconds(std::chrono::nanoseconds value)
+{
+	return std::chrono::duration<double, std::milli>(value).count();
+}
+
+// Nearest-rank percentile of sorted samples.
+std::chrono::nanoseconds percentile(const std::vector<std::chrono::nanoseconds> &sorted, unsigned percent)
+{
+	const std::size_t rank = (sorted.size() * percent + 99) / 100;
+	return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+std::string quoted(const std::string &text)
+{
+	std::string result = "\"";
+	for (const char character : text)
+	{
+		if (character == '"' || character == '\\')
+			result.push_back('\\');
+		result.push_back(character);
+	}
+	result.push_back('"');
+	return result;
+}
+} // namespace
+
+StartupProfiler::Phase::Phase(StartupProfiler &profiler, std::string name)
+	: profiler_(profiler), name_(std::move(name)), wallStart_(Clock::now()), thread_(std::this_thread::get_id()), cpuStart_(threadCpuTime())
+{
+}
+
+StartupProfiler::Phase::~Phase()
+{
+	std::optional<std::chrono::nanoseconds> cpu;
+	if (std::this_thread::get_id() == thread_)
+		cpu = threadCpuTime() - cpuStart_;
+	profiler_.record(name_, Clock::now() - wallStart_, cpu);
+}
+
+StartupProfiler::StartupProfiler()
+	: startedAt_(std::chrono::system_clock::now()), wallStart_(Clock::now()), cpuStart_(processCpuTime())
+{
+}
+
+void StartupProfiler::recordSinceStart(const std::string &name)
+{
+	record(name, Clock::now() - wallStart_, processCpuTime() - cpuStart_);
+}
+
+void StartupProfiler::addSample(const std::string &series, std::chrono::nanoseconds elapsed)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	samples_[series].push_back(elapsed);
+}
+
+void StartupProfiler::record(const std::string &name, std::chrono::nanoseconds wall, std::optional<std::chrono::nanoseconds> cpu)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto [found, inserted] = phases_.try_emplace(name);
+	if (inserted)
+		order_.push_back(name);
+	found->second.wall += wall;
+	if (cpu)
+	{
+		found->second.cpu += *cpu;
+		found->second.cpuMeasured = true;
+	}
+	++found->second.count;
+}
+
+std::chrono::nanoseconds StartupProfiler::processCpuTime()
+{
+#if defined(_WIN32)
+	FILETIME creation {};
+	FILETIME exit {};
+	FILETIME kernel {};
+	FILETIME user {};
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return std::chrono::nanoseconds(0);
+	auto ticks = [](const FILETIME &time)
+	{
+		return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	};
+	// FILETIME counts 100 ns intervals.
+	return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+#else
+	rusage usage {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return std::chrono::nanoseconds(0);
+	auto toDuration = [](const timeval &time)
+	{
+		return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+	};
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(toDuration(usage.ru_utime) + toDuration(usage.ru_stime));
+#endif
+}
+
+std::chrono::nanoseconds StartupProfiler::threadCpuTime()
+{
+#if defined(_WIN32)
+	FILETIME creation {};
+	FILETIME exit {};
+	FILETIME kernel {};
+	FILETIME user {};
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return std::chrono::nanoseconds(0);
+	auto ticks = [](const FILETIME &time)
+	{
+		return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	};
+	return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+#else
+	timespec time {};
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+		return std::chrono::nanoseconds(0);
+	return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+#endif
+}
+
+std::string StartupProfiler::toJson() const
+{
+	const auto wallTotal = Clock::now() - wallStart_;
+	const auto cpuTotal = processCpuTime() - cpuStart_;
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(3);
+	json << "{\n"
+		<< "  \"started_unix\": " << std::chrono::duration_cast<std::chrono::seconds>(startedAt_.time_since_epoch()).count() << ",\n"
+		<< "  \"total_wall_ms\": " << toMilliseconds(wallTotal) << ",\n"
+		<< "  \"total_cpu_ms\": " << toMilliseconds(cpuTotal) << ",\n"
+		<< "  \"phases\": [";
+	for (std::size_t index = 0; index < order_.size(); ++index)
+	{
+		const PhaseTotals &totals = phases_.at(order_[index]);
+		json << (index == 0 ? "\n" : ",\n")
+			<< "    {\"name\": " << quoted(order_[index])
+			<< ", \"wall_ms\": " << toMilliseconds(totals.wall)
+			<< ", \"cpu_ms\": ";
+		if (totals.cpuMeasured)
+			json << toMilliseconds(totals.cpu);
+		else
+			json << "null";
+		json << ", \"count\": " << totals.count << "}";
+	}
+	json << (order_.empty() ? "],\n" : "\n  ],\n") << "  \"samples\": {";
+	bool first = true;
+	for (const auto &[series, values] : samples_)
+	{
+		if (values.empty())
+			continue;
+		std::vector<std::chrono::nanoseconds> sorted = values;
+		std::sort(sorted.begin(), sorted.end());
+		json << (first ? "\n" : ",\n")
+			<< "    " << quoted(series) << ": {\"count\": " << sorted.size()
+			<< ", \"p50_ms\": " << toMilliseconds(percentile(sorted, 50))
+			<< ", \"p90_ms\": " << toMilliseconds(percentile(sorted, 90))
+			<< ", \"p99_ms\": " << toMilliseconds(percentile(sorted, 99))
+			<< ", \"max_ms\": " << toMilliseconds(sorted.back()) << "}";
+		first = false;
+	}
+	json << (first ? "}\n" : "\n  }\n") << "}\n";
+	return json.str();
+}
+
+std::string StartupProfiler::summary() const
+{
+	const auto wallTotal = Clock::now() - wallStart_;
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1) << "Startup took " << toMilliseconds(wallTotal) << " ms";
+	for (std::size_t index = 0; index < order_.size(); ++index)
+	{
+		line << (index == 0 ? " (" : ", ") << order_[index] << ' '
+			<< toMilliseconds(phases_.at(order_[index]).wall) << " ms";
+	}
+	if (!order_.empty())
+		line << ')';
+	for (const auto &[series, values] : samples_)
+	{
+		if (values.empty())
+			continue;
+		std::vector<std::chrono::nanoseconds> sorted = values;
+		std::sort(sorted.begin(), sorted.end());
+		line << "; " << series << " p50 " << toMilliseconds(percentile(sorted, 50))
+			<< " ms, p99 " << toMilliseconds(percentile(sorted, 99)) << " ms over " << sorted.size();
+	}
+	return line.str();
+}
+
+Result StartupProfiler::writeReport(const std::filesystem::path &path) const
+{
+	const std::string report = toJson();
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return Result::Failure("Unable to open startup report '" + path.string() + "'", ResultCode::Storage, true);
+	file << report;
+	file.flush();
+	if (!file.good())
+		return Result::Failure("Unable to write startup report '" + path.string() + "'", ResultCode::Storage, true);
+	return Result::Success();
+}
+} // namespace Utils
@@ -5,6 +5,7 @@
 #include <thread>
 #include <atomic>
 #include "../include/app/ConfigManager.hpp"
+#include "../include/app/SearchEngine.hpp"
 
 namespace fs = std::filesystem;
 
@@ -209,6 +210,78 @@ TEST_F(ConfigManagerTest, PersistsSearchAndProxySettingsWithoutSecrets)
 	EXPECT_EQ(restored.getConfig().dump().find("api_key"), std::string::npos);
 }
 
+TEST_F(ConfigManagerTest, ControlSocketIsOptIn)
+{
+	ConfigManager manager;
+	const std::string configPath = (testDir / "control-settings.json").string();
+	ASSERT_TRUE(manager.load(configPath));
+	EXPECT_FALSE(manager.getControlSocketEnabled());
+	manager.setControlSocketEnabled(true);
+	manager.save(configPath);
+	manager.waitForAsyncOperations();
+
+	ConfigManager restored;
+	ASSERT_TRUE(restored.load(configPath));
+	EXPECT_TRUE(restored.getControlSocketEnabled());
+}
+
+TEST_F(ConfigManagerTest, QueueLimitsRoundTripThroughPreferences)
+{
+	ConfigManager manager;
+	const std::string configPath = (testDir / "queue-settings.json").string();
+	ASSERT_TRUE(manager.load(configPath));
+	PreferencesSettings candidate = manager.getPreferencesSettings();
+	EXPECT_EQ(candidate.activeDownloads, 3);
+	EXPECT_EQ(candidate.activeSeeds, 5);
+	EXPECT_EQ(candidate.activeLimit, 500);
+
+	candidate.activeDownloads = 8;
+	candidate.activeSeeds = 0;
+	candidate.activeLimit = -4;
+	ASSERT_TRUE(manager.savePreferencesCandidate(configPath, candidate).get());
+	ASSERT_TRUE(manager.commitPreferences(candidate));
+
+	ConfigManager restored;
+	ASSERT_TRUE(restored.load(configPath));
+	const PreferencesSettings saved = restored.getPreferencesSettings();
+	EXPECT_EQ(saved.activeDownloads, 8);
+	EXPECT_EQ(saved.activeSeeds, 0);
+	EXPECT_EQ(saved.activeLimit, 0);
+}
+
+TEST_F(ConfigManagerTest, GettersReadPublishedPreferencesSnapshot)
+{
+	const fs::path configPath = testDir / "snapshot-settings.json";
+	{
+		std::ofstream file(configPath);
+		file << R"({"version":2,"theme":"nord","settings":{"speed_limits":{"download":2048,"upload":0}}})";
+	}
+	ConfigManager manager;
+	ASSERT_TRUE(manager.load(configPath.string()));
+	EXPECT_EQ(manager.getTheme(), 2);
+	EXPECT_EQ(manager.getDownloadSpeedLimit(), 2048);
+	EXPECT_EQ(manager.getUploadSpeedLimit(), 0);
+	EXPECT_EQ(manager.getPreferencesSettings().theme, 2);
+
+	std::atomic<bool> writerDone{false};
+	std::thread reader([&]
+					   {
+						   while (!writerDone.load())
+						   {
+							   const std::string path = manager.getDownloadPath();
+							   EXPECT_FALSE(path.empty());
+						   }
+					   });
+	for (int i = 0; i < 200; ++i)
+		manager.setDownloadPath("/downloads/" + std::to_string(i));
+	writerDone = true;
+	reader.join();
+
+	EXPECT_EQ(manager.getDownloadPath(), "/downloads/199");
+	manager.setUploadSpeedLimit(512);
+	EXPECT_EQ(manager.getPreferencesSettings().uploadSpeedLimit, 512);
+}
+
 TEST_F(ConfigManagerTest, FillsMissingNestedDefaultsWithoutDroppingUnknownSettings)
 {
 	const std::string configPath = (testDir / "partial-settings.json").string();
@@ -428,6 +501,49 @@ TEST_F(ConfigManagerTest, IgnoresMalformedResumeDataAndKeepsFallbackIdentity)
 	EXPECT_FALSE(torrents.front().magnetUri.empty());
 }
 
+TEST_F(ConfigManagerTest, StreamsTorrentSnapshotIntoKeyedEntries)
+{
+	const fs::path snapshotPath = testDir / "streamed-torrents.json";
+	const fs::path journalPath = TorrentJournal::journalPathFor(snapshotPath);
+	const json snapshot = json::parse(R"({
+		"version": 2,
+		"ui": {"torrents": {"ignored": [1, 2]}},
+		"generation": 5,
+		"torrents": [
+			{"key": "a", "magnet_uri": "magnet:?xt=urn:btih:first", "save_path": "/downloads/a", "resume_data": "00Ff7a", "extra": {"nested": [true, null]}},
+			42,
+			{"key": "b", "torrent_path": "/torrents/b.torrent", "save_path": "/downloads/b"}
+		]
+	})");
+	std::ofstream(snapshotPath) << snapshot.dump();
+
+	// A journal put for "a" only applies if the streamed entry kept its key.
+	{
+		TorrentJournal journal;
+		ASSERT_TRUE(TorrentJournal::begin(journalPath, 5));
+		ASSERT_EQ(journal.restore(snapshot, journalPath).size(), 2u);
+		auto write = journal.stage({
+			{"a", {{"magnet_uri", "magnet:?xt=urn:btih:first"}, {"save_path", "/archive/a"}, {"resume_data", "00Ff7a"}}},
+			{"b", {{"torrent_path", "/torrents/b.torrent"}, {"save_path", "/downloads/b"}}}});
+		ASSERT_TRUE(write);
+		ASSERT_FALSE(write->compact);
+		ASSERT_TRUE(TorrentJournal::append(journalPath, write->records));
+	}
+
+	ConfigManager manager;
+	std::vector<TorrentConfigData> torrents;
+	ASSERT_TRUE(manager.loadTorrents(snapshotPath.string(), torrents));
+	ASSERT_EQ(torrents.size(), 2u);
+	EXPECT_EQ(torrents[0].savePath, "/archive/a");
+	EXPECT_EQ(torrents[0].resumeData, (std::vector<char>{'\x00', '\xff', '\x7a'}));
+	EXPECT_EQ(torrents[1].torrentFilePath, "/torrents/b.torrent");
+
+	std::ofstream(snapshotPath, std::ios::trunc) << R"({"version": 2, "torrents": {"key": "a"}})";
+	fs::remove(journalPath);
+	EXPECT_FALSE(manager.loadTorrents(snapshotPath.string(), torrents));
+	EXPECT_TRUE(torrents.empty());
+}
+
 TEST_F(ConfigManagerTest, RecoversTorrentsFromBackupAfterPrimaryParseFailure)
 {
 	ConfigManager manager;
@@ -456,6 +572,129 @@ TEST_F(ConfigManagerTest, RecoversTorrentsFromBackupAfterPrimaryParseFailure)
 	EXPECT_EQ(torrents[0].savePath, "/downloads/recovered");
 }
 
+TEST_F(ConfigManagerTest, TorrentJournalAppendsChangesAndReplaysThem)
+{
+	const fs::path snapshotPath = testDir / "torrents.json";
+	const fs::path journalPath = TorrentJournal::journalPathFor(snapshotPath);
+	const json first = {{"magnet_uri", "magnet:?xt=urn:btih:first"}, {"save_path", "/downloads/a"}};
+	const json second = {{"magnet_uri", "magnet:?xt=urn:btih:second"}, {"save_path", "/downloads/b"}};
+
+	TorrentJournal journal;
+	EXPECT_TRUE(journal.restore(json::object(), journalPath).empty());
+	auto compaction = journal.stage({{"a", first}, {"b", second}});
+	ASSERT_TRUE(compaction);
+	ASSERT_TRUE(compaction->compact);
+	std::ofstream(snapshotPath) << compaction->snapshot.dump();
+	ASSERT_TRUE(TorrentJournal::begin(journalPath, compaction->generation));
+
+	EXPECT_FALSE(journal.stage({{"a", first}, {"b", second}}));
+
+	json moved = first;
+	moved["save_path"] = "/archive/a";
+	const json third = {{"magnet_uri", "magnet:?xt=urn:btih:third"}, {"save_path", "/downloads/c"}};
+	auto append = journal.stage({{"a", moved}, {"c", third}});
+	ASSERT_TRUE(append);
+	EXPECT_FALSE(append->compact);
+	EXPECT_LT(append->records.size(), compaction->snapshot.dump().size() * 2);
+	ASSERT_TRUE(TorrentJournal::append(journalPath, append->records));
+
+	ConfigManager manager;
+	std::vector<TorrentConfigData> torrents;
+	ASSERT_TRUE(manager.loadTorrents(snapshotPath.string(), torrents));
+	ASSERT_EQ(torrents.size(), 2u);
+	EXPECT_EQ(torrents[0].savePath, "/archive/a");
+	EXPECT_EQ(torrents[1].magnetUri, "magnet:?xt=urn:btih:third");
+}
+
+TEST_F(ConfigManagerTest, TorrentJournalDropsTornTailsAndStaleGenerations)
+{
+	const fs::path journalPath = testDir / "torrents.json.journal";
+	const json entry = {{"magnet_uri", "magnet:?xt=urn:btih:first"}, {"save_path", "/downloads/a"}};
+	json keyed = entry;
+	keyed["key"] = "a";
+	const json snapshot = {{"version", 2}, {"generation", 3}, {"torrents", json::array({keyed})}};
+
+	ASSERT_TRUE(TorrentJournal::begin(journalPath, 3));
+	{
+		TorrentJournal current;
+		current.restore(snapshot, journalPath);
+		json moved = entry;
+		moved["save_path"] = "/archive/a";
+		auto write = current.stage({{"a", moved}});
+		ASSERT_TRUE(write);
+		ASSERT_FALSE(write->compact);
+		ASSERT_TRUE(TorrentJournal::append(journalPath, write->records));
+	}
+	std::ofstream(journalPath, std::ios::app) << "0badc0de {\"op\":\"remove\",\"ke";
+
+	TorrentJournal torn;
+	auto restored = torn.restore(snapshot, journalPath);
+	ASSERT_EQ(restored.size(), 1u);
+	EXPECT_EQ(restored[0].value["save_path"], "/archive/a");
+	auto rewrite = torn.stage(std::move(restored));
+	ASSERT_TRUE(rewrite);
+	EXPECT_TRUE(rewrite->compact);
+	EXPECT_EQ(rewrite->generation, 4u);
+
+	ASSERT_TRUE(TorrentJournal::begin(journalPath, 9));
+	TorrentJournal stale;
+	restored = stale.restore(snapshot, journalPath);
+	ASSERT_EQ(restored.size(), 1u);
+	EXPECT_EQ(restored[0].value["save_path"], "/downloads/a");
+}
+
+TEST_F(ConfigManagerTest, MovesLegacyFavoritesIntoCompactStore)
+{
+	const fs::path settingsPath = testDir / "favorites-settings.json";
+	const fs::path favoritesPath = testDir / "favorites.json";
+	{
+		std::ofstream file(settingsPath);
+		file << R"({"version":2,"settings":{},"search_history":["ubuntu","debian"],"favorites":[)"
+			 << R"({"name":"Ubuntu","magnet_uri":"magnet:?xt=urn:btih:aa","info_hash":"aa","size_bytes":1024,"seeders":7,"created_unix":1700000000},)"
+			 << R"({"name":"Debian","info_hash":"bb","completed":3}]})";
+	}
+	ConfigManager manager;
+	ASSERT_TRUE(manager.load(settingsPath.string()));
+
+	std::vector<TorrentSearchResult> favorites;
+	std::vector<std::string> history;
+	ASSERT_TRUE(manager.loadFavoritesAndHistory(favoritesPath.string(), favorites, history));
+	ASSERT_EQ(favorites.size(), 2u);
+	EXPECT_EQ(favorites[0].name, "Ubuntu");
+	EXPECT_EQ(favorites[0].sizeBytes, 1024u);
+	EXPECT_EQ(favorites[0].createdUnix, 1700000000);
+	EXPECT_EQ(favorites[1].completed, 3);
+	EXPECT_EQ(history, (std::vector<std::string>{"ubuntu", "debian"}));
+	EXPECT_FALSE(manager.getConfig().contains("favorites"));
+	EXPECT_FALSE(manager.getConfig().contains("search_history"));
+
+	manager.save(settingsPath.string());
+	manager.waitForAsyncOperations();
+	json settings;
+	std::ifstream(settingsPath) >> settings;
+	EXPECT_FALSE(settings.contains("favorites"));
+
+	json stored;
+	std::ifstream(favoritesPath) >> stored;
+	ASSERT_TRUE(stored["favorites"].is_array());
+	EXPECT_TRUE(stored["favorites"][0].is_array());
+	EXPECT_EQ(stored["columns"][0], "info_hash");
+
+	// Rows map through the stored column names, so reordered or unknown
+	// columns still decode.
+	{
+		std::ofstream file(favoritesPath, std::ios::trunc);
+		file << R"({"version":1,"columns":["future","name","info_hash"],"favorites":[[1,"Arch","cc"],[2,"No hash"]],"search_history":["arch"]})";
+	}
+	ConfigManager restored;
+	ASSERT_TRUE(restored.load(settingsPath.string()));
+	ASSERT_TRUE(restored.loadFavoritesAndHistory(favoritesPath.string(), favorites, history));
+	ASSERT_EQ(favorites.size(), 1u);
+	EXPECT_EQ(favorites[0].name, "Arch");
+	EXPECT_EQ(favorites[0].infoHash, "cc");
+	EXPECT_EQ(history, std::vector<std::string>{"arch"});
+}
+
 TEST_F(ConfigManagerTest, AtomicSaveCreatesBackup)
 {
 	ConfigManager manager;
@@ -478,6 +717,71 @@ TEST_F(ConfigManagerTest, AtomicSaveCreatesBackup)
 	EXPECT_EQ(backup["settings"]["download_path"], "/first");
 }
 
+TEST_F(ConfigManagerTest, CoalescesQueuedSavesAndSkipsUnchangedContent)
+{
+	ConfigManager manager;
+	const std::string configPath = (testDir / "coalesced.json").string();
+
+	for (int index = 0; index < 50; ++index)
+	{
+		manager.setDownloadPath("/downloads/" + std::to_string(index));
+		manager.save(configPath);
+	}
+	manager.waitForAsyncOperations();
+	json current;
+	std::ifstream(configPath) >> current;
+	EXPECT_EQ(current["settings"]["download_path"], "/downloads/49");
+
+	manager.setDownloadPath("/final");
+	manager.save(configPath);
+	manager.waitForAsyncOperations();
+	json backup;
+	std::ifstream(configPath + ".bak") >> backup;
+	EXPECT_EQ(backup["settings"]["download_path"], "/downloads/49");
+
+	// An identical snapshot must not rotate the backup again.
+	manager.save(configPath);
+	manager.waitForAsyncOperations();
+	std::ifstream(configPath + ".bak") >> backup;
+	EXPECT_EQ(backup["settings"]["download_path"], "/downloads/49");
+
+	// Edits made outside the worker are overwritten on the next save.
+	std::ofstream(configPath, std::ios::trunc) << "{}";
+	manager.save(configPath);
+	manager.waitForAsyncOperations();
+	std::ifstream(configPath) >> current;
+	EXPECT_EQ(current["settings"]["download_path"], "/final");
+}
+
+TEST_F(ConfigManagerTest, StreamsLargeDocumentsAndWritesTorrentsCompactly)
+{
+	ConfigManager settings;
+	const std::string settingsPath = (testDir / "large.json").string();
+	const std::string longPath(200 * 1024, 'x');
+	settings.setDownloadPath(longPath);
+	settings.save(settingsPath);
+	settings.waitForAsyncOperations();
+	json current;
+	std::ifstream(settingsPath) >> current;
+	EXPECT_EQ(current["settings"]["download_path"], longPath);
+	EXPECT_FALSE(fs::exists(settingsPath + ".tmp"));
+
+	ConfigManager torrents;
+	const std::string torrentsPath = (testDir / "torrents.json").string();
+	std::vector<TorrentConfigData> loaded;
+	ASSERT_TRUE(torrents.loadTorrents(torrentsPath, loaded));
+	torrents.saveTorrents({});
+	torrents.waitForAsyncOperations();
+	std::ifstream file(torrentsPath);
+	std::string firstLine;
+	std::string rest;
+	std::getline(file, firstLine);
+	std::getline(file, rest);
+	EXPECT_TRUE(rest.empty());
+	EXPECT_EQ(json::parse(firstLine)["torrents"], json::array());
+	EXPECT_TRUE(fs::exists(TorrentJournal::journalPathFor(torrentsPath)));
+}
+
 TEST_F(ConfigManagerTest, RecoversFromBackupWhenPrimaryIsMissing)
 {
 	ConfigManager manager;
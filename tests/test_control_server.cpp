@@ -0,0 +1,374 @@
+#include <gtest/gtest.h>
+
+#include "ControlServer.hpp"
+#include "SearchEngine.hpp"
+#include "TorrentManager.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+TEST(ControlOutboxTest, WithholdsNotificationsAboveWatermarkButKeepsResponses)
+{
+	ControlOutbox outbox(16, 64);
+	ASSERT_TRUE(outbox.pushNotification("0123456789"));
+	ASSERT_TRUE(outbox.pushNotification("0123456789"));
+	EXPECT_FALSE(outbox.acceptsNotifications());
+	EXPECT_FALSE(outbox.pushNotification("x"));
+	EXPECT_TRUE(outbox.pushResponse("response"));
+	EXPECT_EQ(outbox.pending(), "0123456789\n0123456789\nresponse\n");
+
+	outbox.consume(22);
+	EXPECT_TRUE(outbox.acceptsNotifications());
+	EXPECT_EQ(outbox.pending(), "response\n");
+}
+
+TEST(ControlOutboxTest, RejectsResponsesPastHardLimit)
+{
+	ControlOutbox outbox(8, 16);
+	EXPECT_TRUE(outbox.pushResponse("0123456789"));
+	EXPECT_FALSE(outbox.pushResponse("0123456789"));
+	outbox.consume(outbox.size());
+	EXPECT_TRUE(outbox.empty());
+	EXPECT_TRUE(outbox.pushResponse("0123456789"));
+}
+
+#ifndef _WIN32
+namespace
+{
+std::filesystem::path makeUniqueTestDirectory()
+{
+	const auto base = std::filesystem::temp_directory_path();
+	std::random_device random;
+
+	for (int attempt = 0; attempt < 100; ++attempt)
+	{
+		const auto candidate = base / ("ht-control-" + std::to_string(random() % 1000000));
+		std::error_code error;
+		if (std::filesystem::create_directory(candidate, error))
+			return candidate;
+	}
+
+	throw std::runtime_error("Unable to create unique control test directory");
+}
+
+class ControlConnection
+{
+public:
+	explicit ControlConnection(const std::filesystem::path &path)
+	{
+		socket_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		const std::string native = path.string();
+		std::copy(native.begin(), native.end(), address.sun_path);
+		connected_ = socket_ >= 0 && ::connect(socket_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+	}
+
+	~ControlConnection()
+	{
+		if (socket_ >= 0)
+			::close(socket_);
+	}
+
+	bool connected() const { return connected_; }
+
+	void send(const std::string &line)
+	{
+		const std::string payload = line + "\n";
+		ASSERT_EQ(::send(socket_, payload.data(), payload.size(), 0), static_cast<ssize_t>(payload.size()));
+	}
+
+	std::optional<json> read(std::chrono::milliseconds timeout = std::chrono::seconds(5))
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (true)
+		{
+			const auto newline = buffer_.find('\n');
+			if (newline != std::string::npos)
+			{
+				const std::string line = buffer_.substr(0, newline);
+				buffer_.erase(0, newline + 1);
+				return json::parse(line);
+			}
+			const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			if (remaining.count() <= 0)
+				return std::nullopt;
+			pollfd descriptor{socket_, POLLIN, 0};
+			if (::poll(&descriptor, 1, static_cast<int>(remaining.count())) <= 0)
+				return std::nullopt;
+			char chunk[4096];
+			const auto received = ::recv(socket_, chunk, sizeof(chunk), 0);
+			if (received <= 0)
+				return std::nullopt;
+			buffer_.append(chunk, static_cast<std::size_t>(received));
+		}
+	}
+
+	json call(const json &request)
+	{
+		send(request.dump());
+		auto response = read();
+		return response ? *response : json();
+	}
+
+private:
+	int socket_ = -1;
+	bool connected_ = false;
+	std::string buffer_;
+};
+
+class ControlServerTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		testDirectory = makeUniqueTestDirectory();
+		std::filesystem::create_directories(testDirectory / "downloads");
+		socketPath = testDirectory / "control.sock";
+		ControlServerOptions options;
+		options.defaultSavePath = [this]() { return (testDirectory / "downloads").string(); };
+		options.statusInterval = std::chrono::milliseconds(50);
+		ASSERT_TRUE(server.start(socketPath, std::move(options)));
+	}
+
+	void TearDown() override
+	{
+		server.stop();
+		std::error_code error;
+		std::filesystem::remove_all(testDirectory, error);
+	}
+
+	std::filesystem::path writeTorrentFile()
+	{
+		const auto path = testDirectory / "fixture.torrent";
+		std::string content = "d4:infod6:lengthi1e4:name7:fixture12:piece lengthi16384e6:pieces20:";
+		content.append(20, '\0');
+		content += "ee";
+		std::ofstream file(path, std::ios::binary);
+		file.write(content.data(), static_cast<std::streamsize>(content.size()));
+		return path;
+	}
+
+	std::filesystem::path testDirectory;
+	std::filesystem::path socketPath;
+	TorrentManager torrentManager;
+	SearchEngine searchEngine;
+	ControlServer server{torrentManager, searchEngine};
+};
+} // namespace
+
+TEST_F(ControlServerTest, BatchAnswersCallsAndSkipsNotifications)
+{
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+
+	// One message per line: a batch must not contain raw newlines.
+	connection.send(R"([{"jsonrpc":"2.0","id":1,"method":"server.info"},)"
+					R"({"jsonrpc":"2.0","method":"server.info"},)"
+					R"({"jsonrpc":"2.0","id":"two","method":"missing.method"},)"
+					R"({"jsonrpc":"1.0","id":3,"method":"server.info"}])");
+	const auto response = connection.read();
+	ASSERT_TRUE(response);
+	ASSERT_TRUE(response->is_array());
+	ASSERT_EQ(response->size(), 3u);
+	EXPECT_EQ((*response)[0]["id"], 1);
+	EXPECT_EQ((*response)[0]["result"]["protocol"], 1);
+	EXPECT_EQ((*response)[1]["id"], "two");
+	EXPECT_EQ((*response)[1]["error"]["code"], -32601);
+	EXPECT_EQ((*response)[2]["id"], 3);
+	EXPECT_EQ((*response)[2]["error"]["code"], -32600);
+}
+
+TEST_F(ControlServerTest, ReportsParseErrorsAndEmptyBatches)
+{
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+
+	connection.send("{not json");
+	auto response = connection.read();
+	ASSERT_TRUE(response);
+	EXPECT_EQ((*response)["error"]["code"], -32700);
+	EXPECT_TRUE((*response)["id"].is_null());
+
+	response = connection.call(json::array());
+	EXPECT_EQ(response.value()["error"]["code"], -32600);
+}
+
+TEST_F(ControlServerTest, BulkOperationsReportPerItemResults)
+{
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+
+	const auto added = connection.call({{"jsonrpc", "2.0"}, {"id", 1}, {"method", "torrent.add"},
+		{"params", {{"items", json::array({
+			{{"magnet", "not-a-magnet"}},
+			{{"file", (testDirectory / "missing.torrent").string()}},
+			json("not an object")})}}}});
+	ASSERT_TRUE(added.contains("result"));
+	EXPECT_EQ(added["result"]["added"], 0);
+	ASSERT_EQ(added["result"]["results"].size(), 3u);
+	for (const auto &item : added["result"]["results"])
+	{
+		EXPECT_FALSE(item["ok"].get<bool>());
+		EXPECT_EQ(item["error"]["code"], -32602);
+	}
+
+	const auto command = connection.call({{"jsonrpc", "2.0"}, {"id", 2}, {"method", "torrent.command"},
+		{"params", {{"command", "pause"}, {"ids", {"v1:0000000000000000000000000000000000000000", "bad"}}}}});
+	ASSERT_TRUE(command.contains("result"));
+	ASSERT_EQ(command["result"]["results"].size(), 2u);
+	EXPECT_FALSE(command["result"]["results"][0]["ok"].get<bool>());
+	EXPECT_FALSE(command["result"]["results"][1]["ok"].get<bool>());
+
+	const auto unknown = connection.call({{"jsonrpc", "2.0"}, {"id", 3}, {"method", "torrent.command"},
+		{"params", {{"command", "explode"}, {"ids", json::array()}}}});
+	EXPECT_EQ(unknown["error"]["code"], -32602);
+	EXPECT_EQ(unknown["error"]["data"]["reason"], "InvalidInput");
+
+	const auto queued = connection.call({{"jsonrpc", "2.0"}, {"id", 4}, {"method", "torrent.queue"},
+		{"params", {{"position", "top"}, {"ids", {"bad"}}}}});
+	ASSERT_TRUE(queued.contains("result"));
+	ASSERT_EQ(queued["result"]["results"].size(), 1u);
+	EXPECT_FALSE(queued["result"]["results"][0]["ok"].get<bool>());
+
+	const auto badPosition = connection.call({{"jsonrpc", "2.0"}, {"id", 5}, {"method", "torrent.queue"},
+		{"params", {{"position", "middle"}, {"ids", {"bad"}}}}});
+	EXPECT_EQ(badPosition["error"]["code"], -32602);
+}
+
+TEST_F(ControlServerTest, QueueReportsEachItemAgainstItsId)
+{
+	ASSERT_TRUE(torrentManager.addTorrent(writeTorrentFile().string(), (testDirectory / "downloads").string()));
+	torrentManager.refreshStatusCache();
+
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+	const auto listed = connection.call({{"jsonrpc", "2.0"}, {"id", 1}, {"method", "torrent.list"},
+		{"params", {{"fields", {"name"}}}}});
+	ASSERT_EQ(listed["result"]["torrents"].size(), 1u);
+	const std::string id = listed["result"]["torrents"][0]["id"];
+
+	for (const json &position : {json("bottom"), json(0)})
+	{
+		const auto queued = connection.call({{"jsonrpc", "2.0"}, {"id", 2}, {"method", "torrent.queue"},
+			{"params", {{"position", position}, {"ids", {"bad", id}}}}});
+		ASSERT_TRUE(queued.contains("result"));
+		const auto &results = queued["result"]["results"];
+		ASSERT_EQ(results.size(), 2u);
+		EXPECT_FALSE(results[0]["ok"].get<bool>());
+		EXPECT_TRUE(results[1]["ok"].get<bool>()) << results[1].dump();
+	}
+}
+
+TEST_F(ControlServerTest, ListProjectsRequestedFieldsAndRejectsUnknownOnes)
+{
+	ASSERT_TRUE(torrentManager.addTorrent(writeTorrentFile().string(), (testDirectory / "downloads").string()));
+	torrentManager.refreshStatusCache();
+
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+	const auto listed = connection.call({{"jsonrpc", "2.0"}, {"id", 1}, {"method", "torrent.list"},
+		{"params", {{"fields", {"name", "progress"}}}}});
+	ASSERT_TRUE(listed.contains("result"));
+	ASSERT_EQ(listed["result"]["torrents"].size(), 1u);
+	const auto &row = listed["result"]["torrents"][0];
+	EXPECT_EQ(row.size(), 3u);
+	EXPECT_TRUE(row.contains("id"));
+	EXPECT_EQ(row["name"], "fixture");
+	EXPECT_TRUE(row.contains("progress"));
+
+	const auto rejected = connection.call({{"jsonrpc", "2.0"}, {"id", 2}, {"method", "torrent.list"},
+		{"params", {{"fields", {"password"}}}}});
+	EXPECT_EQ(rejected["error"]["code"], -32602);
+}
+
+TEST_F(ControlServerTest, SearchRunsThroughActiveProvider)
+{
+	ASSERT_TRUE(searchEngine.registerSearchProvider(
+		"control-fixture",
+		[](const SearchQuery &query, SearchResponse &response, const std::function<bool()> &) {
+			response.torrents.emplace_back(query.query, "magnet:?xt=urn:btih:fixture", "fixture", 42, 3, 1, "", "Test");
+			response.nextToken = "page-2";
+			response.hasMore = true;
+			return Result::Success();
+		}));
+	ASSERT_TRUE(searchEngine.setActiveSearchProvider("control-fixture"));
+
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+	const auto response = connection.call({{"jsonrpc", "2.0"}, {"id", 7}, {"method", "search.query"},
+		{"params", {{"query", "ubuntu"}}}});
+	ASSERT_TRUE(response.contains("result"));
+	ASSERT_EQ(response["result"]["torrents"].size(), 1u);
+	EXPECT_EQ(response["result"]["torrents"][0]["name"], "ubuntu");
+	EXPECT_EQ(response["result"]["nextToken"], "page-2");
+	EXPECT_TRUE(response["result"]["hasMore"].get<bool>());
+}
+
+TEST_F(ControlServerTest, StatusSubscriptionStreamsSnapshotThenRemovals)
+{
+	ControlConnection connection(socketPath);
+	ASSERT_TRUE(connection.connected());
+	const auto subscribed = connection.call({{"jsonrpc", "2.0"}, {"id", 1}, {"method", "subscribe"},
+		{"params", {{"topics", {"status"}}, {"fields", {"name"}}}}});
+	ASSERT_EQ(subscribed["result"]["topics"], json::array({"status"}));
+
+	ASSERT_TRUE(torrentManager.addTorrent(writeTorrentFile().string(), (testDirectory / "downloads").string()));
+	std::optional<json> delta;
+	while ((delta = connection.read()) && (*delta)["params"]["changed"].empty())
+	{
+	}
+	ASSERT_TRUE(delta);
+	EXPECT_EQ((*delta)["method"], "status.delta");
+	ASSERT_EQ((*delta)["params"]["changed"].size(), 1u);
+	const std::string id = (*delta)["params"]["changed"][0]["id"];
+
+	const auto removed = connection.call({{"jsonrpc", "2.0"}, {"id", 2}, {"method", "torrent.remove"},
+		{"params", {{"ids", {id}}}}});
+	ASSERT_TRUE(removed.contains("result"));
+	EXPECT_TRUE(removed["result"]["results"][0]["ok"].get<bool>());
+	while ((delta = connection.read()) && (*delta)["params"]["removed"].empty())
+	{
+	}
+	ASSERT_TRUE(delta);
+	EXPECT_EQ((*delta)["params"]["removed"], json::array({id}));
+}
+
+TEST_F(ControlServerTest, RefusesSecondServerOnLiveSocketAndReplacesStaleOne)
+{
+	TorrentManager otherManager;
+	SearchEngine otherEngine;
+	ControlServer other(otherManager, otherEngine);
+	Result busy = other.start(socketPath);
+	EXPECT_FALSE(busy);
+	EXPECT_EQ(busy.code, ResultCode::Busy);
+
+	server.stop();
+	EXPECT_FALSE(std::filesystem::exists(socketPath));
+	{
+		std::ofstream stale(socketPath);
+	}
+	// Whatever is left at the path is replaced once the connection probe shows
+	// that nothing is listening behind it.
+	EXPECT_TRUE(other.start(socketPath));
+	ControlConnection connection(socketPath);
+	EXPECT_TRUE(connection.connected());
+	other.stop();
+}
+#endif
@@ -7,6 +7,8 @@
 #include "utils/TorrentIdentity.hpp"
 
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
 #include <thread>
@@ -229,4 +231,87 @@ TEST(SearchPresenterTest, RejectsEmptyQueriesWithoutStartingWork)
 	EXPECT_EQ(result.code, ResultCode::InvalidInput);
 	EXPECT_EQ(presenter.state(), Presentation::SearchState::Idle);
 }
+
+TEST(SearchPresenterTest, ShowsLocalMatchesUntilProvidersAnswer)
+{
+	SearchEngine engine;
+	int seeders = 1;
+	ASSERT_TRUE(engine.registerSearchProvider("fixture",
+		[&seeders](const SearchQuery &, SearchResponse &response, const std::function<bool()> &)
+		{
+			response.torrents.emplace_back("Ubuntu 24.04 Desktop", "magnet:?xt=urn:btih:ubuntu", "ubuntu", 4096, seeders, 0, "", "Linux");
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("fixture"));
+	SearchResponse seen;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("ubuntu"), seen));
+	engine.clearSearchCache();
+	seeders = 9;
+
+	Presentation::SearchPresenter presenter(engine);
+	ASSERT_TRUE(presenter.startSearch("ubunt"));
+	ASSERT_EQ(presenter.results().size(), 1u);
+	EXPECT_EQ(presenter.results().front().seeders, 1);
+	EXPECT_EQ(presenter.state(), Presentation::SearchState::Loading);
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (presenter.isSearching() && std::chrono::steady_clock::now() < deadline)
+	{
+		presenter.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	EXPECT_EQ(presenter.state(), Presentation::SearchState::Results);
+	ASSERT_EQ(presenter.results().size(), 1u);
+	EXPECT_EQ(presenter.results().front().seeders, 9);
+}
+
+TEST(SearchPresenterTest, FillsResultsFromStreamedBatchesBeforeCompletion)
+{
+	SearchEngine engine;
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool released = false;
+	ASSERT_TRUE(engine.registerStreamingSearchProvider("streaming",
+		[&](const SearchQuery &, SearchResponse &response, const std::function<bool()> &, const SearchEngine::SearchResultSink &sink)
+		{
+			sink({TorrentSearchResult("Alpha", "", "aaaa", 1, 1, 0, "", ""),
+				TorrentSearchResult("Withdrawn", "", "cccc", 1, 1, 0, "", "")});
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return released; });
+			response.torrents.emplace_back("Alpha", "", "aaaa", 1, 7, 0, "", "");
+			response.torrents.emplace_back("Beta", "", "bbbb", 1, 2, 0, "", "");
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("streaming"));
+
+	Presentation::SearchPresenter presenter(engine);
+	ASSERT_TRUE(presenter.startSearch("streamed"));
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (presenter.results().size() < 2 && std::chrono::steady_clock::now() < deadline)
+	{
+		presenter.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_EQ(presenter.results().size(), 2u);
+	EXPECT_EQ(presenter.results()[0].name, "Alpha");
+	EXPECT_EQ(presenter.state(), Presentation::SearchState::Loading);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		released = true;
+	}
+	changed.notify_all();
+	while (presenter.isSearching() && std::chrono::steady_clock::now() < deadline)
+	{
+		presenter.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_EQ(presenter.state(), Presentation::SearchState::Results);
+	// The final answer replaces streamed copies in place and withdraws the
+	// one it no longer contains.
+	ASSERT_EQ(presenter.results().size(), 2u);
+	EXPECT_EQ(presenter.results()[0].name, "Alpha");
+	EXPECT_EQ(presenter.results()[0].seeders, 7);
+	EXPECT_EQ(presenter.results()[1].name, "Beta");
+}
 } // namespace
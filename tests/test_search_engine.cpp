@@ -1,12 +1,28 @@
 #include <gtest/gtest.h>
 #include "SearchEngine.hpp"
+#include "ConfigManager.hpp"
+#include "SearchResponseParser.hpp"
+#include "SearchCache.hpp"
+#include "LocalSearchIndex.hpp"
+#include "HttpClient.hpp"
 #include <vector>
+#include <map>
 #include <string>
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <climits>
+#include <filesystem>
+#include <atomic>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 // Define the test class to be a friend
 class SearchEngineTest : public ::testing::Test {
@@ -31,6 +47,22 @@ protected:
     std::string buildSearchUrl(const SearchQuery& query) {
         return engine.buildSearchUrl(query);
     }
+
+	Result httpGet(const std::string &url, std::string &body) {
+		return engine.makeHttpRequest(url, body);
+	}
+
+	SearchCache &searchCache() {
+		return *engine.searchCache;
+	}
+
+	HttpClient &httpClient() {
+		return *engine.httpClient;
+	}
+
+	Result performSearch(const SearchQuery &query, SearchResponse &response, const SearchEngine::SearchResultSink &sink) {
+		return engine.performSearch(query, response, sink);
+	}
 };
 
 TEST_F(SearchEngineTest, ParseValidArrayResponse) {
@@ -208,6 +240,73 @@ TEST_F(SearchEngineTest, ParseDuplicates) {
     ASSERT_EQ(response.torrents.size(), 1); // Should only have 1 due to deduplication in overload 2
 }
 
+TEST_F(SearchEngineTest, StreamingParserIsIndependentOfChunkBoundaries) {
+	const std::string body = "\xEF\xBB\xBF" R"({
+		"meta": {"took": 3, "tags": ["a", {"name": "not a torrent"}], "ok": true, "none": null},
+		"torrents": [
+			{"name": "Caf\u00e9 \"quoted\" \ud83d\ude00", "infohash": "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA",
+			 "size_bytes": 18446744073709551615, "seeders": -4, "leechers": 2.5, "created_unix": 1700000000,
+			 "extra": {"name": 1, "infohash": [1, 2]}, "completed": 12},
+			{"name": "Duplicate", "infohash": "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"},
+			{"name": ["not", "a", "string"], "infohash": "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"},
+			"not an object",
+			{"name": "Tabs\tand\nlines\/", "infohash": "cccccccccccccccccccccccccccccccccccccccc", "seeders": 1e3}
+		],
+		"data": [{"name": "Ignored", "infohash": "dddddddddddddddddddddddddddddddddddddddd"}],
+		"next": 1700000000123
+	})";
+
+	SearchResponse whole;
+	ASSERT_TRUE(parseResponse(body, whole));
+	ASSERT_EQ(whole.torrents.size(), 2u);
+	EXPECT_EQ(whole.torrents[0].name, "Caf\xC3\xA9 \"quoted\" \xF0\x9F\x98\x80");
+	EXPECT_EQ(whole.torrents[0].infoHash, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+	EXPECT_EQ(whole.torrents[0].sizeBytes, SIZE_MAX);
+	EXPECT_EQ(whole.torrents[0].seeders, 0);
+	EXPECT_EQ(whole.torrents[0].leechers, 0);
+	EXPECT_EQ(whole.torrents[0].dateUploaded, "1700000000");
+	EXPECT_EQ(whole.torrents[0].completed, 12);
+	EXPECT_EQ(whole.torrents[1].name, "Tabs\tand\nlines/");
+	EXPECT_EQ(whole.torrents[1].seeders, 0);
+	EXPECT_EQ(whole.nextToken, "1700000000123");
+	EXPECT_TRUE(whole.hasMore);
+
+	for (const std::size_t chunkSize : {std::size_t{1}, std::size_t{2}, std::size_t{7}, std::size_t{64}}) {
+		SearchResponse streamed;
+		TorrentsCsvParser parser(streamed, true);
+		for (std::size_t offset = 0; offset < body.size(); offset += chunkSize)
+			ASSERT_TRUE(parser.feed(std::string_view(body).substr(offset, chunkSize))) << chunkSize;
+		ASSERT_TRUE(parser.finish()) << chunkSize;
+		ASSERT_EQ(streamed.torrents.size(), whole.torrents.size()) << chunkSize;
+		for (std::size_t index = 0; index < whole.torrents.size(); ++index) {
+			EXPECT_EQ(streamed.torrents[index].name, whole.torrents[index].name);
+			EXPECT_EQ(streamed.torrents[index].magnetUri, whole.torrents[index].magnetUri);
+		}
+		EXPECT_EQ(streamed.nextToken, whole.nextToken);
+	}
+
+	// Results are available as each object closes, and a malformed body is
+	// rejected where it breaks rather than at the end.
+	SearchResponse partial;
+	TorrentsCsvParser parser(partial, true);
+	EXPECT_TRUE(parser.feed(R"({"torrents": [{"name": "First", "infohash": "1111111111111111111111111111111111111111"}, )"));
+	EXPECT_EQ(partial.torrents.size(), 1u);
+	EXPECT_FALSE(parser.feed(R"({"name": "Second",]})"));
+	EXPECT_FALSE(parser.finish());
+	parser.reset();
+	EXPECT_TRUE(partial.torrents.empty());
+
+	SearchResponse fallback;
+	ASSERT_TRUE(parseResponse(R"({"torrents": "none", "data": [{"name": "Data", "infohash": "2222222222222222222222222222222222222222"}]})", fallback));
+	ASSERT_EQ(fallback.torrents.size(), 1u);
+	EXPECT_EQ(fallback.torrents[0].name, "Data");
+
+	for (const char *malformed : {"", "  ", "[", "[1,]", "{\"torrents\": [] ", "[] []", "[tru]", "[01]", "[\"\\ud800\"]", "{\"a\" 1}"}) {
+		SearchResponse rejected;
+		EXPECT_FALSE(parseResponse(malformed, rejected)) << malformed;
+	}
+}
+
 TEST_F(SearchEngineTest, ParseNumericFields) {
     std::string json = R"([
         {
@@ -305,6 +404,314 @@ TEST_F(SearchEngineTest, ReusesBoundedCacheForIdenticalProviderQuery) {
 	ASSERT_EQ(second.torrents.size(), 1u);
 }
 
+TEST_F(SearchEngineTest, SearchCacheEvictsLeastRecentlyUsedWithinByteBudget) {
+	auto page = [](const std::string &name) {
+		SearchResponse response;
+		response.torrents.emplace_back(name, "magnet:?xt=urn:btih:" + name, name, 1, 1, 0, "", "Test");
+		return response;
+	};
+	const std::size_t pageBytes = SearchCache::estimateBytes(page("a"));
+	SearchCache::Limits limits;
+	limits.maxBytes = pageBytes * 2;
+	SearchCache cache(limits);
+
+	const uint64_t first = SearchCache::makeKey("p", "a", 0, "");
+	const uint64_t second = SearchCache::makeKey("p", "b", 0, "");
+	const uint64_t third = SearchCache::makeKey("p", "c", 0, "");
+	EXPECT_NE(first, SearchCache::makeKey("p", "a", 0, "next"));
+	EXPECT_NE(SearchCache::makeKey("ab", "c", 0, ""), SearchCache::makeKey("a", "bc", 0, ""));
+
+	cache.store(first, page("a"));
+	cache.store(second, page("b"));
+	SearchResponse response;
+	bool refresh = false;
+	// Touching the first page makes the second the eviction candidate.
+	ASSERT_EQ(cache.lookup(first, response, refresh), SearchCache::Hit::Fresh);
+	cache.store(third, page("c"));
+	EXPECT_EQ(cache.size(), 2u);
+	EXPECT_LE(cache.bytes(), limits.maxBytes);
+	EXPECT_EQ(cache.lookup(second, response, refresh), SearchCache::Hit::Miss);
+	EXPECT_EQ(cache.lookup(first, response, refresh), SearchCache::Hit::Fresh);
+	ASSERT_EQ(response.torrents.size(), 1u);
+	EXPECT_EQ(response.torrents.front().name, "a");
+
+	// Only the first caller to see a stale page is asked to refresh it.
+	const auto later = SearchCache::Clock::now() + limits.freshFor + std::chrono::seconds(1);
+	EXPECT_EQ(cache.lookup(third, response, refresh, later), SearchCache::Hit::Stale);
+	EXPECT_TRUE(refresh);
+	EXPECT_EQ(cache.lookup(third, response, refresh, later), SearchCache::Hit::Stale);
+	EXPECT_FALSE(refresh);
+	cache.releaseRefresh(third);
+	EXPECT_EQ(cache.lookup(third, response, refresh, later), SearchCache::Hit::Stale);
+	EXPECT_TRUE(refresh);
+	EXPECT_EQ(cache.lookup(third, response, refresh, later + limits.staleFor), SearchCache::Hit::Miss);
+}
+
+TEST_F(SearchEngineTest, SearchCacheFileKeepsPagesAcrossInstances) {
+	namespace fs = std::filesystem;
+	const fs::path directory = fs::temp_directory_path() / ("hypertube_search_cache_test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+	const fs::path path = directory / "search-cache.json";
+	const uint64_t key = SearchCache::makeKey("torrents-csv", "ubuntu", 0, "");
+	{
+		SearchCache cache;
+		SearchResponse response;
+		response.torrents.emplace_back("Ubuntu \xff", "magnet:?xt=urn:btih:aa", "aa", 4096, 12, 3, "2024-01-01", "Linux", 1700000000, 1700000100, 40);
+		response.nextToken = "2";
+		response.hasMore = true;
+		cache.store(key, response);
+		ASSERT_TRUE(cache.save(path, "scope"));
+	}
+
+	SearchCache other;
+	ASSERT_TRUE(other.load(path, "other scope"));
+	EXPECT_EQ(other.size(), 0u);
+
+	SearchCache cache;
+	ASSERT_TRUE(cache.load(path, "scope"));
+	SearchResponse response;
+	bool refresh = false;
+	ASSERT_NE(cache.lookup(key, response, refresh), SearchCache::Hit::Miss);
+	ASSERT_EQ(response.torrents.size(), 1u);
+	EXPECT_EQ(response.torrents.front().infoHash, "aa");
+	EXPECT_EQ(response.torrents.front().sizeBytes, 4096u);
+	EXPECT_EQ(response.torrents.front().completed, 40);
+	EXPECT_EQ(response.torrents.front().scrapedDate, 1700000100);
+	EXPECT_EQ(response.nextToken, "2");
+	EXPECT_TRUE(response.hasMore);
+	fs::remove_all(directory);
+}
+
+TEST_F(SearchEngineTest, ServesStalePageWhileRefreshingInBackground) {
+	std::atomic<int> calls{0};
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"stale-fixture",
+		[&](const SearchQuery &, SearchResponse &response, const std::function<bool()> &) {
+			const int call = ++calls;
+			response.torrents.emplace_back("v" + std::to_string(call), "magnet:?xt=urn:btih:fixture", "fixture", 1, 1, 0, "", "Test");
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("stale-fixture"));
+
+	SearchResponse response;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("stale"), response));
+	ASSERT_EQ(response.torrents.front().name, "v1");
+
+	// Age the cached page past its freshness window.
+	const uint64_t key = SearchCache::makeKey("stale-fixture", "stale", 0, "");
+	searchCache().store(key, response, SearchCache::Clock::now() - std::chrono::minutes(10));
+
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("stale"), response));
+	ASSERT_EQ(response.torrents.size(), 1u);
+	EXPECT_EQ(response.torrents.front().name, "v1");
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	SearchResponse refreshed;
+	bool refresh = false;
+	while (std::chrono::steady_clock::now() < deadline
+		&& searchCache().lookup(key, refreshed, refresh) != SearchCache::Hit::Fresh)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("stale"), response));
+	ASSERT_EQ(response.torrents.size(), 1u);
+	EXPECT_EQ(response.torrents.front().name, "v2");
+	EXPECT_EQ(calls.load(), 2);
+}
+
+TEST_F(SearchEngineTest, PrefetchesNextPageIntoCache) {
+	std::mutex callsMutex;
+	std::map<std::string, int> calls;
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"paged-fixture",
+		[&](const SearchQuery &query, SearchResponse &response, const std::function<bool()> &) {
+			{
+				std::lock_guard<std::mutex> lock(callsMutex);
+				++calls[query.nextToken];
+			}
+			if (query.nextToken == "2")
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			const int page = query.nextToken.empty() ? 1 : std::stoi(query.nextToken);
+			response.torrents.emplace_back("page " + std::to_string(page), "magnet:?xt=urn:btih:" + std::to_string(page),
+				std::to_string(page), 1, 1, 0, "", "Test");
+			response.hasMore = page < 3;
+			response.nextToken = response.hasMore ? std::to_string(page + 1) : "";
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("paged-fixture"));
+
+	SearchResponse response;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("paged"), response));
+	ASSERT_EQ(response.nextToken, "2");
+	// Page 2 is still being prefetched: the request joins it instead of
+	// sending its own.
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("paged", 0, "2"), response));
+	ASSERT_EQ(response.torrents.size(), 1u);
+	EXPECT_EQ(response.torrents.front().name, "page 2");
+
+	const uint64_t lastPage = SearchCache::makeKey("paged-fixture", "paged", 0, "3");
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (std::chrono::steady_clock::now() < deadline && !searchCache().isFresh(lastPage))
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("paged", 0, "3"), response));
+	EXPECT_EQ(response.torrents.front().name, "page 3");
+	EXPECT_FALSE(response.hasMore);
+
+	std::lock_guard<std::mutex> lock(callsMutex);
+	EXPECT_EQ(calls[""], 1);
+	EXPECT_EQ(calls["2"], 1);
+	EXPECT_EQ(calls["3"], 1);
+}
+
+TEST_F(SearchEngineTest, NewQueryCancelsPrefetchAndBudgetLimitsIt) {
+	std::atomic<bool> prefetchCancelled{false};
+	std::atomic<int> prefetches{0};
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"slow-pages",
+		[&](const SearchQuery &query, SearchResponse &response, const std::function<bool()> &cancelled) {
+			if (!query.nextToken.empty()) {
+				++prefetches;
+				const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+				while (!cancelled() && std::chrono::steady_clock::now() < deadline)
+					std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				prefetchCancelled = cancelled();
+				return Result::Failure("cancelled", ResultCode::Cancelled);
+			}
+			response.torrents.emplace_back(query.query, "magnet:?xt=urn:btih:" + query.query, query.query, 1, 1, 0, "", "Test");
+			response.hasMore = true;
+			response.nextToken = "2";
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("slow-pages"));
+
+	SearchResponse response;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("first"), response));
+	const auto started = std::chrono::steady_clock::now();
+	while (prefetches.load() == 0 && std::chrono::steady_clock::now() - started < std::chrono::seconds(5))
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	ASSERT_EQ(prefetches.load(), 1);
+
+	engine.setPrefetchBudget("slow-pages", 0);
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("second"), response));
+	while (!prefetchCancelled.load() && std::chrono::steady_clock::now() - started < std::chrono::seconds(5))
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	EXPECT_TRUE(prefetchCancelled.load());
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(prefetches.load(), 1);
+}
+
+TEST_F(SearchEngineTest, LocalIndexRanksPartialAndMisspelledMatches) {
+	const std::string ubuntuHash = "0123456789ABCDEF0123456789ABCDEF01234567";
+	LocalSearchIndex index;
+	const auto now = LocalSearchIndex::Clock::now();
+	index.record({
+		TorrentSearchResult("Ubuntu 24.04 Desktop amd64", "magnet:?xt=urn:btih:a", ubuntuHash, 1, 5, 0, "", "Linux"),
+		TorrentSearchResult("Ubuntu 22.04 Server", "magnet:?xt=urn:btih:b", "", 1, 50, 0, "", "Linux"),
+		TorrentSearchResult("Debian 12 netinst", "magnet:?xt=urn:btih:c", "", 1, 80, 0, "", "Linux"),
+		TorrentSearchResult("No identity", "", "", 1, 1, 0, "", "Linux"),
+	}, now);
+	EXPECT_EQ(index.size(), 3u);
+
+	auto results = index.search("ubuntu");
+	ASSERT_EQ(results.size(), 2u);
+	EXPECT_EQ(results[0].name, "Ubuntu 22.04 Server");
+	EXPECT_EQ(index.search("UBUNTO desktop").front().name, "Ubuntu 24.04 Desktop amd64");
+	EXPECT_EQ(index.search("linux").size(), 3u);
+	EXPECT_TRUE(index.search("fedora").empty());
+	EXPECT_TRUE(index.search("  --  ").empty());
+
+	// Favorites rank first among equal matches and never age out.
+	index.setFavorite(TorrentSearchResult("Ubuntu 24.04 Desktop amd64", "", ubuntuHash.substr(0), 1, 5, 0, "", "Linux"), true, now);
+	EXPECT_EQ(index.search("ubuntu").front().name, "Ubuntu 24.04 Desktop amd64");
+	// A renamed result is reindexed under its new name.
+	index.record({TorrentSearchResult("Debian 12.5 DVD", "magnet:?xt=urn:btih:c", "", 1, 90, 0, "", "Linux")}, now);
+	EXPECT_TRUE(index.search("netinst").empty());
+	EXPECT_EQ(index.search("debian dvd").front().seeders, 90);
+
+	namespace fs = std::filesystem;
+	const fs::path directory = fs::temp_directory_path() / ("hypertube_local_index_test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+	const fs::path path = directory / "local-index.json";
+	ASSERT_TRUE(index.save(path, now));
+	EXPECT_FALSE(index.dirty());
+
+	LocalSearchIndex restored(std::chrono::hours(24));
+	ASSERT_TRUE(restored.load(path, now + std::chrono::hours(48)));
+	ASSERT_EQ(restored.size(), 1u);
+	EXPECT_EQ(restored.search("ubuntu").front().infoHash, ubuntuHash);
+	fs::remove_all(directory);
+}
+
+TEST_F(SearchEngineTest, SearchLocalFindsFetchedResultsAndFavorites) {
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"local-fixture",
+		[](const SearchQuery &, SearchResponse &response, const std::function<bool()> &) {
+			response.torrents.emplace_back("Arch Linux 2024.05", "magnet:?xt=urn:btih:arch", "arch", 1, 7, 0, "", "Linux");
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("local-fixture"));
+	EXPECT_TRUE(engine.searchLocal("arch").empty());
+
+	SearchResponse response;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("arch"), response));
+	engine.addToFavorites(TorrentSearchResult("Blender 4.1", "magnet:?xt=urn:btih:blender", "blender", 1, 3, 0, "", "Software"));
+
+	ASSERT_EQ(engine.searchLocal("arch linux").size(), 1u);
+	ASSERT_EQ(engine.searchLocal("blender").size(), 1u);
+	engine.removeFromFavorites("blender");
+	// No longer a favorite, but still a result seen recently.
+	EXPECT_EQ(engine.searchLocal("blender").size(), 1u);
+}
+
+TEST_F(SearchEngineTest, FanOutMergesProvidersAndCutsOffStragglers) {
+	const std::string shared = "0123456789abcdef0123456789abcdef01234567";
+	// torrents-csv always joins a fan-out; point it somewhere that refuses fast.
+	engine.setApiUrl("http://127.0.0.1:1/search");
+	engine.setMaxRetries(1);
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"fast",
+		[&](const SearchQuery &query, SearchResponse &response, const std::function<bool()> &) {
+			if (query.nextToken.empty()) {
+				response.torrents.emplace_back("Shared", "magnet:?xt=urn:btih:" + shared, shared, 10, 3, 1, "", "General");
+				response.hasMore = true;
+				response.nextToken = "page-2";
+			} else {
+				response.torrents.emplace_back("Fast page 2", "magnet:?xt=urn:btih:fixture", "1111111111111111111111111111111111111111", 1, 1, 0, "", "Test");
+			}
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"indexer",
+		[&](const SearchQuery &, SearchResponse &response, const std::function<bool()> &) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			response.torrents.emplace_back("Shared", "magnet:?xt=urn:btih:" + shared, "0123456789ABCDEF0123456789ABCDEF01234567", 0, 9, 4, "2024-01-01", "Video");
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.registerSearchProvider(
+		"stalled",
+		[](const SearchQuery &, SearchResponse &, const std::function<bool()> &cancelled) {
+			while (!cancelled())
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			return Result::Failure("cancelled", ResultCode::Cancelled);
+		}));
+	engine.setFanOutEnabled(true);
+	engine.setFanOutGrace(std::chrono::milliseconds(200));
+
+	SearchResponse response;
+	const auto started = std::chrono::steady_clock::now();
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("shared"), response));
+	EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(5));
+	ASSERT_EQ(response.torrents.size(), 1u);
+	EXPECT_EQ(response.torrents[0].seeders, 9);
+	EXPECT_EQ(response.torrents[0].sizeBytes, 10u);
+	EXPECT_EQ(response.torrents[0].category, "Video");
+	ASSERT_TRUE(response.hasMore);
+
+	// The next page only asks providers that reported more.
+	SearchResponse next;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("shared", 0, response.nextToken), next));
+	ASSERT_EQ(next.torrents.size(), 1u);
+	EXPECT_EQ(next.torrents[0].name, "Fast page 2");
+	EXPECT_FALSE(next.hasMore);
+}
+
 TEST_F(SearchEngineTest, AsyncSearchRejectsConcurrentRequestAndPublishesCompletion) {
     std::mutex mutex;
     std::condition_variable enteredCv;
@@ -400,6 +807,73 @@ TEST_F(SearchEngineTest, ParsesTorznabResultsAndPagination) {
 	EXPECT_EQ(response.nextToken, "1");
 }
 
+TEST_F(SearchEngineTest, TorznabParserIsIndependentOfChunkBoundaries) {
+	const std::string xml = R"(<?xml version="1.0" encoding="UTF-8"?>
+	<!DOCTYPE rss>
+	<rss version="2.0" xmlns:torznab="http://torznab.com/schemas/2015/feed">
+	<channel><title>Indexer &amp; Co</title>
+	<newznab:response offset='100' total="250" />
+	<!-- <item><title>commented out</title></item> -->
+	<item>
+		<title><![CDATA[Movie <2024> ]]] & Extras]]>&#233;&#x1F600; &amp;&bogus; R&amp;D</title>
+		<guid isPermaLink="false">https://indexer.example/details/1</guid>
+		<link>https://indexer.example/download/1</link>
+		<size> 4096</size>
+		<pubDate>Mon, 01 Jan 2024 00:00:00 +0000</pubDate>
+		<category>2000</category><category>2040</category>
+		<enclosure url="https://indexer.example/download/1" length="4096" type="application/x-bittorrent"/>
+		<torznab:attr name="seeders" value="30"/>
+		<torznab:attr name="seeders" value="1"/>
+		<torznab:attr name='peers' value='5'/>
+		<torznab:attr name="infohash" value="ABCDEFABCDEFABCDEFABCDEFABCDEFABCDEFABCD"/>
+	</item>
+	<item><title>Magnet only</title><link>magnet:?xt=urn:btih:1234567890abcdef1234567890abcdef12345678&amp;dn=x</link></item>
+	<item><title>No hash</title><guid>not-a-hash</guid></item>
+	<item><title>Duplicate</title><guid>abcdefabcdefabcdefabcdefabcdefabcdefabcd</guid></item>
+	</channel></rss>)";
+
+	SearchResponse whole;
+	ASSERT_TRUE(parseTorznab(xml, whole));
+	ASSERT_EQ(whole.torrents.size(), 2u);
+	EXPECT_EQ(whole.torrents[0].name, "Movie <2024> ]]] & Extras\xC3\xA9\xF0\x9F\x98\x80 &&bogus; R&D");
+	EXPECT_EQ(whole.torrents[0].infoHash, "abcdefabcdefabcdefabcdefabcdefabcdefabcd");
+	EXPECT_EQ(whole.torrents[0].sizeBytes, 4096u);
+	EXPECT_EQ(whole.torrents[0].seeders, 30);
+	EXPECT_EQ(whole.torrents[0].leechers, 5);
+	EXPECT_EQ(whole.torrents[0].category, "2000");
+	EXPECT_EQ(whole.torrents[0].dateUploaded, "Mon, 01 Jan 2024 00:00:00 +0000");
+	EXPECT_EQ(whole.torrents[1].magnetUri, "magnet:?xt=urn:btih:1234567890abcdef1234567890abcdef12345678&dn=x");
+	EXPECT_EQ(whole.torrents[1].infoHash, "1234567890abcdef1234567890abcdef12345678");
+	EXPECT_EQ(whole.torrents[1].category, "General");
+	EXPECT_TRUE(whole.hasMore);
+	EXPECT_EQ(whole.nextToken, "102");
+
+	for (const std::size_t chunkSize : {std::size_t{1}, std::size_t{3}, std::size_t{17}}) {
+		SearchResponse streamed;
+		TorznabParser parser(streamed);
+		for (std::size_t offset = 0; offset < xml.size(); offset += chunkSize)
+			ASSERT_TRUE(parser.feed(std::string_view(xml).substr(offset, chunkSize)));
+		ASSERT_TRUE(parser.finish());
+		ASSERT_EQ(streamed.torrents.size(), whole.torrents.size()) << chunkSize;
+		for (std::size_t index = 0; index < whole.torrents.size(); ++index) {
+			EXPECT_EQ(streamed.torrents[index].name, whole.torrents[index].name) << chunkSize;
+			EXPECT_EQ(streamed.torrents[index].magnetUri, whole.torrents[index].magnetUri) << chunkSize;
+		}
+		EXPECT_EQ(streamed.nextToken, whole.nextToken);
+	}
+
+	// A provider error stops the parse where it appears.
+	SearchResponse failed;
+	TorznabParser parser(failed);
+	EXPECT_FALSE(parser.feed(R"(<?xml version="1.0"?><error code="429" description="Too &quot;many&quot; requests"/><rss>)"));
+	Result error = parser.finish();
+	EXPECT_EQ(error.code, ResultCode::Unavailable);
+	EXPECT_EQ(error.message, "Too \"many\" requests");
+
+	SearchResponse truncated;
+	EXPECT_EQ(parseTorznab("<rss><channel><item><title>Cut", truncated).code, ResultCode::Parse);
+}
+
 TEST_F(SearchEngineTest, RejectsInvalidTorznabConfigurationAndProviderErrors) {
 	Result invalid = engine.configureTorznabProvider("file:///tmp/feed");
 	EXPECT_FALSE(invalid);
@@ -438,3 +912,367 @@ TEST_F(SearchEngineTest, ValidatesPreferencesWithoutMutatingRuntimeState) {
 	EXPECT_FALSE(SearchEngine::validateProxyConfig(true, "http", "localhost", 70000).success);
 	EXPECT_TRUE(SearchEngine::validateProxyConfig(false, "socks5", "", 1080).success);
 }
+
+TEST_F(SearchEngineTest, LoadsFavoritesLazilyAndSavesOnlyChanges) {
+	namespace fs = std::filesystem;
+	const fs::path directory = fs::temp_directory_path() / ("hypertube_favorites_test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+	fs::create_directories(directory);
+	const fs::path favoritesPath = directory / "favorites.json";
+
+	ConfigManager store;
+	engine.attachFavoritesStore(store, favoritesPath.string());
+	// Written after attaching: the store is only read on first use.
+	store.saveFavoritesAndHistory(favoritesPath.string(),
+		{TorrentSearchResult("Ubuntu", "magnet:?xt=urn:btih:aa", "aa", 1024, 5, 1, "2024-01-01", "Linux")}, {"ubuntu"});
+	store.waitForAsyncOperations();
+
+	EXPECT_TRUE(engine.isFavorite("aa"));
+	ASSERT_EQ(engine.getFavorites().size(), 1u);
+	EXPECT_EQ(engine.getSearchHistory(), std::vector<std::string>{"ubuntu"});
+
+	// Unchanged state does not rewrite the file.
+	fs::remove(favoritesPath);
+	engine.saveFavoritesAndHistory();
+	store.waitForAsyncOperations();
+	EXPECT_FALSE(fs::exists(favoritesPath));
+
+	engine.addToFavorites(TorrentSearchResult("Debian", "magnet:?xt=urn:btih:bb", "bb", 2048, 3, 0, "2024-02-01", "Linux"));
+	engine.saveFavoritesAndHistory();
+	store.waitForAsyncOperations();
+
+	std::vector<TorrentSearchResult> saved;
+	std::vector<std::string> history;
+	ASSERT_TRUE(store.loadFavoritesAndHistory(favoritesPath.string(), saved, history));
+	ASSERT_EQ(saved.size(), 2u);
+	EXPECT_EQ(saved[1].infoHash, "bb");
+	EXPECT_EQ(saved[1].sizeBytes, 2048u);
+	EXPECT_EQ(history, std::vector<std::string>{"ubuntu"});
+	fs::remove_all(directory);
+}
+
+#ifndef _WIN32
+namespace {
+// Serves scripted HTTP replies on a loopback port. Each request gets the next
+// reply (the last one repeats) and the connection stays open for another
+// request unless the reply says "Connection: close". An empty reply leaves the
+// request unanswered, like a stalled server. Records when each request arrived
+// and how many connections were accepted.
+class ScriptedServer {
+public:
+	explicit ScriptedServer(std::vector<std::string> replies) : replies_(std::move(replies)) {
+		listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		::bind(listener_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+		::listen(listener_, 8);
+		socklen_t length = sizeof(address);
+		::getsockname(listener_, reinterpret_cast<sockaddr *>(&address), &length);
+		url_ = "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + "/search";
+		thread_ = std::thread([this] { run(); });
+	}
+
+	~ScriptedServer() {
+		stop_ = true;
+		thread_.join();
+		::close(listener_);
+	}
+
+	const std::string &url() const { return url_; }
+	int connections() const { return connections_.load(); }
+
+	std::vector<std::chrono::steady_clock::time_point> arrivals() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return arrivals_;
+	}
+
+	bool waitForRequests(std::size_t count, std::chrono::milliseconds timeout) {
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (arrivals().size() < count) {
+			if (std::chrono::steady_clock::now() >= deadline)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	// A 200 reply whose body is sent in chunked encoding, pieceSize bytes at a time.
+	static std::string chunked(const std::string &body, std::size_t pieceSize) {
+		std::string reply = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n";
+		for (std::size_t offset = 0; offset < body.size(); offset += pieceSize) {
+			const std::string piece = body.substr(offset, pieceSize);
+			char size[16];
+			std::snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+			reply += size + piece + "\r\n";
+		}
+		return reply + "0\r\n\r\n";
+	}
+
+private:
+	void run() {
+		std::vector<pollfd> sockets{{listener_, POLLIN, 0}};
+		std::vector<std::string> pending{""};
+		while (!stop_.load()) {
+			if (::poll(sockets.data(), sockets.size(), 20) <= 0)
+				continue;
+			for (std::size_t index = 0; index < sockets.size(); ++index) {
+				if (!(sockets[index].revents & (POLLIN | POLLHUP)))
+					continue;
+				if (index == 0) {
+					sockets.push_back({::accept(listener_, nullptr, nullptr), POLLIN, 0});
+					pending.emplace_back();
+					++connections_;
+					continue;
+				}
+				char buffer[1024];
+				const ssize_t received = ::recv(sockets[index].fd, buffer, sizeof(buffer), 0);
+				if (received <= 0) {
+					closeClient(sockets[index]);
+					continue;
+				}
+				pending[index].append(buffer, static_cast<std::size_t>(received));
+				if (pending[index].find("\r\n\r\n") == std::string::npos)
+					continue;
+				pending[index].clear();
+				std::string reply;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					reply = replies_[std::min(arrivals_.size(), replies_.size() - 1)];
+					arrivals_.push_back(std::chrono::steady_clock::now());
+				}
+				if (reply.empty())
+					continue;
+				::send(sockets[index].fd, reply.data(), reply.size(), 0);
+				if (reply.find("Connection: close\r\n") != std::string::npos)
+					closeClient(sockets[index]);
+			}
+		}
+		for (std::size_t index = 1; index < sockets.size(); ++index)
+			closeClient(sockets[index]);
+	}
+
+	static void closeClient(pollfd &socket) {
+		if (socket.fd >= 0)
+			::close(socket.fd);
+		// poll() skips negative descriptors.
+		socket.fd = -1;
+	}
+
+	std::vector<std::string> replies_;
+	int listener_ = -1;
+	std::string url_;
+	std::atomic<bool> stop_{false};
+	std::atomic<int> connections_{0};
+	std::mutex mutex_;
+	std::vector<std::chrono::steady_clock::time_point> arrivals_;
+	std::thread thread_;
+};
+
+const std::string emptyPage = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\n[]";
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(SearchEngineTest, ReusesPooledConnectionAcrossRequests) {
+	ScriptedServer server({"HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok"});
+	std::string first;
+	std::string second;
+	EXPECT_TRUE(httpGet(server.url(), first));
+	EXPECT_TRUE(httpGet(server.url() + "?page=2", second));
+
+	EXPECT_EQ(first, "ok");
+	EXPECT_EQ(second, "ok");
+	EXPECT_EQ(server.arrivals().size(), 2u);
+	EXPECT_EQ(server.connections(), 1);
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(SearchEngineTest, CancellationDropsStalledTransferWithoutWaitingForCurl) {
+	// Accepts the request and never answers it.
+	ScriptedServer server({""});
+	engine.setApiUrl(server.url());
+	engine.setTimeout(30);
+	engine.setMaxRetries(1);
+	uint64_t requestId = 0;
+	ASSERT_TRUE(engine.startSearch(SearchQuery("stalled"), requestId));
+	ASSERT_TRUE(server.waitForRequests(1, std::chrono::seconds(5)));
+
+	const auto cancelled = std::chrono::steady_clock::now();
+	engine.cancelCurrentSearch();
+	std::optional<CompletedSearch> completion;
+	while (!completion && std::chrono::steady_clock::now() - cancelled < std::chrono::seconds(5)) {
+		completion = engine.takeCompletedSearch();
+		if (!completion)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - cancelled;
+
+	ASSERT_TRUE(completion.has_value());
+	EXPECT_EQ(completion->requestId, requestId);
+	EXPECT_EQ(completion->result.code, ResultCode::Cancelled);
+	// curl's own progress callbacks only fire about once a second on an idle
+	// transfer; the wakeup does not wait for them.
+	EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(SearchEngineTest, StreamsTorrentsCsvBodyFromTransfer) {
+	std::string body = R"({"torrents": [)";
+	for (int index = 0; index < 200; ++index) {
+		char hash[41];
+		std::snprintf(hash, sizeof(hash), "%040x", index + 1);
+		body += std::string(index ? "," : "") + R"({"name": "Torrent )" + std::to_string(index) + R"(", "infohash": ")" + hash + R"(", "seeders": )" + std::to_string(index) + "}";
+	}
+	body += R"(], "next": "page-2"})";
+	// Small chunked-encoding pieces split tokens across reads.
+	ScriptedServer server({ScriptedServer::chunked(body, 37)});
+
+	engine.setApiUrl(server.url());
+	engine.setMaxRetries(1);
+	SearchResponse response;
+	Result result = engine.searchTorrents(SearchQuery("streamed"), response);
+
+	ASSERT_TRUE(result) << result.message;
+	ASSERT_EQ(response.torrents.size(), 200u);
+	EXPECT_EQ(response.torrents[199].name, "Torrent 199");
+	EXPECT_EQ(response.torrents[199].seeders, 199);
+	EXPECT_EQ(response.nextToken, "page-2");
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(SearchEngineTest, HonoursRetryAfterAndProviderRateLimit) {
+	ScriptedServer server({"HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+		emptyPage});
+	engine.setApiUrl(server.url());
+	engine.setMaxRetries(2);
+	ASSERT_TRUE(engine.setProviderRateLimit("torrents-csv", 600, 1));
+	EXPECT_EQ(engine.setProviderRateLimit("missing", 600, 1).code, ResultCode::NotFound);
+
+	SearchResponse response;
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("first"), response));
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("second"), response));
+	ASSERT_TRUE(engine.searchTorrents(SearchQuery("third"), response));
+
+	const auto arrivals = server.arrivals();
+	ASSERT_EQ(arrivals.size(), 4u);
+	// The retry waits for Retry-After, not the shorter default backoff.
+	EXPECT_GE(arrivals[1] - arrivals[0], std::chrono::milliseconds(900));
+	// 600 requests per minute with no burst spaces the searches 100 ms apart.
+	EXPECT_GE(arrivals[2] - arrivals[1], std::chrono::milliseconds(90));
+	EXPECT_GE(arrivals[3] - arrivals[2], std::chrono::milliseconds(90));
+}
+
+TEST_F(SearchEngineTest, OpenCircuitFailsFastAcrossSearches) {
+	ScriptedServer server({"HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"});
+	HostPolicy policy;
+	policy.requestsPerSecond = 0;
+	policy.backoffBase = std::chrono::milliseconds(10);
+	policy.failureThreshold = 3;
+	policy.cooldown = std::chrono::minutes(1);
+	httpClient().setHostPolicy(HttpClient::hostKey(server.url()), policy);
+	engine.setApiUrl(server.url());
+	engine.setMaxRetries(2);
+
+	SearchResponse response;
+	// Two failures, then one more opens the circuit during the retry's wait.
+	EXPECT_EQ(engine.searchTorrents(SearchQuery("first"), response).code, ResultCode::Network);
+	const Result second = engine.searchTorrents(SearchQuery("second"), response);
+	EXPECT_FALSE(second);
+	const auto opened = std::chrono::steady_clock::now();
+	const Result third = engine.searchTorrents(SearchQuery("third"), response);
+
+	EXPECT_EQ(third.code, ResultCode::Unavailable);
+	EXPECT_TRUE(third.retryable);
+	EXPECT_LT(std::chrono::steady_clock::now() - opened, std::chrono::milliseconds(500));
+	EXPECT_EQ(server.arrivals().size(), 3u);
+	EXPECT_EQ(HttpClient::hostKey("HTTPS://Example.COM:443/x"), "example.com");
+	EXPECT_EQ(HttpClient::hostKey("http://127.0.0.1:9117/api"), "127.0.0.1:9117");
+}
+#endif
+
+TEST_F(SearchEngineTest, QueuesStreamedBatchesBeforeCompletion) {
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool released = false;
+	ASSERT_TRUE(engine.registerStreamingSearchProvider("streaming",
+		[&](const SearchQuery &, SearchResponse &response, const std::function<bool()> &, const SearchEngine::SearchResultSink &sink) {
+			response.torrents.emplace_back("First", "", "1111111111111111111111111111111111111111", 1, 5, 0, "", "");
+			sink(std::vector<TorrentSearchResult>(response.torrents));
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return released; });
+			response.torrents.emplace_back("Second", "", "2222222222222222222222222222222222222222", 1, 3, 0, "", "");
+			sink({response.torrents.back()});
+			return Result::Success();
+		}));
+	ASSERT_TRUE(engine.setActiveSearchProvider("streaming"));
+
+	uint64_t requestId = 0;
+	ASSERT_TRUE(engine.startSearch(SearchQuery("streamed"), requestId));
+	std::optional<SearchBatch> batch;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (!batch && std::chrono::steady_clock::now() < deadline) {
+		batch = engine.takeSearchBatch();
+		if (!batch)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_TRUE(batch.has_value());
+	EXPECT_EQ(batch->requestId, requestId);
+	ASSERT_EQ(batch->torrents.size(), 1u);
+	EXPECT_EQ(batch->torrents[0].name, "First");
+	EXPECT_FALSE(engine.takeCompletedSearch().has_value());
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		released = true;
+	}
+	changed.notify_all();
+	std::optional<CompletedSearch> completion;
+	while (!completion && std::chrono::steady_clock::now() < deadline) {
+		completion = engine.takeCompletedSearch();
+		if (!completion)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	ASSERT_TRUE(completion.has_value());
+	EXPECT_EQ(completion->response.torrents.size(), 2u);
+	batch = engine.takeSearchBatch();
+	ASSERT_TRUE(batch.has_value());
+	EXPECT_EQ(batch->torrents[0].name, "Second");
+	EXPECT_FALSE(engine.takeSearchBatch().has_value());
+}
+
+#ifndef _WIN32
+TEST_F(SearchEngineTest, StreamsTorrentsCsvResultsAsTheyAreParsed) {
+	std::string body = R"({"torrents": [)";
+	for (int index = 0; index < 300; ++index) {
+		char hash[41];
+		std::snprintf(hash, sizeof(hash), "%040x", index + 1);
+		body += std::string(index ? "," : "") + R"({"name": "Torrent )" + std::to_string(index) + R"(", "infohash": ")" + hash + R"("})";
+	}
+	body += "]}";
+	ScriptedServer server({"HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body});
+	engine.setApiUrl(server.url());
+
+	std::vector<TorrentSearchResult> streamed;
+	SearchResponse response;
+	ASSERT_TRUE(performSearch(SearchQuery("streamed"), response, [&](std::vector<TorrentSearchResult> &&batch) {
+		EXPECT_FALSE(batch.empty());
+		streamed.insert(streamed.end(), batch.begin(), batch.end());
+	}));
+
+	ASSERT_EQ(streamed.size(), 300u);
+	ASSERT_EQ(response.torrents.size(), 300u);
+	for (std::size_t index = 0; index < streamed.size(); ++index)
+		EXPECT_EQ(streamed[index].infoHash, response.torrents[index].infoHash);
+
+	// A cached page is answered whole, without batches.
+	streamed.clear();
+	ASSERT_TRUE(performSearch(SearchQuery("streamed"), response, [&](std::vector<TorrentSearchResult> &&batch) {
+		streamed.insert(streamed.end(), batch.begin(), batch.end());
+	}));
+	EXPECT_TRUE(streamed.empty());
+	EXPECT_EQ(response.torrents.size(), 300u);
+}
+#endif
@@ -1,10 +1,17 @@
 #include <gtest/gtest.h>
 #include "AppPaths.hpp"
+#include "BoundedQueue.hpp"
+#include "DurableFile.hpp"
+#include "StartupProfiler.hpp"
 #include "SystemUtils.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <stdexcept>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -137,4 +144,156 @@ TEST(SystemOpenerTest, DestroysCleanlyWithPendingWork)
 	std::filesystem::remove(tempFile, error);
 }
 
+TEST(StartupProfilerTest, ChargesPhasesWithTheirOwnThreadCpuTime)
+{
+	Utils::StartupProfiler profiler;
+	std::atomic<bool> spinning{true};
+	std::thread worker([&]()
+	{
+		auto phase = profiler.phase("busy");
+		const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(150);
+		while (std::chrono::steady_clock::now() < until)
+		{
+		}
+		spinning = false;
+	});
+	{
+		// Overlaps the busy worker without using CPU itself.
+		auto phase = profiler.phase("idle");
+		while (spinning)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	worker.join();
+
+	const std::string json = profiler.toJson();
+	auto cpuMilliseconds = [&json](const std::string &name)
+	{
+		const auto entry = json.find("{\"name\": \"" + name + "\"");
+		const auto field = json.find("\"cpu_ms\": ", entry);
+		return std::stod(json.substr(field + 10));
+	};
+	EXPECT_GT(cpuMilliseconds("busy"), 50.0);
+	EXPECT_LT(cpuMilliseconds("idle"), 50.0);
+}
+
+TEST(StartupProfilerTest, AccumulatesPhasesAndReportsSamplePercentiles)
+{
+	Utils::StartupProfiler profiler;
+	{
+		auto phase = profiler.phase("settings_load");
+	}
+	{
+		auto phase = profiler.phase("credential_store");
+	}
+	{
+		auto phase = profiler.phase("settings_load");
+	}
+	for (int sample = 1; sample <= 100; ++sample)
+		profiler.addSample("torrent_restore", std::chrono::milliseconds(sample));
+
+	const std::string json = profiler.toJson();
+	EXPECT_NE(json.find("{\"name\": \"settings_load\""), std::string::npos);
+	EXPECT_NE(json.find("\"count\": 2}"), std::string::npos);
+	EXPECT_LT(json.find("settings_load"), json.find("credential_store"));
+	EXPECT_NE(json.find("\"torrent_restore\": {\"count\": 100, \"p50_ms\": 50.000, \"p90_ms\": 90.000, \"p99_ms\": 99.000, \"max_ms\": 100.000}"), std::string::npos);
+
+	const std::string summary = profiler.summary();
+	EXPECT_EQ(summary.rfind("Startup took ", 0), 0U);
+	EXPECT_NE(summary.find("torrent_restore p50 50.0 ms"), std::string::npos);
+
+	const auto reportPath = std::filesystem::temp_directory_path() / "hypertube-startup-test" / "startup-report.json";
+	ASSERT_TRUE(profiler.writeReport(reportPath));
+	std::ifstream report(reportPath);
+	const std::string written((std::istreambuf_iterator<char>(report)), std::istreambuf_iterator<char>());
+	EXPECT_NE(written.find("\"phases\""), std::string::npos);
+	std::error_code error;
+	std::filesystem::remove_all(reportPath.parent_path(), error);
+}
+
+TEST(DurableFileTest, AtomicWriteReplacesOrKeepsThePreviousFile)
+{
+	const auto directory = std::filesystem::temp_directory_path() / "hypertube-durable-file-test";
+	const auto path = directory / "state.json";
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+
+	ASSERT_TRUE(Utils::writeFileAtomically(path, [](std::ostream &stream) { stream << "first"; }));
+	ASSERT_TRUE(Utils::writeFileAtomically(path, [](std::ostream &stream) { stream << "second"; }, true));
+	const Result abandoned = Utils::writeFileAtomically(path, [](std::ostream &stream)
+	{
+		stream << "partial";
+		throw std::runtime_error("serializer failed");
+	});
+	EXPECT_FALSE(abandoned);
+	EXPECT_EQ(abandoned.code, ResultCode::Storage);
+
+	auto read = [](const std::filesystem::path &file)
+	{
+		std::ifstream stream(file, std::ios::binary);
+		return std::string((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	};
+	EXPECT_EQ(read(path), "second");
+	EXPECT_EQ(read(path.string() + ".bak"), "first");
+	EXPECT_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+	std::filesystem::remove_all(directory, error);
+}
+
+TEST(BoundedQueueTest, RejectsPushWhenFullAndKeepsOrder)
+{
+	Utils::BoundedQueue<int> queue(3);
+	ASSERT_EQ(queue.capacity(), 4U);
+	for (int value = 0; value < 4; ++value)
+		EXPECT_TRUE(queue.tryPush(int(value)));
+	EXPECT_FALSE(queue.tryPush(4));
+
+	int value = -1;
+	for (int expected = 0; expected < 4; ++expected)
+	{
+		ASSERT_TRUE(queue.tryPop(value));
+		EXPECT_EQ(value, expected);
+	}
+	EXPECT_FALSE(queue.tryPop(value));
+	EXPECT_TRUE(queue.tryPush(5));
+}
+
+TEST(BoundedQueueTest, DeliversEveryItemOnceAcrossThreads)
+{
+	constexpr int producers = 4;
+	constexpr int perProducer = 20000;
+	Utils::BoundedQueue<int> queue(64);
+	std::vector<std::thread> threads;
+	for (int producer = 0; producer < producers; ++producer)
+	{
+		threads.emplace_back([&queue, producer]
+		{
+			for (int index = 0; index < perProducer; ++index)
+			{
+				while (!queue.tryPush(producer * perProducer + index))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	std::vector<int> seen(producers * perProducer, 0);
+	std::vector<int> lastByProducer(producers, -1);
+	int received = 0;
+	while (received < producers * perProducer)
+	{
+		int value = 0;
+		if (!queue.tryPop(value))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		++seen[value];
+		// Each producer's items arrive in the order it pushed them.
+		EXPECT_GT(value, lastByProducer[value / perProducer]);
+		lastByProducer[value / perProducer] = value;
+		++received;
+	}
+	for (auto &thread : threads)
+		thread.join();
+	EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), producers * perProducer);
+}
+
 } // namespace
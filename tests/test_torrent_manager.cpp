@@ -3,8 +3,11 @@
 #include "TorrentManager.hpp"
 #include "ConfigManager.hpp"
 
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <iterator>
 #include <random>
 #include <stdexcept>
 #include <thread>
@@ -43,10 +46,13 @@ protected:
 		std::filesystem::remove_all(testDirectory, error);
 	}
 
-	std::filesystem::path writeTorrentFile()
+	std::filesystem::path writeTorrentFile(const std::string &announce = {})
 	{
 		const auto path = testDirectory / "fixture.torrent";
-		std::string content = "d4:infod6:lengthi1e4:name7:fixture12:piece lengthi16384e6:pieces20:";
+		std::string content = "d";
+		if (!announce.empty())
+			content += "8:announce" + std::to_string(announce.size()) + ":" + announce;
+		content += "4:infod6:lengthi1e4:name7:fixture12:piece lengthi16384e6:pieces20:";
 		content.append(20, '\0');
 		content += "ee";
 		std::ofstream file(path, std::ios::binary);
@@ -116,7 +122,12 @@ TEST_F(TorrentManagerTest, FastResumeSnapshotCanRestoreTorrent)
 		ASSERT_TRUE(manager.getPersistenceSnapshot(snapshot, std::chrono::seconds(2)));
 		ASSERT_EQ(snapshot.size(), 1u);
 		ASSERT_FALSE(snapshot.front().resumeData.empty());
-		persisted.magnetUri = lt::make_magnet_uri(snapshot.front().handle);
+		// Identity comes from cached state, not a call into the session.
+		EXPECT_EQ(snapshot.front().magnetUri.rfind("magnet:?xt=urn:bt", 0), 0u);
+		manager.refreshStatusCache();
+		ASSERT_TRUE(manager.getPersistenceSnapshot(snapshot, std::chrono::seconds(2)));
+		EXPECT_EQ(std::filesystem::path(snapshot.front().savePath), downloadPath);
+		persisted.magnetUri = snapshot.front().magnetUri;
 		persisted.savePath = downloadPath.string();
 		persisted.torrentFilePath = torrentPath.string();
 		persisted.resumeData = snapshot.front().resumeData;
@@ -236,3 +247,246 @@ TEST_F(TorrentManagerTest, EventDrainingDoesNotInterfereWithPersistenceAlerts)
 	ASSERT_EQ(snapshot.size(), 1u);
 	EXPECT_FALSE(snapshot.front().resumeData.empty());
 }
+
+TEST_F(TorrentManagerTest, PersistsSessionStateAndIgnoresCorruptFiles)
+{
+	const auto statePath = testDirectory / "session.dat";
+	{
+		TorrentManager manager(statePath);
+		manager.setDownloadSpeedLimit(123456);
+		manager.setUploadSpeedLimit(65432);
+		ASSERT_TRUE(manager.saveSessionState());
+		EXPECT_TRUE(manager.saveSessionState());
+	}
+	ASSERT_TRUE(std::filesystem::is_regular_file(statePath));
+	EXPECT_FALSE(std::filesystem::exists(statePath.string() + ".tmp"));
+
+	{
+		TorrentManager restored(statePath);
+		EXPECT_EQ(restored.getDownloadSpeedLimit(), 123456);
+		EXPECT_EQ(restored.getUploadSpeedLimit(), 65432);
+		EXPECT_TRUE(restored.saveSessionState());
+	}
+
+	{
+		std::ofstream file(statePath, std::ios::binary | std::ios::trunc);
+		file << "not bencode";
+	}
+	TorrentManager recovered(statePath);
+	EXPECT_EQ(recovered.getDownloadSpeedLimit(), 0);
+	ASSERT_TRUE(recovered.saveSessionState());
+	std::ifstream file(statePath, std::ios::binary);
+	const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	EXPECT_NE(content, "not bencode");
+}
+
+TEST_F(TorrentManagerTest, ShutdownFlushReportsProgressAndStopsCheckpoints)
+{
+	TorrentManager manager;
+	const auto torrentPath = writeTorrentFile();
+	ASSERT_TRUE(manager.addTorrent(torrentPath.string(), (testDirectory / "downloads").string()));
+
+	std::vector<PersistenceProgress> reports;
+	std::vector<ManagedTorrent> snapshot;
+	ASSERT_TRUE(manager.flushForShutdown(snapshot, std::chrono::seconds(2),
+		[&reports](const PersistenceProgress &progress) { reports.push_back(progress); }));
+	ASSERT_EQ(snapshot.size(), 1u);
+	EXPECT_FALSE(snapshot.front().resumeData.empty());
+	ASSERT_FALSE(reports.empty());
+	EXPECT_EQ(reports.back().completed, reports.back().total);
+
+	std::vector<ManagedTorrent> late;
+	EXPECT_FALSE(manager.getPersistenceSnapshot(late, std::chrono::milliseconds(10)));
+	EXPECT_FALSE(manager.requestPersistenceSnapshot());
+}
+
+TEST_F(TorrentManagerTest, ShutdownFlushStopsBackgroundRestoreBetweenTorrents)
+{
+	TorrentManager manager;
+	std::vector<TorrentConfigData> persisted(2);
+	persisted[0].torrentFilePath = writeTorrentFile().string();
+	persisted[0].savePath = (testDirectory / "downloads").string();
+	persisted[1].magnetUri = "magnet:?xt=urn:btih:0123456789abcdef0123456789abcdef01234567&dn=restored";
+	persisted[1].savePath = (testDirectory / "downloads").string();
+
+	std::promise<void> firstRestored;
+	auto firstRestoredFuture = firstRestored.get_future();
+	std::atomic<int> samples{0};
+	std::atomic<bool> completed{false};
+	manager.restoreTorrentsInBackground(persisted,
+		[&samples, &firstRestored](std::chrono::nanoseconds)
+		{
+			if (++samples == 1)
+			{
+				firstRestored.set_value();
+				// Holds the worker until the flush has asked it to stop.
+				std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			}
+		},
+		[&completed]() { completed = true; });
+
+	firstRestoredFuture.wait();
+	std::vector<ManagedTorrent> snapshot;
+	ASSERT_TRUE(manager.flushForShutdown(snapshot, std::chrono::seconds(2)));
+	EXPECT_TRUE(completed.load());
+	EXPECT_FALSE(manager.isRestoringTorrents());
+	EXPECT_EQ(samples.load(), 1);
+	// The magnet the restore never reached is saved from its persisted entry.
+	ASSERT_EQ(snapshot.size(), 2u);
+	EXPECT_EQ(manager.getTorrentSnapshot().size(), 1u);
+	EXPECT_EQ(snapshot[1].magnetUri, persisted[1].magnetUri);
+	EXPECT_EQ(snapshot[1].savePath, persisted[1].savePath);
+}
+
+TEST_F(TorrentManagerTest, CheckpointDuringRestoreKeepsUnrestoredTorrents)
+{
+	TorrentManager manager;
+	std::vector<TorrentConfigData> persisted(2);
+	persisted[0].torrentFilePath = writeTorrentFile().string();
+	persisted[0].savePath = (testDirectory / "downloads").string();
+	persisted[1].magnetUri = "magnet:?xt=urn:btih:0123456789abcdef0123456789abcdef01234567&dn=restored";
+	persisted[1].savePath = (testDirectory / "downloads").string();
+
+	std::promise<void> firstRestored;
+	auto firstRestoredFuture = firstRestored.get_future();
+	std::promise<void> release;
+	auto releaseFuture = release.get_future().share();
+	manager.restoreTorrentsInBackground(persisted,
+		[&firstRestored, releaseFuture, first = true](std::chrono::nanoseconds) mutable
+		{
+			if (!first)
+				return;
+			first = false;
+			firstRestored.set_value();
+			releaseFuture.wait();
+		});
+
+	firstRestoredFuture.wait();
+	EXPECT_TRUE(manager.isRestoringTorrents());
+	std::vector<ManagedTorrent> snapshot;
+	const Result result = manager.getPersistenceSnapshot(snapshot, std::chrono::seconds(2));
+	release.set_value();
+	ASSERT_TRUE(result) << result.message;
+	ASSERT_EQ(snapshot.size(), 2u);
+	EXPECT_EQ(snapshot[1].magnetUri, persisted[1].magnetUri);
+}
+
+TEST_F(TorrentManagerTest, ShutdownFlushCollectsFinishedBackgroundRestore)
+{
+	TorrentManager manager;
+	std::vector<TorrentConfigData> persisted(2);
+	persisted[0].torrentFilePath = writeTorrentFile().string();
+	persisted[0].savePath = (testDirectory / "downloads").string();
+	persisted[1].magnetUri = "magnet:?xt=urn:btih:0123456789abcdef0123456789abcdef01234567&dn=restored";
+	persisted[1].savePath = (testDirectory / "downloads").string();
+
+	std::promise<void> restored;
+	auto restoredFuture = restored.get_future();
+	manager.restoreTorrentsInBackground(persisted, {}, [&restored]() { restored.set_value(); });
+	restoredFuture.wait();
+
+	std::vector<ManagedTorrent> snapshot;
+	ASSERT_TRUE(manager.flushForShutdown(snapshot, std::chrono::seconds(2)));
+	EXPECT_EQ(snapshot.size(), 2u);
+}
+
+TEST_F(TorrentManagerTest, MovesStorageAndReportsProgress)
+{
+	TorrentManager manager;
+	EXPECT_EQ(manager.moveStorage({}, (testDirectory / "archive").string()).code, ResultCode::InvalidInput);
+	const lt::info_hash_t unknown(lt::sha1_hash("0123456789abcdefghij"));
+	EXPECT_EQ(manager.moveStorage(std::span<const lt::info_hash_t>(&unknown, 1), (testDirectory / "archive").string()).code, ResultCode::NotFound);
+
+	const auto torrentPath = writeTorrentFile();
+	ASSERT_TRUE(manager.addTorrent(torrentPath.string(), (testDirectory / "downloads").string()));
+	const auto snapshot = manager.getTorrentSnapshot();
+	ASSERT_EQ(snapshot.size(), 1u);
+	const std::vector<lt::info_hash_t> hashes{snapshot.front().hash, snapshot.front().hash};
+	const auto archive = testDirectory / "archive";
+	EXPECT_EQ(manager.moveStorage(hashes, archive.string()).code, ResultCode::Partial);
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	StorageMoveProgress progress = manager.getStorageMoveProgress();
+	while (progress.completed + progress.failed < progress.total && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		progress = manager.getStorageMoveProgress();
+	}
+	EXPECT_EQ(progress.total, 1u);
+	EXPECT_EQ(progress.completed, 1u);
+	EXPECT_EQ(progress.active, 0u);
+	EXPECT_EQ(std::filesystem::path(snapshot.front().handle.status(lt::torrent_handle::query_save_path).save_path), archive);
+}
+
+TEST_F(TorrentManagerTest, PersistedMagnetKeepsTrackersOfFileTorrents)
+{
+	TorrentManager manager;
+	ASSERT_TRUE(manager.addTorrent(writeTorrentFile("http://tracker.example/announce").string(), (testDirectory / "downloads").string()));
+
+	std::vector<ManagedTorrent> snapshot;
+	ASSERT_TRUE(manager.getPersistenceSnapshot(snapshot, std::chrono::seconds(2)));
+	ASSERT_EQ(snapshot.size(), 1u);
+	const std::string &magnet = snapshot.front().magnetUri;
+	EXPECT_EQ(magnet.rfind("magnet:?xt=urn:btih:", 0), 0u);
+	EXPECT_NE(magnet.find("&tr=http"), std::string::npos) << magnet;
+	EXPECT_NE(magnet.find("tracker.example"), std::string::npos) << magnet;
+}
+
+TEST_F(TorrentManagerTest, SnapshotAfterMoveRestoresAtTheNewLocation)
+{
+	const auto torrentPath = writeTorrentFile();
+	const auto archive = testDirectory / "archive";
+	TorrentConfigData persisted;
+	{
+		TorrentManager manager;
+		ASSERT_TRUE(manager.addTorrent(torrentPath.string(), (testDirectory / "downloads").string()));
+		// Caches the old location; nothing refreshes it after the move.
+		manager.refreshStatusCache();
+		const auto torrents = manager.getTorrentSnapshot();
+		ASSERT_EQ(torrents.size(), 1u);
+		const lt::info_hash_t hash = torrents.front().hash;
+		ASSERT_TRUE(manager.moveStorage(std::span<const lt::info_hash_t>(&hash, 1), archive.string()));
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		StorageMoveProgress progress = manager.getStorageMoveProgress();
+		while (progress.completed + progress.failed < progress.total && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			progress = manager.getStorageMoveProgress();
+		}
+		ASSERT_EQ(progress.completed, 1u);
+
+		std::vector<ManagedTorrent> snapshot;
+		ASSERT_TRUE(manager.getPersistenceSnapshot(snapshot, std::chrono::seconds(2)));
+		ASSERT_EQ(snapshot.size(), 1u);
+		EXPECT_EQ(std::filesystem::path(snapshot.front().savePath), archive);
+		persisted.magnetUri = snapshot.front().magnetUri;
+		persisted.savePath = snapshot.front().savePath;
+		persisted.torrentFilePath = torrentPath.string();
+		persisted.resumeData = snapshot.front().resumeData;
+	}
+
+	TorrentManager restored;
+	restored.addTorrentsFromConfig({persisted});
+	const auto torrents = restored.getTorrentSnapshot();
+	ASSERT_EQ(torrents.size(), 1u);
+	EXPECT_EQ(std::filesystem::path(torrents.front().handle.status(lt::torrent_handle::query_save_path).save_path), archive);
+}
+
+TEST_F(TorrentManagerTest, BulkQueueMovesValidateHashes)
+{
+	TorrentManager manager;
+	EXPECT_EQ(manager.moveQueue({}, QueueMove::Top).code, ResultCode::InvalidInput);
+	const lt::info_hash_t unknown(lt::sha1_hash("0123456789abcdefghij"));
+	EXPECT_EQ(manager.moveQueue(std::span<const lt::info_hash_t>(&unknown, 1), QueueMove::Bottom).code, ResultCode::NotFound);
+	EXPECT_EQ(manager.setQueuePosition(unknown, 0).code, ResultCode::NotFound);
+
+	const auto torrentPath = writeTorrentFile();
+	ASSERT_TRUE(manager.addTorrent(torrentPath.string(), (testDirectory / "downloads").string()));
+	const auto snapshot = manager.getTorrentSnapshot();
+	ASSERT_EQ(snapshot.size(), 1u);
+	const std::vector<lt::info_hash_t> hashes{snapshot.front().hash, unknown};
+	EXPECT_EQ(manager.moveQueue(hashes, QueueMove::Top).code, ResultCode::Partial);
+	EXPECT_TRUE(manager.setQueuePosition(snapshot.front().hash, 0));
+	EXPECT_EQ(manager.setQueuePosition(snapshot.front().hash, -1).code, ResultCode::InvalidInput);
+}
@@ -0,0 +1,255 @@
+#include "ConfigManager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+// Fast-resume blobs are mostly the piece bitfield plus peer and tracker
+// lists; a few KiB is typical for a long-running library.
+constexpr std::size_t minResumeBytes = 256;
+constexpr std::size_t maxResumeBytes = 4096;
+// Share of the torrents whose resume data changes between two checkpoints.
+constexpr double changedPerCheckpoint = 0.01;
+
+std::uint64_t peakResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS_EX counters {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(),
+		reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&counters), sizeof(counters)))
+		return 0;
+	return static_cast<std::uint64_t>(counters.PeakWorkingSetSize);
+#else
+	rusage usage {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024ULL;
+#endif
+#endif
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::uintmax_t fileSize(const std::filesystem::path &path)
+{
+	std::error_code error;
+	const auto size = std::filesystem::file_size(path, error);
+	return error ? 0 : size;
+}
+
+void fillResumeData(std::vector<char> &data, std::mt19937 &random)
+{
+	std::uniform_int_distribution<std::size_t> length(minResumeBytes, maxResumeBytes);
+	std::uniform_int_distribution<int> byte(0, 255);
+	data.resize(length(random));
+	for (char &value : data)
+		value = static_cast<char>(byte(random));
+}
+
+std::vector<ManagedTorrent> syntheticTorrents(std::size_t count, std::mt19937 &random)
+{
+	static constexpr char digits[] = "0123456789abcdef";
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::vector<ManagedTorrent> torrents(count);
+	for (std::size_t index = 0; index < count; ++index)
+	{
+		char bytes[20];
+		std::string hex;
+		for (char &value : bytes)
+		{
+			value = static_cast<char>(byte(random));
+			hex.push_back(digits[static_cast<unsigned char>(value) >> 4]);
+			hex.push_back(digits[static_cast<unsigned char>(value) & 0x0f]);
+		}
+		ManagedTorrent &torrent = torrents[index];
+		torrent.hash = lt::info_hash_t(lt::sha1_hash(bytes));
+		torrent.displayName = "Synthetic torrent " + std::to_string(index);
+		torrent.magnetUri = "magnet:?xt=urn:btih:" + hex + "&dn=Synthetic+torrent+" + std::to_string(index);
+		torrent.savePath = "/srv/downloads/library-" + std::to_string(index % 16);
+		fillResumeData(torrent.resumeData, random);
+	}
+	return torrents;
+}
+
+// Times one saveTorrents() round trip through the worker and reports the
+// bytes it put on disk: a rewritten snapshot plus the fresh journal, or the
+// records appended to the current journal.
+nlohmann::json checkpoint(ConfigManager &manager, const std::filesystem::path &snapshotPath,
+	const std::vector<ManagedTorrent> &torrents)
+{
+	const std::filesystem::path journalPath = snapshotPath.string() + ".journal";
+	std::error_code error;
+	const auto snapshotTimeBefore = std::filesystem::last_write_time(snapshotPath, error);
+	const bool hadSnapshot = !error;
+	const std::uintmax_t journalBefore = fileSize(journalPath);
+
+	// Callers hand over their own snapshot; copying it is not part of a save.
+	std::vector<ManagedTorrent> snapshot = torrents;
+	const auto start = std::chrono::steady_clock::now();
+	manager.saveTorrents(std::move(snapshot));
+	manager.waitForAsyncOperations();
+	const double saveMs = millisecondsSince(start);
+
+	const auto snapshotTimeAfter = std::filesystem::last_write_time(snapshotPath, error);
+	const bool compacted = !error && (!hadSnapshot || snapshotTimeAfter != snapshotTimeBefore);
+	const std::uintmax_t journalAfter = fileSize(journalPath);
+	const std::uintmax_t bytesWritten = compacted
+		? fileSize(snapshotPath) + journalAfter
+		: journalAfter - std::min(journalAfter, journalBefore);
+	return {
+		{"save_ms", saveMs},
+		{"bytes_written", bytesWritten},
+		{"compacted", compacted}};
+}
+
+nlohmann::json runScenario(std::size_t count, const std::filesystem::path &workDirectory, std::mt19937 &random)
+{
+	std::error_code error;
+	std::filesystem::remove_all(workDirectory, error);
+	std::filesystem::create_directories(workDirectory, error);
+	const std::filesystem::path snapshotPath = workDirectory / "torrents.json";
+
+	std::vector<ManagedTorrent> torrents = syntheticTorrents(count, random);
+	std::uintmax_t resumeBytes = 0;
+	for (const auto &torrent : torrents)
+		resumeBytes += torrent.resumeData.size();
+
+	nlohmann::json result = {{"torrents", count}, {"resume_bytes", resumeBytes}};
+	{
+		ConfigManager manager;
+		std::vector<TorrentConfigData> restored;
+		// Binds the manager to the scenario file; nothing exists there yet.
+		manager.loadTorrents(snapshotPath.string(), restored);
+
+		result["initial_save"] = checkpoint(manager, snapshotPath, torrents);
+		result["snapshot_bytes"] = fileSize(snapshotPath);
+
+		const std::size_t changed = std::max<std::size_t>(1, static_cast<std::size_t>(count * changedPerCheckpoint));
+		for (std::size_t index = 0; index < changed; ++index)
+			fillResumeData(torrents[(index * count) / changed].resumeData, random);
+		result["changed_checkpoint"] = checkpoint(manager, snapshotPath, torrents);
+		result["changed_checkpoint"]["changed_torrents"] = changed;
+		result["unchanged_checkpoint"] = checkpoint(manager, snapshotPath, torrents);
+	}
+	torrents.clear();
+	torrents.shrink_to_fit();
+
+	ConfigManager loader;
+	std::vector<TorrentConfigData> restored;
+	const auto loadStart = std::chrono::steady_clock::now();
+	const bool torrentsLoaded = static_cast<bool>(loader.loadTorrents(snapshotPath.string(), restored));
+	result["load_ms"] = millisecondsSince(loadStart);
+	result["loaded_torrents"] = restored.size();
+	result["load_ok"] = torrentsLoaded && restored.size() == count;
+	// Peak RSS is process-wide, so scenarios run from smallest to largest.
+	result["peak_rss_bytes"] = peakResidentBytes();
+
+	std::filesystem::remove_all(workDirectory, error);
+	return result;
+}
+}
+
+int main(int argc, char **argv)
+{
+	const char *usage = "Usage: persistence_bench <report.json> [torrent counts...]\n";
+	if (argc < 2)
+	{
+		std::cerr << usage;
+		return 2;
+	}
+	const std::filesystem::path reportPath = argv[1];
+	std::vector<std::size_t> counts;
+	for (int index = 2; index < argc; ++index)
+	{
+		const std::string argument = argv[index];
+		unsigned long count = 0;
+		std::size_t parsed = 0;
+		try
+		{
+			// stoul accepts whitespace, a sign, and trailing text; none is a count.
+			if (!argument.empty() && argument.front() >= '0' && argument.front() <= '9')
+				count = std::stoul(argument, &parsed);
+		}
+		catch (const std::exception &)
+		{
+			parsed = 0;
+		}
+		if (parsed == 0 || parsed != argument.size())
+		{
+			std::cerr << "Invalid torrent count: " << argument << '\n' << usage;
+			return 2;
+		}
+		if (count == 0)
+		{
+			std::cerr << "Torrent counts must be positive\n";
+			return 2;
+		}
+		counts.push_back(count);
+	}
+	if (counts.empty())
+		counts = {1000, 10000, 50000};
+	std::sort(counts.begin(), counts.end());
+
+	std::error_code error;
+	std::filesystem::create_directories(reportPath.parent_path(), error);
+	const std::filesystem::path workDirectory = reportPath.parent_path() / "persistence-bench-work";
+	// A fixed seed keeps the generated stores identical between runs.
+	std::mt19937 random(0x68797065);
+
+	nlohmann::json scenarios = nlohmann::json::array();
+	bool stable = true;
+	for (const std::size_t count : counts)
+	{
+		nlohmann::json scenario = runScenario(count, workDirectory, random);
+		stable = stable && scenario["load_ok"].get<bool>();
+		std::cout << count << " torrents: save " << scenario["initial_save"]["save_ms"].get<double>()
+			<< " ms, checkpoint " << scenario["changed_checkpoint"]["save_ms"].get<double>() << " ms / "
+			<< scenario["changed_checkpoint"]["bytes_written"].get<std::uintmax_t>() << " bytes, load "
+			<< scenario["load_ms"].get<double>() << " ms, "
+			<< scenario["peak_rss_bytes"].get<std::uint64_t>() / (1024 * 1024) << " MiB peak RSS\n";
+		scenarios.push_back(std::move(scenario));
+	}
+
+	std::ofstream report(reportPath);
+	if (!report)
+	{
+		std::cerr << "Cannot write benchmark report: " << reportPath << '\n';
+		return 1;
+	}
+	report << nlohmann::json{
+		{"min_resume_bytes", minResumeBytes},
+		{"max_resume_bytes", maxResumeBytes},
+		{"changed_per_checkpoint", changedPerCheckpoint},
+		{"scenarios", std::move(scenarios)},
+		{"stable", stable}}.dump(2) << '\n';
+	if (!stable)
+	{
+		std::cerr << "A scenario did not restore every torrent it saved\n";
+		return 1;
+	}
+	return 0;
+}